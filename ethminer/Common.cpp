@@ -18,6 +18,7 @@ along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "Common.h"
 #include "MultiLog.h"
+#include <future>
 
 using namespace std;
 using namespace boost;
@@ -67,6 +68,20 @@ TimerCallback::TimerCallback(CallbackFn _cb) : isRunning(false), m_cb(_cb)
 	m_timer = new asio::deadline_timer(*m_ios);
 }
 
+TimerCallback::~TimerCallback()
+{
+	stop();
+	// the cancelled wait still calls back into this object, so let it drain first.  not
+	// needed (and not possible) if we're being destroyed by our own callback.
+	if (m_bt->get_id() != boost::this_thread::get_id())
+	{
+		std::promise<void> drained;
+		m_ios->post([&] () { drained.set_value(); });
+		drained.get_future().wait();
+	}
+	delete m_timer;
+}
+
 // rate is milliseconds
 void TimerCallback::start(long _rate)
 {
@@ -39,6 +39,7 @@ public:
 	static void Init();
 
 	TimerCallback(CallbackFn _cb);
+	~TimerCallback();
 	// rate is milliseconds
 	void start(long _rate);
 	void stop();
@@ -0,0 +1,153 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FarmSubmitter.h"
+
+#include <libdevcore/Log.h>
+#include <libethcore/VerificationEngine.h>
+#include "KeepAliveHttpClient.h"
+#include "FarmClient.h"
+#include "MultiLog.h"
+
+using namespace std;
+
+namespace
+{
+	// attempts at getting a solution to the node, and the wait before the first retry,
+	// which doubles after every failure.
+	unsigned const c_submitAttempts = 4;
+	unsigned const c_retryMs = 250;
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class FarmSubmitter
+*----------------------------------------------------------------------------------*/
+FarmSubmitter::FarmSubmitter(GenericFarm<EthashProofOfWork>& _f, std::string const& _host, std::string const& _port, unsigned _threads) :
+	m_farm(_f), m_host(_host), m_port(_port)
+{
+	for (unsigned i = 0; i < max(1u, _threads); i++)
+		m_threads.push_back(std::thread(&FarmSubmitter::ioLoop, this));
+}
+
+FarmSubmitter::~FarmSubmitter()
+{
+	{
+		Guard l(x_queue);
+		m_running = false;
+	}
+	m_queueChanged.notify_all();
+	for (auto& t : m_threads)
+		t.join();
+}
+
+void FarmSubmitter::submit(Solution const& _sol, int _miner, WorkPackage const& _current, WorkPackage const& _previous)
+{
+	{
+		Guard l(x_queue);
+		m_queue.push_back(Job{_sol, _miner, _current, _previous, SteadyClock::now()});
+	}
+	m_queueChanged.notify_one();
+}
+
+void FarmSubmitter::ioLoop()
+{
+	setThreadName("submit");
+	// the HTTP client isn't thread safe, so each I/O thread gets its own connection.
+	KeepAliveHttpClient client(m_host, m_port);
+	::FarmClient rpc(client);
+
+	for (;;)
+	{
+		Job job;
+		{
+			UniqueGuard l(x_queue);
+			m_queueChanged.wait(l, [&] () { return !m_running || !m_queue.empty(); });
+			// drain the queue before shutting down, solutions are valuable.
+			if (m_queue.empty())
+				return;
+			job = m_queue.front();
+			m_queue.pop_front();
+		}
+		process(rpc, job);
+	}
+}
+
+void FarmSubmitter::process(FarmClient& _rpc, Job const& _job)
+{
+	LogB << "Solution found; Submitting to node ...";
+
+	// figure out which work package the solution belongs to.  mining carries on with the
+	// current package, so by the time we get here a new block may already be in.
+	WorkPackage const* wp = nullptr;
+	bool stale = false;
+	// the miner that found it evaluated it against the current job already, so that check
+	// is normally answered from the engine's cache.
+	VerificationEngine& engine = VerificationEngine::get();
+	VerificationEngine::Request current{_job.current.seedHash, _job.current.headerHash, _job.sol.nonce, _job.sol.mixHash};
+	VerificationEngine::Request previous{_job.previous.seedHash, _job.previous.headerHash, _job.sol.nonce, _job.sol.mixHash};
+	if (_job.current && VerificationEngine::valid(current, engine.verify(current).get(), _job.current.boundary))
+		wp = &_job.current;
+	else if (_job.previous && VerificationEngine::valid(previous, engine.verify(previous).get(), _job.previous.boundary))
+	{
+		wp = &_job.previous;
+		stale = true;
+	}
+
+	if (!wp)
+	{
+		Guard l(x_report);
+		m_farm.solutionFound(SolutionState::Failed, false, _job.miner);
+		return;
+	}
+
+	// a node that can't be reached says nothing about the solution, so that's retried.  an
+	// error the node sends back is its answer, and counts as a rejection.
+	bool ok = false;
+	bool answered = false;
+	for (unsigned attempt = 0; !answered && attempt < c_submitAttempts; attempt++)
+	{
+		if (attempt)
+		{
+			this_thread::sleep_for(chrono::milliseconds(c_retryMs << (attempt - 1)));
+			LogB << "Retrying solution submission ...";
+		}
+		try
+		{
+			ok = _rpc.eth_submitWork("0x" + toString(_job.sol.nonce), "0x" + toString(wp->headerHash), "0x" + toString(_job.sol.mixHash));
+			answered = true;
+		}
+		catch (jsonrpc::JsonRpcException& e)
+		{
+			LogB << "Error submitting solution : " << e.what();
+			answered = e.GetCode() != jsonrpc::Errors::ERROR_CLIENT_CONNECTOR;
+		}
+	}
+
+	double ms = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - _job.found).count() / 1000.0;
+
+	Guard l(x_report);
+	if (!answered)
+	{
+		m_farm.solutionFound(SolutionState::Unsent, stale, _job.miner);
+		return;
+	}
+	m_submitted++;
+	m_avgMs = m_submitted == 1 ? ms : m_avgMs * 0.8 + ms * 0.2;
+	LogF << "FarmSubmitter : solution submitted in " << ms << " ms, avg = " << m_avgMs << " ms";
+	m_farm.solutionFound(ok ? SolutionState::Accepted : SolutionState::Rejected, stale, _job.miner);
+}
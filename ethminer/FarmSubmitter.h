@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// submits getWork solutions to the node in the background.  miners keep hashing on the
+// current work package while the solution is verified and sent off; a handful of I/O
+// threads (each with its own keep-alive HTTP connection) allow several submissions to be
+// in flight at the same time.  if the node can't be reached, a submission is retried a few
+// times before the solution is reported as unsent.
+
+#include <deque>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <libdevcore/Guards.h>
+#include <libethcore/EthashAux.h>
+#include <libethcore/Farm.h>
+#include "Common.h"
+
+using namespace dev::eth;
+
+class FarmClient;
+
+class FarmSubmitter
+{
+public:
+	using WorkPackage = EthashProofOfWork::WorkPackage;
+	using Solution = EthashProofOfWork::Solution;
+
+	FarmSubmitter(GenericFarm<EthashProofOfWork>& _f, std::string const& _host, std::string const& _port, unsigned _threads);
+	~FarmSubmitter();
+
+	// called from the miner threads.  _current and _previous are the work packages the
+	// solution might belong to.  returns immediately.
+	void submit(Solution const& _sol, int _miner, WorkPackage const& _current, WorkPackage const& _previous);
+
+private:
+	struct Job
+	{
+		Solution sol;
+		int miner;
+		WorkPackage current;
+		WorkPackage previous;
+		SteadyClock::time_point found;
+	};
+
+	void ioLoop();
+	void process(FarmClient& _rpc, Job const& _job);
+
+	GenericFarm<EthashProofOfWork>& m_farm;
+	std::string m_host;
+	std::string m_port;
+
+	Mutex x_queue;
+	std::condition_variable m_queueChanged;
+	std::deque<Job> m_queue;
+	bool m_running = true;
+	std::vector<std::thread> m_threads;
+
+	// serializes result reporting to the farm
+	Mutex x_report;
+	unsigned m_submitted = 0;
+	double m_avgMs = 0;			// found -> response from the node
+};
@@ -0,0 +1,302 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "KeepAliveHttpClient.h"
+
+#include <istream>
+#include <boost/algorithm/string.hpp>
+#include "MultiLog.h"
+
+using namespace std;
+using namespace boost::asio;
+using boost::asio::ip::tcp;
+
+
+namespace
+{
+	// run the io_service until _done is set by a completion handler, or the timeout
+	// expires, in which case the pending operation is cancelled.
+	void runUntil(io_service& _ios, tcp::socket& _socket, unsigned _timeout, bool const& _done, boost::system::error_code& _ec)
+	{
+		deadline_timer timer(_ios);
+		bool timedOut = false;
+		if (_timeout)
+		{
+			timer.expires_from_now(boost::posix_time::milliseconds(_timeout));
+			timer.async_wait([&] (boost::system::error_code const& _e) {
+				if (!_e)
+				{
+					timedOut = true;
+					boost::system::error_code ignored;
+					_socket.cancel(ignored);
+				}
+			});
+		}
+		_ios.reset();
+		while (!_done && _ios.run_one())
+			;
+		timer.cancel();
+		// let the timer's handler run (aborted) before it goes out of scope.
+		_ios.reset();
+		_ios.poll();
+		if (timedOut)
+			_ec = error::timed_out;
+	}
+
+	// the node closed a kept-alive connection before it saw our request.  the only failure
+	// that's safe to retry: nothing of the request was acted on.
+	struct StaleConnection: std::runtime_error
+	{
+		StaleConnection(boost::system::error_code const& _ec): std::runtime_error(_ec.message()) {}
+	};
+
+	bool closedByPeer(boost::system::error_code const& _ec)
+	{
+		return _ec == error::eof || _ec == error::connection_reset || _ec == error::broken_pipe;
+	}
+
+	std::string consume(boost::asio::streambuf& _buf, size_t _n)
+	{
+		std::string s(buffers_begin(_buf.data()), buffers_begin(_buf.data()) + _n);
+		_buf.consume(_n);
+		return s;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class KeepAliveHttpClient
+*----------------------------------------------------------------------------------*/
+KeepAliveHttpClient::Url KeepAliveHttpClient::parseUrl(std::string const& _host, std::string const& _port)
+{
+	Url url;
+	std::string rest = _host;
+	size_t p = rest.find("://");
+	if (p != string::npos)
+	{
+		std::string scheme = boost::to_lower_copy(rest.substr(0, p));
+		if (scheme == "https")
+			throw std::invalid_argument("https is not supported, use an http URL or a local proxy");
+		if (scheme != "http")
+			throw std::invalid_argument("unsupported URL scheme " + scheme);
+		rest = rest.substr(p + 3);
+	}
+
+	p = rest.find('/');
+	url.path = p == string::npos ? "/" : rest.substr(p);
+	std::string authority = rest.substr(0, p);
+	// [v6 address]:port
+	size_t colon = authority.rfind(':');
+	if (colon != string::npos && authority.find(']', colon) == string::npos)
+	{
+		url.host = authority.substr(0, colon);
+		url.port = authority.substr(colon + 1);
+	}
+	else
+	{
+		url.host = authority;
+		url.port = _port;
+	}
+	if (url.host.size() > 1 && url.host.front() == '[' && url.host.back() == ']')
+		url.host = url.host.substr(1, url.host.size() - 2);
+	if (url.port.empty())
+		url.port = "80";
+	if (url.host.empty())
+		throw std::invalid_argument("no host in \"" + _host + "\"");
+	return url;
+}
+
+KeepAliveHttpClient::KeepAliveHttpClient(std::string const& _host, std::string const& _port) :
+	m_url(parseUrl(_host, _port)), m_socket(m_ios)
+{
+}
+
+KeepAliveHttpClient::~KeepAliveHttpClient()
+{
+	close();
+}
+
+void KeepAliveHttpClient::setTimeout(unsigned _ms)
+{
+	m_timeout = _ms;
+}
+
+void KeepAliveHttpClient::close()
+{
+	boost::system::error_code ignored;
+	m_socket.close(ignored);
+	m_connected = false;
+}
+
+void KeepAliveHttpClient::connect()
+{
+	LogF << "Trace: KeepAliveHttpClient::connect " << m_url.host << ":" << m_url.port;
+	tcp::resolver resolver(m_ios);
+	tcp::resolver::query q(m_url.host, m_url.port);
+	boost::asio::connect(m_socket, resolver.resolve(q));
+	m_socket.set_option(tcp::no_delay(true));
+	m_socket.set_option(socket_base::keep_alive(true));
+	m_connected = true;
+}
+
+void KeepAliveHttpClient::SendRPCMessage(const std::string& _message, std::string& _result)
+{
+	_result = post(_message);
+}
+
+std::string KeepAliveHttpClient::post(std::string const& _body)
+{
+	// a connection we've been holding on to may have been closed by the node in the
+	// meantime, so if a re-used connection turns out to be closed before any of the
+	// response arrives, try once more on a new one.  nothing else is retried: after a
+	// timeout or an error status the node may have acted on the request (a submitted
+	// share, say), and a long poll that timed out would just wait as long again.
+	for (int attempt = 0; ; attempt++)
+	{
+		bool reused = m_connected;
+		try
+		{
+			if (!m_connected)
+				connect();
+			return exchange(_body);
+		}
+		catch (StaleConnection const& _e)
+		{
+			close();
+			if (reused && attempt == 0)
+				continue;
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, string("could not connect to ") + m_url.host + ":" + m_url.port + " : " + _e.what());
+		}
+		catch (std::exception const& _e)
+		{
+			close();
+			throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, string("could not connect to ") + m_url.host + ":" + m_url.port + " : " + _e.what());
+		}
+	}
+}
+
+std::string KeepAliveHttpClient::exchange(std::string const& _body)
+{
+	std::string host = m_url.host.find(':') == string::npos ? m_url.host : "[" + m_url.host + "]";
+	std::string request =
+		"POST " + m_url.path + " HTTP/1.1\r\n"
+		"Host: " + host + ":" + m_url.port + "\r\n"
+		"Content-Type: application/json\r\n"
+		"Content-Length: " + to_string(_body.size()) + "\r\n"
+		"Connection: keep-alive\r\n\r\n" + _body;
+	boost::system::error_code ec;
+	boost::asio::write(m_socket, buffer(request), ec);
+	if (ec && closedByPeer(ec))
+		throw StaleConnection(ec);
+	if (ec)
+		throw boost::system::system_error(ec);
+
+	boost::asio::streambuf buf;
+	bool done = false;
+	size_t n = 0;
+	async_read_until(m_socket, buf, "\r\n\r\n", [&] (boost::system::error_code const& _e, size_t _n) {
+		ec = _e;
+		n = _n;
+		done = true;
+	});
+	runUntil(m_ios, m_socket, m_timeout, done, ec);
+	if (ec && closedByPeer(ec) && !buf.size())
+		throw StaleConnection(ec);
+	if (ec)
+		throw boost::system::system_error(ec);
+
+	std::string headers = consume(buf, n);
+	if (headers.compare(0, 12, "HTTP/1.1 200") != 0 && headers.compare(0, 12, "HTTP/1.0 200") != 0)
+		throw std::runtime_error(headers.substr(0, headers.find("\r\n")));
+
+	std::string body;
+	readBody(buf, headers, body);
+
+	std::string lower = boost::to_lower_copy(headers);
+	if (lower.find("connection: close") != string::npos || headers.compare(0, 8, "HTTP/1.0") == 0)
+		close();
+	return body;
+}
+
+void KeepAliveHttpClient::readBody(boost::asio::streambuf& _buf, std::string const& _headers, std::string& _body)
+{
+	std::string lower = boost::to_lower_copy(_headers);
+	boost::system::error_code ec;
+	bool done;
+
+	auto readExactly = [&] (size_t _n) {
+		if (_buf.size() >= _n)
+			return;
+		done = false;
+		async_read(m_socket, _buf, transfer_exactly(_n - _buf.size()), [&] (boost::system::error_code const& _e, size_t) {
+			ec = _e;
+			done = true;
+		});
+		runUntil(m_ios, m_socket, m_timeout, done, ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+	};
+
+	auto readLine = [&] () {
+		done = false;
+		size_t n = 0;
+		async_read_until(m_socket, _buf, "\r\n", [&] (boost::system::error_code const& _e, size_t _n) {
+			ec = _e;
+			n = _n;
+			done = true;
+		});
+		runUntil(m_ios, m_socket, m_timeout, done, ec);
+		if (ec)
+			throw boost::system::system_error(ec);
+		return consume(_buf, n);
+	};
+
+	size_t p = lower.find("content-length:");
+	if (p != string::npos)
+	{
+		size_t len = stoul(lower.substr(p + 15));
+		readExactly(len);
+		_body = consume(_buf, len);
+	}
+	else if (lower.find("transfer-encoding: chunked") != string::npos)
+	{
+		for (;;)
+		{
+			size_t len = stoul(readLine(), nullptr, 16);
+			// chunk data is followed by CRLF
+			readExactly(len + 2);
+			_body += consume(_buf, len);
+			_buf.consume(2);
+			if (len == 0)
+				break;
+		}
+	}
+	else
+	{
+		// no length given. the body runs until the node closes the connection.
+		done = false;
+		async_read(m_socket, _buf, transfer_all(), [&] (boost::system::error_code const& _e, size_t) {
+			ec = _e;
+			done = true;
+		});
+		runUntil(m_ios, m_socket, m_timeout, done, ec);
+		if (ec && ec != error::eof)
+			throw boost::system::system_error(ec);
+		_body = consume(_buf, _buf.size());
+		close();
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// drop-in replacement for jsonrpc::HttpClient that keeps its TCP connection to the node
+// open between requests (HTTP/1.1 keep-alive) instead of paying for a new connection on
+// every call.  like HttpClient, an instance must only be used by one thread at a time.
+// only plain http is spoken; https node URLs are refused up front.
+
+#include <string>
+#include <stdexcept>
+#include <boost/asio.hpp>
+#include <jsonrpccpp/client.h>
+
+class KeepAliveHttpClient: public jsonrpc::IClientConnector
+{
+public:
+	struct Url
+	{
+		std::string host;
+		std::string port;
+		std::string path;
+	};
+
+	// _host is a host name or address, or a URL: [http://]host[:port][/path].  a port in
+	// the URL takes precedence over _port.  throws std::invalid_argument for anything but
+	// http, so callers can check a node's URL before they rely on it.
+	static Url parseUrl(std::string const& _host, std::string const& _port);
+
+	KeepAliveHttpClient(std::string const& _host, std::string const& _port);
+	~KeepAliveHttpClient();
+
+	// throws jsonrpc::JsonRpcException on communication errors.
+	void SendRPCMessage(const std::string& _message, std::string& _result) override;
+
+	// like SendRPCMessage, but returns the raw body of the response.
+	std::string post(std::string const& _body);
+
+	// milliseconds to wait for a response. zero means wait forever.
+	void setTimeout(unsigned _ms);
+	void close();
+
+private:
+	void connect();
+	std::string exchange(std::string const& _body);
+	void readBody(boost::asio::streambuf& _buf, std::string const& _headers, std::string& _body);
+
+	Url m_url;
+	unsigned m_timeout = 0;
+
+	boost::asio::io_service m_ios;
+	boost::asio::ip::tcp::socket m_socket;
+	bool m_connected = false;
+};
@@ -0,0 +1,137 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MVisFrame.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace std;
+using namespace dev;
+
+
+/*-----------------------------------------------------------------------------------
+* class MVisWriter
+*----------------------------------------------------------------------------------*/
+MVisWriter& MVisWriter::f64(double _v)
+{
+	uint64_t bits;
+	memcpy(&bits, &_v, sizeof(bits));
+	return bytes(bits, 8);
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class MVisCoalescer
+*----------------------------------------------------------------------------------*/
+bool MVisCoalescer::coalesces(MVisEvent _type)
+{
+	switch (_type)
+	{
+	case MVisEvent::CloseHit:
+	case MVisEvent::HashFault:
+	case MVisEvent::Solution:
+	case MVisEvent::HashSample:
+		return false;
+	default:
+		return true;
+	}
+}
+
+bool MVisCoalescer::batches(MVisEvent _type)
+{
+	return _type == MVisEvent::HashSample;
+}
+
+void MVisCoalescer::post(MVisEvent _type, std::vector<uint8_t> const& _payload, uint8_t _key)
+{
+	Guard l(x_events);
+	m_posted++;
+	if (coalesces(_type))
+		for (auto& e: m_events)
+			if (e.type == _type && e.key == _key)
+			{
+				e.payload = _payload;
+				m_coalesced++;
+				return;
+			}
+	if (batches(_type))
+	{
+		// a batch has to fit in a datagram on its own: header, record header and count.
+		for (auto& e: m_events)
+			if (e.type == _type && e.key == _key && e.payload[0] < 255 && 6 + 3 + e.payload.size() + _payload.size() <= c_maxDatagram)
+			{
+				e.payload[0]++;
+				e.payload.insert(e.payload.end(), _payload.begin(), _payload.end());
+				m_batched++;
+				return;
+			}
+		Event e{_type, _key, std::vector<uint8_t>(1, 1)};
+		e.payload.insert(e.payload.end(), _payload.begin(), _payload.end());
+		m_events.push_back(e);
+		return;
+	}
+	m_events.push_back(Event{_type, _key, _payload});
+}
+
+void MVisCoalescer::flush()
+{
+	Guard l(x_events);
+	unsigned count = 0;
+	for (auto const& e: m_events)
+	{
+		if (count > 0 && (count == 255 || m_datagram.size() + 3 + e.payload.size() > c_maxDatagram))
+		{
+			send(count);
+			count = 0;
+		}
+		if (count == 0)
+		{
+			m_datagram.clear();
+			MVisWriter(m_datagram).u8('M').u8('V').u8(MVIS_FRAME_VERSION).u16(m_minerId).u8(0);
+		}
+		MVisWriter(m_datagram).u8((uint8_t) e.type).u16((uint16_t) e.payload.size());
+		m_datagram.insert(m_datagram.end(), e.payload.begin(), e.payload.end());
+		count++;
+	}
+	if (count)
+		send(count);
+	m_events.clear();
+}
+
+void MVisCoalescer::send(unsigned _count)
+{
+	// the record count is the last byte of the header.
+	m_datagram[5] = uint8_t(_count);
+	m_datagrams++;
+	m_bytes += m_datagram.size();
+	m_send(m_datagram);
+}
+
+void MVisCoalescer::clear()
+{
+	Guard l(x_events);
+	m_events.clear();
+}
+
+std::string MVisCoalescer::summary()
+{
+	Guard l(x_events);
+	ostringstream ss;
+	ss << m_posted << " events, " << m_coalesced << " coalesced, " << m_batched << " batched, " << m_datagrams << " datagrams, " << m_bytes << " bytes";
+	return ss.str();
+}
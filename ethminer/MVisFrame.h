@@ -0,0 +1,151 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// compact binary framing for MVis notifications.  a client that connects with rpc_version
+// 11 or later gets its notifications this way (command responses are still JSON).  events
+// are queued and sent together, once per coalescing window (Network.UdpCoalesceMs).  the
+// high rate ones (hash rates, temps ...) only keep their latest value within a window, the
+// discrete ones (close hits, faults, solutions) are all sent.  hash samples are a series,
+// so every one is kept, but the samples of a window are batched into as few records as
+// they fit.
+//
+// everything is little-endian.  a datagram is:
+//
+//	'M' 'V' version:u8 miner_id:u16 count:u8, followed by count records of
+//	type:u8 length:u16 payload[length]
+//
+// payloads, by type.  times are unix seconds, gpu is the miner index.
+//
+//	1  best hash		hash:u64 time:u32
+//	2  close hit		hash:u64 work:u32 gpu:u8 time:u32
+//	3  hash fault		gpu:u8 time:u32
+//	4  solution			block:u32 gpu:u8 state:u8 stale:u8 time:u32
+//	5  work package		block:u32 boundary:u64
+//	6  hash samples		n:u8 n * (gpu:u8 hash:u64 last_sample:u8)
+//	7  gpu temps		n:u8 n * (temp * 100):i16
+//	8  fan speeds		n:u8 n * percent:i16
+//	9  hash rates		farm kH/s:u32 n:u8 n * kH/s:u32
+//	10 peer count		count:u16
+//	11 account balance	ether:f64
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <libdevcore/Guards.h>
+
+#define MVIS_FRAME_VERSION	1
+
+enum class MVisEvent : uint8_t
+{
+	BestHash = 1,
+	CloseHit,
+	HashFault,
+	Solution,
+	WorkPackage,
+	HashSample,
+	GpuTemps,
+	FanSpeeds,
+	HashRates,
+	PeerCount,
+	AccountBalance
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class MVisWriter
+*----------------------------------------------------------------------------------*/
+// appends little-endian fields to a byte buffer.
+class MVisWriter
+{
+public:
+	explicit MVisWriter(std::vector<uint8_t>& _out) : m_out(_out) {}
+
+	MVisWriter& u8(uint8_t _v) { m_out.push_back(_v); return *this; }
+	MVisWriter& u16(uint16_t _v) { return bytes(_v, 2); }
+	MVisWriter& i16(int16_t _v) { return bytes((uint16_t) _v, 2); }
+	MVisWriter& u32(uint32_t _v) { return bytes(_v, 4); }
+	MVisWriter& u64(uint64_t _v) { return bytes(_v, 8); }
+	MVisWriter& f64(double _v);
+
+private:
+	MVisWriter& bytes(uint64_t _v, unsigned _n)
+	{
+		for (unsigned i = 0; i < _n; i++, _v >>= 8)
+			m_out.push_back(uint8_t(_v));
+		return *this;
+	}
+
+	std::vector<uint8_t>& m_out;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class MVisCoalescer
+*----------------------------------------------------------------------------------*/
+class MVisCoalescer
+{
+public:
+	using SendFn = std::function<void(std::vector<uint8_t> const& _datagram)>;
+
+	// keep datagrams well under the usual MTU.
+	static const unsigned c_maxDatagram = 1200;
+
+	MVisCoalescer(SendFn const& _send) : m_send(_send) {}
+
+	void setMinerId(uint16_t _id) { m_minerId = _id; }
+
+	// queues an event.  _key tells apart events of the same type that shouldn't replace
+	// each other (usually the gpu).  for a batched type _payload is one item of the batch.
+	void post(MVisEvent _type, std::vector<uint8_t> const& _payload, uint8_t _key = 0);
+	// sends everything queued, in as few datagrams as it fits.
+	void flush();
+	void clear();
+
+	// counters since construction, for the log.
+	std::string summary();
+
+private:
+	struct Event
+	{
+		MVisEvent type;
+		uint8_t key;
+		std::vector<uint8_t> payload;
+	};
+
+	// events of these types only matter for their latest value.
+	static bool coalesces(MVisEvent _type);
+	// events of these types are items of a series, sent as n:u8 followed by the items.
+	static bool batches(MVisEvent _type);
+	void send(unsigned _count);
+
+	SendFn m_send;
+	uint16_t m_minerId = 0;
+
+	dev::Mutex x_events;
+	std::vector<Event> m_events;
+	std::vector<uint8_t> m_datagram;
+
+	uint64_t m_posted = 0;
+	uint64_t m_coalesced = 0;
+	uint64_t m_batched = 0;
+	uint64_t m_datagrams = 0;
+	uint64_t m_bytes = 0;
+};
@@ -19,6 +19,7 @@ along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "UDPSocket.h"
+#include "MVisFrame.h"
 
 namespace dev {
 //namespace rpc {
@@ -31,7 +32,9 @@ using namespace std;
 #define RATE_ON_CHANGE		-1
 #define RATE_REGULAR		1	// really, anything > 0  (milliseconds)
 
-#define MINER_RPC_VERSION	10
+#define MINER_RPC_VERSION	11
+// the oldest version we still talk to.  clients before 11 get JSON notifications only.
+#define MINER_RPC_VERSION_JSON	10
 
 
 // this class implements a UDP JSON RPC interface between this program and MVis.
@@ -60,6 +63,8 @@ public:
 		udp = new UDPSocket(udpListen);
 		// set up a handler for incoming UDP commands.
 		udp->onCommandRecv(boost::bind(&MVisRPC::processCmd, this, _1));
+		m_coalescer = new MVisCoalescer(boost::bind(&UDPSocket::send_datagram, udp, _1));
+		m_coalesceMs = strToInt(ProgOpt::Get("Network", "UdpCoalesceMs", "100"), 100);
 
 		TimerCallback::Init();
 		m_hashRateTimer = new TimerCallback(bind(&MVisRPC::hashRateCB, this, _1));
@@ -68,6 +73,7 @@ public:
 		m_fanSpeedsTimer = new TimerCallback(bind(&MVisRPC::fanSpeedsCB, this, _1));
 		m_peerCountTimer = new TimerCallback(bind(&MVisRPC::peerCountCB, this, _1));
 		m_acctBalanceTimer = new TimerCallback(bind(&MVisRPC::acctBalanceCB, this, _1));
+		m_flushTimer = new TimerCallback(bind(&MVisRPC::flushCB, this, _1));
 
 		m_farm->onBestHash(boost::bind(&MVisRPC::onBestHash, this, _1));
 		m_farm->onCloseHit(boost::bind(&MVisRPC::onCloseHit, this, _1, _2, _3));
@@ -134,16 +140,33 @@ public:
 					return;
 				}
 
-				udp->setCallerAsClient(cmd["return_port"].asInt(), cmd["miner_id"].asInt());
-
-				if (cmd["rpc_version"].asInt() != MINER_RPC_VERSION)
-					throw std::invalid_argument("Miner RPC Error : Invalid RPC version number");
+				// a caller we turn away mustn't become the client, or nobody else could connect.
+				int version = cmd["rpc_version"].asInt();
+				if (version < MINER_RPC_VERSION_JSON || version > MINER_RPC_VERSION)
+					jsonResults["error"] = "Miner RPC Error : Invalid RPC version number";
+				else if (cmd["password"].asString() != ProgOpt::Get("Network", "UdpPassword"))
+					jsonResults["error"] = "Miner RPC Error : Password not accepted";
+				if (jsonResults.isMember("error"))
+				{
+					LogB << "MVisRPC.ProcessCmd : " << jsonResults["error"].asString();
+					udp->send_packet(jsonResults, cmd["return_port"].asInt());
+					return;
+				}
 
-				if (cmd["password"].asString() != ProgOpt::Get("Network", "UdpPassword"))
-					throw std::invalid_argument("Miner RPC Error : Password not accepted");
+				udp->setCallerAsClient(cmd["return_port"].asInt(), cmd["miner_id"].asInt());
 
 				m_keepAlive->start(KeepAliveWait);
 
+				// newer clients get their notifications in the binary format.
+				m_binary = version >= 11 && ProgOpt::Get("Network", "UdpBinary", "1") != "0";
+				m_coalescer->clear();
+				m_coalescer->setMinerId(udp->minerId());
+				if (m_binary && m_coalesceMs > 0)
+					m_flushTimer->start(m_coalesceMs);
+				jsonResults["framing"] = m_binary ? "binary" : "json";
+				jsonResults["frame_version"] = MVIS_FRAME_VERSION;
+				jsonResults["coalesce_ms"] = m_coalesceMs;
+
 				// send back a few vital pieces of information
 				jsonResults["gpu_count"] = m_farm->minerCount();
 				jsonResults["last_solution"] = m_farm->logger.retrieveLastSolution();
@@ -510,6 +533,30 @@ public:
 				m_farm->tunePIDController(cmd["gpu"].asInt(), cmd["kp"].asDouble(), cmd["ki"].asDouble(), cmd["kd"].asDouble());
 			}
 
+			// --- job_latency ---
+
+			else if (cmd["command"] == "job_latency")
+			{
+				// time from a job arriving from the network to each stage of the mining pipeline.
+				Json::Value data(Json::arrayValue);
+				for (auto const& e : eth::WorkTrace::get().snapshot())
+				{
+					Json::Value v;
+					v["gpu"] = e.device;
+					v["stage"] = eth::WorkTrace::stageName(e.stage);
+					v["count"] = (Json::UInt64) e.latency.count();
+					v["mean"] = e.latency.meanMs();
+					v["p50"] = e.latency.percentileMs(50);
+					v["p90"] = e.latency.percentileMs(90);
+					v["p99"] = e.latency.percentileMs(99);
+					v["max"] = e.latency.maxUs() / 1000.0;
+					data.append(v);
+				}
+				jsonResults["data"] = data;
+				if (cmd.isMember("reset") && cmd["reset"].asBool())
+					eth::WorkTrace::get().reset();
+			}
+
 			// --- disconnect ---
 
 			else if (cmd["command"] == "disconnect")
@@ -547,6 +594,11 @@ public:
 		m_fanSpeedsTimer->stop();
 		m_peerCountTimer->stop();
 		m_acctBalanceTimer->stop();
+		m_flushTimer->stop();
+		if (m_binary)
+			LogF << "MVisRPC : binary notifications : " << m_coalescer->summary();
+		m_coalescer->clear();
+		m_binary = false;
 		if (udp->connected())
 			udp->disconnect(_returnType);
 		m_keepAlive->stop();
@@ -557,7 +609,13 @@ public:
 	*----------------------------------------------------------------------------------*/
 	void onBestHash(uint64_t _bh)
 	{
-		if (m_reportBestHash)
+		if (m_reportBestHash && m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).u64(_bh).u32(unixTime());
+			post(MVisEvent::BestHash, p);
+		}
+		else if (m_reportBestHash)
 		{
 			Json::Value v(Json::objectValue);
 			v["data_id"] = "best_hash";
@@ -576,7 +634,14 @@ public:
 
 		static Mutex s_lock;
 		Guard l(s_lock);
-		if (udp->connected())
+		if (udp->connected() && m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).u64(_closeHit).u32(_work).u8(_miner).u32(unixTime());
+			post(MVisEvent::CloseHit, p, _miner);
+			return true;
+		}
+		else if (udp->connected())
 		{
 			Json::Value closeHit;
 			closeHit["date"] = m_farm->logger.now();
@@ -604,7 +669,14 @@ public:
 
 		static Mutex s_lock;
 		Guard l(s_lock);
-		if (udp->connected())
+		if (udp->connected() && m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).u8(_miner).u32(unixTime());
+			post(MVisEvent::HashFault, p, _miner);
+			return true;
+		}
+		else if (udp->connected())
 		{
 			Json::Value hashFault;
 			hashFault["date"] = m_farm->logger.now();
@@ -625,9 +697,16 @@ public:
 	/*-----------------------------------------------------------------------------------
 	* onSolutionProcessed
 	*----------------------------------------------------------------------------------*/
-	bool onSolutionProcessed(unsigned _blockNumber, SolutionState _state, bool _stale, int _miner)
+	bool onSolutionProcessed(unsigned _blockNumber, eth::SolutionState _state, bool _stale, int _miner)
 	{
-		if (udp->connected())
+		if (udp->connected() && m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).u32(_blockNumber).u8(_miner).u8(_state).u8(_stale).u32(unixTime());
+			post(MVisEvent::Solution, p, _miner);
+			return true;
+		}
+		else if (udp->connected())
 		{
 			Json::Value solution(Json::objectValue);
 			solution["block"] = _blockNumber;
@@ -654,7 +733,13 @@ public:
 	*----------------------------------------------------------------------------------*/
 	void onSetWork(uint64_t boundary) 
 	{
-		if (m_reportWorkPackage)
+		if (m_reportWorkPackage && m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).u32(m_farm->currentBlock).u64(boundary);
+			post(MVisEvent::WorkPackage, p);
+		}
+		else if (m_reportWorkPackage)
 		{
 			Json::Value v(Json::objectValue);
 			v["data_id"] = "work_package";
@@ -693,15 +778,22 @@ public:
 	*----------------------------------------------------------------------------------*/
 	void hashSamplesCB(void* _miner)
 	{
+		bool last = SteadyClock::now() > m_hashSampleStop;
+		if (last)
+			m_hashSamplesTimer->stop();
+		if (m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).u8((uint64_t) _miner).u64(m_farm->currentHash((uint64_t) _miner)).u8(last);
+			post(MVisEvent::HashSample, p);
+			return;
+		}
 		Json::Value v(Json::objectValue);
 		v["data_id"] = "hash_samples";
 		v["data"] = (Json::UInt64) m_farm->currentHash((uint64_t)_miner);
 		v["type"] = "notify";
-		if (SteadyClock::now() > m_hashSampleStop)
-		{
-			m_hashSamplesTimer->stop();
+		if (last)
 			v["last_sample"] = true;
-		}
 		udp->send_packet(v);
 
 	}
@@ -713,27 +805,34 @@ public:
 	{
 		Json::Value temps(Json::nullValue);
 		std::vector<double> data;
+		bool res = gpuTempsChanged(data, _delta);
+		for (int i = 0; i < data.size(); i++)
+			temps.append(int(data[i] * 100));
+		_packet["data"] = temps;
+		return res;
+	}
+
+	/*-----------------------------------------------------------------------------------
+	* gpuTempsChanged
+	*   - reads the temps, and returns true if any changed by more than _delta.
+	*----------------------------------------------------------------------------------*/
+	bool gpuTempsChanged(std::vector<double>& _data, double _delta)
+	{
 		static std::vector<double> lastReported;
 
-		m_farm->getMinerTemps(data);
+		m_farm->getMinerTemps(_data);
 
 		bool res = false;
 		if (lastReported.size() == 0)
 			// first time here. fill lastReported vectors with zeros.
-			lastReported.assign(data.size(), 0);
+			lastReported.assign(_data.size(), 0);
 
-		// assemble the temps into the json structure & check for delta changes.
-		for (int i = 0; i < data.size(); i++)
-		{
-			temps.append(int(data[i] * 100));
-			if (abs(data[i] - lastReported[i]) >= _delta)
+		for (int i = 0; i < _data.size(); i++)
+			if (abs(_data[i] - lastReported[i]) >= _delta)
 				res = true;
-		}
 
 		if (res == true)
-			lastReported = data;
-
-		_packet["data"] = temps;
+			lastReported = _data;
 		return res;
 	}
 
@@ -744,6 +843,20 @@ public:
 	{
 		LogF << "Trace: MVisRPC.gpuTempsCB";
 		double delta = uint64_t(_data) / 100.0;
+		if (m_binary)
+		{
+			std::vector<double> temps;
+			if (gpuTempsChanged(temps, delta))
+			{
+				std::vector<uint8_t> p;
+				MVisWriter w(p);
+				w.u8(temps.size());
+				for (double t: temps)
+					w.i16(int16_t(t * 100));
+				post(MVisEvent::GpuTemps, p);
+			}
+			return;
+		}
 		Json::Value packet(Json::objectValue);
 		packet["data_id"] = "gpu_temps";
 		packet["type"] = "notify";
@@ -758,27 +871,34 @@ public:
 	{
 		Json::Value speeds(Json::nullValue);
 		std::vector<int> data;
+		bool res = fanSpeedsChanged(data, _delta);
+		for (int i = 0; i < data.size(); i++)
+			speeds.append(data[i]);
+		_packet["data"] = speeds;
+		return res;
+	}
+
+	/*-----------------------------------------------------------------------------------
+	* fanSpeedsChanged
+	*   - reads the fan speeds, and returns true if any changed by more than _delta.
+	*----------------------------------------------------------------------------------*/
+	bool fanSpeedsChanged(std::vector<int>& _data, int _delta)
+	{
 		static std::vector<int> lastReported;
 
-		m_farm->getFanSpeeds(data);
+		m_farm->getFanSpeeds(_data);
 
 		bool res = false;
 		if (lastReported.size() == 0)
 			// first time here. fill lastReported vectors with zeros.
-			lastReported.assign(data.size(), 0);
+			lastReported.assign(_data.size(), 0);
 
-		// assemble the speeds into the json structure & check for delta changes.
-		for (int i = 0; i < data.size(); i++)
-		{
-			speeds.append(data[i]);
-			if (abs(data[i] - lastReported[i]) >= _delta)
+		for (int i = 0; i < _data.size(); i++)
+			if (abs(_data[i] - lastReported[i]) >= _delta)
 				res = true;
-		}
 
 		if (res == true)
-			lastReported = data;
-
-		_packet["data"] = speeds;
+			lastReported = _data;
 		return res;
 	}
 
@@ -789,6 +909,20 @@ public:
 	{
 		LogF << "Trace: MVisRPC.fanSpeedsCB";
 		int delta = (uint64_t) _data;
+		if (m_binary)
+		{
+			std::vector<int> speeds;
+			if (fanSpeedsChanged(speeds, delta))
+			{
+				std::vector<uint8_t> p;
+				MVisWriter w(p);
+				w.u8(speeds.size());
+				for (int f: speeds)
+					w.i16(int16_t(f));
+				post(MVisEvent::FanSpeeds, p);
+			}
+			return;
+		}
 		Json::Value packet(Json::objectValue);
 		packet["data_id"] = "fan_speeds";
 		packet["type"] = "notify";
@@ -829,6 +963,22 @@ public:
 	void hashRateCB(void* _data)
 	{
 		double delta = uint64_t(_data) / 1000.0;
+		if (m_binary)
+		{
+			bool deltaExceeded;
+			m_farm->hashRates().update();
+			m_farm->hashRates().deltaExceeded(delta, deltaExceeded);
+			if (deltaExceeded)
+			{
+				std::vector<uint8_t> p;
+				MVisWriter w(p);
+				w.u32(uint32_t(m_farm->hashRates().farmRate() * 1000)).u8(m_farm->minerCount());
+				for (int i = 0; i < m_farm->minerCount(); i++)
+					w.u32(uint32_t(m_farm->hashRates().minerRate(i) * 1000));
+				post(MVisEvent::HashRates, p);
+			}
+			return;
+		}
 		Json::Value packet(Json::objectValue);
 		packet["data_id"] = "hash_rates";
 		packet["type"] = "notify";
@@ -854,6 +1004,13 @@ public:
 			if (abs(pc - peerCountLastReported) >= delta)
 			{
 				peerCountLastReported = pc;
+				if (m_binary)
+				{
+					std::vector<uint8_t> p;
+					MVisWriter(p).u16(pc);
+					post(MVisEvent::PeerCount, p);
+					return;
+				}
 				Json::Value packet(Json::objectValue);
 				packet["data_id"] = "peer_count";
 				packet["type"] = "notify";
@@ -917,7 +1074,15 @@ public:
 		Json::Value packet(Json::objectValue);
 		packet["data_id"] = "account_balance";
 		packet["type"] = "notify";
-		if (queryAcctBalance(packet, delta))
+		if (!queryAcctBalance(packet, delta))
+			return;
+		if (m_binary)
+		{
+			std::vector<uint8_t> p;
+			MVisWriter(p).f64(packet["data"].asDouble());
+			post(MVisEvent::AccountBalance, p);
+		}
+		else
 			udp->send_packet(packet);
 	}
 
@@ -929,6 +1094,27 @@ public:
 		disconnect("notify");
 	}
 
+	/*-----------------------------------------------------------------------------------
+	* post
+	*   - queues a binary notification for the next flush.
+	*----------------------------------------------------------------------------------*/
+	void post(MVisEvent _type, std::vector<uint8_t> const& _payload, uint8_t _key = 0)
+	{
+		m_coalescer->post(_type, _payload, _key);
+		if (m_coalesceMs == 0)
+			m_coalescer->flush();
+	}
+
+	/*-----------------------------------------------------------------------------------
+	* flushCB
+	*----------------------------------------------------------------------------------*/
+	void flushCB(void*)
+	{
+		m_coalescer->flush();
+	}
+
+	static uint32_t unixTime() { return (uint32_t) std::time(nullptr); }
+
 
 private:
 
@@ -945,11 +1131,17 @@ private:
 	TimerCallback* m_fanSpeedsTimer;
 	TimerCallback* m_peerCountTimer;
 	TimerCallback* m_acctBalanceTimer;
+	TimerCallback* m_flushTimer;
 
 	bool m_reportBestHash = false;
 	bool m_reportWorkPackage = false;
 	SteadyClock::time_point m_hashSampleStop;
 
+	// binary notifications (rpc_version 11+), sent every m_coalesceMs.
+	std::atomic<bool> m_binary = {false};
+	MVisCoalescer* m_coalescer;
+	int m_coalesceMs = 100;
+
 
 	TimerCallback* m_keepAlive;
 
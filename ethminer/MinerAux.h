@@ -43,9 +43,13 @@
 #include <libethcore/EthashCUDAMiner.h>
 #include <libethcore/EthashGPUMiner.h>
 #include <libethcore/EthashCPUMiner.h>
+#include <libethcore/EthashSimMiner.h>
+#include <libethcore/NumaDag.h>
+#include <libethcore/VerificationEngine.h>
 #include <libethcore/Farm.h>
 
 #include <libethash-cl/ethash_cl_miner.h>
+#include <libethash/keccak.h>
 
 #if ETH_ETHASHCUDA
 #include <libethash-cuda/ethash_cuda_miner.h>
@@ -58,8 +62,12 @@
 
 #include "PhoneHome.h"
 #include "FarmClient.h"
+#include "FarmSubmitter.h"
+#include "WorkFetcher.h"
 
 #include <libstratum/EthStratumClient.h>
+#include <libstratum/PoolManager.h>
+#include <libstratum/StratumProxy.h>
 
 #include "ProgOpt.h"
 #include "Misc.h"
@@ -131,6 +139,19 @@ public:
 		node.stratumPort = ProgOpt::Get("Node2", "StratumPort");
 		node.stratumPwd = ProgOpt::Get("Node2", "StratumPwd");
 		m_nodes.push_back(node);
+
+		// any further backups
+		for (unsigned i = 3; i <= c_maxNodes; i++)
+		{
+			string section = "Node" + toString(i);
+			node.url = ProgOpt::Get(section, "Host");
+			if (node.url == "")
+				break;
+			node.rpcPort = ProgOpt::Get(section, "RPCPort");
+			node.stratumPort = ProgOpt::Get(section, "StratumPort");
+			node.stratumPwd = ProgOpt::Get(section, "StratumPwd");
+			m_nodes.push_back(node);
+		}
 	}
 
 	/*-----------------------------------------------------------------------------------
@@ -160,6 +181,15 @@ public:
 		return true;
 	}
 
+	/*-----------------------------------------------------------------------------------
+	* proxyPort
+	*   - port to serve stratum on for other miners, or 0 if the proxy is disabled.
+	*----------------------------------------------------------------------------------*/
+	unsigned proxyPort()
+	{
+		return m_proxyPort ? m_proxyPort : strToInt(ProgOpt::Get("Proxy", "Port"), 0);
+	}
+
 	/*-----------------------------------------------------------------------------------
 	* failOverAvailable
 	*----------------------------------------------------------------------------------*/
@@ -168,6 +198,30 @@ public:
 		return m_nodes[1].url != "";
 	}
 
+	/*-----------------------------------------------------------------------------------
+	* standbyPools
+	*   - the stratum nodes that can be kept connected at the same time, in order of
+	*     preference.  hot standby only kicks in if the primary and at least one backup
+	*     are stratum nodes.
+	*----------------------------------------------------------------------------------*/
+	std::vector<PoolManager::Pool> standbyPools()
+	{
+		std::vector<PoolManager::Pool> pools;
+		if (ProgOpt::Get("Network", "HotStandby") != "1" || m_nodes[0].stratumPort == "")
+			return pools;
+		if (proxyPort())
+		{
+			LogB << "Hot standby is not available in stratum proxy mode.";
+			return pools;
+		}
+		for (auto const& n : m_nodes)
+			if (n.url != "" && n.stratumPort != "")
+				pools.push_back(PoolManager::Pool{n.url, n.stratumPort, n.stratumPwd});
+		if (pools.size() < 2)
+			pools.clear();
+		return pools;
+	}
+
 	/*-----------------------------------------------------------------------------------
 	* interpretOption
 	*----------------------------------------------------------------------------------*/
@@ -233,6 +287,33 @@ public:
 		{
 			m_worktimeout = atoi(argv[++i]);
 		}
+		else if (arg == "--getwork-mode" && i + 1 < argc)
+		{
+			if (!WorkFetcher::parseMode(argv[++i], m_workMode))
+			{
+				LogS << "Invalid " << arg << " option: " << argv[i];
+				exit(-1);
+			}
+		}
+		else if (arg == "--proxy-port" && i + 1 < argc)
+		{
+			m_proxyPort = strToInt(argv[++i], 0);
+			if (m_proxyPort == 0)
+			{
+				LogS << "Invalid " << arg << " option: Numerical port number only!";
+				exit(-1);
+			}
+		}
+		else if (arg == "--getwork-push-port" && i + 1 < argc)
+		{
+			m_workPushPort = strToInt(argv[++i], 0);
+			if (m_workPushPort == 0)
+			{
+				LogS << "Invalid " << arg << " option: Numerical port number only!";
+				exit(-1);
+			}
+			m_workMode = WorkFetcher::Mode::Push;
+		}
 		
 		else if (arg == "--opencl-platform" && i + 1 < argc)
 			try {
@@ -244,12 +325,11 @@ public:
 				exit(-1);
 			}
 		else if (arg == "--opencl-devices" || arg == "--opencl-device")
-			while (m_openclDeviceCount < 16 && i + 1 < argc)
+			while (i + 1 < argc)
 			{
 				try
 				{
-					m_openclDevices[m_openclDeviceCount] = stol(argv[++i]);
-					++m_openclDeviceCount;
+					m_openclDevices.push_back(stol(argv[++i]));
                 }
 				catch (...)
 				{
@@ -297,12 +377,11 @@ public:
 #if ETH_ETHASHCUDA
 		else if (arg == "--cuda-devices")
 		{
-			while (m_cudaDeviceCount < 16 && i + 1 < argc)
+			while (i + 1 < argc)
 			{
 				try
 				{
-					m_cudaDevices[m_cudaDeviceCount] = stol(argv[++i]);
-					++m_cudaDeviceCount;
+					m_cudaDevices.push_back(stol(argv[++i]));
 				}
 				catch (...)
 				{
@@ -383,6 +462,19 @@ public:
 		{
 			m_minerType = MinerType::Mixed;
 		}
+		else if (arg == "--sim")
+		{
+			m_minerType = MinerType::Sim;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				m_simDevices = strToInt(argv[++i], 0);
+				if (m_simDevices == 0)
+				{
+					LogS << "Invalid " << arg << " option: " << argv[i];
+					exit(-1);
+				}
+			}
+		}
 		else if (arg == "-M" || arg == "--benchmark")
 		{
 			m_doBenchmark = true;
@@ -405,6 +497,21 @@ public:
 				}
 			}
 		}
+		else if (arg == "--benchmark-interleave")
+			m_doInterleaveBenchmark = true;
+		else if (arg == "--benchmark-verify")
+		{
+			m_doVerifyBenchmark = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				m_verifyBenchmarkShares = strToInt(argv[++i], 0);
+				if (m_verifyBenchmarkShares == 0)
+				{
+					LogS << "Invalid " << arg << " option: " << argv[i];
+					exit(-1);
+				}
+			}
+		}
 
 		else if ((arg == "-t" || arg == "--mining-threads") && i + 1 < argc)
 		{
@@ -438,6 +545,13 @@ public:
 	*----------------------------------------------------------------------------------*/
 	void execute()
 	{
+		EthashAux::setPageCacheBudget((size_t) max(0, strToInt(ProgOpt::Get("Verification", "PageCacheMB", "0"), 0)) << 20);
+
+		if (m_doInterleaveBenchmark)
+			doInterleaveBenchmark(m_benchmarkTrial);
+
+		if (m_doVerifyBenchmark)
+			doVerifyBenchmark(m_verifyBenchmarkShares);
 
 		if (m_minerType == MinerType::Undefined)
 		{
@@ -456,6 +570,8 @@ public:
 			if (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed)
 				EthashCUDAMiner::listDevices();
 #endif
+			if (m_minerType == MinerType::Sim)
+				EthashSimMiner::listDevices();
 			if (m_minerType == MinerType::CPU)
 				LogS << "--list-devices should be combined with GPU mining flag (-G for OpenCL or -U for CUDA)";
 			exit(0);
@@ -469,17 +585,27 @@ public:
 		}
 
 
+		// light caches, DAG checks and CPU hashing all go through it.
+		LogF << "Keccak backend : " << ethash_keccak_backend();
+
 		// configure GPU
 		if (m_minerType == MinerType::CPU)
 		{
 			EthashCPUMiner::setNumInstances(m_miningThreads);
+			EthashCPUMiner::setInterleave(strToInt(ProgOpt::Get("CPU", "Interleave"), 4));
+			if (ProgOpt::Get("CPU", "Numa", "0") == "1")
+			{
+				EthashCPUMiner::setNuma(true);
+				for (auto const& n : NumaTopology::nodes())
+					LogS << "NUMA node " << n.id << " : " << n.cpus.size() << " cpus";
+			}
 		}
 		else if (m_minerType == MinerType::CL || m_minerType == MinerType::Mixed)
 		{
-			if (m_openclDeviceCount > 0)
+			if (m_openclDevices.size() > 0)
 			{
-				EthashGPUMiner::setDevices(m_openclDevices, m_openclDeviceCount);
-				m_miningThreads = m_openclDeviceCount;
+				EthashGPUMiner::setDevices(m_openclDevices);
+				m_miningThreads = m_openclDevices.size();
 			}
 			
 			if (!EthashGPUMiner::configureGPU(
@@ -499,10 +625,10 @@ public:
 		else if (m_minerType == MinerType::CUDA || m_minerType == MinerType::Mixed)
 		{
 #if ETH_ETHASHCUDA
-			if (m_cudaDeviceCount > 0)
+			if (m_cudaDevices.size() > 0)
 			{
-				EthashCUDAMiner::setDevices(m_cudaDevices, m_cudaDeviceCount);
-				m_miningThreads = m_cudaDeviceCount;
+				EthashCUDAMiner::setDevices(m_cudaDevices);
+				m_miningThreads = m_cudaDevices.size();
 			}
 			
 			EthashCUDAMiner::setNumInstances(m_miningThreads);
@@ -523,6 +649,22 @@ public:
 #endif
 		}
 
+		else if (m_minerType == MinerType::Sim)
+		{
+			EthashSimMiner::Settings settings;
+			settings.devices = m_simDevices;
+			settings.hashRate = atof(ProgOpt::Get("Simulation", "HashRate", "30").c_str());
+			settings.kernelMs = max(1, strToInt(ProgOpt::Get("Simulation", "KernelMs"), 20));
+			settings.kernelJitter = strToInt(ProgOpt::Get("Simulation", "KernelJitter"), 10);
+			settings.stallRate = atof(ProgOpt::Get("Simulation", "StallRate", "0").c_str());
+			settings.faultRate = atof(ProgOpt::Get("Simulation", "FaultRate", "0").c_str());
+			settings.solutionRate = atof(ProgOpt::Get("Simulation", "SolutionRate", "0").c_str());
+			EthashSimMiner::configure(settings);
+			// temperatures come from the devices' thermal models.
+			g_sensors.start(new SimSensorProvider);
+			LogB << "Simulating " << EthashSimMiner::platformInfo();
+		}
+
 		if (m_doBenchmark)
 			doBenchmark(m_minerType, m_benchmarkWarmup, m_benchmarkTrial, m_benchmarkTrials);
 		else
@@ -531,6 +673,10 @@ public:
 			f.start(createMiners(m_minerType, &f));
 			mvisRPC = new MVisRPC(f);
 
+			std::vector<PoolManager::Pool> pools = standbyPools();
+			if (pools.size())
+				doPools(f, pools);
+
 			int i = 0;
 			while (true)
 			{
@@ -542,7 +688,7 @@ public:
 						doFarm(f, m_nodes[i].url, m_nodes[i].rpcPort);
 				}
 				LogB << "Switching to failover node";
-				i = ++i % 2;
+				i = (i + 1) % m_nodes.size();
 			}
 		}
 			
@@ -565,6 +711,13 @@ public:
 			<< "    -P2, --stratum-pwd2 <string>  Stratum password of failover node (default: disabled)" << endl
 			<< "    -I, --polling-interval <n>  If using getWork (polling) to obtain work packages, check for new work" << endl
 			<< "        every <n> milliseconds (default: 200). Does not apply to stratum mode (-S)." << endl
+			<< "    --getwork-mode <mode>  How to obtain work packages in getWork mode. Does not apply to stratum mode (-S)." << endl
+			<< "            poll      - call eth_getWork every polling interval (default)" << endl
+			<< "            longpoll  - call eth_awaitNewWork, which the node answers as soon as there is new work" << endl
+			<< "            push      - the node notifies us of new work (eg. geth --miner.notify). requires --getwork-push-port" << endl
+			<< "    --getwork-push-port <port>  Port to listen on for work notifications from the node. Implies --getwork-mode push" << endl
+			<< "    --proxy-port <port>  In stratum mode, also act as a stratum server on <port> for other miners on" << endl
+			<< "        the LAN, which mine through our pool connection (default: disabled)" << endl
 			<< "    --work-timeout <n> In stratum mode, if more than <n> seconds go by with no new work package, attempt" << endl
 			<< "        to reconnect, or, if a failover node is available, switch to the failover.  Defaults to 180. Don't" << endl
 			<< "        set lower than max. avg. block time" << endl
@@ -576,10 +729,16 @@ public:
 			<< "    --benchmark-warmup <seconds>  Set the duration of warmup for the benchmark tests (default: 8)." << endl
 			<< "    --benchmark-trial <seconds>  Set the duration for each trial for the benchmark tests (default: 3)." << endl
 			<< "    --benchmark-trials <n>  Set the number of benchmark tests (default: 5)." << endl
+			<< "    --benchmark-interleave  Time CPU hashing on one thread with 1, 2, 4, 8 and 16 hashes interleaved" << endl
+			<< "        (see [CPU] Interleave in ethminer.ini), for --benchmark-trial seconds each, and exit." << endl
+			<< "    --benchmark-verify [<n>]  Time the verification of <n> shares (default: 2000) against the benchmark" << endl
+			<< "        block's light cache, the same shares again, and <n> new ones against its DAG, and exit." << endl
+			<< "        See [Verification] in ethminer.ini." << endl
 			<< endl
 			<< " Mining configuration:" << endl
 			<< "    -C,--cpu  CPU mining" << endl
 			<< "    -G,--opencl  When mining use the GPU via OpenCL." << endl
+			<< "    --sim [<n>]  Mine on <n> simulated devices (default: 16), for load testing. See [Simulation] in the INI file" << endl
 			<< "    --cl-local-work <n> Set the OpenCL local work size. Default is " << toString(ethash_cl_miner::c_defaultLocalWorkSize) << endl
 			<< "    --cl-work-multiplier <n> This value multiplied by the cl-local-work value equals the number of hashes computed per kernel " << endl
 			<< "       run (ie. global work size). (Default: " << toString(ethash_cl_miner::c_defaultWorkSizeMultiplier) << ")" << endl
@@ -641,6 +800,11 @@ public:
 			instances = EthashGPUMiner::instances();
 			create = [] (GenericFarm<EthashProofOfWork>* _farm, unsigned _index) { return new EthashGPUMiner(_farm, _index); };
 		}
+		else if (_minerType == MinerType::Sim)
+		{
+			instances = EthashSimMiner::instances();
+			create = [] (GenericFarm<EthashProofOfWork>* _farm, unsigned _index) { return new EthashSimMiner(_farm, _index); };
+		}
 		else if (_minerType == MinerType::CUDA)
 		{
 #if ETH_ETHASHCUDA
@@ -670,7 +834,7 @@ private:
 		GenericFarm<EthashProofOfWork> f;
 		f.onSolutionFound([&](EthashProofOfWork::Solution, int) { return false; });
 
-		string platformInfo = _m == MinerType::CPU ? "CPU" : (_m == MinerType::CL ? "CL" : "CUDA");
+		string platformInfo = _m == MinerType::CPU ? "CPU" : (_m == MinerType::CL ? "CL" : (_m == MinerType::Sim ? "Sim" : "CUDA"));
 		LogS << "Benchmarking on platform: " << platformInfo;
 
 		LogS << "Preparing DAG for block #" << m_benchmarkBlock;
@@ -718,6 +882,87 @@ private:
 	}	// doBenchmark
 
 
+	/*-----------------------------------------------------------------------------------
+	* doInterleaveBenchmark
+	*   - single thread CPU hash rate against the benchmark block's DAG, for each number of
+	*     hashes in flight.
+	*----------------------------------------------------------------------------------*/
+	void doInterleaveBenchmark(unsigned _trialDuration)
+	{
+		LogS << "Preparing DAG for block #" << m_benchmarkBlock;
+		NumaDag::ReplicaPtr dag = NumaDag::wrap(EthashAux::full(EthashAux::seedHash(m_benchmarkBlock), true));
+		if (!dag)
+		{
+			LogS << "Unable to load the DAG";
+			exit(-1);
+		}
+
+		h256 header = h256::random();
+		uint64_t nonces[ETHASH_MAX_INTERLEAVE];
+		EthashProofOfWork::Result results[ETHASH_MAX_INTERLEAVE];
+		uint64_t nonce = 0;
+		double single = 0;
+		for (unsigned k = 1; k <= ETHASH_MAX_INTERLEAVE; k *= 2)
+		{
+			uint64_t hashes = 0;
+			auto start = SteadyClock::now();
+			auto elapsed = [&] () { return std::chrono::duration_cast<std::chrono::milliseconds>(SteadyClock::now() - start).count() / 1000.0; };
+			while (elapsed() < _trialDuration)
+			{
+				for (unsigned i = 0; i < k; i++)
+					nonces[i] = nonce++;
+				dag->computeBatch(header, nonces, k, results);
+				hashes += k;
+			}
+			double rate = hashes / elapsed();
+			if (k == 1)
+				single = rate;
+			cout << "Interleave " << k << ": " << rate / 1000 << " kH/s  (" << rate / single << "x)" << endl;
+		}
+		exit(0);
+	}	// doInterleaveBenchmark
+
+
+	/*-----------------------------------------------------------------------------------
+	* doVerifyBenchmark
+	*   - share verification throughput of the VerificationEngine, against the light cache,
+	*     from its cache, and against the full DAG.
+	*----------------------------------------------------------------------------------*/
+	void doVerifyBenchmark(unsigned _shares)
+	{
+		h256 seed = EthashAux::seedHash(m_benchmarkBlock);
+		LogS << "Preparing light cache for block #" << m_benchmarkBlock;
+		EthashAux::light(seed);
+
+		VerificationEngine& engine = VerificationEngine::get();
+		h256 header = h256::random();
+		auto run = [&] (char const* _what, uint64_t _firstNonce) {
+			std::vector<VerificationEngine::Request> batch;
+			for (unsigned i = 0; i < _shares; i++)
+				batch.push_back(VerificationEngine::Request{seed, header, (Nonce) (u64) (_firstNonce + i), h256()});
+			auto start = SteadyClock::now();
+			for (auto& f : engine.verify(batch))
+				f.wait();
+			double secs = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start).count() / 1000000.0;
+			cout << _what << ": " << _shares / secs << " shares/s" << endl;
+		};
+
+		run("Light cache", 0);
+		run("Repeated   ", 0);
+		if (auto pages = EthashAux::light(seed)->pages.get())
+			cout << "DAG page cache: " << pages->summary() << endl;
+
+		LogS << "Preparing DAG for block #" << m_benchmarkBlock;
+		EthashAux::FullType full = EthashAux::full(seed, true);
+		if (full)
+			run("Full DAG   ", _shares);
+		else
+			LogS << "Unable to load the DAG";
+		cout << engine.summary() << endl;
+		exit(0);
+	}	// doVerifyBenchmark
+
+
 	/*-----------------------------------------------------------------------------------
 	* elapsedSeconds
 	*----------------------------------------------------------------------------------*/
@@ -754,26 +999,40 @@ private:
 		int maxRetries = failOverAvailable() ? m_maxFarmRetries : c_StopWorkAt;
 		bool connectedToNode = false;
 
+		try
+		{
+			KeepAliveHttpClient::parseUrl(_nodeURL, _rpcPort);
+		}
+		catch (std::invalid_argument const& e)
+		{
+			LogS << "Can't use node " << _nodeURL << " : " << e.what();
+			this_thread::sleep_for(chrono::seconds(5));
+			return;
+		}
+
 		LogS << "Connecting to node at " << _nodeURL + ":" + _rpcPort << " ...";
-		jsonrpc::HttpClient client(_nodeURL + ":" + _rpcPort);
-		::FarmClient rpc(client);
 		mvisRPC->configNodeRPC(_nodeURL + ":" + _rpcPort);
 
+		// solutions are handed to the submitter and sent off on its I/O threads.  mining
+		// carries on with the current work package in the meantime.
+		Mutex x_current;
 		EthashProofOfWork::WorkPackage current, previous;
+		FarmSubmitter submitter(f, _nodeURL, _rpcPort, strToInt(ProgOpt::Get("Network", "SubmitThreads", "2"), 2));
+		f.onSolutionFound([&] (EthashProofOfWork::Solution sol, int miner) {
+			Guard l(x_current);
+			submitter.submit(sol, miner, current, previous);
+			return false;
+		});
+
+		// new work packages are fetched in the background, either by polling, long polling
+		// or being notified by the node.
+		WorkFetcher fetcher(_nodeURL, _rpcPort, m_workMode, m_pollingInterval, m_workPushPort);
+
 		while (true)
 		{
 			try
 			{
-				bool solutionFound = false;
-				EthashProofOfWork::Solution solution;
-				int solutionMiner;
-				f.onSolutionFound([&] (EthashProofOfWork::Solution sol, int miner) {
-					solution = sol;
-					solutionMiner = miner;
-					return solutionFound = true;
-				});
-
-				while (!solutionFound && !f.shutDown)
+				while (!f.shutDown)
 				{
 					if (current)
 					{
@@ -784,31 +1043,38 @@ private:
 						}
 					}
 
-					Json::Value v = rpc.eth_getWork();
-					if (!connectedToNode)
+					WorkFetcher::Work w;
+					if (fetcher.waitForWork(200, w))
 					{
-						connectedToNode = true;
-						LogS << "Connection established.";
-					}
-					h256 hh(v[0].asString());
-					h256 newSeedHash(v[1].asString());
-					farmRetries = 0;
+						if (!connectedToNode)
+						{
+							connectedToNode = true;
+							LogS << "Connection established.";
+						}
+						farmRetries = 0;
 
-					if (hh != current.headerHash)
-					{
-						try
+						if (w.header != current.headerHash)
 						{
-							f.currentBlock = mvisRPC->getBlockNumber() + 1;
+							WorkTrace::get().received(w.header, w.received);
+							DEV_GUARDED(x_current)
+							{
+								previous = current;
+								current.headerHash = w.header;
+								current.seedHash = w.seed;
+								current.boundary = w.boundary;
+							}
+							f.setWork(current);
+							lastBlockTime.restart();
+							LogF << "getWork: new work dispatched to miners " 
+								<< std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - w.received).count() / 1000.0
+								<< " ms after it arrived from the node";
+							// this is a round trip to the node, so it waits until the miners have their work.
+							try
+							{
+								f.currentBlock = mvisRPC->getBlockNumber() + 1;
+							}
+							catch (...) {}
 						}
-						catch (...) {}
-						previous.headerHash = current.headerHash;
-						previous.seedHash = current.seedHash;
-						previous.boundary = current.boundary;
-						current.headerHash = hh;
-						current.seedHash = newSeedHash;
-						current.boundary = h256(fromHex(v[2].asString()), h256::AlignRight);
-						f.setWork(current);
-						lastBlockTime.restart();
 					}
 
 					if (lastBlockTime.elapsedSeconds() > m_worktimeout && failOverAvailable())
@@ -817,29 +1083,10 @@ private:
 						// quick & dirty way to break out of 2 loops
 						goto out;
 					}
-
-					this_thread::sleep_for(chrono::milliseconds(m_pollingInterval));
 				}
 
 				if (f.shutDown)
 					break;
-
-				LogB << "Solution found; Submitting to node ...";
-				if (EthashAux::eval(current.seedHash, current.headerHash, solution.nonce).value < current.boundary)
-				{
-					bool ok = rpc.eth_submitWork("0x" + toString(solution.nonce), "0x" + toString(current.headerHash), "0x" + toString(solution.mixHash));
-					f.solutionFound(ok ? SolutionState::Accepted : SolutionState::Rejected, false, solutionMiner);
-				}
-				else if (EthashAux::eval(previous.seedHash, previous.headerHash, solution.nonce).value < previous.boundary)
-				{
-					bool ok = rpc.eth_submitWork("0x" + toString(solution.nonce), "0x" + toString(previous.headerHash), "0x" + toString(solution.mixHash));
-					f.solutionFound(ok ? SolutionState::Accepted : SolutionState::Rejected, true, solutionMiner);
-				}
-				else
-				{
-					f.solutionFound(SolutionState::Failed, NULL, solutionMiner);
-				}
-				current.reset();
 			}
 			catch (jsonrpc::JsonRpcException& e)
 			{
@@ -851,7 +1098,8 @@ private:
 				{
 					// if there's a failover available, we'll switch to it, but worst case scenario, it could be 
 					// unavailable as well, so at some point we should pause mining.  we'll do it here.
-					current.reset();
+					DEV_GUARDED(x_current)
+						current.reset();
 					f.setWork(current);
 					LogS << "Mining paused ...";
 					if (failOverAvailable())
@@ -867,6 +1115,9 @@ private:
 		}
 
 out:
+		// the submitter is about to go out of scope, and with it any pending submissions
+		// will be flushed.
+		f.onSolutionFound([&] (EthashProofOfWork::Solution, int) { return false; });
 		mvisRPC->disconnect("notify");
 
 	}	// doFarm
@@ -882,6 +1133,25 @@ out:
 		EthStratumClient client(&f, m_minerType, _nodeURL, _stratumPort, _stratumPwd, maxRetries, m_worktimeout);
 		mvisRPC->configNodeRPC(_nodeURL + ":" + _rpcPort);
 
+		std::unique_ptr<StratumProxy> proxy;
+		if (proxyPort())
+		{
+			StratumProxy::Settings settings;
+			settings.port = proxyPort();
+			settings.extraNonceBits = strToInt(ProgOpt::Get("Proxy", "ExtraNonceBits"), 8);
+			settings.password = ProgOpt::Get("Proxy", "Password");
+			settings.loginTimeout = strToInt(ProgOpt::Get("Proxy", "LoginTimeout"), 30);
+			settings.idleTimeout = strToInt(ProgOpt::Get("Proxy", "IdleTimeout"), 900);
+			try
+			{
+				proxy.reset(new StratumProxy(client, settings));
+			}
+			catch (std::exception const& e)
+			{
+				LogB << "Unable to start the stratum proxy on port " << settings.port << " : " << e.what();
+			}
+		}
+
 		Timer lastHashRateDisplay;
 		Timer lastBlockTime;
 
@@ -904,6 +1174,54 @@ out:
 
 	}	// doStratum
 
+
+	/*-----------------------------------------------------------------------------------
+	* doPools
+	*   - stratum mining with hot standby connections to all the backup pools.  failover
+	*     is handled by the pool manager, so this doesn't return.
+	*----------------------------------------------------------------------------------*/
+	void doPools(GenericFarm<EthashProofOfWork>& f, std::vector<PoolManager::Pool> const& _pools)
+	{
+		PoolManager::Settings settings;
+		settings.maxJobLag = strToInt(ProgOpt::Get("Network", "MaxJobLag"), 3000);
+		settings.maxRejectRate = strToInt(ProgOpt::Get("Network", "MaxRejectRate"), 50);
+		settings.switchBackDelay = strToInt(ProgOpt::Get("Network", "SwitchBackDelay"), 30);
+		settings.worktimeout = m_worktimeout;
+
+		LogB << "Hot standby enabled with " << _pools.size() << " stratum pools";
+		PoolManager manager(&f, m_minerType, _pools, settings);
+
+		Timer lastHashRateDisplay;
+		Timer lastBlockTime;
+
+		manager.onWorkPackage([&] (unsigned int _blockNumber) {
+			f.currentBlock = _blockNumber;
+			lastBlockTime.restart();
+		});
+
+		int rpcNode = -1;
+		while (true)
+		{
+			int active = manager.active();
+			if (active >= 0 && active != rpcNode)
+			{
+				// the stratum pools are the nodes that have a stratum port, in the same order.
+				int n = -1;
+				for (auto const& node : m_nodes)
+					if (node.url != "" && node.stratumPort != "" && ++n == active)
+						mvisRPC->configNodeRPC(node.url + ":" + node.rpcPort);
+				rpcNode = active;
+			}
+			if (lastHashRateDisplay.elapsedSeconds() >= 2.0 && manager.isConnected() && f.isMining())
+			{
+				positionedOutput(f, lastBlockTime);
+				lastHashRateDisplay.restart();
+			}
+			this_thread::sleep_for(chrono::milliseconds(200));
+		}
+
+	}	// doPools
+
 public:
 
 	MVisRPC* mvisRPC;
@@ -912,6 +1230,7 @@ private:
 
 	/// Mining options
 	MinerType m_minerType = MinerType::Undefined;
+	unsigned m_simDevices = 16;
 	unsigned m_openclPlatform = 0;
 	unsigned m_openclDevice = 0;
 	unsigned m_miningThreads = UINT_MAX;
@@ -920,8 +1239,7 @@ private:
 	unsigned m_exportDAG_blockNum;
 	bool m_clAllowCPU = false;
 #if ETH_ETHASHCL || !ETH_TRUE
-	unsigned m_openclDeviceCount = 0;
-	unsigned m_openclDevices[16];
+	std::vector<unsigned> m_openclDevices;
 #if !ETH_ETHASHCUDA || !ETH_TRUE
 	unsigned m_workSizeMultiplier = ethash_cl_miner::c_defaultWorkSizeMultiplier;
 	unsigned m_localWorkSize = ethash_cl_miner::c_defaultLocalWorkSize;
@@ -930,8 +1248,7 @@ private:
 #if ETH_ETHASHCUDA || !ETH_TRUE
 	unsigned m_workSizeMultiplier = ethash_cuda_miner::c_defaultGridSize;
 	unsigned m_localWorkSize = ethash_cuda_miner::c_defaultBlockSize;
-	unsigned m_cudaDeviceCount = 0;
-	unsigned m_cudaDevices[16];
+	std::vector<unsigned> m_cudaDevices;
 	unsigned m_numStreams = ethash_cuda_miner::c_defaultNumStreams;
 	unsigned m_cudaSchedule = 4; // sync
 #endif
@@ -946,10 +1263,18 @@ private:
 	unsigned m_benchmarkTrial = 3;
 	unsigned m_benchmarkTrials = 5;
 	unsigned m_benchmarkBlock = 0;
+	bool m_doInterleaveBenchmark = false;
+	bool m_doVerifyBenchmark = false;
+	unsigned m_verifyBenchmarkShares = 2000;
 	
 	std::vector<node_t> m_nodes;
+	// primary plus backups configured in [Node2] .. [Node8]
+	static const unsigned c_maxNodes = 8;
 
 	unsigned m_maxFarmRetries = 4;
 	unsigned m_pollingInterval = 200;
 	unsigned m_worktimeout = 180;
+	WorkFetcher::Mode m_workMode = WorkFetcher::Mode::Poll;
+	unsigned m_workPushPort = 0;
+	unsigned m_proxyPort = 0;
 };
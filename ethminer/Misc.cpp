@@ -99,7 +99,7 @@ filesystem::path getAppDataFolder(void)
 #endif
 	s = local / s;
 	if (!filesystem::exists(s))
-		filesystem::create_directory(s);
+		filesystem::create_directories(s);
 
 	return s;
 }
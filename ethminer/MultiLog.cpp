@@ -55,6 +55,21 @@ int MultiLog::m_currentYExtent;
 // cursor has moved we know a rogue agent has output something directly to screen.
 int MultiLog::m_rogueCatcher = 0;
 
+namespace
+{
+	// positioned output needs a terminal to report the cursor position.  when the output is
+	// redirected, lines are simply written one after the other.
+	bool isTerminal()
+	{
+#ifdef WIN32
+		return true;
+#else
+		static const bool s_terminal = isatty(STDIN_FILENO) && isatty(STDOUT_FILENO);
+		return s_terminal;
+#endif
+	}
+}
+
 
 void MultiLog::Init()
 {
@@ -70,7 +85,8 @@ void MultiLog::Init()
 		std::cout << "Exception: MultiLog.Init - " << e.what() << std::endl;
 	}
 	loadFilters();
-	m_currentYBase = m_currentYExtent = getYPos();
+	if (isTerminal())
+		m_currentYBase = m_currentYExtent = getYPos();
 }
 
 
@@ -113,37 +129,42 @@ MultiLog::~MultiLog()
 		if (m_screenMode == LogOn || (1 == (filterResult = filterMatch(outStr))))
 		{
 			Guard l(x_screenOutput);
-			int ypos = getYPos();
-			if (ypos != m_rogueCatcher)
-			{
-				// start over after the rogue output
-				m_currentYBase = m_currentYExtent = ypos;
-			}
-			if (m_positioned)
-				GotoXY(m_xpos, m_currentYBase + m_ypos);
+			if (!isTerminal())
+				simpleDebugOut(cout, outStr, true, true);
 			else
 			{
-				if (m_currentYExtent > m_currentYBase)
-					clearYExtent();
-
-				GotoXY(0, m_currentYBase);
-			}
-			
-			simpleDebugOut(cout, outStr, !m_positioned, !m_positioned);
-
-			if (m_positioned)
-			{
-				// update the Y extent in case we've positioned something further down the screen.
-				m_currentYExtent = max(m_currentYExtent, getYPos() + 1);
-				// put cursor after the last positioned line in case a rogue agent outputs some text directly to screen.
-				GotoXY(0, m_currentYExtent);
-				// the previous goto might have caused a scroll
-				m_currentYExtent = min(m_currentYExtent, getBufferHeight() - 1);
+				int ypos = getYPos();
+				if (ypos != m_rogueCatcher)
+				{
+					// start over after the rogue output
+					m_currentYBase = m_currentYExtent = ypos;
+				}
+				if (m_positioned)
+					GotoXY(m_xpos, m_currentYBase + m_ypos);
+				else
+				{
+					if (m_currentYExtent > m_currentYBase)
+						clearYExtent();
+
+					GotoXY(0, m_currentYBase);
+				}
+
+				simpleDebugOut(cout, outStr, !m_positioned, !m_positioned);
+
+				if (m_positioned)
+				{
+					// update the Y extent in case we've positioned something further down the screen.
+					m_currentYExtent = max(m_currentYExtent, getYPos() + 1);
+					// put cursor after the last positioned line in case a rogue agent outputs some text directly to screen.
+					GotoXY(0, m_currentYExtent);
+					// the previous goto might have caused a scroll
+					m_currentYExtent = min(m_currentYExtent, getBufferHeight() - 1);
+				}
+				else
+					m_currentYBase = m_currentYExtent = getYPos();
+
+				m_rogueCatcher = m_currentYExtent;
 			}
-			else
-				m_currentYBase = m_currentYExtent = getYPos();
-
-			m_rogueCatcher = m_currentYExtent;
 		}
 
 	if (m_diskMode != LogOff)
@@ -67,6 +67,7 @@ bool ProgOpt::Load(std::string _config)
 		// set up sensible defaults for various settings. note that emplace does
 		// not overwrite existing values.
 		m_defaults->emplace("General.NonceGeneration", "Linear");
+		m_defaults->emplace("General.LatencyLogInterval", "300");
 		m_defaults->emplace("Kernel.Tech", "CPP");
 
 		m_defaults->emplace("CloseHits.Enabled", "1");
@@ -74,10 +75,48 @@ bool ProgOpt::Load(std::string _config)
 		m_defaults->emplace("CloseHits.WorkUnitFrequency", "600");
 
 		m_defaults->emplace("Network.UdpListen", "5225");
+		m_defaults->emplace("Network.UdpBinary", "1");
+		m_defaults->emplace("Network.UdpCoalesceMs", "100");
+		m_defaults->emplace("Network.SubmitThreads", "2");
 
 		m_defaults->emplace("ThermalProtection.TempProvider", "amd_adl");
 		m_defaults->emplace("ThermalProtection.ThrottleTemp", "80");
 		m_defaults->emplace("ThermalProtection.ShutDown", "20");
+		m_defaults->emplace("ThermalProtection.SensorRate", "1000");
+		m_defaults->emplace("ThermalProtection.ThrottleMode", "device");
+		m_defaults->emplace("ThermalProtection.RigPowerBudget", "0");
+		m_defaults->emplace("ThermalProtection.RigTempBudget", "0");
+		m_defaults->emplace("ThermalProtection.SysfsRoot", "/sys/class/drm");
+
+		m_defaults->emplace("HashFaults.SampleInterval", "4");
+		m_defaults->emplace("HashFaults.QueueSize", "256");
+		m_defaults->emplace("Verification.Threads", "2");
+		m_defaults->emplace("Verification.BatchSize", "64");
+		m_defaults->emplace("Verification.CacheSize", "4096");
+		m_defaults->emplace("Verification.PageCacheMB", "0");
+		m_defaults->emplace("Epochs.RamMB", "256");
+		m_defaults->emplace("Epochs.DiskMB", "0");
+
+		m_defaults->emplace("Network.HotStandby", "1");
+		m_defaults->emplace("Network.MaxJobLag", "3000");
+		m_defaults->emplace("Network.MaxRejectRate", "50");
+		m_defaults->emplace("Network.SwitchBackDelay", "30");
+
+		m_defaults->emplace("CPU.Numa", "0");
+		m_defaults->emplace("CPU.Interleave", "4");
+
+		m_defaults->emplace("Simulation.HashRate", "30");
+		m_defaults->emplace("Simulation.KernelMs", "20");
+		m_defaults->emplace("Simulation.KernelJitter", "10");
+		m_defaults->emplace("Simulation.StallRate", "0");
+		m_defaults->emplace("Simulation.FaultRate", "0");
+		m_defaults->emplace("Simulation.SolutionRate", "0");
+
+		m_defaults->emplace("Proxy.Port", "0");
+		m_defaults->emplace("Proxy.ExtraNonceBits", "8");
+		m_defaults->emplace("Proxy.Password", "");
+		m_defaults->emplace("Proxy.LoginTimeout", "30");
+		m_defaults->emplace("Proxy.IdleTimeout", "900");
 
 		m_defaults->emplace("Node.Host", "127.0.0.1");
 		m_defaults->emplace("Node.RPCPort", "8545");
@@ -0,0 +1,280 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SensorSampler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include <libdevcore/Common.h>
+#include <libdevcore/Log.h>
+#include <ethminer/ADLUtils.h>
+#include <libethcore/EthashSimMiner.h>
+#ifdef _WIN32
+#include <ethminer/speedfan.h>
+#endif
+#include "ProgOpt.h"
+#include "Misc.h"
+#include "MultiLog.h"
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+SensorSampler g_sensors;
+
+
+/*-----------------------------------------------------------------------------------
+* class ADLSensorProvider
+*----------------------------------------------------------------------------------*/
+bool ADLSensorProvider::read(unsigned _device, SensorReading& _r)
+{
+	_r.temp = g_ADLUtils.getTemps(_device);
+	_r.fanSpeed = g_ADLUtils.getFanSpeed(_device);
+	_r.power = 0;
+	return true;
+}
+
+
+#ifdef _WIN32
+/*-----------------------------------------------------------------------------------
+* class SpeedFanSensorProvider
+*----------------------------------------------------------------------------------*/
+bool SpeedFanSensorProvider::read(unsigned _device, SensorReading& _r)
+{
+	try
+	{
+		std::vector<double> data;
+		g_SpeedFan.getData(data, SpeedFan::Temperatures, _device + 1);
+		_r.temp = data.size() > _device ? data[_device] : 0;
+	}
+	catch (std::exception& e)
+	{
+		LogF << "SpeedFanSensorProvider::read : " << e.what();
+		_r.temp = 0;
+	}
+	// speedfan doesn't know which fan belongs to which GPU, so we still ask the driver.
+	_r.fanSpeed = g_ADLUtils.getFanSpeed(_device);
+	_r.power = 0;
+	return true;
+}
+#endif
+
+
+/*-----------------------------------------------------------------------------------
+* class SimSensorProvider
+*----------------------------------------------------------------------------------*/
+bool SimSensorProvider::read(unsigned _device, SensorReading& _r)
+{
+	return dev::eth::EthashSimMiner::simReading(_device, _r.temp, _r.power);
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class HwmonSensorProvider
+*----------------------------------------------------------------------------------*/
+HwmonSensorProvider::HwmonSensorProvider(std::string const& _root) : m_root(_root)
+{
+	scan();
+}
+
+void HwmonSensorProvider::scan()
+{
+	m_hwmonDirs.clear();
+	vector<pair<int, fs::path>> cards;
+	try
+	{
+		if (!fs::is_directory(m_root))
+		{
+			LogB << "HwmonSensorProvider : " << m_root << " does not exist.";
+			return;
+		}
+		for (fs::directory_iterator itr(m_root), end; itr != end; ++itr)
+		{
+			// we want card0, card1 ... but not connector entries like card0-DP-1
+			string name = itr->path().filename().string();
+			if (name.size() > 4 && name.compare(0, 4, "card") == 0 && isDigits(name.substr(4)))
+				cards.push_back(make_pair(stoi(name.substr(4)), itr->path()));
+		}
+		sort(cards.begin(), cards.end(), [] (pair<int, fs::path> const& a, pair<int, fs::path> const& b) { return a.first < b.first; });
+
+		for (auto const& card : cards)
+		{
+			fs::path hwmon = card.second / "device" / "hwmon";
+			if (!fs::is_directory(hwmon))
+				continue;
+			for (fs::directory_iterator itr(hwmon), end; itr != end; ++itr)
+				if (itr->path().filename().string().compare(0, 5, "hwmon") == 0)
+				{
+					m_hwmonDirs.push_back(itr->path().string());
+					LogF << "HwmonSensorProvider : GPU[" << m_hwmonDirs.size() - 1 << "] = " << itr->path().string();
+					break;
+				}
+		}
+	}
+	catch (std::exception& e)
+	{
+		LogB << "Exception: HwmonSensorProvider::scan - " << e.what();
+	}
+}
+
+bool HwmonSensorProvider::readValue(std::string const& _file, long long& _value)
+{
+	std::ifstream f(_file);
+	return f.good() && (f >> _value);
+}
+
+bool HwmonSensorProvider::read(unsigned _device, SensorReading& _r)
+{
+	if (_device >= m_hwmonDirs.size())
+		return false;
+	string dir = m_hwmonDirs[_device] + "/";
+	long long v;
+	bool any = false;
+
+	// temperatures are in millidegrees, power in microwatts, fans in RPM.
+	if (readValue(dir + "temp1_input", v))
+	{
+		_r.temp = v / 1000.0;
+		any = true;
+	}
+	if (readValue(dir + "fan1_input", v))
+	{
+		_r.fanSpeed = int(v);
+		any = true;
+	}
+	if (readValue(dir + "power1_average", v) || readValue(dir + "power1_input", v))
+	{
+		_r.power = int(v / 1000000);
+		any = true;
+	}
+	return any;
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class SensorSampler
+*----------------------------------------------------------------------------------*/
+SensorSampler::~SensorSampler()
+{
+	stop();
+}
+
+void SensorSampler::start(SensorProvider* _provider, unsigned _rateMs)
+{
+	std::call_once(m_started, [&] () {
+		if (_provider)
+			m_provider.reset(_provider);
+		else
+		{
+			string source = ProgOpt::Get("ThermalProtection", "TempProvider", TEMP_SOURCE_AMD);
+			LowerCase(source);
+#ifdef _WIN32
+			if (source == TEMP_SOURCE_SPEEDFAN)
+				m_provider.reset(new SpeedFanSensorProvider);
+			else
+#endif
+			if (source == TEMP_SOURCE_SIM)
+				m_provider.reset(new SimSensorProvider);
+			else if (source == TEMP_SOURCE_SYSFS)
+				m_provider.reset(new HwmonSensorProvider(ProgOpt::Get("ThermalProtection", "SysfsRoot", "/sys/class/drm")));
+			else
+				m_provider.reset(new ADLSensorProvider);
+		}
+		m_rateMs = _rateMs ? _rateMs : max(50, strToInt(ProgOpt::Get("ThermalProtection", "SensorRate", "1000"), 1000));
+		LogF << "SensorSampler : provider = " << m_provider->name() << ", rate = " << m_rateMs << " ms";
+
+		m_running = true;
+		m_thread.reset(new std::thread(&SensorSampler::sampleLoop, this));
+	});
+}
+
+void SensorSampler::stop()
+{
+	if (!m_running)
+		return;
+	{
+		Guard l(x_wait);
+		m_running = false;
+	}
+	m_wakeUp.notify_all();
+	if (m_thread && m_thread->joinable())
+		m_thread->join();
+}
+
+SensorReading SensorSampler::reading(unsigned _device)
+{
+	start();
+	SensorReading r;
+	if (_device >= c_maxDevices)
+	{
+		// out of range for the cache.  we'll have to go to the driver.
+		Guard l(x_provider);
+		if (m_provider->read(_device, r))
+			r.stamp = SteadyClock::now();
+		return r;
+	}
+
+	Slot& s = m_slots[_device];
+	if (!s.watched.exchange(true))
+		// first time anyone has asked about this device.
+		sample(_device);
+
+	r.temp = s.tempCenti.load(std::memory_order_relaxed) / 100.0;
+	r.fanSpeed = s.fanSpeed.load(std::memory_order_relaxed);
+	r.power = s.power.load(std::memory_order_relaxed);
+	r.stamp = SteadyClock::time_point(SteadyClock::duration(s.stamp.load(std::memory_order_acquire)));
+	return r;
+}
+
+std::string SensorSampler::providerName()
+{
+	start();
+	return m_provider->name();
+}
+
+void SensorSampler::sample(unsigned _device)
+{
+	SensorReading r;
+	bool ok;
+	{
+		Guard l(x_provider);
+		ok = m_provider->read(_device, r);
+	}
+	if (!ok)
+		// keep the last good values, and their stamp, so consumers can tell they're stale.
+		return;
+	Slot& s = m_slots[_device];
+	s.tempCenti.store(int(r.temp * 100), std::memory_order_relaxed);
+	s.fanSpeed.store(r.fanSpeed, std::memory_order_relaxed);
+	s.power.store(r.power, std::memory_order_relaxed);
+	s.stamp.store(SteadyClock::now().time_since_epoch().count(), std::memory_order_release);
+}
+
+void SensorSampler::sampleLoop()
+{
+	dev::setThreadName("sensors");
+	while (m_running)
+	{
+		for (unsigned i = 0; i < c_maxDevices && m_running; i++)
+			if (m_slots[i].watched)
+				DEV_TIMED_ABOVE("sensor sample", 250)
+					sample(i);
+
+		UniqueGuard l(x_wait);
+		m_wakeUp.wait_for(l, std::chrono::milliseconds(m_rateMs), [&] () { return !m_running; });
+	}
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// background sampling of GPU sensors (temperature, fan speed, power).  driver queries can
+// be slow, so a single thread polls every device at a fixed rate and publishes the values
+// into a lock-free cache.  consumers (PID controller, MVisRPC, screen output) only ever
+// read the cache.
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <condition_variable>
+#include <libdevcore/Guards.h>
+#include <ethminer/Common.h>
+
+#define TEMP_SOURCE_AMD			"amd_adl"
+#define TEMP_SOURCE_SPEEDFAN	"speedfan"
+#define TEMP_SOURCE_SYSFS		"sysfs"
+#define TEMP_SOURCE_SIM			"sim"
+
+
+struct SensorReading
+{
+	double temp = 0;		// degrees celcius
+	int fanSpeed = 0;		// RPM, or percent, depending on the driver
+	int power = 0;			// watts.  zero means unknown.
+	SteadyClock::time_point stamp;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class SensorProvider
+*----------------------------------------------------------------------------------*/
+class SensorProvider
+{
+public:
+	virtual ~SensorProvider() {}
+	virtual std::string name() = 0;
+	// read all sensors of the indicated device. return false if nothing could be read.
+	virtual bool read(unsigned _device, SensorReading& _r) = 0;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class ADLSensorProvider
+*----------------------------------------------------------------------------------*/
+class ADLSensorProvider: public SensorProvider
+{
+public:
+	std::string name() override { return TEMP_SOURCE_AMD; }
+	bool read(unsigned _device, SensorReading& _r) override;
+};
+
+
+#ifdef _WIN32
+/*-----------------------------------------------------------------------------------
+* class SpeedFanSensorProvider
+*----------------------------------------------------------------------------------*/
+class SpeedFanSensorProvider: public SensorProvider
+{
+public:
+	std::string name() override { return TEMP_SOURCE_SPEEDFAN; }
+	bool read(unsigned _device, SensorReading& _r) override;
+};
+#endif
+
+
+/*-----------------------------------------------------------------------------------
+* class HwmonSensorProvider
+*----------------------------------------------------------------------------------*/
+// linux hwmon interface exposed by the amdgpu / radeon / nouveau drivers.  each
+// card directory under _root (normally /sys/class/drm) that has a device/hwmon/hwmonN
+// sub-folder is considered a GPU, and they are numbered in sorted order.  pointing
+// _root at a fake directory tree is a convenient way to exercise this code.
+class HwmonSensorProvider: public SensorProvider
+{
+public:
+	HwmonSensorProvider(std::string const& _root);
+	std::string name() override { return TEMP_SOURCE_SYSFS; }
+	bool read(unsigned _device, SensorReading& _r) override;
+
+private:
+	void scan();
+	static bool readValue(std::string const& _file, long long& _value);
+
+	std::string m_root;
+	std::vector<std::string> m_hwmonDirs;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class SimSensorProvider
+*----------------------------------------------------------------------------------*/
+// thermal models of the simulated devices (see EthashSimMiner).
+class SimSensorProvider: public SensorProvider
+{
+public:
+	std::string name() override { return TEMP_SOURCE_SIM; }
+	bool read(unsigned _device, SensorReading& _r) override;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class SensorSampler
+*----------------------------------------------------------------------------------*/
+class SensorSampler
+{
+public:
+
+	// maximum number of devices we keep cached readings for.
+	enum { c_maxDevices = 256 };
+
+	SensorSampler() {}
+	~SensorSampler();
+
+	// provider & rate come from the INI file, unless specified here. the sampler thread
+	// is launched automatically on first use, so calling this is optional.
+	void start(SensorProvider* _provider = nullptr, unsigned _rateMs = 0);
+	void stop();
+
+	double temperature(unsigned _device) { return reading(_device).temp; }
+	int fanSpeed(unsigned _device) { return reading(_device).fanSpeed; }
+	int power(unsigned _device) { return reading(_device).power; }
+
+	// most recent values for the device.  the first request for any device is
+	// answered synchronously, after which the device is sampled in the background.
+	SensorReading reading(unsigned _device);
+
+	std::string providerName();
+
+private:
+
+	struct Slot
+	{
+		std::atomic<bool> watched = {false};
+		std::atomic<int> tempCenti = {0};
+		std::atomic<int> fanSpeed = {0};
+		std::atomic<int> power = {0};
+		std::atomic<int64_t> stamp = {0};	// steady clock ticks of the last good read. zero means never.
+	};
+
+	void sampleLoop();
+	void sample(unsigned _device);
+
+	Slot m_slots[c_maxDevices];
+	std::unique_ptr<SensorProvider> m_provider;
+	unsigned m_rateMs = 1000;
+
+	std::once_flag m_started;
+	std::unique_ptr<std::thread> m_thread;
+	std::atomic<bool> m_running = {false};
+	Mutex x_wait;
+	std::condition_variable m_wakeUp;
+	// serializes calls into the provider
+	Mutex x_provider;
+};
+
+extern SensorSampler g_sensors;
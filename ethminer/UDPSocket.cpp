@@ -43,6 +43,8 @@ UDPSocket::UDPSocket(unsigned _udpListen) :
 UDPSocket::~UDPSocket()
 {
 	m_ios->stop();
+	for (auto b: m_freeBuffers)
+		delete b;
 }
 
 /*-----------------------------------------------------------------------------------
@@ -171,23 +173,63 @@ void UDPSocket::send_packet(Json::Value _v, int _returnPort, boost::asio::ip::ud
 	Json::FastWriter fw;
 	fw.omitEndingLineFeed();
 	_v["miner_id"] = m_minerId;
-	boost::shared_ptr<std::string> message(new std::string(fw.write(_v)));
+	std::string* message = allocBuffer();
+	*message = fw.write(_v);
 	LogF << "UDPSocket::send_packet : " << *message;
-	// we're passing message to handle_send just to keep the memory valid long enough.
-	m_socket->async_send_to(buffer(*message),
-							_send_endpoint,
+	send_buffer(message, _send_endpoint);
+}
+
+/*-----------------------------------------------------------------------------------
+* send_datagram
+*----------------------------------------------------------------------------------*/
+void UDPSocket::send_datagram(std::vector<uint8_t> const& _data)
+{
+	if (!m_connected)
+		return;
+	udp::endpoint _send_endpoint = m_connection_endpoint;
+	_send_endpoint.port(m_connection_returnport);
+	std::string* message = allocBuffer();
+	message->assign((char const*) _data.data(), _data.size());
+	send_buffer(message, _send_endpoint);
+}
+
+/*-----------------------------------------------------------------------------------
+* send_buffer
+*----------------------------------------------------------------------------------*/
+void UDPSocket::send_buffer(std::string* _message, udp::endpoint const& _endpoint)
+{
+	// the buffer goes back on the free list in handle_send, once the send has completed.
+	m_socket->async_send_to(buffer(*_message),
+							_endpoint,
 							boost::bind(&UDPSocket::handle_send, this,
-										message,
+										_message,
 										boost::asio::placeholders::error,
 										boost::asio::placeholders::bytes_transferred));
 }
 
+/*-----------------------------------------------------------------------------------
+* allocBuffer
+*----------------------------------------------------------------------------------*/
+std::string* UDPSocket::allocBuffer()
+{
+	dev::Guard l(x_buffers);
+	if (m_freeBuffers.empty())
+		return new std::string;
+	std::string* b = m_freeBuffers.back();
+	m_freeBuffers.pop_back();
+	return b;
+}
+
 /*-----------------------------------------------------------------------------------
 * handle_send
 *----------------------------------------------------------------------------------*/
-void UDPSocket::handle_send(boost::shared_ptr<std::string> message, const boost::system::error_code& error, std::size_t bytes_transferred)
+void UDPSocket::handle_send(std::string* message, const boost::system::error_code& error, std::size_t bytes_transferred)
 {
 	(void) bytes_transferred;
+	{
+		dev::Guard l(x_buffers);
+		m_freeBuffers.push_back(message);
+	}
 	if (error)
 		LogB << "UDPSocket::handle_send error : " << error.category().name() << " " << error.message() << ":" << error.value();
 }
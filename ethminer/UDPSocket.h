@@ -25,6 +25,7 @@ along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 #include <boost/array.hpp>
 #include <boost/thread.hpp>
 #include <json/json.h>
+#include <libdevcore/Guards.h>
 
 class UDPSocket {
 public:
@@ -38,6 +39,9 @@ public:
 	void send_packet(Json::Value _v);
 	void send_packet(Json::Value _v, int _returnPort);
 	void send_packet(Json::Value _v, int _returnPort, boost::asio::ip::udp::endpoint _endpoint);
+	// sends a binary datagram (see MVisFrame.h) to the connected client.
+	void send_datagram(std::vector<uint8_t> const& _data);
+	int minerId() { return m_minerId; }
 	void setCallerAsClient(int _returnPort, int _minerId);
 	bool isCallerClient(int _returnPort);
 	void disconnect(std::string _returnType);
@@ -47,7 +51,10 @@ private:
 	void launchIOS();
 	void start_receive();
 	void handle_receive(const boost::system::error_code& error, std::size_t bytes_transferred);
-	void handle_send(boost::shared_ptr<std::string> message, const boost::system::error_code& error, std::size_t bytes_transferred);
+	void send_buffer(std::string* _message, boost::asio::ip::udp::endpoint const& _endpoint);
+	void handle_send(std::string* message, const boost::system::error_code& error, std::size_t bytes_transferred);
+	// send buffers are recycled rather than allocated for every packet.
+	std::string* allocBuffer();
 
 private:
 
@@ -68,6 +75,9 @@ private:
 	// this does not refer to a socket connection, but rather to a miner connection.
 	bool m_connected;
 
+	dev::Mutex x_buffers;
+	std::vector<std::string*> m_freeBuffers;
+
 };
 
 
@@ -0,0 +1,326 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WorkFetcher.h"
+
+#include <json/json.h>
+#include <libdevcore/Log.h>
+#include <libdevcore/CommonData.h>
+#include "Misc.h"
+#include "MultiLog.h"
+
+using namespace std;
+using namespace dev;
+using boost::asio::ip::tcp;
+
+namespace
+{
+	// the request ids never change, so identical work produces byte-for-byte identical responses.
+	char const* c_getWork = "{\"jsonrpc\":\"2.0\",\"method\":\"eth_getWork\",\"params\":[],\"id\":1}";
+	char const* c_awaitNewWork = "{\"jsonrpc\":\"2.0\",\"method\":\"eth_awaitNewWork\",\"params\":[],\"id\":2}";
+
+	// how long a long poll is left hanging before we check in with a regular getWork.
+	unsigned const c_longPollTimeout = 10000;
+	// timeout on regular requests.
+	unsigned const c_requestTimeout = 5000;
+	// in push mode we still poll, just not very often.
+	unsigned const c_pushPollInterval = 5000;
+	// wait this long after a communication error before trying again.
+	unsigned const c_retryDelay = 5000;
+	// a node pushing work gets this long to deliver it, and this many bytes to do it in.
+	unsigned const c_pushTimeout = 5000;
+	size_t const c_maxPushBody = 64 * 1024;
+	char const c_pushResponse[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+	// one work notification: read the request, answer it and hang up.  it's all asynchronous
+	// so a connection that stalls can't hold up the ones behind it.
+	class PushSession: public std::enable_shared_from_this<PushSession>
+	{
+	public:
+		using Handler = std::function<void(std::string const&)>;
+
+		PushSession(boost::asio::io_service& _ios, Handler const& _handler): m_socket(_ios), m_timer(_ios), m_handler(_handler) {}
+
+		tcp::socket& socket() { return m_socket; }
+
+		void start()
+		{
+			auto self = shared_from_this();
+			m_timer.expires_from_now(boost::posix_time::milliseconds(c_pushTimeout));
+			m_timer.async_wait([self] (boost::system::error_code const& _ec) {
+				if (!_ec)
+					self->close();
+			});
+			boost::asio::async_read_until(m_socket, m_buf, "\r\n\r\n", [self] (boost::system::error_code const& _ec, size_t _n) {
+				if (_ec)
+					self->close();
+				else
+					self->onHeaders(_n);
+			});
+		}
+
+	private:
+		void onHeaders(size_t _n)
+		{
+			std::string lower(buffers_begin(m_buf.data()), buffers_begin(m_buf.data()) + _n);
+			m_buf.consume(_n);
+			LowerCase(lower);
+			size_t p = lower.find("content-length:");
+			size_t len = 0;
+			try
+			{
+				if (p != string::npos)
+					len = stoul(lower.substr(p + 15));
+			}
+			catch (std::exception const&)
+			{
+				len = c_maxPushBody + 1;
+			}
+			if (len > c_maxPushBody)
+			{
+				LogF << "WorkFetcher : ignoring malformed work notification";
+				close();
+				return;
+			}
+
+			auto self = shared_from_this();
+			size_t missing = len > m_buf.size() ? len - m_buf.size() : 0;
+			boost::asio::async_read(m_socket, m_buf, boost::asio::transfer_exactly(missing), [self, len] (boost::system::error_code const& _ec, size_t) {
+				if (_ec)
+					self->close();
+				else
+					self->onBody(len);
+			});
+		}
+
+		void onBody(size_t _len)
+		{
+			std::string body(buffers_begin(m_buf.data()), buffers_begin(m_buf.data()) + _len);
+			auto self = shared_from_this();
+			boost::asio::async_write(m_socket, boost::asio::buffer(c_pushResponse, sizeof(c_pushResponse) - 1), [self] (boost::system::error_code const&, size_t) {
+				self->close();
+			});
+			m_handler(body);
+		}
+
+		void close()
+		{
+			boost::system::error_code ignored;
+			m_timer.cancel(ignored);
+			m_socket.close(ignored);
+		}
+
+		tcp::socket m_socket;
+		boost::asio::deadline_timer m_timer;
+		boost::asio::streambuf m_buf;
+		Handler m_handler;
+	};
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class WorkFetcher
+*----------------------------------------------------------------------------------*/
+WorkFetcher::WorkFetcher(std::string const& _host, std::string const& _port, Mode _mode, unsigned _pollingInterval, unsigned _pushPort) :
+	m_host(_host), m_port(_port), m_mode(_mode), m_pollingInterval(_pollingInterval), m_pushPort(_pushPort)
+{
+	m_fetchThread.reset(new std::thread(&WorkFetcher::fetchLoop, this));
+	if (m_mode == Mode::Push)
+		m_pushThread.reset(new std::thread(&WorkFetcher::pushLoop, this));
+}
+
+WorkFetcher::~WorkFetcher()
+{
+	DEV_GUARDED(x_work)
+		m_running = false;
+	m_workChanged.notify_all();
+	m_pushIos.stop();
+	if (m_pushThread)
+		m_pushThread->join();
+	m_fetchThread->join();
+}
+
+bool WorkFetcher::parseMode(std::string _s, Mode& _mode)
+{
+	LowerCase(_s);
+	if (_s == "poll")
+		_mode = Mode::Poll;
+	else if (_s == "longpoll")
+		_mode = Mode::LongPoll;
+	else if (_s == "push")
+		_mode = Mode::Push;
+	else
+		return false;
+	return true;
+}
+
+bool WorkFetcher::waitForWork(unsigned _ms, Work& _work)
+{
+	UniqueGuard l(x_work);
+	m_workChanged.wait_for(l, std::chrono::milliseconds(_ms), [&] () { return m_haveWork || m_failed; });
+	if (m_failed)
+	{
+		m_failed = false;
+		throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, m_error);
+	}
+	if (!m_haveWork)
+		return false;
+	_work = m_work;
+	m_haveWork = false;
+	return true;
+}
+
+void WorkFetcher::fetchLoop()
+{
+	setThreadName("getwork");
+	KeepAliveHttpClient client(m_host, m_port);
+	bool longPoll = false;
+
+	while (m_running)
+	{
+		unsigned delay = m_mode == Mode::Push ? c_pushPollInterval : m_pollingInterval;
+		try
+		{
+			if (longPoll)
+			{
+				client.setTimeout(c_longPollTimeout);
+				try
+				{
+					if (!fetchOnce(client, true))
+					{
+						LogB << "Node does not support eth_awaitNewWork.  Falling back to polling.";
+						m_mode = Mode::Poll;
+						longPoll = false;
+					}
+				}
+				catch (jsonrpc::JsonRpcException&)
+				{
+					// most likely nothing happened for a while.  the regular getWork below
+					// will tell us if the node really is gone.
+				}
+			}
+			client.setTimeout(c_requestTimeout);
+			fetchOnce(client, false);
+			// the first getWork gets us going.  from then on we wait on the node.
+			longPoll = m_mode == Mode::LongPoll;
+		}
+		catch (jsonrpc::JsonRpcException& e)
+		{
+			DEV_GUARDED(x_work)
+			{
+				m_failed = true;
+				m_error = e.what();
+				// make sure whatever the node gives us once it's back gets passed on.
+				m_lastRaw.clear();
+				m_lastHeader = h256();
+			}
+			m_workChanged.notify_all();
+			delay = c_retryDelay;
+			longPoll = false;
+		}
+
+		if (!longPoll)
+		{
+			UniqueGuard l(x_work);
+			m_workChanged.wait_for(l, std::chrono::milliseconds(delay), [&] () { return !m_running; });
+		}
+	}
+}
+
+bool WorkFetcher::fetchOnce(KeepAliveHttpClient& _client, bool _longPoll)
+{
+	std::string raw = _client.post(_longPoll ? c_awaitNewWork : c_getWork);
+	DEV_GUARDED(x_work)
+		if (raw == m_lastRaw)
+			// nothing has changed.  don't bother parsing it.
+			return true;
+
+	if (raw.find("\"error\"") != string::npos)
+	{
+		if (_longPoll)
+			return false;
+		throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_INVALID_RESPONSE, raw);
+	}
+	publish(raw, true);
+	return true;
+}
+
+bool WorkFetcher::publish(std::string const& _raw, bool _isResult)
+{
+	SteadyClock::time_point received = SteadyClock::now();
+
+	Json::Value root;
+	Json::Reader reader;
+	if (!reader.parse(_raw, root))
+	{
+		LogF << "WorkFetcher : unable to parse " << _raw;
+		return false;
+	}
+	// pushed work may come as the bare array or wrapped the same way as a getWork response.
+	Json::Value v = (_isResult || root.isObject()) ? root["result"] : root;
+	if (!v.isArray() || v.size() < 3)
+	{
+		LogF << "WorkFetcher : unexpected work package " << _raw;
+		return false;
+	}
+
+	Guard l(x_work);
+	m_lastRaw = _raw;
+	// the header string is all we need to look at to know whether this is new work.
+	h256 header(v[0].asString());
+	if (header == m_lastHeader)
+		return false;
+	m_lastHeader = header;
+	m_work.header = header;
+	m_work.seed = h256(v[1].asString());
+	m_work.boundary = h256(fromHex(v[2].asString()), h256::AlignRight);
+	m_work.received = received;
+	m_haveWork = true;
+	m_workChanged.notify_all();
+	return true;
+}
+
+void WorkFetcher::pushLoop()
+{
+	setThreadName("workpush");
+	try
+	{
+		tcp::acceptor acceptor(m_pushIos, tcp::endpoint(tcp::v4(), m_pushPort));
+		LogS << "Listening for work notifications on port " << m_pushPort;
+
+		PushSession::Handler onPush = [this] (std::string const& _body) {
+			if (publish(_body, false))
+				LogF << "WorkFetcher : work pushed by node";
+		};
+		std::function<void()> accept;
+		accept = [&] () {
+			auto session = std::make_shared<PushSession>(m_pushIos, onPush);
+			acceptor.async_accept(session->socket(), [&, session] (boost::system::error_code const& _ec) {
+				if (_ec)
+					return;
+				session->start();
+				accept();
+			});
+		};
+		accept();
+		m_pushIos.run();
+	}
+	catch (std::exception const& e)
+	{
+		LogB << "Unable to listen for work notifications on port " << m_pushPort << " : " << e.what();
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// obtains getWork packages from the node on a background thread.  three strategies:
+//
+//	poll		eth_getWork every polling interval, over a persistent keep-alive connection.
+//	longpoll	eth_awaitNewWork, which the node answers only when there is new work.  falls
+//				back to polling if the node doesn't support it.
+//	push		the node POSTs new work to a port we listen on (eg. geth --miner.notify).
+//				we keep polling slowly as a safety net.
+//
+// responses identical to the previous one are discarded before any JSON parsing or hex
+// decoding is done.
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <condition_variable>
+#include <boost/asio.hpp>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+#include "KeepAliveHttpClient.h"
+#include "Common.h"
+
+class WorkFetcher
+{
+public:
+	enum class Mode { Poll, LongPoll, Push };
+
+	struct Work
+	{
+		dev::h256 header;
+		dev::h256 seed;
+		dev::h256 boundary;
+		SteadyClock::time_point received;	// when the response / notification arrived
+	};
+
+	WorkFetcher(std::string const& _host, std::string const& _port, Mode _mode, unsigned _pollingInterval, unsigned _pushPort);
+	~WorkFetcher();
+
+	// wait up to _ms milliseconds for a new work package. throws jsonrpc::JsonRpcException
+	// if communication with the node has failed since the last call.
+	bool waitForWork(unsigned _ms, Work& _work);
+
+	Mode mode() const { return m_mode.load(); }
+
+	static bool parseMode(std::string _s, Mode& _mode);
+
+private:
+	void fetchLoop();
+	void pushLoop();
+	bool fetchOnce(KeepAliveHttpClient& _client, bool _longPoll);
+	// returns true if the response contained new work.
+	bool publish(std::string const& _raw, bool _isResult);
+
+	std::string m_host;
+	std::string m_port;
+	std::atomic<Mode> m_mode;
+	unsigned m_pollingInterval;
+	unsigned m_pushPort;
+
+	Mutex x_work;
+	std::condition_variable m_workChanged;
+	std::string m_lastRaw;
+	dev::h256 m_lastHeader;
+	Work m_work;
+	bool m_haveWork = false;
+	bool m_failed = false;
+	std::string m_error;
+
+	std::atomic<bool> m_running = {true};
+	std::unique_ptr<std::thread> m_fetchThread;
+	std::unique_ptr<std::thread> m_pushThread;
+	boost::asio::io_service m_pushIos;
+};
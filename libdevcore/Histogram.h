@@ -0,0 +1,98 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// latency histogram with power-of-two microsecond buckets.  bucket i holds samples in
+// [2^i, 2^(i+1)) us, so 32 buckets cover everything from 1us to over an hour at a fixed
+// 256 bytes, and recording a sample is a handful of instructions.  not thread safe; the
+// owner is expected to guard it.
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <cstdint>
+#include <algorithm>
+
+namespace dev
+{
+
+class LatencyHistogram
+{
+public:
+	static const unsigned c_buckets = 32;
+
+	void record(std::chrono::steady_clock::duration _d)
+	{
+		record((uint64_t) std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(_d).count()));
+	}
+
+	void record(uint64_t _us)
+	{
+		unsigned b = 0;
+		for (uint64_t v = _us; v > 1 && b < c_buckets - 1; v >>= 1)
+			b++;
+		m_buckets[b]++;
+		m_count++;
+		m_total += _us;
+		m_max = std::max(m_max, _us);
+	}
+
+	void reset() { *this = LatencyHistogram(); }
+
+	uint64_t count() const { return m_count; }
+	uint64_t maxUs() const { return m_max; }
+	double meanMs() const { return m_count ? m_total / 1000.0 / m_count : 0; }
+
+	// upper bound of the bucket containing the _p'th percentile (0 < _p <= 100), in ms.
+	double percentileMs(double _p) const
+	{
+		if (!m_count)
+			return 0;
+		uint64_t target = std::max<uint64_t>(1, (uint64_t) (m_count * _p / 100.0 + 0.5));
+		uint64_t seen = 0;
+		for (unsigned b = 0; b < c_buckets; b++)
+		{
+			seen += m_buckets[b];
+			if (seen >= target)
+				return std::min<uint64_t>(uint64_t(2) << b, m_max) / 1000.0;
+		}
+		return m_max / 1000.0;
+	}
+
+	uint64_t bucket(unsigned _i) const { return m_buckets[_i]; }
+
+	// eg. "n=120 mean=41.2ms p50=65.5ms p90=65.5ms p99=131ms max=98.3ms"
+	std::string summary() const
+	{
+		std::ostringstream ss;
+		ss.precision(3);
+		ss << "n=" << m_count << " mean=" << meanMs() << "ms p50=" << percentileMs(50) << "ms p90=" << percentileMs(90)
+			<< "ms p99=" << percentileMs(99) << "ms max=" << m_max / 1000.0 << "ms";
+		return ss.str();
+	}
+
+private:
+	std::array<uint64_t, c_buckets> m_buckets = {{}};
+	uint64_t m_count = 0;
+	uint64_t m_total = 0;
+	uint64_t m_max = 0;
+};
+
+}
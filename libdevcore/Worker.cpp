@@ -29,27 +29,57 @@
 using namespace std;
 using namespace dev;
 
+namespace
+{
+Mutex x_latency;
+LatencyHistogram s_startLatency;
+LatencyHistogram s_stopLatency;
+
+void recordLatency(LatencyHistogram& _h, chrono::steady_clock::time_point _since)
+{
+	Guard l(x_latency);
+	_h.record(chrono::steady_clock::now() - _since);
+}
+}
+
+void Worker::transitionLatency(LatencyHistogram& _start, LatencyHistogram& _stop)
+{
+	Guard l(x_latency);
+	_start = s_startLatency;
+	_stop = s_stopLatency;
+}
+
 void Worker::startWorking()
 {
 	LogF << "Worker::startWorking, startWorking for thread " << m_name;
 	Guard l(x_work);
+	auto requested = chrono::steady_clock::now();
+	bool starting = true;
 	if (m_work)
 	{
-		WorkerState ex = WorkerState::Stopped;
-		m_state.compare_exchange_strong(ex, WorkerState::Starting);
+		Guard sl(x_state);
+		starting = m_state == WorkerState::Stopped;
+		if (starting)
+			setState(WorkerState::Starting);
 	}
 	else
 	{
-		m_state = WorkerState::Starting;
+		DEV_GUARDED(x_state)
+			m_state = WorkerState::Starting;
 		m_work.reset(new thread([&]()
 		{
 			setThreadName(m_name.c_str());
 			LogF << "Worker::startWorking, Thread begins";
-			while (m_state != WorkerState::Killing)
+			while (true)
 			{
-				WorkerState ex = WorkerState::Starting;
-				bool ok = m_state.compare_exchange_strong(ex, WorkerState::Started);
-				(void)ok;
+				{
+					// park here until we're started again (or killed).
+					unique_lock<mutex> sl(x_state);
+					m_stateChanged.wait(sl, [&] () { return m_state == WorkerState::Starting || m_state == WorkerState::Killing; });
+					if (m_state == WorkerState::Killing)
+						break;
+					setState(WorkerState::Started);
+				}
 
 				try
 				{
@@ -62,20 +92,23 @@ void Worker::startWorking()
 					clog(WarnChannel) << "Exception thrown in Worker thread: " << _e.what();
 				}
 
-				ex = m_state.exchange(WorkerState::Stopped);
+				unique_lock<mutex> sl(x_state);
+				WorkerState ex = m_state;
 				LogF << "Worker::startWorking, State: Stopped: Thread was " << (unsigned)ex;
-				if (ex == WorkerState::Killing || ex == WorkerState::Starting)
-					m_state.exchange(ex);
-
-				DEV_TIMED_ABOVE("Worker stopping", 100)
-					while (m_state == WorkerState::Stopped)
-						this_thread::sleep_for(chrono::milliseconds(20));
+				if (ex == WorkerState::Killing)
+					break;
+				setState(WorkerState::Stopped);
 			}
 		}));
 	}
+
 	DEV_TIMED_ABOVE("Start worker", 100)
-		while (m_state == WorkerState::Starting)
-			this_thread::sleep_for(chrono::microseconds(20));
+	{
+		unique_lock<mutex> sl(x_state);
+		m_stateChanged.wait(sl, [&] () { return m_state != WorkerState::Starting; });
+	}
+	if (starting)
+		recordLatency(s_startLatency, requested);
 }
 
 void Worker::stopWorking()
@@ -83,12 +116,17 @@ void Worker::stopWorking()
 	DEV_GUARDED(x_work)
 		if (m_work)
 		{
-			WorkerState ex = WorkerState::Started;
-			m_state.compare_exchange_strong(ex, WorkerState::Stopping);
+			auto requested = chrono::steady_clock::now();
+			unique_lock<mutex> sl(x_state);
+			bool stopping = m_state == WorkerState::Started;
+			if (stopping)
+				setState(WorkerState::Stopping);
 
 			DEV_TIMED_ABOVE("Stop worker", 100)
-				while (m_state != WorkerState::Stopped)
-					this_thread::sleep_for(chrono::microseconds(20));
+				m_stateChanged.wait(sl, [&] () { return m_state == WorkerState::Stopped; });
+			sl.unlock();
+			if (stopping)
+				recordLatency(s_stopLatency, requested);
 		}
 }
 
@@ -98,7 +136,8 @@ void Worker::terminate()
 	DEV_GUARDED(x_work)
 		if (m_work)
 		{
-			m_state.exchange(WorkerState::Killing);
+			DEV_GUARDED(x_state)
+				setState(WorkerState::Killing);
 
 			DEV_TIMED_ABOVE("Terminate worker", 100)
 				m_work->join();
@@ -24,7 +24,9 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <condition_variable>
 #include "Guards.h"
+#include "Histogram.h"
 
 namespace dev
 {
@@ -47,6 +49,10 @@ enum class WorkerState
 
 class Worker
 {
+public:
+	/// Time from start/stop being requested to the worker thread acknowledging it, over all workers.
+	static void transitionLatency(LatencyHistogram& _start, LatencyHistogram& _stop);
+
 protected:
 	Worker(std::string const& _name = "anon", unsigned _idleWaitMs = 30): m_name(_name), m_idleWaitMs(_idleWaitMs) {}
 
@@ -66,10 +72,11 @@ protected:
 	/// Allows changing worker name if work is stopped.
 	void setName(std::string _n) { if (!isWorking()) m_name = _n; }
 
-	/// Starts worker thread; causes startedWorking() to be called.
+	/// Starts worker thread; causes startedWorking() to be called.  Returns once the thread has
+	/// picked up the request.
 	void startWorking();
 	
-	/// Stop worker thread; causes call to stopWorking().
+	/// Stop worker thread; causes call to stopWorking().  Returns once workLoop() has exited.
 	void stopWorking();
 
 	/// Returns if worker thread is present.
@@ -95,13 +102,19 @@ private:
 	/// Stop and never start again.
 	void terminate();
 
+	/// Changes m_state and wakes up everyone waiting on it.  x_state must be held.
+	void setState(WorkerState _s) { m_state = _s; m_stateChanged.notify_all(); }
+
 	std::string m_name;
 
 	unsigned m_idleWaitMs = 0;
 	
 	mutable Mutex x_work;						// Lock for the network existence.
 	std::unique_ptr<std::thread> m_work;		// The network thread.
+	// m_state is only changed under x_state, but it's atomic so shouldStop() can poll it without the lock.
 	std::atomic<WorkerState> m_state = {WorkerState::Starting};
+	Mutex x_state;
+	std::condition_variable m_stateChanged;
 };
 
 }
@@ -884,6 +884,9 @@ void ethash_cl_miner::search(h256 _header, uint64_t target, search_hook& hook, b
 		// put in a rough guess for now, in case we are throttling
 		int kernelTime = 100;
 		int batchCount = 0;
+		bool launched = false;
+		// stratum only: every nonce of the job has been claimed, by us or the other devices.
+		bool exhausted = false;
 
 		{
 			// if we're throttling we only use one buffer to keep things linear, so we can do a 
@@ -962,11 +965,24 @@ void ethash_cl_miner::search(h256 _header, uint64_t target, search_hook& hook, b
 			// events to know when the data is available). this causes both kernels to run at the same time.  
 
 			kernelStartTime = SteadyClock::now();
-			if (m_pending.size() < l_bufferCount)
+			if (m_pending.size() < l_bufferCount && !exhausted && _ethStratum && !hook.claim(m_globalWorkSize, start_nonce))
 			{
-				if (_ethStratum)
-					start_nonce += m_globalWorkSize;
-				else
+				// carrying on past our claim would hash nonces that another device has, so
+				// finish the runs in flight and sit idle until the next job.
+				exhausted = true;
+				LogB << "Nonce space exhausted, idling until new work, device[" << m_device << "]";
+			}
+			if (exhausted && m_pending.empty())
+			{
+				this_thread::sleep_for(chrono::milliseconds(100));
+				hook.searched(0, 0, c_maxHash);	// keep the hash rates display up-to-date
+				if (hook.shouldStop())
+					break;
+				continue;
+			}
+			if (m_pending.size() < l_bufferCount && !exhausted)
+			{
+				if (!_ethStratum)
 					start_nonce = nextNonceIndex(nonce_index, false) * m_globalWorkSize;
 
 				m_searchKernel.setArg(0, m_searchBuffer[m_buf]);
@@ -975,13 +991,18 @@ void ethash_cl_miner::search(h256 _header, uint64_t target, search_hook& hook, b
 
 				m_queue[m_buf].enqueueNDRangeKernel(m_searchKernel, cl::NullRange, m_globalWorkSize, s_workgroupSize);
 				m_pending.push_back({start_nonce, _header, m_buf});
+				if (!launched)
+				{
+					launched = true;
+					hook.launched(_header);
+				}
 
 				m_results[m_buf] = (search_results*) m_queue[m_buf].enqueueMapBuffer(m_searchBuffer[m_buf], CL_FALSE, CL_MAP_READ, 0, 
 																			   sizeof(search_results), 0, &m_mapEvents[m_buf]);
 				m_buf = (m_buf + 1) % l_bufferCount;
 			}
 
-			if (m_pending.size() == l_bufferCount)
+			if (m_pending.size() == l_bufferCount || (exhausted && !m_pending.empty()))
 			{
 				// read results
 
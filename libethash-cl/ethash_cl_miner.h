@@ -36,6 +36,11 @@ public:
 		virtual bool found(uint64_t const* nonces, uint32_t count) = 0;
 		virtual bool searched(uint32_t _count, uint64_t _hashSample, uint64_t _bestHash) = 0;
 		virtual bool shouldStop() = 0;
+		// the first kernel run for _header has been queued.
+		virtual void launched(h256 const& _header) { (void) _header; }
+		// stratum mode: claims the next _count nonces to search.  return false when there's
+		// nothing left to claim, and the search idles until it's stopped.
+		virtual bool claim(uint64_t _count, uint64_t& _start) { (void) _count; (void) _start; return false; }
 	};
 
 	typedef struct
@@ -292,6 +292,7 @@ void ethash_cuda_miner::search(uint8_t const* header, uint64_t target, search_ho
 {
 	bool initialize = false;
 	bool exit = false;
+	bool launched = false;
 	SteadyClock::time_point batchStartTime; 
 	
 	if (memcmp(&m_current_header, header, sizeof(hash32_t)))
@@ -337,6 +338,10 @@ void ethash_cuda_miner::search(uint8_t const* header, uint64_t target, search_ho
 	}
 	batchStartTime = SteadyClock::now();
 	uint64_t batch_size = s_gridSize * s_blockSize;
+	m_stream_nonce.resize(s_numStreams);
+	// stratum only: every nonce of the job has been claimed, by us or the other devices.
+	bool exhausted = false;
+	unsigned idle = 0;
 	for (; !exit; m_current_index++, m_current_nonce += batch_size)
 	{
 		unsigned int stream_index = m_current_index % s_numStreams;
@@ -344,7 +349,11 @@ void ethash_cuda_miner::search(uint8_t const* header, uint64_t target, search_ho
 		volatile uint32_t* buffer = m_search_buf[stream_index];
 		uint32_t found_count = 0;
 		uint64_t nonces[SEARCH_RESULT_BUFFER_SIZE - 1];
-		uint64_t nonce_base = m_current_nonce - s_numStreams * batch_size;
+		uint64_t nonce_base = m_stream_nonce[stream_index];
+		// once we've stopped launching, the other streams each still have a batch to finish.
+		bool running = !exhausted || ++idle < s_numStreams;
+		if (!running)
+			this_thread::sleep_for(chrono::milliseconds(100));
 		if (m_current_index >= s_numStreams)
 		{
 			CUDA_SAFE_CALL(cudaStreamSynchronize(stream));
@@ -354,11 +363,27 @@ void ethash_cuda_miner::search(uint8_t const* header, uint64_t target, search_ho
 			for (unsigned int j = 0; j < found_count; j++)
 				nonces[j] = nonce_base + buffer[j + 1];
 		}
-		run_ethash_search(s_gridSize, s_blockSize, m_sharedBytes, stream, buffer, m_current_nonce);
-		if (m_current_index >= s_numStreams)
+		if (_ethStratum && !exhausted && !hook.claim(batch_size, m_current_nonce))
+		{
+			// carrying on past our claim would hash nonces that another device has, so
+			// finish the batches in flight and sit idle until the next job.
+			exhausted = true;
+			ETHCUDA_LOG("Nonce space exhausted, idling until new work");
+		}
+		if (!exhausted)
+		{
+			m_stream_nonce[stream_index] = m_current_nonce;
+			run_ethash_search(s_gridSize, s_blockSize, m_sharedBytes, stream, buffer, m_current_nonce);
+			if (!launched)
+			{
+				launched = true;
+				hook.launched(header);
+			}
+		}
+		if (m_current_index >= s_numStreams || !running)
 		{
 			exit = found_count && hook.found(nonces, found_count);
-			exit |= hook.searched(batch_size, 0, 0);
+			exit |= hook.searched(running ? batch_size : 0, 0, 0);
 		}
 		batchStartTime = SteadyClock::now();
 	}
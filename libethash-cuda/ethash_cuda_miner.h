@@ -4,6 +4,7 @@
 
 #include <time.h>
 #include <functional>
+#include <vector>
 #include <libethash/ethash.h>
 #include "ethash_cuda_miner_kernel.h"
 
@@ -18,6 +19,11 @@ public:
 		// reports progress, return true to abort
 		virtual bool found(uint64_t const* nonces, uint32_t count) = 0;
 		virtual bool searched(uint32_t _count, uint64_t _hashSample, uint64_t _bestHash) = 0;
+		// the first kernel run for _header (32 bytes) has been launched.
+		virtual void launched(uint8_t const* _header) { (void) _header; }
+		// stratum mode: claims the next _count nonces to search.  return false when there's
+		// nothing left to claim, and the search idles until it's stopped.
+		virtual bool claim(uint64_t _count, uint64_t& _start) { (void) _count; (void) _start; return false; }
 	};
 
 public:
@@ -55,6 +61,8 @@ private:
 	uint64_t m_current_nonce;
 	uint64_t m_starting_nonce;
 	uint64_t m_current_index;
+	// the start nonce of the batch running on each stream, since claimed batches aren't contiguous.
+	std::vector<uint64_t> m_stream_nonce;
 
 	uint32_t m_sharedBytes;
 
@@ -31,3 +31,13 @@
 #define restrict __restrict__
 #endif
 
+
+// hint that the cache line at p is about to be read
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define ethash_prefetch(p) _mm_prefetch((char const*)(p), _MM_HINT_T0)
+#elif defined(__GNUC__) || defined(__clang__)
+#define ethash_prefetch(p) __builtin_prefetch((p), 0, 3)
+#else
+#define ethash_prefetch(p) ((void)(p))
+#endif
@@ -0,0 +1,160 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ethash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file dagsum.c
+ * Per chunk checksums of a DAG file.  See dagsum.h.
+ */
+#include "dagsum.h"
+#include <string.h>
+#include <stdio.h>
+#include "io.h"
+
+#define DAGSUM_MAGIC 0x324d555347414445ULL	// "EDAGSUM2"
+#define DAGSUM_PRIME1 0x9E3779B185EBCA87ULL
+#define DAGSUM_PRIME2 0xC2B2AE3D27D4EB4FULL
+
+struct dagsum_header {
+	uint64_t magic;
+	uint32_t version;
+	uint32_t chunk_bytes;
+	uint64_t full_size;
+	uint64_t chunks;
+};
+
+static inline uint64_t rotl64(uint64_t x, unsigned r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t dagsum_round(uint64_t acc, uint64_t w)
+{
+	return rotl64(acc + w * DAGSUM_PRIME2, 31) * DAGSUM_PRIME1;
+}
+
+size_t ethash_dagsum_chunks(uint64_t full_size)
+{
+	return (size_t)((full_size + ETHASH_DAGSUM_CHUNK_BYTES - 1) / ETHASH_DAGSUM_CHUNK_BYTES);
+}
+
+uint64_t ethash_dagsum_chunk(void const* data, size_t size)
+{
+	// four independent lanes over 32 byte stripes, so it runs at memory speed.
+	uint64_t acc[4] = { DAGSUM_PRIME1 + DAGSUM_PRIME2, DAGSUM_PRIME2, 0, 0 - DAGSUM_PRIME1 };
+	uint8_t const* p = (uint8_t const*) data;
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		uint64_t w[4];
+		memcpy(w, p + i, 32);
+		for (unsigned l = 0; l != 4; ++l) {
+			acc[l] = dagsum_round(acc[l], w[l]);
+		}
+	}
+	uint64_t h = rotl64(acc[0], 1) + rotl64(acc[1], 7) + rotl64(acc[2], 12) + rotl64(acc[3], 18);
+	for (unsigned l = 0; l != 4; ++l) {
+		h = (h ^ dagsum_round(0, acc[l])) * DAGSUM_PRIME1 + DAGSUM_PRIME2;
+	}
+	// whatever is left over
+	for (; i < size; ++i) {
+		h = rotl64(h ^ (p[i] * DAGSUM_PRIME1), 11) * DAGSUM_PRIME2;
+	}
+	h ^= size;
+	h ^= h >> 33;
+	h *= DAGSUM_PRIME2;
+	h ^= h >> 29;
+	return h;
+}
+
+static char* dagsum_filename(char const* dirname, ethash_h256_t const seed_hash)
+{
+	char name[DAG_MUTABLE_NAME_MAX_SIZE + 4];
+	if (!ethash_io_mutable_name(ETHASH_REVISION, &seed_hash, name)) {
+		return NULL;
+	}
+	strcat(name, ".sum");
+	return ethash_io_create_filename(dirname, name, strlen(name));
+}
+
+bool ethash_dagsum_write(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size,
+	uint64_t const* sums
+)
+{
+	bool ret = false;
+	char* filename = dagsum_filename(dirname, seed_hash);
+	if (!filename) {
+		return false;
+	}
+	FILE* f = ethash_fopen(filename, "wb");
+	if (!f) {
+		ETHASH_CRITICAL("Could not create DAG checksum file: \"%s\"", filename);
+		goto free_name;
+	}
+	struct dagsum_header hdr = { DAGSUM_MAGIC, ETHASH_DAGSUM_VERSION, ETHASH_DAGSUM_CHUNK_BYTES, full_size, ethash_dagsum_chunks(full_size) };
+	uint64_t const total = ethash_dagsum_chunk(sums, (size_t)hdr.chunks * sizeof(uint64_t)) ^ hdr.chunks;
+	ret = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+		fwrite(sums, sizeof(uint64_t), (size_t)hdr.chunks, f) == hdr.chunks &&
+		fwrite(&total, sizeof(total), 1, f) == 1;
+	ret = (fclose(f) == 0) && ret;
+	if (!ret) {
+		ETHASH_CRITICAL("Could not write DAG checksum file: \"%s\"", filename);
+		remove(filename);
+	}
+free_name:
+	free(filename);
+	return ret;
+}
+
+uint64_t* ethash_dagsum_read(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size
+)
+{
+	uint64_t* sums = NULL;
+	char* filename = dagsum_filename(dirname, seed_hash);
+	if (!filename) {
+		return NULL;
+	}
+	FILE* f = ethash_fopen(filename, "rb");
+	free(filename);
+	if (!f) {
+		return NULL;
+	}
+	struct dagsum_header hdr;
+	size_t const chunks = ethash_dagsum_chunks(full_size);
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+		hdr.magic != DAGSUM_MAGIC ||
+		hdr.version != ETHASH_DAGSUM_VERSION ||
+		hdr.chunk_bytes != ETHASH_DAGSUM_CHUNK_BYTES ||
+		hdr.full_size != full_size ||
+		hdr.chunks != chunks) {
+		goto close;
+	}
+	sums = malloc(chunks * sizeof(uint64_t));
+	uint64_t total;
+	if (!sums ||
+		fread(sums, sizeof(uint64_t), chunks, f) != chunks ||
+		fread(&total, sizeof(total), 1, f) != 1 ||
+		total != (ethash_dagsum_chunk(sums, chunks * sizeof(uint64_t)) ^ chunks)) {
+		free(sums);
+		sums = NULL;
+	}
+close:
+	fclose(f);
+	return sums;
+}
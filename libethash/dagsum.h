@@ -0,0 +1,81 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ethash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file dagsum.h
+ * Per chunk checksums of a DAG file, kept in a sidecar file next to it.
+ *
+ * The DAG is split in ETHASH_DAGSUM_CHUNK_BYTES chunks (the last one may be shorter),
+ * and each chunk gets a 64 bit checksum when it is generated.  The sidecar is the DAG
+ * file's name plus ".sum": a header, one checksum per chunk, and a checksum of those.
+ * A DAG loaded from disk can then be checked chunk by chunk, in parallel, and only the
+ * chunks that don't match need to be generated again.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "ethash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ETHASH_DAGSUM_CHUNK_BYTES (16 * 1024 * 1024)
+#define ETHASH_DAGSUM_VERSION 2
+
+/**
+ * @return  the number of chunks a DAG of full_size bytes has
+ */
+size_t ethash_dagsum_chunks(uint64_t full_size);
+
+/**
+ * Checksum of one chunk.  Not cryptographic; it's there to catch truncated and
+ * bit-rotted files.
+ *
+ * @param data    The chunk
+ * @param size    Its size in bytes
+ */
+uint64_t ethash_dagsum_chunk(void const* data, size_t size);
+
+/**
+ * Write the sidecar of the DAG file for seed_hash in dirname.
+ *
+ * @param sums    ethash_dagsum_chunks(full_size) checksums
+ * @return        false if the file couldn't be written
+ */
+bool ethash_dagsum_write(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size,
+	uint64_t const* sums
+);
+
+/**
+ * Read the sidecar of the DAG file for seed_hash in dirname.
+ *
+ * @return        ethash_dagsum_chunks(full_size) checksums, which the caller must free(),
+ *                or NULL if there is no sidecar, or it is damaged or for a different size
+ */
+uint64_t* ethash_dagsum_read(
+	char const* dirname,
+	ethash_h256_t const seed_hash,
+	uint64_t full_size
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -37,6 +37,7 @@
 #define ETHASH_DATASET_PARENTS 256
 #define ETHASH_CACHE_ROUNDS 3
 #define ETHASH_ACCESSES 64
+#define ETHASH_MAX_INTERLEAVE 16
 #define ETHASH_DAG_MAGIC_NUM_SIZE 8
 #define ETHASH_DAG_MAGIC_NUM 0xFEE1DEADBADDCAFE
 
@@ -94,6 +95,36 @@ ethash_return_value_t ethash_light_compute(
 	uint64_t nonce
 );
 
+/**
+ * Supplies DAG page number page (ETHASH_MIX_BYTES bytes) to a light client evaluation,
+ * eg. from a cache of pages computed earlier.  Pages it doesn't have can be computed
+ * with ethash_light_compute_page().  It may be called from several threads at once.
+ */
+typedef void (*ethash_page_source_t)(void* ctx, uint32_t page, uint8_t* out);
+
+/**
+ * Calculate the light client data, getting the DAG pages it reads from source
+ *
+ * @param light          The light client handler
+ * @param header_hash    The header hash to pack into the mix
+ * @param nonce          The nonce to pack into the mix
+ * @param source         Called for each of the ETHASH_ACCESSES pages the hash reads
+ * @param source_ctx     Passed to source
+ * @return               an object of ethash_return_value_t holding the return values
+ */
+ethash_return_value_t ethash_light_compute_paged(
+	ethash_light_t light,
+	ethash_h256_t const header_hash,
+	uint64_t nonce,
+	ethash_page_source_t source,
+	void* source_ctx
+);
+
+/**
+ * Compute DAG page number page (ETHASH_MIX_BYTES bytes) from the light cache
+ */
+void ethash_light_compute_page(ethash_light_t light, uint32_t page, uint8_t* out);
+
 /**
  * Allocate and initialize a new ethash_full handler
  *
@@ -128,6 +159,44 @@ ethash_return_value_t ethash_full_compute(
 	ethash_h256_t const header_hash,
 	uint64_t nonce
 );
+/**
+ * Calculate the full client data against a DAG held elsewhere in memory, eg. a copy
+ * of ethash_full_dag() placed on a particular NUMA node
+ *
+ * @param full_data      The DAG data
+ * @param full_size      The size of the DAG data in bytes
+ * @param header_hash    The header hash to pack into the mix
+ * @param nonce          The nonce to pack into the mix
+ * @return               An object of ethash_return_value to hold the return value
+ */
+ethash_return_value_t ethash_full_compute_data(
+	void const* full_data,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+);
+/**
+ * Calculate the full client data for several nonces at once.  Their DAG accesses are
+ * interleaved and prefetched so the memory fetches of one overlap the mixing of the
+ * others, which hides much of the DRAM latency a single hash stalls on.  Nonces are
+ * processed ETHASH_MAX_INTERLEAVE at a time, so count sets how many are in flight.
+ *
+ * @param full_data      The DAG data
+ * @param full_size      The size of the DAG data in bytes
+ * @param header_hash    The header hash to pack into the mix
+ * @param nonces         count nonces to hash
+ * @param count          The number of nonces
+ * @param results        count results, in the same order as nonces
+ * @return               false if the DAG parameters are invalid
+ */
+bool ethash_full_compute_batch(
+	void const* full_data,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* results
+);
 /**
  * Get a pointer to the full DAG data
  */
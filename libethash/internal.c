@@ -33,13 +33,9 @@
 #include "data_sizes.h"
 #include "io.h"
 
-#ifdef WITH_CRYPTOPP
-
-#include "sha3_cryptopp.h"
-
-#else
 #include "sha3.h"
-#endif // WITH_CRYPTOPP
+#include "keccak.h"
+#include "dagsum.h"
 
 uint64_t ethash_get_datasize(uint64_t const block_number)
 {
@@ -90,56 +86,62 @@ bool static ethash_compute_cache_nodes(
 	return true;
 }
 
-void ethash_calculate_dag_item(
+// fold src into dst with FNV, word by word
+static inline void ethash_fnv_node(node* dst, node const* src)
+{
+#if defined(_M_X64) && ENABLE_SSE
+	__m128i fnv_prime = _mm_set1_epi32(FNV_PRIME);
+	__m128i xmm0 = _mm_mullo_epi32(fnv_prime, dst->xmm[0]);
+	__m128i xmm1 = _mm_mullo_epi32(fnv_prime, dst->xmm[1]);
+	__m128i xmm2 = _mm_mullo_epi32(fnv_prime, dst->xmm[2]);
+	__m128i xmm3 = _mm_mullo_epi32(fnv_prime, dst->xmm[3]);
+	dst->xmm[0] = _mm_xor_si128(xmm0, src->xmm[0]);
+	dst->xmm[1] = _mm_xor_si128(xmm1, src->xmm[1]);
+	dst->xmm[2] = _mm_xor_si128(xmm2, src->xmm[2]);
+	dst->xmm[3] = _mm_xor_si128(xmm3, src->xmm[3]);
+#else
+	for (unsigned w = 0; w != NODE_WORDS; ++w) {
+		dst->words[w] = fnv_hash(dst->words[w], src->words[w]);
+	}
+#endif
+}
+
+// DAG items first .. first + count - 1 (count <= ETHASH_KECCAK_LANES), side by side so
+// their Keccak hashes share a multi-buffer call.
+static void ethash_calculate_dag_items(
 	node* const ret,
-	uint32_t node_index,
+	uint32_t first,
+	unsigned count,
 	ethash_light_t const light
 )
 {
 	uint32_t num_parent_nodes = (uint32_t) (light->cache_size / sizeof(node));
 	node const* cache_nodes = (node const *) light->cache;
-	node const* init = &cache_nodes[node_index % num_parent_nodes];
-	memcpy(ret, init, sizeof(node));
-	ret->words[0] ^= node_index;
-	SHA3_512(ret->bytes, ret->bytes, sizeof(node));
-#if defined(_M_X64) && ENABLE_SSE
-	__m128i const fnv_prime = _mm_set1_epi32(FNV_PRIME);
-	__m128i xmm0 = ret->xmm[0];
-	__m128i xmm1 = ret->xmm[1];
-	__m128i xmm2 = ret->xmm[2];
-	__m128i xmm3 = ret->xmm[3];
-#endif
+	uint8_t* bytes[ETHASH_KECCAK_LANES];
+	for (unsigned k = 0; k != count; ++k) {
+		uint32_t const node_index = first + k;
+		memcpy(&ret[k], &cache_nodes[node_index % num_parent_nodes], sizeof(node));
+		ret[k].words[0] ^= node_index;
+		bytes[k] = ret[k].bytes;
+	}
+	ethash_keccak512_multi(bytes, (uint8_t const* const*)bytes, sizeof(node), count);
 
 	for (uint32_t i = 0; i != ETHASH_DATASET_PARENTS; ++i) {
-		uint32_t parent_index = fnv_hash(node_index ^ i, ret->words[i % NODE_WORDS]) % num_parent_nodes;
-		node const *parent = &cache_nodes[parent_index];
-
-#if defined(_M_X64) && ENABLE_SSE
-		{
-			xmm0 = _mm_mullo_epi32(xmm0, fnv_prime);
-			xmm1 = _mm_mullo_epi32(xmm1, fnv_prime);
-			xmm2 = _mm_mullo_epi32(xmm2, fnv_prime);
-			xmm3 = _mm_mullo_epi32(xmm3, fnv_prime);
-			xmm0 = _mm_xor_si128(xmm0, parent->xmm[0]);
-			xmm1 = _mm_xor_si128(xmm1, parent->xmm[1]);
-			xmm2 = _mm_xor_si128(xmm2, parent->xmm[2]);
-			xmm3 = _mm_xor_si128(xmm3, parent->xmm[3]);
-
-			// have to write to ret as values are used to compute index
-			ret->xmm[0] = xmm0;
-			ret->xmm[1] = xmm1;
-			ret->xmm[2] = xmm2;
-			ret->xmm[3] = xmm3;
+		for (unsigned k = 0; k != count; ++k) {
+			uint32_t parent_index = fnv_hash((first + k) ^ i, ret[k].words[i % NODE_WORDS]) % num_parent_nodes;
+			ethash_fnv_node(&ret[k], &cache_nodes[parent_index]);
 		}
-		#else
-		{
-			for (unsigned w = 0; w != NODE_WORDS; ++w) {
-				ret->words[w] = fnv_hash(ret->words[w], parent->words[w]);
-			}
-		}
-#endif
 	}
-	SHA3_512(ret->bytes, ret->bytes, sizeof(node));
+	ethash_keccak512_multi(bytes, (uint8_t const* const*)bytes, sizeof(node), count);
+}
+
+void ethash_calculate_dag_item(
+	node* const ret,
+	uint32_t node_index,
+	ethash_light_t const light
+)
+{
+	ethash_calculate_dag_items(ret, node_index, 1, light);
 }
 
 bool ethash_compute_full_data(
@@ -155,90 +157,80 @@ bool ethash_compute_full_data(
 	}
 	uint32_t const max_n = (uint32_t)(full_size / sizeof(node));
 	node* full_nodes = mem;
-	double const progress_change = 1.0f / max_n;
-	double progress = 0.0f;
+	uint32_t const report_every = max_n / 100 ? max_n / 100 : 1;
+	uint32_t next_report = 0;
 	// now compute full nodes
-	for (uint32_t n = 0; n != max_n; ++n) {
-		if (callback &&
-			n % (max_n / 100) == 0 &&
-			callback((unsigned int)(ceil(progress * 100.0f))) != 0) {
-
-			return false;
+	for (uint32_t n = 0; n < max_n; n += ETHASH_KECCAK_LANES) {
+		if (callback && n >= next_report) {
+			if (callback((unsigned int)(ceil(n * 100.0 / max_n))) != 0) {
+				return false;
+			}
+			next_report += report_every;
 		}
-		progress += progress_change;
-		ethash_calculate_dag_item(&(full_nodes[n]), n, light);
+		unsigned const count = max_n - n < ETHASH_KECCAK_LANES ? max_n - n : ETHASH_KECCAK_LANES;
+		ethash_calculate_dag_items(&full_nodes[n], n, count, light);
 	}
 	return true;
 }
 
-static bool ethash_hash(
-	ethash_return_value_t* ret,
-	node const* full_nodes,
-	ethash_light_t const light,
+bool ethash_compute_full_range(
+	void* mem,
 	uint64_t full_size,
-	ethash_h256_t const header_hash,
-	uint64_t const nonce
+	uint64_t first,
+	uint64_t size,
+	ethash_light_t const light
 )
 {
-	if (full_size % MIX_WORDS != 0) {
+	if (first % sizeof(node) != 0 || size % sizeof(node) != 0 || first + size > full_size) {
 		return false;
 	}
+	uint32_t const end = (uint32_t)((first + size) / sizeof(node));
+	node* full_nodes = mem;
+	for (uint32_t n = (uint32_t)(first / sizeof(node)); n < end; n += ETHASH_KECCAK_LANES) {
+		unsigned const count = end - n < ETHASH_KECCAK_LANES ? end - n : ETHASH_KECCAK_LANES;
+		ethash_calculate_dag_items(&full_nodes[n], n, count, light);
+	}
+	return true;
+}
 
-	// pack hash and nonce together into first 40 bytes of s_mix
+// pack hash and nonce together into first 40 bytes of s_mix
+static void ethash_hash_seed(
+	node* s_mix,
+	ethash_h256_t const* header_hash,
+	uint64_t const nonce
+)
+{
 	assert(sizeof(node) * 8 == 512);
-	node s_mix[MIX_NODES + 1];
-	memcpy(s_mix[0].bytes, &header_hash, 32);
+	memcpy(s_mix[0].bytes, header_hash, 32);
 	fix_endian64(s_mix[0].double_words[4], nonce);
+}
 
-	// compute sha3-512 hash and replicate across mix
-	SHA3_512(s_mix->bytes, s_mix->bytes, 40);
+// replicate the sha3-512 of the seed across the mix
+static void ethash_hash_expand(node* s_mix)
+{
 	fix_endian_arr32(s_mix[0].words, 16);
 
 	node* const mix = s_mix + 1;
 	for (uint32_t w = 0; w != MIX_WORDS; ++w) {
 		mix->words[w] = s_mix[0].words[w % NODE_WORDS];
 	}
+}
 
-	unsigned const page_size = sizeof(uint32_t) * MIX_WORDS;
-	unsigned const num_full_pages = (unsigned) (full_size / page_size);
-
-	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
-		uint32_t const index = fnv_hash(s_mix->words[0] ^ i, mix->words[i % MIX_WORDS]) % num_full_pages;
-
-		for (unsigned n = 0; n != MIX_NODES; ++n) {
-			node const* dag_node;
-			if (full_nodes) {
-				dag_node = &full_nodes[MIX_NODES * index + n];
-			} else {
-				node tmp_node;
-				ethash_calculate_dag_item(&tmp_node, index * MIX_NODES + n, light);
-				dag_node = &tmp_node;
-			}
-
-#if defined(_M_X64) && ENABLE_SSE
-			{
-				__m128i fnv_prime = _mm_set1_epi32(FNV_PRIME);
-				__m128i xmm0 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[0]);
-				__m128i xmm1 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[1]);
-				__m128i xmm2 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[2]);
-				__m128i xmm3 = _mm_mullo_epi32(fnv_prime, mix[n].xmm[3]);
-				mix[n].xmm[0] = _mm_xor_si128(xmm0, dag_node->xmm[0]);
-				mix[n].xmm[1] = _mm_xor_si128(xmm1, dag_node->xmm[1]);
-				mix[n].xmm[2] = _mm_xor_si128(xmm2, dag_node->xmm[2]);
-				mix[n].xmm[3] = _mm_xor_si128(xmm3, dag_node->xmm[3]);
-			}
-			#else
-			{
-				for (unsigned w = 0; w != NODE_WORDS; ++w) {
-					mix[n].words[w] = fnv_hash(mix[n].words[w], dag_node->words[w]);
-				}
-			}
-#endif
-		}
-
-	}
+static void ethash_hash_init(
+	node* s_mix,
+	ethash_h256_t const* header_hash,
+	uint64_t const nonce
+)
+{
+	ethash_hash_seed(s_mix, header_hash, nonce);
+	SHA3_512(s_mix->bytes, s_mix->bytes, 40);
+	ethash_hash_expand(s_mix);
+}
 
-	// compress mix
+// compress the mix, leaving s_mix ready for the final Keccak hash
+static void ethash_hash_compress(ethash_return_value_t* ret, node* s_mix)
+{
+	node* const mix = s_mix + 1;
 	for (uint32_t w = 0; w != MIX_WORDS; w += 4) {
 		uint32_t reduction = mix->words[w + 0];
 		reduction = reduction * FNV_PRIME ^ mix->words[w + 1];
@@ -249,8 +241,58 @@ static bool ethash_hash(
 
 	fix_endian_arr32(mix->words, MIX_WORDS / 4);
 	memcpy(&ret->mix_hash, mix->bytes, 32);
+}
+
+static void ethash_hash_final(ethash_return_value_t* ret, node* s_mix)
+{
+	ethash_hash_compress(ret, s_mix);
 	// final Keccak hash
 	SHA3_256(&ret->result, s_mix->bytes, 64 + 32); // Keccak-256(s + compressed_mix)
+}
+
+static bool ethash_hash(
+	ethash_return_value_t* ret,
+	node const* full_nodes,
+	ethash_light_t const light,
+	ethash_page_source_t source,
+	void* source_ctx,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t const nonce
+)
+{
+	if (full_size % MIX_WORDS != 0) {
+		return false;
+	}
+
+	node s_mix[MIX_NODES + 1];
+	ethash_hash_init(s_mix, &header_hash, nonce);
+	node* const mix = s_mix + 1;
+
+	unsigned const page_size = sizeof(uint32_t) * MIX_WORDS;
+	unsigned const num_full_pages = (unsigned) (full_size / page_size);
+
+	for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
+		uint32_t const index = fnv_hash(s_mix->words[0] ^ i, mix->words[i % MIX_WORDS]) % num_full_pages;
+
+		node const* page;
+		node tmp_nodes[MIX_NODES];
+		if (full_nodes) {
+			page = &full_nodes[MIX_NODES * index];
+		} else if (source) {
+			source(source_ctx, index, tmp_nodes[0].bytes);
+			page = tmp_nodes;
+		} else {
+			ethash_calculate_dag_items(tmp_nodes, index * MIX_NODES, MIX_NODES, light);
+			page = tmp_nodes;
+		}
+		for (unsigned n = 0; n != MIX_NODES; ++n) {
+			ethash_fnv_node(&mix[n], &page[n]);
+		}
+
+	}
+
+	ethash_hash_final(ret, s_mix);
 	return true;
 }
 
@@ -344,7 +386,7 @@ ethash_return_value_t ethash_light_compute_internal(
 {
   	ethash_return_value_t ret;
 	ret.success = true;
-	if (!ethash_hash(&ret, NULL, light, full_size, header_hash, nonce)) {
+	if (!ethash_hash(&ret, NULL, light, NULL, NULL, full_size, header_hash, nonce)) {
 		ret.success = false;
 	}
 	return ret;
@@ -360,6 +402,30 @@ ethash_return_value_t ethash_light_compute(
 	return ethash_light_compute_internal(light, full_size, header_hash, nonce);
 }
 
+ethash_return_value_t ethash_light_compute_paged(
+	ethash_light_t light,
+	ethash_h256_t const header_hash,
+	uint64_t nonce,
+	ethash_page_source_t source,
+	void* source_ctx
+)
+{
+	ethash_return_value_t ret;
+	ret.success = true;
+	uint64_t full_size = ethash_get_datasize(light->block_number);
+	if (!ethash_hash(&ret, NULL, light, source, source_ctx, full_size, header_hash, nonce)) {
+		ret.success = false;
+	}
+	return ret;
+}
+
+void ethash_light_compute_page(ethash_light_t light, uint32_t page, uint8_t* out)
+{
+	node tmp_nodes[MIX_NODES];
+	ethash_calculate_dag_items(tmp_nodes, page * MIX_NODES, MIX_NODES, light);
+	memcpy(out, tmp_nodes, sizeof(tmp_nodes));
+}
+
 static bool ethash_mmap(struct ethash_full* ret, FILE* f)
 {
 	int fd;
@@ -394,6 +460,7 @@ ethash_full_t ethash_full_new_internal(
 {
 	struct ethash_full* ret;
 	FILE *f = NULL;
+	uint64_t* sums = NULL;
 	ret = calloc(sizeof(*ret), 1);
 	if (!ret) {
 		return NULL;
@@ -408,6 +475,7 @@ ethash_full_t ethash_full_new_internal(
 			ETHASH_CRITICAL("mmap failure()");
 			goto fail_close_file;
 		}
+		ret->loaded = true;
 		return ret;
 	case ETHASH_IO_MEMO_SIZE_MISMATCH:
 		// if a DAG of same filename but unexpected size is found, silently force new file creation
@@ -424,10 +492,29 @@ ethash_full_t ethash_full_new_internal(
 		break;
 	}
 
-	if (!ethash_compute_full_data(ret->data, full_size, light, callback)) {
+	if (full_size % (sizeof(uint32_t) * MIX_WORDS) != 0) {
 		ETHASH_CRITICAL("Failure at computing DAG data.");
 		goto fail_free_full_data;
 	}
+	// generate it a chunk at a time, and checksum each chunk while it's still in the
+	// cache.  the mapping writes it back to the file in the background as we go.
+	size_t const chunks = ethash_dagsum_chunks(full_size);
+	sums = malloc(chunks * sizeof(uint64_t));
+	if (!sums) {
+		goto fail_free_full_data;
+	}
+	for (size_t c = 0; c != chunks; ++c) {
+		if (callback && callback((unsigned)(c * 100 / chunks)) != 0) {
+			goto fail_free_full_data;
+		}
+		uint64_t const first = (uint64_t)c * ETHASH_DAGSUM_CHUNK_BYTES;
+		uint64_t const size = full_size - first < ETHASH_DAGSUM_CHUNK_BYTES ? full_size - first : ETHASH_DAGSUM_CHUNK_BYTES;
+		if (!ethash_compute_full_range(ret->data, full_size, first, size, light)) {
+			ETHASH_CRITICAL("Failure at computing DAG data.");
+			goto fail_free_full_data;
+		}
+		sums[c] = ethash_dagsum_chunk((uint8_t const*)ret->data + first, (size_t)size);
+	}
 
 	// after the DAG has been filled then we finalize it by writting the magic number at the beginning
 	if (fseek(f, 0, SEEK_SET) != 0) {
@@ -443,9 +530,13 @@ ethash_full_t ethash_full_new_internal(
 		ETHASH_CRITICAL("Could not flush memory mapped data to DAG file. Insufficient space?");
 		goto fail_free_full_data;
 	}
+	// without its checksums the file will just be checked more loosely when it's loaded.
+	ethash_dagsum_write(dirname, seed_hash, full_size, sums);
+	free(sums);
 	return ret;
 
 fail_free_full_data:
+	free(sums);
 	// could check that munmap(..) == 0 but even if it did not can't really do anything here
 	munmap(ret->data, (size_t)full_size);
 fail_close_file:
@@ -492,6 +583,8 @@ ethash_return_value_t ethash_full_compute(
 		&ret,
 		(node const*)full->data,
 		NULL,
+		NULL,
+		NULL,
 		full->file_size,
 		header_hash,
 		nonce)) {
@@ -500,6 +593,93 @@ ethash_return_value_t ethash_full_compute(
 	return ret;
 }
 
+ethash_return_value_t ethash_full_compute_data(
+	void const* full_data,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t nonce
+)
+{
+	ethash_return_value_t ret;
+	ret.success = true;
+	if (!ethash_hash(
+		&ret,
+		(node const*)full_data,
+		NULL,
+		NULL,
+		NULL,
+		full_size,
+		header_hash,
+		nonce)) {
+		ret.success = false;
+	}
+	return ret;
+}
+
+bool ethash_full_compute_batch(
+	void const* full_data,
+	uint64_t full_size,
+	ethash_h256_t const header_hash,
+	uint64_t const* nonces,
+	unsigned count,
+	ethash_return_value_t* results
+)
+{
+	if (!full_data || full_size % MIX_WORDS != 0) {
+		return false;
+	}
+	node const* const full_nodes = (node const*)full_data;
+	unsigned const page_size = sizeof(uint32_t) * MIX_WORDS;
+	unsigned const num_full_pages = (unsigned) (full_size / page_size);
+
+	node s_mix[ETHASH_MAX_INTERLEAVE][MIX_NODES + 1];
+	uint32_t index[ETHASH_MAX_INTERLEAVE];
+	uint8_t* bytes[ETHASH_MAX_INTERLEAVE];
+	uint8_t* out[ETHASH_MAX_INTERLEAVE];
+
+	for (unsigned base = 0; base < count; base += ETHASH_MAX_INTERLEAVE) {
+		unsigned const lanes = count - base < ETHASH_MAX_INTERLEAVE ? count - base : ETHASH_MAX_INTERLEAVE;
+
+		for (unsigned k = 0; k != lanes; ++k) {
+			ethash_hash_seed(s_mix[k], &header_hash, nonces[base + k]);
+			bytes[k] = s_mix[k]->bytes;
+		}
+		ethash_keccak512_multi(bytes, (uint8_t const* const*)bytes, 40, lanes);
+		for (unsigned k = 0; k != lanes; ++k) {
+			ethash_hash_expand(s_mix[k]);
+			index[k] = fnv_hash(s_mix[k][0].words[0], s_mix[k][1].words[0]) % num_full_pages;
+			ethash_prefetch(&full_nodes[MIX_NODES * index[k]]);
+			ethash_prefetch(&full_nodes[MIX_NODES * index[k] + 1]);
+		}
+
+		// each lane's next page is worked out and prefetched as soon as its current one is
+		// mixed in, so it has the other lanes' rounds to arrive before it's needed.
+		for (unsigned i = 0; i != ETHASH_ACCESSES; ++i) {
+			for (unsigned k = 0; k != lanes; ++k) {
+				node* const mix = s_mix[k] + 1;
+				node const* const page = &full_nodes[MIX_NODES * index[k]];
+				for (unsigned n = 0; n != MIX_NODES; ++n) {
+					ethash_fnv_node(&mix[n], &page[n]);
+				}
+				if (i + 1 != ETHASH_ACCESSES) {
+					index[k] = fnv_hash(s_mix[k][0].words[0] ^ (i + 1), mix->words[(i + 1) % MIX_WORDS]) % num_full_pages;
+					ethash_prefetch(&full_nodes[MIX_NODES * index[k]]);
+					ethash_prefetch(&full_nodes[MIX_NODES * index[k] + 1]);
+				}
+			}
+		}
+
+		for (unsigned k = 0; k != lanes; ++k) {
+			results[base + k].success = true;
+			ethash_hash_compress(&results[base + k], s_mix[k]);
+			out[k] = (uint8_t*)&results[base + k].result;
+		}
+		// Keccak-256(s + compressed_mix)
+		ethash_keccak256_multi(out, (uint8_t const* const*)bytes, 64 + 32, lanes);
+	}
+	return true;
+}
+
 void const* ethash_full_dag(ethash_full_t full)
 {
 	return full->data;
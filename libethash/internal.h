@@ -115,6 +115,7 @@ struct ethash_full {
 	FILE* file;
 	uint64_t file_size;
 	node* data;
+	bool loaded;	// mapped from an existing file, not generated.  see ethash_dagsum_read()
 };
 
 /**
@@ -174,6 +175,24 @@ bool ethash_compute_full_data(
 	ethash_callback_t callback
 );
 
+/**
+ * Compute part of the memory data for a full node's memory, eg. to repair it
+ *
+ * @param mem         A pointer to an ethash full's memory
+ * @param full_size   The size of the full data in bytes
+ * @param first       Offset of the first byte to compute, a multiple of the node size
+ * @param size        Number of bytes to compute, a multiple of the node size
+ * @param light       A cache object to use in the calculation
+ * @return            true if all went fine and false for invalid parameters
+ */
+bool ethash_compute_full_range(
+	void* mem,
+	uint64_t full_size,
+	uint64_t first,
+	uint64_t size,
+	ethash_light_t const light
+);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,373 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ethash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file keccak.c
+ * Replaces the copies of libkeccak-tiny (David Leon Gil, CC0) that libethash/sha3.c and
+ * libdevcore/SHA3.cpp used to carry, and the CryptoPP alternative.  The sponge is still
+ * libkeccak-tiny's.  The permutation is written once as an unrolled round and instantiated
+ * for plain 64 bit words and for AVX2 / AVX-512 vectors holding 4 or 8 states.
+ */
+#include "keccak.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(_MSC_VER))
+#define ETHASH_KECCAK_AVX2 1
+#if !defined(_MSC_VER) || _MSC_VER >= 1910
+#define ETHASH_KECCAK_AVX512 1
+#endif
+#endif
+
+#if ETHASH_KECCAK_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ETHASH_TARGET(t)
+#else
+#define ETHASH_TARGET(t) __attribute__((target(t)))
+#endif
+#endif
+
+/******** The Keccak-f[1600] permutation ********/
+
+static const uint64_t RC[24] = \
+	{1ULL, 0x8082ULL, 0x800000000000808aULL, 0x8000000080008000ULL,
+	 0x808bULL, 0x80000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+	 0x8aULL, 0x88ULL, 0x80008009ULL, 0x8000000aULL,
+	 0x8000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+	 0x8000000000008002ULL, 0x8000000000000080ULL, 0x800aULL, 0x800000008000000aULL,
+	 0x8000000080008081ULL, 0x8000000000008080ULL, 0x80000001ULL, 0x8000000080008008ULL};
+
+// one round but iota, unrolled so every rotation is a constant.  theta, then rho and pi
+// together (B[y, 2x + 3y] = rot(A[x, y] ^ D[x], r[x, y])), then chi.  every backend
+// runs this with its own XOR, ROL and CHI (a ^ (~b & c)).
+#define KECCAK_ROUND(XOR, ROL, CHI, A, B, C, D)	\
+	C[0] = XOR(XOR(XOR(XOR(A[0], A[5]), A[10]), A[15]), A[20]);	\
+	C[1] = XOR(XOR(XOR(XOR(A[1], A[6]), A[11]), A[16]), A[21]);	\
+	C[2] = XOR(XOR(XOR(XOR(A[2], A[7]), A[12]), A[17]), A[22]);	\
+	C[3] = XOR(XOR(XOR(XOR(A[3], A[8]), A[13]), A[18]), A[23]);	\
+	C[4] = XOR(XOR(XOR(XOR(A[4], A[9]), A[14]), A[19]), A[24]);	\
+	D[0] = XOR(C[4], ROL(C[1], 1));	\
+	D[1] = XOR(C[0], ROL(C[2], 1));	\
+	D[2] = XOR(C[1], ROL(C[3], 1));	\
+	D[3] = XOR(C[2], ROL(C[4], 1));	\
+	D[4] = XOR(C[3], ROL(C[0], 1));	\
+	B[0] = XOR(A[0], D[0]);	\
+	B[10] = ROL(XOR(A[1], D[1]), 1);	\
+	B[20] = ROL(XOR(A[2], D[2]), 62);	\
+	B[5] = ROL(XOR(A[3], D[3]), 28);	\
+	B[15] = ROL(XOR(A[4], D[4]), 27);	\
+	B[16] = ROL(XOR(A[5], D[0]), 36);	\
+	B[1] = ROL(XOR(A[6], D[1]), 44);	\
+	B[11] = ROL(XOR(A[7], D[2]), 6);	\
+	B[21] = ROL(XOR(A[8], D[3]), 55);	\
+	B[6] = ROL(XOR(A[9], D[4]), 20);	\
+	B[7] = ROL(XOR(A[10], D[0]), 3);	\
+	B[17] = ROL(XOR(A[11], D[1]), 10);	\
+	B[2] = ROL(XOR(A[12], D[2]), 43);	\
+	B[12] = ROL(XOR(A[13], D[3]), 25);	\
+	B[22] = ROL(XOR(A[14], D[4]), 39);	\
+	B[23] = ROL(XOR(A[15], D[0]), 41);	\
+	B[8] = ROL(XOR(A[16], D[1]), 45);	\
+	B[18] = ROL(XOR(A[17], D[2]), 15);	\
+	B[3] = ROL(XOR(A[18], D[3]), 21);	\
+	B[13] = ROL(XOR(A[19], D[4]), 8);	\
+	B[14] = ROL(XOR(A[20], D[0]), 18);	\
+	B[24] = ROL(XOR(A[21], D[1]), 2);	\
+	B[9] = ROL(XOR(A[22], D[2]), 61);	\
+	B[19] = ROL(XOR(A[23], D[3]), 56);	\
+	B[4] = ROL(XOR(A[24], D[4]), 14);	\
+	A[0] = CHI(B[0], B[1], B[2]);	\
+	A[1] = CHI(B[1], B[2], B[3]);	\
+	A[2] = CHI(B[2], B[3], B[4]);	\
+	A[3] = CHI(B[3], B[4], B[0]);	\
+	A[4] = CHI(B[4], B[0], B[1]);	\
+	A[5] = CHI(B[5], B[6], B[7]);	\
+	A[6] = CHI(B[6], B[7], B[8]);	\
+	A[7] = CHI(B[7], B[8], B[9]);	\
+	A[8] = CHI(B[8], B[9], B[5]);	\
+	A[9] = CHI(B[9], B[5], B[6]);	\
+	A[10] = CHI(B[10], B[11], B[12]);	\
+	A[11] = CHI(B[11], B[12], B[13]);	\
+	A[12] = CHI(B[12], B[13], B[14]);	\
+	A[13] = CHI(B[13], B[14], B[10]);	\
+	A[14] = CHI(B[14], B[10], B[11]);	\
+	A[15] = CHI(B[15], B[16], B[17]);	\
+	A[16] = CHI(B[16], B[17], B[18]);	\
+	A[17] = CHI(B[17], B[18], B[19]);	\
+	A[18] = CHI(B[18], B[19], B[15]);	\
+	A[19] = CHI(B[19], B[15], B[16]);	\
+	A[20] = CHI(B[20], B[21], B[22]);	\
+	A[21] = CHI(B[21], B[22], B[23]);	\
+	A[22] = CHI(B[22], B[23], B[24]);	\
+	A[23] = CHI(B[23], B[24], B[20]);	\
+	A[24] = CHI(B[24], B[20], B[21])
+
+#define S_XOR(a, b) ((a) ^ (b))
+#define S_ROL(x, s) (((x) << (s)) | ((x) >> (64 - (s))))
+#define S_CHI(a, b, c) ((a) ^ (~(b) & (c)))
+
+static void keccakf(uint64_t* a)
+{
+	uint64_t b[25], c[5], d[5];
+	for (int r = 0; r < 24; r++) {
+		KECCAK_ROUND(S_XOR, S_ROL, S_CHI, a, b, c, d);
+		a[0] ^= RC[r];
+	}
+}
+
+/******** The sponge ********/
+
+#define Plen 200
+
+static inline void xorin(uint8_t* dst, uint8_t const* src, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		dst[i] ^= src[i];
+	}
+}
+
+static inline uint64_t load64(uint8_t const* p)
+{
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+// Keccak's own padding, which is what Ethereum calls sha3.  FIPS 202 SHA3 uses 0x06.
+#define KECCAK_DELIM 0x01
+
+static void keccak(uint8_t* out, size_t outlen, uint8_t const* in, size_t inlen, size_t rate)
+{
+	uint64_t a[25] = {0};
+	uint8_t* const bytes = (uint8_t*)a;
+	// Absorb input.
+	while (inlen >= rate) {
+		xorin(bytes, in, rate);
+		keccakf(a);
+		in += rate;
+		inlen -= rate;
+	}
+	// Xor in the DS and pad frame, and the last block.
+	bytes[inlen] ^= KECCAK_DELIM;
+	bytes[rate - 1] ^= 0x80;
+	xorin(bytes, in, inlen);
+	keccakf(a);
+	// Squeeze output.  never more than one block for the fixed sizes here.
+	memcpy(out, bytes, outlen);
+}
+
+typedef void (*sponge_fn)(uint8_t* const* out, size_t outlen, uint8_t const* const* in, size_t inlen, size_t rate, unsigned count);
+
+static void scalar_sponge(uint8_t* const* out, size_t outlen, uint8_t const* const* in, size_t inlen, size_t rate, unsigned count)
+{
+	for (unsigned i = 0; i < count; i++) {
+		keccak(out[i], outlen, in[i], inlen, rate);
+	}
+}
+
+/******** SIMD backends ********/
+
+// the permutation and sponge for states held in vectors of T, lane i of state word j being
+// word j of message i.  lanes beyond count hash a copy of message 0 and are thrown away.
+#define KECCAK_SIMD(NAME, T, LANES, ATTR, XOR, ROL, CHI, SET1, GATHER, STORE)						\
+	ATTR static void NAME##_permute(T* a)															\
+	{																								\
+		T b[25], c[5], d[5];																		\
+		for (int r = 0; r < 24; r++) {																\
+			KECCAK_ROUND(XOR, ROL, CHI, a, b, c, d);												\
+			a[0] = XOR(a[0], SET1(RC[r]));															\
+		}																							\
+	}																								\
+																									\
+	ATTR static void NAME##_sponge(uint8_t* const* out, size_t outlen, uint8_t const* const* in,	\
+		size_t inlen, size_t rate, unsigned count)													\
+	{																								\
+		T a[25];																					\
+		uint64_t w[LANES];																			\
+		uint8_t last[LANES][Plen];																	\
+		uint8_t const* src[LANES];																	\
+		uint8_t const* pad[LANES];																	\
+		for (unsigned i = 0; i < LANES; i++) {														\
+			src[i] = in[i < count ? i : 0];															\
+			pad[i] = last[i];																		\
+		}																							\
+		for (int j = 0; j < 25; j++) {																\
+			a[j] = SET1(0);																			\
+		}																							\
+		size_t off = 0;																				\
+		for (; inlen - off >= rate; off += rate) {													\
+			for (size_t j = 0; j < rate / 8; j++) {													\
+				a[j] = XOR(a[j], GATHER(src, off + 8 * j));											\
+			}																						\
+			NAME##_permute(a);																		\
+		}																							\
+		for (unsigned i = 0; i < LANES; i++) {														\
+			memset(last[i], 0, rate);																\
+			memcpy(last[i], src[i] + off, inlen - off);												\
+			last[i][inlen - off] ^= KECCAK_DELIM;													\
+			last[i][rate - 1] ^= 0x80;																\
+		}																							\
+		for (size_t j = 0; j < rate / 8; j++) {														\
+			a[j] = XOR(a[j], GATHER(pad, 8 * j));													\
+		}																							\
+		NAME##_permute(a);																			\
+		for (size_t j = 0; j < outlen / 8; j++) {													\
+			STORE(w, a[j]);																			\
+			for (unsigned i = 0; i < count; i++) {													\
+				memcpy(out[i] + 8 * j, &w[i], 8);													\
+			}																						\
+		}																							\
+	}
+
+#if ETHASH_KECCAK_AVX2
+#define V256_XOR(a, b) _mm256_xor_si256(a, b)
+#define V256_ROL(x, n) _mm256_or_si256(_mm256_slli_epi64(x, n), _mm256_srli_epi64(x, 64 - (n)))
+#define V256_CHI(a, b, c) _mm256_xor_si256(a, _mm256_andnot_si256(b, c))
+#define V256_SET1(v) _mm256_set1_epi64x((long long)(v))
+#define V256_GATHER(p, off) _mm256_set_epi64x(load64(p[3] + (off)), load64(p[2] + (off)), load64(p[1] + (off)), load64(p[0] + (off)))
+#define V256_STORE(w, v) _mm256_storeu_si256((__m256i*)(w), v)
+KECCAK_SIMD(avx2, __m256i, 4, ETHASH_TARGET("avx2"), V256_XOR, V256_ROL, V256_CHI, V256_SET1, V256_GATHER, V256_STORE)
+#endif
+
+#if ETHASH_KECCAK_AVX512
+#define V512_XOR(a, b) _mm512_xor_si512(a, b)
+#define V512_ROL(x, n) _mm512_rol_epi64(x, n)
+// a ^ (~b & c) in one instruction
+#define V512_CHI(a, b, c) _mm512_ternarylogic_epi64(a, b, c, 0xD2)
+#define V512_SET1(v) _mm512_set1_epi64((long long)(v))
+#define V512_GATHER(p, off) _mm512_set_epi64(load64(p[7] + (off)), load64(p[6] + (off)), load64(p[5] + (off)), load64(p[4] + (off)), \
+	load64(p[3] + (off)), load64(p[2] + (off)), load64(p[1] + (off)), load64(p[0] + (off)))
+#define V512_STORE(w, v) _mm512_storeu_si512((void*)(w), v)
+KECCAK_SIMD(avx512, __m512i, 8, ETHASH_TARGET("avx512f"), V512_XOR, V512_ROL, V512_CHI, V512_SET1, V512_GATHER, V512_STORE)
+#endif
+
+/******** CPU detection ********/
+
+#if ETHASH_KECCAK_AVX2 && defined(_MSC_VER)
+// leaf 7 ebx feature bit, and the register state the OS has to be saving for it.
+static bool cpu_has(unsigned bit, unsigned long long xcr0)
+{
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] < 7) {
+		return false;
+	}
+	__cpuid(r, 1);
+	if (!(r[2] & (1 << 27)) || (_xgetbv(0) & xcr0) != xcr0) {
+		return false;
+	}
+	__cpuidex(r, 7, 0);
+	return (r[1] >> bit) & 1;
+}
+static bool has_avx2(void) { return cpu_has(5, 0x6); }
+#if ETHASH_KECCAK_AVX512
+static bool has_avx512(void) { return cpu_has(16, 0xe6); }
+#endif
+#elif ETHASH_KECCAK_AVX2
+static bool has_avx2(void) { __builtin_cpu_init(); return __builtin_cpu_supports("avx2"); }
+#if ETHASH_KECCAK_AVX512
+static bool has_avx512(void) { __builtin_cpu_init(); return __builtin_cpu_supports("avx512f"); }
+#endif
+#endif
+
+static bool has_scalar(void) { return true; }
+
+/******** Dispatch ********/
+
+typedef struct keccak_backend {
+	char const* name;
+	unsigned lanes;
+	sponge_fn sponge;
+	bool (*supported)(void);
+} keccak_backend_t;
+
+// best first
+static keccak_backend_t const s_backends[] = {
+#if ETHASH_KECCAK_AVX512
+	{"avx512", 8, avx512_sponge, has_avx512},
+#endif
+#if ETHASH_KECCAK_AVX2
+	{"avx2", 4, avx2_sponge, has_avx2},
+#endif
+	{"scalar", 1, scalar_sponge, has_scalar}
+};
+
+// picking a backend is idempotent, so threads racing to do it first is harmless.
+static keccak_backend_t const* volatile s_backend = NULL;
+
+static keccak_backend_t const* backend(void)
+{
+	if (!s_backend) {
+		for (size_t i = 0; i < sizeof(s_backends) / sizeof(s_backends[0]); i++) {
+			if (s_backends[i].supported()) {
+				s_backend = &s_backends[i];
+				break;
+			}
+		}
+	}
+	return s_backend;
+}
+
+char const* ethash_keccak_backend(void)
+{
+	return backend()->name;
+}
+
+bool ethash_keccak_set_backend(char const* name)
+{
+	for (size_t i = 0; i < sizeof(s_backends) / sizeof(s_backends[0]); i++) {
+		if (strcmp(s_backends[i].name, name) == 0 && s_backends[i].supported()) {
+			s_backend = &s_backends[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+static void keccak_multi(uint8_t* const* out, size_t outlen, uint8_t const* const* in, size_t inlen, size_t rate, unsigned count)
+{
+	keccak_backend_t const* b = backend();
+	for (unsigned i = 0; i < count; i += b->lanes) {
+		unsigned n = count - i < b->lanes ? count - i : b->lanes;
+		// a lone message isn't worth a whole vector.
+		if (n == 1) {
+			keccak(out[i], outlen, in[i], inlen, rate);
+		} else {
+			b->sponge(out + i, outlen, in + i, inlen, rate, n);
+		}
+	}
+}
+
+void ethash_keccak256(uint8_t* out, uint8_t const* in, size_t inlen)
+{
+	keccak(out, 32, in, inlen, Plen - 2 * 32);
+}
+
+void ethash_keccak512(uint8_t* out, uint8_t const* in, size_t inlen)
+{
+	keccak(out, 64, in, inlen, Plen - 2 * 64);
+}
+
+void ethash_keccak256_multi(uint8_t* const* out, uint8_t const* const* in, size_t inlen, unsigned count)
+{
+	keccak_multi(out, 32, in, inlen, Plen - 2 * 32, count);
+}
+
+void ethash_keccak512_multi(uint8_t* const* out, uint8_t const* const* in, size_t inlen, unsigned count)
+{
+	keccak_multi(out, 64, in, inlen, Plen - 2 * 64, count);
+}
@@ -0,0 +1,63 @@
+/*
+  This file is part of ethash.
+
+  ethash is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  ethash is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with ethash.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/** @file keccak.h
+ * The one Keccak-f[1600] implementation in the tree, used by libethash and libdevcore.
+ *
+ * These are Ethereum's "sha3" hashes, ie. Keccak with its original padding rather than
+ * the FIPS 202 one.  The permutation has scalar, AVX2 (4 states at once) and AVX-512
+ * (8 states at once) backends; the best one the CPU supports is picked on first use.
+ * The multi-buffer calls hash several independent messages of the same length in one
+ * go, which is where the SIMD backends pay off.  Single messages always go through
+ * the scalar permutation.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include "compiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// the most messages a SIMD backend hashes at once.  the multi-buffer calls take any number.
+#define ETHASH_KECCAK_LANES 8
+
+void ethash_keccak256(uint8_t* out, uint8_t const* in, size_t inlen);
+void ethash_keccak512(uint8_t* out, uint8_t const* in, size_t inlen);
+
+/**
+ * Hash count messages, each inlen bytes long.  out[i] may be the same buffer as in[i].
+ */
+void ethash_keccak256_multi(uint8_t* const* out, uint8_t const* const* in, size_t inlen, unsigned count);
+void ethash_keccak512_multi(uint8_t* const* out, uint8_t const* const* in, size_t inlen, unsigned count);
+
+/**
+ * @return  the backend the multi-buffer calls use: "scalar", "avx2" or "avx512"
+ */
+char const* ethash_keccak_backend(void);
+
+/**
+ * Force a backend, eg. to compare them.
+ * @return  false if it isn't compiled in or the CPU can't run it
+ */
+bool ethash_keccak_set_backend(char const* name);
+
+#ifdef __cplusplus
+}
+#endif
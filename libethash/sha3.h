@@ -7,23 +7,18 @@ extern "C" {
 #include "compiler.h"
 #include <stdint.h>
 #include <stdlib.h>
+#include "keccak.h"
 
 struct ethash_h256;
 
-#define decsha3(bits) \
-	int sha3_##bits(uint8_t*, size_t, uint8_t const*, size_t);
-
-decsha3(256)
-decsha3(512)
-
 static inline void SHA3_256(struct ethash_h256 const* ret, uint8_t const* data, size_t const size)
 {
-	sha3_256((uint8_t*)ret, 32, data, size);
+	ethash_keccak256((uint8_t*)ret, data, size);
 }
 
 static inline void SHA3_512(uint8_t* ret, uint8_t const* data, size_t const size)
 {
-	sha3_512(ret, 64, data, size);
+	ethash_keccak512(ret, data, size);
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,208 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CPUMiningPool.h"
+
+#include <sstream>
+#include <libdevcore/Log.h>
+#include "EthashCPUMiner.h"
+#include "NoncePartitioner.h"
+#include "ethminer/MultiLog.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+unsigned const c_rateLogInterval = 60;		// seconds
+}
+
+
+CPUMiningPool& CPUMiningPool::get()
+{
+	static CPUMiningPool s_pool;
+	return s_pool;
+}
+
+CPUMiningPool::~CPUMiningPool()
+{
+	{
+		Guard l(x_job);
+		m_exit = true;
+	}
+	m_jobChanged.notify_all();
+	for (auto& s: m_slots)
+		if (s && s->thread.joinable())
+			s->thread.join();
+}
+
+void CPUMiningPool::attach(EthashCPUMiner* _miner)
+{
+	Guard l(x_job);
+	unsigned i = _miner->index();
+	if (m_slots.size() <= i)
+		m_slots.resize(i + 1);
+	if (!m_slots[i])
+	{
+		m_slots[i].reset(new Slot);
+		Slot* s = m_slots[i].get();
+		s->thread = thread([=] () { run(s, i); });
+	}
+	m_slots[i]->miner = _miner;
+}
+
+void CPUMiningPool::detach(EthashCPUMiner* _miner)
+{
+	Slot* s = nullptr;
+	{
+		Guard l(x_job);
+		unsigned i = _miner->index();
+		if (i >= m_slots.size() || !m_slots[i] || m_slots[i]->miner != _miner)
+			return;
+		s = m_slots[i].get();
+	}
+	// stop it mid chunk, and wait until it's out of the miner.
+	s->detaching = true;
+	Guard busy(s->x_busy);
+	Guard l(x_job);
+	s->miner = nullptr;
+	s->detaching = false;
+
+	// with the farm gone the job is too.  a new farm starts from scratch even if it gets the
+	// same package.
+	bool any = false;
+	for (auto const& slot: m_slots)
+		any = any || (slot && slot->miner);
+	if (!any)
+		m_work.reset();
+}
+
+void CPUMiningPool::setWork(WorkPackage const& _work)
+{
+	{
+		Guard l(x_job);
+		if (m_work && _work.headerHash == m_work.headerHash && _work.boundary == m_work.boundary && _work.startNonce == m_work.startNonce && _work.exSizeBits == m_work.exSizeBits)
+			return;
+		m_work = _work;
+		m_cursor = m_rng();
+		m_epoch++;
+	}
+	m_jobChanged.notify_all();
+}
+
+void CPUMiningPool::pause()
+{
+	{
+		Guard l(x_job);
+		if (!m_work)
+			return;
+		m_work.reset();
+		m_epoch++;
+	}
+	m_jobChanged.notify_all();
+}
+
+bool CPUMiningPool::stale(Slot const& _slot, uint64_t _epoch) const
+{
+	return m_epoch.load(memory_order_relaxed) != _epoch || _slot.detaching.load(memory_order_relaxed) || m_exit.load(memory_order_relaxed);
+}
+
+bool CPUMiningPool::nextChunk(unsigned _index, WorkPackage const& _work, uint64_t& _start)
+{
+	if (_work.exSizeBits >= 0)
+		// anything outside the partitioner's ranges belongs to one of the other devices.
+		return NoncePartitioner::get().claim(_index, _work.headerHash, c_chunk, _start);
+	_start = m_cursor.fetch_add(c_chunk);
+	return true;
+}
+
+void CPUMiningPool::run(Slot* _slot, unsigned _index)
+{
+	setThreadName("cpu" + toString(_index));
+	uint64_t epoch = 0;
+	Timer logTime;
+	while (true)
+	{
+		WorkPackage w;
+		{
+			UniqueGuard l(x_job);
+			m_jobChanged.wait(l, [&] () { return m_exit || (m_epoch != epoch && _slot->miner); });
+			if (m_exit)
+				return;
+			epoch = m_epoch;
+			w = m_work;
+		}
+		if (!w)
+			continue;
+
+		Guard busy(_slot->x_busy);
+		EthashCPUMiner* miner;
+		DEV_GUARDED(x_job)
+			miner = _slot->miner;
+		if (!miner || stale(*_slot, epoch))
+			continue;
+
+		try
+		{
+			NumaDag::ReplicaPtr dag = miner->prepare(w);
+			auto isStale = [&] () { return stale(*_slot, epoch); };
+			bool solved = false;
+			while (!solved && !isStale())
+			{
+				uint64_t start;
+				if (!nextChunk(_index, w, start))
+				{
+					LogF << "CPU miner " << _index << " : nonce space exhausted, waiting for new work";
+					break;
+				}
+				_slot->hashes += miner->hashChunk(w, dag.get(), start, c_chunk, isStale, solved);
+				_slot->chunks++;
+				if (_index == 0 && logTime.elapsedSeconds() >= c_rateLogInterval)
+				{
+					LogF << "CPU threads : " << summary();
+					logTime.restart();
+				}
+			}
+		}
+		catch (std::exception const& e)
+		{
+			LogB << "CPU miner " << _index << " : " << e.what();
+		}
+	}
+}
+
+string CPUMiningPool::summary()
+{
+	Guard l(x_job);
+	double secs = max(1.0, duration_cast<milliseconds>(steady_clock::now() - m_since).count() / 1000.0);
+	ostringstream ss;
+	ss.precision(3);
+	uint64_t chunks = 0;
+	unsigned n = 0;
+	for (auto const& s: m_slots)
+	{
+		if (!s)
+			continue;
+		ss << (n++ ? ", " : "") << s->hashes.exchange(0) / secs / 1000.0 << " kH/s";
+		chunks += s->chunks.exchange(0);
+	}
+	ss << " (" << chunks << " chunks)";
+	m_since = steady_clock::now();
+	return ss.str();
+}
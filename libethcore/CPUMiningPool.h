@@ -0,0 +1,108 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// the threads behind the CPU miners.  each EthashCPUMiner gets a thread of its own the
+// first time it's attached, and that thread lives until the program exits.  a new work
+// package doesn't restart anything: it bumps the job epoch, and every thread notices at
+// its next batch of hashes and moves on to the new job.
+//
+// threads take their nonces a chunk at a time.  with a stratum extranonce the chunks come
+// from the farm's NoncePartitioner (which steals from the devices with the most left when
+// a thread's own range runs out), otherwise from a single atomic cursor that starts at a
+// random nonce for each job.  either way no two threads ever hash the same nonce, and the
+// faster threads simply take more chunks.  a thread that finds the partitioner empty waits
+// for the next job.
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <condition_variable>
+#include <libdevcore/Guards.h>
+#include "EthashAux.h"
+
+namespace dev
+{
+namespace eth
+{
+
+class EthashCPUMiner;
+
+class CPUMiningPool
+{
+public:
+	using WorkPackage = EthashProofOfWork::WorkPackage;
+
+	// nonces handed out at a time.
+	static const uint64_t c_chunk = 2048;
+
+	static CPUMiningPool& get();
+	~CPUMiningPool();
+
+	// gives _miner a mining thread (the one it had before, if there was one at its index).
+	void attach(EthashCPUMiner* _miner);
+	// returns once the thread has stopped using _miner.
+	void detach(EthashCPUMiner* _miner);
+
+	// a new job for every thread.  the farm hands the same package to each miner in turn,
+	// so the same job again is ignored.  the same job with a different nonce range is a new job.
+	void setWork(WorkPackage const& _work);
+	void pause();
+
+	// per thread hash rates since the last summary, which starts a new period.
+	std::string summary();
+
+private:
+	CPUMiningPool() {}
+
+	struct Slot
+	{
+		EthashCPUMiner* miner = nullptr;
+		std::atomic<bool> detaching{false};
+		// held while the thread is hashing for miner.
+		Mutex x_busy;
+		std::thread thread;
+		std::atomic<uint64_t> hashes{0};
+		std::atomic<uint64_t> chunks{0};
+	};
+
+	void run(Slot* _slot, unsigned _index);
+	// the job _epoch has been replaced, or the thread's miner is going away.
+	bool stale(Slot const& _slot, uint64_t _epoch) const;
+	// false once the job's extranonce space has been used up, by us or the devices.
+	bool nextChunk(unsigned _index, WorkPackage const& _work, uint64_t& _start);
+
+	Mutex x_job;
+	std::condition_variable m_jobChanged;
+	WorkPackage m_work;
+	std::atomic<uint64_t> m_epoch{0};
+	std::atomic<uint64_t> m_cursor{0};
+	std::atomic<bool> m_exit{false};
+	std::mt19937_64 m_rng{std::random_device()()};
+
+	std::vector<std::unique_ptr<Slot>> m_slots;
+	std::chrono::steady_clock::time_point m_since = std::chrono::steady_clock::now();
+};
+
+}
+}
@@ -0,0 +1,81 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DagPageCache.h"
+
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+
+DagPageCache::DagPageCache(ethash_light_t _light, size_t _budget):
+	m_light(_light), m_shards(new Shard[c_shards])
+{
+	m_shardSlots = max<size_t>(1, _budget / sizeof(Slot) / c_shards);
+	for (unsigned i = 0; i < c_shards; i++)
+		m_shards[i].slots.resize(m_shardSlots);
+}
+
+void DagPageCache::page(uint32_t _page, uint8_t* _out)
+{
+	// pages are pseudo random, so the low bits pick the shard and the rest the slot.
+	Shard& shard = m_shards[_page % c_shards];
+	Slot& slot = shard.slots[(_page / c_shards) % m_shardSlots];
+	{
+		SpinGuard l(shard.lock);
+		if (slot.tag == _page + 1)
+		{
+			memcpy(_out, slot.data, ETHASH_MIX_BYTES);
+			m_hits++;
+			return;
+		}
+	}
+
+	m_misses++;
+	ethash_light_compute_page(m_light, _page, _out);
+	SpinGuard l(shard.lock);
+	slot.tag = _page + 1;
+	memcpy(slot.data, _out, ETHASH_MIX_BYTES);
+}
+
+void DagPageCache::source(void* _ctx, uint32_t _page, uint8_t* _out)
+{
+	((DagPageCache*) _ctx)->page(_page, _out);
+}
+
+DagPageCache::Stats DagPageCache::stats() const
+{
+	Stats s;
+	s.hits = m_hits;
+	s.misses = m_misses;
+	s.pages = m_shardSlots * c_shards;
+	return s;
+}
+
+string DagPageCache::summary() const
+{
+	Stats s = stats();
+	ostringstream ss;
+	ss.precision(3);
+	ss << s.pages * ETHASH_MIX_BYTES / 1048576 << " MB, " << s.hits << " hits, " << s.misses << " misses ("
+		<< (s.hits + s.misses ? 100.0 * s.hits / (s.hits + s.misses) : 0.0) << "% hit rate)";
+	return ss.str();
+}
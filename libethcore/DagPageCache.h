@@ -0,0 +1,87 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// DAG pages computed by light client evaluations, kept for the next evaluation that reads
+// them.  without a full DAG every page a hash reads is rebuilt from the light cache, 512
+// parent lookups per page, which is nearly all the time a light evaluation takes.  a share
+// reads 64 pseudo random pages, so the hit rate is roughly the cache size over the DAG size.
+//
+// the cache is a fixed size table, split in shards that each have their own spin lock.
+// a page has exactly one place it can go, and evicts whatever was there.  lookups and
+// inserts only hold the lock for the 128 byte copy, and compute misses outside it.
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <libdevcore/Guards.h>
+#include <libethash/ethash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+class DagPageCache
+{
+public:
+	struct Stats
+	{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		size_t pages = 0;		// capacity
+	};
+
+	// a cache of _budget bytes for the DAG of _light, which must outlive it.
+	DagPageCache(ethash_light_t _light, size_t _budget);
+
+	// page _page of the DAG, from the cache or computed and remembered.
+	void page(uint32_t _page, uint8_t* _out);
+
+	// for ethash_light_compute_paged, with the cache as _ctx.
+	static void source(void* _ctx, uint32_t _page, uint8_t* _out);
+
+	Stats stats() const;
+	std::string summary() const;
+
+private:
+	static const unsigned c_shards = 64;
+
+	struct Slot
+	{
+		uint32_t tag = 0;		// page + 1, or 0 if empty
+		uint8_t data[ETHASH_MIX_BYTES];
+	};
+
+	struct Shard
+	{
+		SpinLock lock;
+		std::vector<Slot> slots;
+	};
+
+	ethash_light_t m_light;
+	std::unique_ptr<Shard[]> m_shards;
+	size_t m_shardSlots;
+	std::atomic<uint64_t> m_hits{0};
+	std::atomic<uint64_t> m_misses{0};
+};
+
+}
+}
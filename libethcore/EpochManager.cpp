@@ -0,0 +1,252 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EpochManager.h"
+
+#include <sstream>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <libethash/io.h>
+#include "EthashAux.h"
+#include "ethminer/ProgOpt.h"
+#include "ethminer/MultiLog.h"
+#include "ethminer/Common.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+namespace fs = boost::filesystem;
+
+namespace
+{
+	double mb(uint64_t _bytes) { return _bytes / 1048576.0; }
+
+	// DAG file name -> epoch.  the names only carry the first 8 bytes of the seed hash.
+	map<string, unsigned> dagFileNames()
+	{
+		map<string, unsigned> ret;
+		for (unsigned e = 0; e < EthashAux::c_maxEpochs; e++)
+		{
+			h256 seed = EthashAux::seedHash(e * ETHASH_EPOCH_LENGTH);
+			char name[DAG_MUTABLE_NAME_MAX_SIZE];
+			if (ethash_io_mutable_name(ETHASH_REVISION, (ethash_h256_t const*) seed.data(), name))
+				ret[name] = e;
+		}
+		return ret;
+	}
+}
+
+
+EpochManager& EpochManager::get()
+{
+	static EpochManager s_manager(
+		(uint64_t) max(0, strToInt(ProgOpt::Get("Epochs", "RamMB", "256"), 256)) << 20,
+		(uint64_t) max(0, strToInt(ProgOpt::Get("Epochs", "DiskMB", "0"), 0)) << 20
+	);
+	return s_manager;
+}
+
+EpochManager::EpochManager(uint64_t _ram, uint64_t _disk): m_ram(_ram), m_disk(_disk)
+{
+	LogF << "EpochManager : RAM budget = " << mb(m_ram) << " MB, disk budget = " << (m_disk ? toString(mb(m_disk)) + " MB" : "none");
+}
+
+void EpochManager::setCurrent(h256 const& _seedHash)
+{
+	unsigned epoch;
+	try
+	{
+		epoch = EthashAux::number(_seedHash) / ETHASH_EPOCH_LENGTH;
+	}
+	catch (std::exception const&)
+	{
+		return;
+	}
+	DEV_GUARDED(x_manager)
+	{
+		if (m_current == (int) epoch)
+			return;
+		m_current = epoch;
+		m_lastUsed[epoch] = ++m_uses;
+	}
+	LogF << "EpochManager : now on epoch " << epoch;
+	trim();
+	LogF << "EpochManager : " << summary();
+}
+
+void EpochManager::touch(unsigned _epoch)
+{
+	Guard l(x_manager);
+	m_lastUsed[_epoch] = ++m_uses;
+}
+
+bool EpochManager::pinned(unsigned _epoch) const
+{
+	return m_current >= 0 && _epoch + 1 >= (unsigned) m_current && _epoch <= (unsigned) m_current + 1;
+}
+
+multimap<unsigned, string> EpochManager::dagFiles()
+{
+	static map<string, unsigned> const s_names = dagFileNames();
+	multimap<unsigned, string> ret;
+	fs::path dir(EthashAux::dagDirName());
+	boost::system::error_code ec;
+	if (!fs::is_directory(dir, ec))
+		return ret;
+	for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		auto n = s_names.find(it->path().filename().string());
+		if (n != s_names.end() && fs::is_regular_file(it->path(), ec))
+			ret.insert(make_pair(n->second, it->path().string()));
+	}
+	return ret;
+}
+
+vector<EpochManager::Usage> EpochManager::usage()
+{
+	map<unsigned, Usage> u;
+	EthashAux* aux = EthashAux::get();
+	{
+		ReadGuard l(aux->x_lights);
+		for (auto const& i : aux->m_lights)
+		{
+			Usage& e = u[i.second->epoch];
+			e.light += i.second->size;
+			if (i.second->pages)
+				e.light += i.second->pages->stats().pages * ETHASH_MIX_BYTES;
+		}
+	}
+	{
+		Guard l(aux->x_fulls);
+		for (auto it = aux->m_fulls.begin(); it != aux->m_fulls.end(); )
+			if (EthashAux::FullType f = it->second.lock())
+			{
+				u[EthashAux::number(it->first) / ETHASH_EPOCH_LENGTH].dag += f->size();
+				++it;
+			}
+			else
+				// nobody has it any more.  m_fulls gets an entry for every seed ever looked up.
+				it = aux->m_fulls.erase(it);
+	}
+	if (m_disk)
+		for (auto const& f : dagFiles())
+		{
+			boost::system::error_code ec;
+			uint64_t size = fs::file_size(f.second, ec);
+			if (!ec)
+				u[f.first].file += size;
+		}
+
+	vector<Usage> ret;
+	Guard l(x_manager);
+	for (auto& i : u)
+	{
+		i.second.epoch = i.first;
+		i.second.pinned = pinned(i.first);
+		ret.push_back(i.second);
+	}
+	return ret;
+}
+
+void EpochManager::trim(int _keep)
+{
+	// one trim at a time.  the manager's own lock is never held while EthashAux's are.
+	static Mutex s_trimming;
+	Guard trimming(s_trimming);
+
+	vector<Usage> u = usage();
+	map<unsigned, uint64_t> lastUsed;
+	DEV_GUARDED(x_manager)
+		lastUsed = m_lastUsed;
+	// least recently used first.  epochs that were never touched count as oldest.
+	sort(u.begin(), u.end(), [&] (Usage const& a, Usage const& b) { return lastUsed[a.epoch] < lastUsed[b.epoch]; });
+
+	uint64_t ram = 0;
+	uint64_t disk = 0;
+	for (auto const& e : u)
+	{
+		ram += e.light + e.dag;
+		disk += e.file;
+	}
+
+	EthashAux* aux = EthashAux::get();
+	for (auto const& e : u)
+	{
+		if (ram <= m_ram)
+			break;
+		if (e.pinned || e.epoch == (unsigned) _keep || e.light + e.dag == 0)
+			continue;
+		LogF << "EpochManager : dropping epoch " << e.epoch << " from memory (" << mb(e.light + e.dag) << " MB)";
+		DEV_WRITE_GUARDED(aux->x_lights)
+			for (auto it = aux->m_lights.begin(); it != aux->m_lights.end(); )
+				if (it->second->epoch == e.epoch)
+					it = aux->m_lights.erase(it);
+				else
+					++it;
+		DEV_GUARDED(aux->x_fulls)
+			for (auto it = aux->m_fulls.begin(); it != aux->m_fulls.end(); )
+				if (EthashAux::number(it->first) / ETHASH_EPOCH_LENGTH == e.epoch)
+				{
+					if (aux->m_lastUsedFull && aux->m_lastUsedFull == it->second.lock())
+						aux->m_lastUsedFull.reset();
+					it = aux->m_fulls.erase(it);
+				}
+				else
+					++it;
+		ram -= e.light + e.dag;
+	}
+
+	if (!m_disk || disk <= m_disk)
+		return;
+	multimap<unsigned, string> files = dagFiles();
+	for (auto const& e : u)
+	{
+		if (disk <= m_disk)
+			break;
+		// a DAG that's in memory may be mapped from its file.
+		if (e.pinned || e.epoch == (unsigned) _keep || e.file == 0 || e.dag)
+			continue;
+		auto range = files.equal_range(e.epoch);
+		for (auto f = range.first; f != range.second; ++f)
+		{
+			LogB << "Deleting DAG file " << f->second;
+			boost::system::error_code ec;
+			fs::remove(f->second, ec);
+			fs::remove(f->second + ".sum", ec);
+		}
+		disk -= e.file;
+	}
+}
+
+string EpochManager::summary()
+{
+	ostringstream ss;
+	ss.precision(4);
+	uint64_t ram = 0;
+	uint64_t disk = 0;
+	for (auto const& e : usage())
+	{
+		ss << "epoch " << e.epoch << (e.pinned ? " (pinned)" : "") << " : light " << mb(e.light) << " MB, DAG "
+			<< mb(e.dag) << " MB, file " << mb(e.file) << " MB;  ";
+		ram += e.light + e.dag;
+		disk += e.file;
+	}
+	ss << "total " << mb(ram) << " MB in memory";
+	if (m_disk)
+		ss << ", " << mb(disk) << " MB on disk";
+	return ss.str();
+}
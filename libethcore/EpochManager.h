@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// keeps the per epoch resources EthashAux accumulates within a budget.  left alone,
+// EthashAux keeps every light cache it ever made, so a miner that runs for months (or keeps
+// getting work for stale seeds from a failover pool) slowly grows.
+//
+// every light cache or host DAG that's looked up marks its epoch as used.  when the light
+// caches and DAGs in memory add up to more than the RAM budget, the least recently used
+// epochs are dropped from EthashAux until they fit.  anything still holding one keeps it
+// until it lets go.  DAG files in the DAG directory are pruned the same way against the
+// disk budget.  the epoch being mined, the one before it and the next one are pinned and
+// never dropped.  the previous one is for stale shares found just before an epoch switch:
+// they're verified against its light cache, which would otherwise be the first thing to go.
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+class EpochManager
+{
+public:
+	struct Usage
+	{
+		unsigned epoch = 0;
+		uint64_t light = 0;		// bytes of light cache, including its page cache
+		uint64_t dag = 0;		// bytes of DAG in memory
+		uint64_t file = 0;		// bytes of DAG files on disk
+		bool pinned = false;
+	};
+
+	// the shared instance, configured from the [Epochs] section of the INI file.
+	static EpochManager& get();
+
+	// budgets in bytes.  a disk budget of 0 leaves DAG files alone.
+	EpochManager(uint64_t _ram, uint64_t _disk);
+
+	// work for _seedHash's epoch.  it and the epochs either side are pinned from now on.
+	void setCurrent(h256 const& _seedHash);
+	// _epoch's light cache or DAG has just been used.
+	void touch(unsigned _epoch);
+	// drops the least recently used epochs until everything fits the budgets.  _keep is
+	// an epoch that has just been loaded, and isn't dropped even if nothing is pinned yet.
+	void trim(int _keep = -1);
+
+	// every epoch that has something in memory or on disk.
+	std::vector<Usage> usage();
+	std::string summary();
+
+private:
+	bool pinned(unsigned _epoch) const;
+	// epochs of the DAG files in the DAG directory, by file name.
+	std::multimap<unsigned, std::string> dagFiles();
+
+	uint64_t m_ram;
+	uint64_t m_disk;
+
+	Mutex x_manager;
+	std::map<unsigned, uint64_t> m_lastUsed;	// epoch -> use count at its last use
+	uint64_t m_uses = 0;
+	int m_current = -1;
+};
+
+}
+}
@@ -33,9 +33,11 @@
 #include <libdevcore/FileSystem.h>
 #include <libethash/internal.h>
 #include <libethash/io.h>
+#include <libethash/dagsum.h>
 #include <ethminer/MultiLog.h>
 #include "BlockInfo.h"
 #include "Exceptions.h"
+#include "EpochManager.h"
 using namespace std;
 using namespace chrono;
 using namespace dev;
@@ -47,6 +49,7 @@ const char* DAGChannel::name() { return EthGreen "DAG"; }
 EthashAux* dev::eth::EthashAux::s_this = nullptr;
 char  dev::eth::EthashAux::s_dagDirName[256] = "";
 dev::eth::DAGEraseMode dev::eth::EthashAux::s_dagEraseMode = DAGEraseMode::None;
+std::atomic<size_t> dev::eth::EthashAux::s_pageCacheBudget{0};
 
 const unsigned EthashProofOfWork::defaultLocalWorkSize = 64;
 const unsigned EthashProofOfWork::defaultGlobalWorkSizeMultiplier = 4096; // * CL_DEFAULT_LOCAL_WORK_SIZE
@@ -90,6 +93,9 @@ void EthashAux::setDAGDirName(const char * custom_dir_name)
 
 char * EthashAux::dagDirName()
 {
+	// until setDAGDirName says otherwise, the DAG lives where ethash_full_new puts it.
+	static bool const s_defaulted = !*s_dagDirName && ethash_get_default_dirname(s_dagDirName, sizeof(s_dagDirName));
+	(void) s_defaulted;
 	return s_dagDirName;
 }
 
@@ -102,11 +108,11 @@ void EthashAux::eraseDAGs()
 {
 	if (s_dagEraseMode == DAGEraseMode::None) return;
 
-	path p(s_dagDirName);
+	path p(dagDirName());
 	
 	if (!is_directory(p))
 	{
-		cnote << "Can't clean up DAG directory:" << s_dagDirName << "does not exist (yet).";
+		cnote << "Can't clean up DAG directory:" << dagDirName() << "does not exist (yet).";
 		return;
 	}
 
@@ -116,7 +122,8 @@ void EthashAux::eraseDAGs()
 
 	for (directory_iterator itr(p); itr != end_itr; ++itr)
 	{
-		if (is_regular_file(itr->path())) {
+		// checksum files go with their DAG.
+		if (is_regular_file(itr->path()) && itr->path().extension() != ".sum") {
 			files.push_back(itr->path());
 		}
 	}
@@ -137,54 +144,63 @@ void EthashAux::eraseDAGs()
 		{
 			cnote << "Deleting DAG file " << path->string();
 			remove(*path);
+			boost::system::error_code ec;
+			remove(path->string() + ".sum", ec);
 		}
 		dagcounter++;
 	}
 }
 
-h256 EthashAux::seedHash(unsigned _number)
+namespace
 {
-	unsigned epoch = _number / ETHASH_EPOCH_LENGTH;
-	Guard l(get()->x_epochs);
-	if (epoch >= get()->m_seedHashes.size())
+	// seed hash of every epoch EthashAux::number() accepts, and the reverse.  built once, on
+	// first use, and never changed after that, so lookups need no lock.
+	struct SeedTable
 	{
-		h256 ret;
-		unsigned n = 0;
-		if (!get()->m_seedHashes.empty())
+		SeedTable()
 		{
-			ret = get()->m_seedHashes.back();
-			n = get()->m_seedHashes.size() - 1;
-		}
-		get()->m_seedHashes.resize(epoch + 1);
-//		cdebug << "Searching for seedHash of epoch " << epoch;
-		for (; n <= epoch; ++n, ret = sha3(ret))
-		{
-			get()->m_seedHashes[n] = ret;
-//			cdebug << "Epoch" << n << "is" << ret;
+			h256 seed;
+			for (unsigned e = 0; e < EthashAux::c_maxEpochs; e++, seed = sha3(seed))
+			{
+				seeds[e] = seed;
+				epochs[seed] = e;
+			}
 		}
+		h256 seeds[EthashAux::c_maxEpochs];
+		std::unordered_map<h256, unsigned> epochs;
+	};
+
+	SeedTable const& seedTable()
+	{
+		static SeedTable const s_table;
+		return s_table;
 	}
-	return get()->m_seedHashes[epoch];
+}
+
+h256 EthashAux::seedHash(unsigned _number)
+{
+	unsigned epoch = _number / ETHASH_EPOCH_LENGTH;
+	SeedTable const& table = seedTable();
+	if (epoch < c_maxEpochs)
+		return table.seeds[epoch];
+	// beyond anything number() would accept.  carry on from the end of the table.
+	h256 ret = table.seeds[c_maxEpochs - 1];
+	for (unsigned n = c_maxEpochs - 1; n < epoch; ++n)
+		ret = sha3(ret);
+	return ret;
 }
 
 uint64_t EthashAux::number(h256 const& _seedHash)
 {
-	Guard l(get()->x_epochs);
-	unsigned epoch = 0;
-	auto epochIter = get()->m_epochs.find(_seedHash);
-	if (epochIter == get()->m_epochs.end())
+	SeedTable const& table = seedTable();
+	auto it = table.epochs.find(_seedHash);
+	if (it == table.epochs.end())
 	{
-		//		cdebug << "Searching for seedHash " << _seedHash;
-		for (h256 h; h != _seedHash && epoch < 2048; ++epoch, h = sha3(h), get()->m_epochs[h] = epoch) {}
-		if (epoch == 2048)
-		{
-			std::ostringstream error;
-			error << "apparent block number for " << _seedHash << " is too high; max is " << (ETHASH_EPOCH_LENGTH * 2048);
-			throw std::invalid_argument(error.str());
-		}
+		std::ostringstream error;
+		error << "apparent block number for " << _seedHash << " is too high; max is " << (ETHASH_EPOCH_LENGTH * c_maxEpochs);
+		throw std::invalid_argument(error.str());
 	}
-	else
-		epoch = epochIter->second;
-	return epoch * ETHASH_EPOCH_LENGTH;
+	return (uint64_t) it->second * ETHASH_EPOCH_LENGTH;
 }
 
 void EthashAux::killCache(h256 const& _s)
@@ -195,11 +211,23 @@ void EthashAux::killCache(h256 const& _s)
 
 EthashAux::LightType EthashAux::light(h256 const& _seedHash)
 {
-	UpgradableGuard l(get()->x_lights);
-	if (get()->m_lights.count(_seedHash))
-		return get()->m_lights.at(_seedHash);
-	UpgradeGuard l2(l);
-	return (get()->m_lights[_seedHash] = make_shared<LightAllocation>(_seedHash));
+	LightType ret;
+	bool created = false;
+	{
+		UpgradableGuard l(get()->x_lights);
+		if (get()->m_lights.count(_seedHash))
+			ret = get()->m_lights.at(_seedHash);
+		else
+		{
+			UpgradeGuard l2(l);
+			ret = get()->m_lights[_seedHash] = make_shared<LightAllocation>(_seedHash);
+			created = true;
+		}
+	}
+	EpochManager::get().touch(ret->epoch);
+	if (created)
+		EpochManager::get().trim(ret->epoch);
+	return ret;
 }
 
 EthashAux::LightAllocation::LightAllocation(h256 const& _seedHash)
@@ -209,10 +237,16 @@ EthashAux::LightAllocation::LightAllocation(h256 const& _seedHash)
 	if (!light)
 		BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_light_new()"));
 	size = ethash_get_cachesize(blockNumber);
+	epoch = blockNumber / ETHASH_EPOCH_LENGTH;
+	if (s_pageCacheBudget)
+		pages.reset(new DagPageCache(light, s_pageCacheBudget));
 }
 
 EthashAux::LightAllocation::~LightAllocation()
 {
+	if (pages)
+		LogF << "DAG page cache for epoch " << epoch << " : " << pages->summary();
+	pages.reset();
 	ethash_light_delete(light);
 }
 
@@ -223,14 +257,81 @@ bytesConstRef EthashAux::LightAllocation::data() const
 
 EthashAux::FullAllocation::FullAllocation(ethash_light_t _light, ethash_callback_t _cb)
 {
+	// the checksums go next to the DAG file, so both are looked for in the same place.
+	std::string dir = EthashAux::dagDirName();
 //	cdebug << "About to call ethash_full_new...";
-	full = ethash_full_new(_light, EthashAux::dagDirName(), _cb);
+	full = ethash_full_new(_light, dir.c_str(), _cb);
 //	cdebug << "Called OK.";
 	if (!full)
 	{
 		clog(DAGChannel) << "DAG Generation Failure. Reason: "  << strerror(errno);
 		BOOST_THROW_EXCEPTION(ExternalFunctionFailure("ethash_full_new"));
 	}
+	if (full->loaded)
+		verify(_light, dir);
+}
+
+void EthashAux::FullAllocation::verify(ethash_light_t _light, std::string const& _dir)
+{
+	auto start = SteadyClock::now();
+	uint8_t* dag = (uint8_t*) full->data;
+	uint64_t dagSize = full->file_size;
+	size_t chunks = ethash_dagsum_chunks(dagSize);
+	ethash_h256_t seed = ethash_get_seedhash(_light->block_number);
+	std::unique_ptr<uint64_t, decltype(&free)> sums(ethash_dagsum_read(_dir.c_str(), seed, dagSize), &free);
+
+	auto chunkSize = [&] (size_t _c) { return min<uint64_t>(ETHASH_DAGSUM_CHUNK_BYTES, dagSize - _c * ETHASH_DAGSUM_CHUNK_BYTES); };
+	auto parallel = [&] (std::function<void(size_t)> const& _f) {
+		std::atomic<size_t> next(0);
+		vector<thread> threads;
+		for (unsigned i = 0; i < max(1u, thread::hardware_concurrency()); i++)
+			threads.push_back(thread([&] () {
+				for (size_t c; (c = next++) < chunks; )
+					_f(c);
+			}));
+		for (auto& t : threads)
+			t.join();
+	};
+
+	vector<uint8_t> bad(chunks, 0);
+	if (sums)
+		parallel([&] (size_t c) {
+			bad[c] = ethash_dagsum_chunk(dag + c * ETHASH_DAGSUM_CHUNK_BYTES, chunkSize(c)) != sums.get()[c];
+		});
+	else
+	{
+		// a file from before there were checksums.  spot check a few items in each chunk
+		// against the light cache, then give it checksums.
+		parallel([&] (size_t c) {
+			unsigned const samples = 4;
+			uint64_t items = chunkSize(c) / sizeof(node);
+			for (unsigned s = 0; s < samples && !bad[c]; s++)
+			{
+				uint32_t item = (uint32_t) (c * ETHASH_DAGSUM_CHUNK_BYTES / sizeof(node) + (items - 1) * s / (samples - 1));
+				node n;
+				ethash_calculate_dag_item(&n, item, _light);
+				bad[c] = memcmp(&n, dag + (uint64_t) item * sizeof(node), sizeof(node)) != 0;
+			}
+		});
+	}
+
+	size_t repaired = count(bad.begin(), bad.end(), 1);
+	if (repaired)
+	{
+		LogB << "DAG file has " << repaired << " bad chunks out of " << chunks << ".  Regenerating them ...";
+		parallel([&] (size_t c) {
+			if (bad[c])
+				ethash_compute_full_range(dag, dagSize, c * ETHASH_DAGSUM_CHUNK_BYTES, chunkSize(c), _light);
+		});
+	}
+	if (!sums || repaired)
+	{
+		vector<uint64_t> fresh(chunks);
+		parallel([&] (size_t c) { fresh[c] = ethash_dagsum_chunk(dag + c * ETHASH_DAGSUM_CHUNK_BYTES, chunkSize(c)); });
+		ethash_dagsum_write(_dir.c_str(), seed, dagSize, fresh.data());
+	}
+	LogF << "DAG file checked in " << duration_cast<milliseconds>(SteadyClock::now() - start).count() << " ms ("
+		<< chunks << " chunks, " << repaired << " regenerated" << (sums ? "" : ", no checksums") << ")";
 }
 
 EthashAux::FullAllocation::~FullAllocation()
@@ -271,6 +372,7 @@ EthashAux::FullType EthashAux::full(h256 const& _seedHash, bool _createIfMissing
 
 		DEV_GUARDED(get()->x_fulls)
 			get()->m_fulls[_seedHash] = get()->m_lastUsedFull = ret;
+		EpochManager::get().trim(l->epoch);
 	}
 
 	return ret;
@@ -321,17 +423,25 @@ EthashProofOfWork::Result EthashAux::FullAllocation::compute(h256 const& _header
 
 EthashProofOfWork::Result EthashAux::LightAllocation::compute(h256 const& _headerHash, Nonce const& _nonce) const
 {
-	ethash_return_value r = ethash_light_compute(light, *(ethash_h256_t*)_headerHash.data(), (uint64_t)(u64)_nonce);
+	ethash_return_value r = pages ?
+		ethash_light_compute_paged(light, *(ethash_h256_t*)_headerHash.data(), (uint64_t)(u64)_nonce, &DagPageCache::source, pages.get()) :
+		ethash_light_compute(light, *(ethash_h256_t*)_headerHash.data(), (uint64_t)(u64)_nonce);
 	if (!r.success)
 		BOOST_THROW_EXCEPTION(DAGCreationFailure());
 	return EthashProofOfWork::Result{h256((uint8_t*)&r.result, h256::ConstructFromPointer), h256((uint8_t*)&r.mix_hash, h256::ConstructFromPointer)};
 }
 
+EthashAux::FullType EthashAux::loadedFull(h256 const& _seedHash)
+{
+	Guard l(get()->x_fulls);
+	auto it = get()->m_fulls.find(_seedHash);
+	return it == get()->m_fulls.end() ? FullType() : it->second.lock();
+}
+
 EthashProofOfWork::Result EthashAux::eval(h256 const& _seedHash, h256 const& _headerHash, Nonce const& _nonce)
 {
-	DEV_GUARDED(get()->x_fulls)
-		if (FullType dag = get()->m_fulls[_seedHash].lock())
-			return dag->compute(_headerHash, _nonce);
+	if (FullType dag = loadedFull(_seedHash))
+		return dag->compute(_headerHash, _nonce);
 	DEV_IF_THROWS(return EthashAux::get()->light(_seedHash)->compute(_headerHash, _nonce))
 	{
 		return EthashProofOfWork::Result{ ~h256(), h256() };
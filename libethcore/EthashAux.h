@@ -21,11 +21,14 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include <condition_variable>
 #include <libethash/ethash.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/Worker.h>
 #include "Ethash.h"
+#include "DagPageCache.h"
 
 namespace dev
 {
@@ -103,6 +106,9 @@ public:
 		EthashProofOfWork::Result compute(h256 const& _headerHash, Nonce const& _nonce) const;
 		ethash_light_t light;
 		uint64_t size;
+		unsigned epoch;
+		// DAG pages computed by earlier evaluations.  null if the page cache is off.
+		std::unique_ptr<DagPageCache> pages;
 	};
 
 	struct FullAllocation
@@ -113,11 +119,18 @@ public:
 		bytesConstRef data() const;
 		uint64_t size() const { return ethash_full_dag_size(full); }
 		ethash_full_t full;
+
+	private:
+		// checks a DAG loaded from _dir against its checksums, and generates any bad chunks again.
+		void verify(ethash_light_t _light, std::string const& _dir);
 	};
 
 	using LightType = std::shared_ptr<LightAllocation>;
 	using FullType = std::shared_ptr<FullAllocation>;
 
+	/// number() knows the seed hashes of this many epochs.
+	static const unsigned c_maxEpochs = 2048;
+
 	static h256 seedHash(unsigned _number);
 	static uint64_t number(h256 const& _seedHash);
 	static uint64_t cacheSize(BlockInfo const& _header);
@@ -126,6 +139,8 @@ public:
 	static char * dagDirName();
 
 	static void setDAGEraseMode(DAGEraseMode mode);
+	/// Gives each light cache created from now on a DagPageCache of @a _bytes.  0 turns it off.
+	static void setPageCacheBudget(size_t _bytes) { s_pageCacheBudget = _bytes; }
 	static void eraseDAGs();
 
 	static LightType light(h256 const& _seedHash);
@@ -137,12 +152,17 @@ public:
 	static std::pair<uint64_t, unsigned> fullGeneratingProgress() { return std::make_pair(get()->m_generatingFullNumber, get()->m_fullProgress); }
 	/// Kicks off generation of DAG for @a _blocknumber and blocks until ready; @returns result or empty pointer if not existing and _createIfMissing is false.
 	static FullType full(h256 const& _seedHash, bool _createIfMissing = false, std::function<int(unsigned)> const& _f = std::function<int(unsigned)>());
+	/// @returns the full DAG for @a _seedHash if something is holding it in memory already, otherwise an empty pointer.  Never loads or generates it.
+	static FullType loadedFull(h256 const& _seedHash);
 	
 
 
 	static EthashProofOfWork::Result eval(h256 const& _seedHash, h256 const& _headerHash, Nonce const& _nonce);
 
 private:
+	// evicts light caches and DAGs from our maps.
+	friend class EpochManager;
+
 	EthashAux() {}
 
 	/// Kicks off generation of DAG for @a _blocknumber and blocks until ready; @returns result.
@@ -152,6 +172,7 @@ private:
 	static EthashAux* s_this;
 	static char s_dagDirName[256];
 	static DAGEraseMode s_dagEraseMode;
+	static std::atomic<size_t> s_pageCacheBudget;
 
 	SharedMutex x_lights;
 	std::unordered_map<h256, std::shared_ptr<LightAllocation>> m_lights;
@@ -164,10 +185,6 @@ private:
 	uint64_t m_generatingFullNumber = NotGenerating;
 	unsigned m_fullProgress;
 
-	Mutex x_epochs;
-	std::unordered_map<h256, unsigned> m_epochs;
-	h256s m_seedHashes;
-
 	
 };
 
@@ -22,10 +22,10 @@
  */
 
 #include "EthashCPUMiner.h"
+#include "CPUMiningPool.h"
 #include <thread>
 #include <chrono>
 #include <boost/algorithm/string.hpp>
-#include <random>
 #if ETH_CPUID || !ETH_TRUE
 #define HAVE_STDINT_H
 #include <libcpuid/libcpuid.h>
@@ -35,6 +35,8 @@ using namespace dev;
 using namespace eth;
 
 unsigned EthashCPUMiner::s_numInstances = 0;
+bool EthashCPUMiner::s_numa = false;
+unsigned EthashCPUMiner::s_interleave = 1;
 
 #if ETH_CPUID || !ETH_TRUE
 static string jsonEncode(map<string, string> const& _m)
@@ -55,72 +57,119 @@ static string jsonEncode(map<string, string> const& _m)
 #endif
 
 EthashCPUMiner::EthashCPUMiner(Farm* _farm, unsigned _index):
-	GenericMiner<EthashProofOfWork>(_farm, _index), Worker("miner" + toString(index()))
+	GenericMiner<EthashProofOfWork>(_farm, _index)
 {
+	CPUMiningPool::get().attach(this);
 }
 
 EthashCPUMiner::~EthashCPUMiner()
 {
+	CPUMiningPool::get().detach(this);
 }
 
 void EthashCPUMiner::kickOff()
 {
 	LogF << "Trace: EthashCPUMiner::kickOff";
-	startWorking();
+	CPUMiningPool::get().setWork(work());
 }
 
 void EthashCPUMiner::pause()
 {
 	LogF << "Trace: EthashCPUMiner::pause";
-	stopWorking();
+	// the farm pauses every miner before giving it new work.  only an empty package stops
+	// the pool, a new one simply replaces the job.
+	if (!work())
+		CPUMiningPool::get().pause();
 }
 
-void EthashCPUMiner::workLoop()
+NumaDag::ReplicaPtr EthashCPUMiner::prepare(WorkPackage const& _work)
 {
-	LogF << "Trace: EthashCPUMiner::workLoop";
-	uint64_t const c_maxHash = ~uint64_t(0);
-
-	auto tid = std::this_thread::get_id();
-	static std::mt19937_64 s_eng((time(0) + std::hash<decltype(tid)>()(tid)));
-	uint64_t bestHash = c_maxHash;
-
-	uint64_t tryNonce = s_eng();
-
-	WorkPackage w = work();
+	LogF << "Trace: EthashCPUMiner::prepare";
+	if (s_numa && !m_pinned)
+	{
+		unsigned cpu;
+		NumaTopology::placeThread(m_index, m_node, cpu);
+		if (NumaTopology::pin(cpu))
+			LogF << "CPU miner " << m_index << " pinned to cpu " << cpu << ", node " << NumaTopology::nodes()[m_node].id;
+		m_pinned = true;
+	}
+	if (_work.seedHash != m_dagSeed)
+	{
+		m_dag.reset();
+		if (s_numa)
+			m_dag = NumaDag::get().replica(_work.seedHash, m_node);
+		else if (s_interleave > 1)
+			m_dag = NumaDag::wrap(EthashAux::full(_work.seedHash, true));
+		m_dagSeed = _work.seedHash;
+	}
 
-	h256 boundary = w.boundary;
-	unsigned hashCount = 1;
-	uint64_t batchCount = 0;
-	Timer batchTime;
+	m_jobBest = ~uint64_t(0);
+	m_hashCount = 0;
+	m_batchCount = 0;
+	m_batchTime.restart();
 
 	m_farm->setIsMining(true);
-	
-	for (; !shouldStop(); tryNonce++, hashCount++)
-	{
-		Nonce n = (Nonce) (u64) tryNonce;
-		EthashProofOfWork::Result r = EthashAux::eval(w.seedHash, w.headerHash, n);
-		if (r.value < w.boundary && submitProof(Solution{n, r.mixHash}))
-			break;
-
-		m_currentHash = upper64OfHash(r.value);
+	// no kernel on the CPU, hashing simply starts here.
+	WorkTrace::get().stage(WorkTrace::WorkerStart, _work.headerHash, m_index);
+	WorkTrace::get().stage(WorkTrace::KernelLaunch, _work.headerHash, m_index);
+	return m_dag;
+}
 
-		if (m_currentHash < bestHash)
-			setBestHash(m_currentHash);
+unsigned EthashCPUMiner::hashChunk(WorkPackage const& _work, NumaDag::Replica const* _dag, uint64_t _start, unsigned _count, std::function<bool()> const& _stale, bool& _solved)
+{
+	// interleaving needs the full DAG in memory.  without it we're back to light evaluation.
+	unsigned const lanes = _dag ? s_interleave : 1;
+	uint64_t nonces[ETHASH_MAX_INTERLEAVE];
+	EthashProofOfWork::Result results[ETHASH_MAX_INTERLEAVE];
 
-		if (m_closeHit > 0 && m_currentHash < m_closeHit)
+	unsigned done = 0;
+	while (done < _count && !_stale())
+	{
+		unsigned n = std::min(lanes, _count - done);
+		for (unsigned k = 0; k < n; k++)
+			nonces[k] = _start + done + k;
+		if (n > 1)
+			_dag->computeBatch(_work.headerHash, nonces, n, results);
+		else
+			results[0] = _dag ? _dag->compute(_work.headerHash, (Nonce) (u64) nonces[0]) : EthashAux::eval(_work.seedHash, _work.headerHash, (Nonce) (u64) nonces[0]);
+
+		for (unsigned k = 0; k < n; k++)
 		{
-			unsigned work = std::chrono::duration_cast<std::chrono::seconds>(SteadyClock::now() - m_lastCloseHit).count();
-			m_farm->reportCloseHit(m_currentHash, work, m_index);
-			m_lastCloseHit = SteadyClock::now();
+			EthashProofOfWork::Result const& r = results[k];
+			if (r.value < _work.boundary && submitProof(Solution{(Nonce) (u64) nonces[k], r.mixHash}))
+			{
+				_solved = true;
+				return done + k + 1;
+			}
+
+			m_currentHash = upper64OfHash(r.value);
+
+			if (m_currentHash < m_jobBest)
+			{
+				m_jobBest = m_currentHash;
+				setBestHash(m_currentHash);
+			}
+
+			if (m_closeHit > 0 && m_currentHash < m_closeHit)
+			{
+				unsigned work = std::chrono::duration_cast<std::chrono::seconds>(SteadyClock::now() - m_lastCloseHit).count();
+				m_farm->reportCloseHit(m_currentHash, work, m_index);
+				m_lastCloseHit = SteadyClock::now();
+			}
 		}
+		done += n;
+		m_hashCount += n;
 
-		if (batchTime.elapsedMilliseconds() > 100)
+		if (m_batchTime.elapsedMilliseconds() > 100)
 		{
-			accumulateHashes(hashCount, batchCount++);
-			batchTime.restart();
-			hashCount = 1;
+			accumulateHashes(m_hashCount, m_batchCount++);
+			if (s_numa)
+				NumaDag::get().reportHashes(m_node, m_hashCount);
+			m_batchTime.restart();
+			m_hashCount = 0;
 		}
 	}
+	return done;
 }
 
 std::string EthashCPUMiner::platformInfo()
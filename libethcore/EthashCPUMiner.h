@@ -23,8 +23,11 @@
 
 #pragma once
 
-#include "libdevcore/Worker.h"
+#include <thread>
+#include <functional>
+#include <libethash/ethash.h>
 #include "EthashAux.h"
+#include "NumaDag.h"
 #include "Miner.h"
 
 namespace dev
@@ -32,7 +35,8 @@ namespace dev
 namespace eth
 {
 
-class EthashCPUMiner: public GenericMiner<EthashProofOfWork>, Worker
+// hashes on one of CPUMiningPool's threads.  see CPUMiningPool.h.
+class EthashCPUMiner: public GenericMiner<EthashProofOfWork>
 {
 public:
 	EthashCPUMiner(Farm* _farm, unsigned _index);
@@ -43,14 +47,40 @@ public:
 	static void listDevices() {}
 	static bool configureGPU(unsigned, unsigned, unsigned, unsigned, unsigned, bool, unsigned, uint64_t) { return false; }
 	static void setNumInstances(unsigned _instances) { s_numInstances = std::min<unsigned>(_instances, std::thread::hardware_concurrency()); }
+	// pin threads to cores and hash against a DAG copy on the local NUMA node.  see NumaDag.h.
+	static void setNuma(bool _numa) { s_numa = _numa; }
+	// hashes each thread keeps in flight, so their DAG reads overlap.  1 hashes one at a time.
+	static void setInterleave(unsigned _k) { s_interleave = std::max(1u, std::min<unsigned>(_k, ETHASH_MAX_INTERLEAVE)); }
+	static unsigned interleave() { return s_interleave; }
+
+	// called on the pool thread.  gets ready for a new job and returns the DAG to hash
+	// against, or null for light evaluation.
+	NumaDag::ReplicaPtr prepare(WorkPackage const& _work);
+	// hashes _count nonces from _start, until _stale says the job is over.  returns the
+	// number hashed.  _solved is set if a solution was accepted.
+	unsigned hashChunk(WorkPackage const& _work, NumaDag::Replica const* _dag, uint64_t _start, unsigned _count, std::function<bool()> const& _stale, bool& _solved);
 
 protected:
 	void kickOff() override;
 	void pause() override;
 
 private:
-	void workLoop() override;
 	static unsigned s_numInstances;
+	static bool s_numa;
+	static unsigned s_interleave;
+
+	// NUMA mode.  the pool thread lives as long as the program, so it's only pinned once.
+	bool m_pinned = false;
+	unsigned m_node = 0;
+
+	h256 m_dagSeed;
+	NumaDag::ReplicaPtr m_dag;
+
+	// this job's
+	uint64_t m_jobBest = ~uint64_t(0);
+	unsigned m_hashCount = 0;
+	uint64_t m_batchCount = 0;
+	Timer m_batchTime;
 };
 
 }
@@ -27,6 +27,8 @@ along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 #include <thread>
 #include <chrono>
 #include <libethash-cuda/ethash_cuda_miner.h>
+#include "NoncePartitioner.h"
+#include "VerificationEngine.h"
 
 #if defined(WIN32)
 #include <Windows.h>
@@ -67,10 +69,11 @@ namespace eth
 			//			cwarn << "Couldn't abort. Abandoning OpenCL process.";
 		}
 
-		void reset()
+		void reset(h256 const& _header)
 		{
 			UniqueGuard l(x_all);
 			m_aborted = m_abort = false;
+			m_header = _header;
 		}
 
 	protected:
@@ -93,11 +96,22 @@ namespace eth
 			return (m_aborted = shouldStop);
 		}
 
+		virtual void launched(uint8_t const* _header) override
+		{
+			WorkTrace::get().stage(WorkTrace::KernelLaunch, h256(_header, h256::ConstructFromPointer), m_owner->index());
+		}
+
+		virtual bool claim(uint64_t _count, uint64_t& _start) override
+		{
+			return NoncePartitioner::get().claim(m_owner->index(), m_header, _count, _start);
+		}
+
 	private:
 		Mutex x_all;
 		bool m_abort = false;
 		Notified<bool> m_aborted = { true };
 		EthashCUDAMiner* m_owner = nullptr;
+		h256 m_header;		// the job being searched, for claiming nonces
 	};
 }
 }
@@ -105,7 +119,7 @@ namespace eth
 unsigned EthashCUDAMiner::s_platformId = 0;
 unsigned EthashCUDAMiner::s_deviceId = 0;
 unsigned EthashCUDAMiner::s_numInstances = 0;
-int EthashCUDAMiner::s_devices[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+std::vector<int> EthashCUDAMiner::s_devices;
 
 EthashCUDAMiner::EthashCUDAMiner(Farm* _farm, unsigned _index) :
 	GenericMiner<EthashProofOfWork>(_farm, _index),
@@ -124,15 +138,16 @@ EthashCUDAMiner::~EthashCUDAMiner()
 bool EthashCUDAMiner::report(uint64_t _nonce)
 {
 	Nonce n = (Nonce)(u64)_nonce;
-	EthashProofOfWork::Result r = EthashAux::eval(work().seedHash, work().headerHash, n);
-	if (r.value < work().boundary)
+	WorkPackage w = work();
+	EthashProofOfWork::Result r = VerificationEngine::get().verify({w.seedHash, w.headerHash, n, h256()}).get();
+	if (r.value < w.boundary)
 		return submitProof(Solution{ n, r.mixHash });
 	return false;
 }
 
 void EthashCUDAMiner::kickOff()
 {
-	m_hook->reset();
+	m_hook->reset(work().headerHash);
 	startWorking();
 }
 
@@ -141,10 +156,11 @@ void EthashCUDAMiner::workLoop()
 	// take local copy of work since it may end up being overwritten by kickOff/pause.
 	try {
 		WorkPackage w = work();
+		WorkTrace::get().stage(WorkTrace::WorkerStart, w.headerHash, m_index);
 		//cnote << "set work; seed: " << "#" + w.seedHash.hex().substr(0, 8) + ", target: " << "#" + w.boundary.hex().substr(0, 12);
 		if (!m_miner || m_minerSeed != w.seedHash)
 		{
-			m_device = s_devices[index()] > -1 ? s_devices[index()] : index();
+			m_device = index() < s_devices.size() && s_devices[index()] > -1 ? s_devices[index()] : index();
 
 			if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL)
 			{
@@ -197,9 +213,8 @@ void EthashCUDAMiner::workLoop()
 
 		m_farm->setIsMining(true);
 
-		uint64_t startN = 0;
-		if (w.exSizeBits >= 0)
-			startN = w.startNonce | ((uint64_t)index() << (64 - 4 - w.exSizeBits)); // this can support up to 16 devices
+		// nonces are claimed from the partitioner a batch at a time, see EthashCUDAHook::claim.
+		uint64_t startN = w.startNonce;
 		m_miner->search(w.headerHash.data(), upper64OfHash(w.boundary), *m_hook, (w.exSizeBits >= 0), startN);
 	}
 	catch (std::runtime_error const& _e)
@@ -244,10 +259,12 @@ bool EthashCUDAMiner::configureGPU(
 {
 	s_dagLoadMode = _dagLoadMode;
 	s_dagCreateDevice = _dagCreateDevice;
+	// ethash_cuda_miner::configureGPU reads an entry for every CUDA device, -1 = unused.
+	s_devices.resize(max<size_t>(s_devices.size(), getNumDevices()), -1);
 	_blockSize = ((_blockSize + 7) / 8) * 8;
 
 	if (!ethash_cuda_miner::configureGPU(
-		s_devices,
+		s_devices.data(),
 		_blockSize,
 		_gridSize,
 		_numStreams,
@@ -61,12 +61,9 @@ namespace eth
 		{ 
 			s_numInstances = std::min<unsigned>(_instances, getNumDevices());
 		}
-		static void setDevices(unsigned * _devices, unsigned _selectedDeviceCount) 
+		static void setDevices(std::vector<unsigned> const& _devices) 
 		{
-			for (unsigned i = 0; i < _selectedDeviceCount; i++) 
-			{
-				s_devices[i] = _devices[i];
-			}
+			s_devices.assign(_devices.begin(), _devices.end());
 		}
 	protected:
 		void kickOff() override;
@@ -83,7 +80,7 @@ namespace eth
 		static unsigned s_platformId;
 		static unsigned s_deviceId;
 		static unsigned s_numInstances;
-		static int s_devices[16];
+		static std::vector<int> s_devices;
 
 	};
 }
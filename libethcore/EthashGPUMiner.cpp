@@ -27,6 +27,9 @@
 #include <thread>
 #include <chrono>
 #include <libethash-cl/ethash_cl_miner.h>
+#include "HashVerifier.h"
+#include "VerificationEngine.h"
+#include "NoncePartitioner.h"
 #include "ethminer/MultiLog.h"
 
 using namespace std;
@@ -66,10 +69,11 @@ public:
 		m_aborted.wait(true);
 	}
 
-	void reset()
+	void reset(h256 const& _header)
 	{
 		UniqueGuard l(x_all);
 		m_aborted = m_abort = false;
+		m_header = _header;
 	}
 
 protected:
@@ -91,6 +95,16 @@ protected:
 		return (m_aborted = shouldStop);
 	}
 
+	virtual void launched(h256 const& _header) override
+	{
+		WorkTrace::get().stage(WorkTrace::KernelLaunch, _header, m_owner->m_index);
+	}
+
+	virtual bool claim(uint64_t _count, uint64_t& _start) override
+	{
+		return NoncePartitioner::get().claim(m_owner->m_index, m_header, _count, _start);
+	}
+
 	virtual bool shouldStop() override
 	{
 		UniqueGuard l(x_all);
@@ -104,6 +118,7 @@ private:
 	bool m_abort = false;
 	Notified<bool> m_aborted = {true};
 	EthashGPUMiner* m_owner = nullptr;
+	h256 m_header;		// the job being searched, for claiming nonces
 };
 
 }
@@ -117,17 +132,23 @@ private:
 unsigned EthashGPUMiner::s_platformId = 0;
 unsigned EthashGPUMiner::s_deviceId = 0;
 unsigned EthashGPUMiner::s_numInstances = 0;
-int EthashGPUMiner::s_devices[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+std::vector<int> EthashGPUMiner::s_devices;
 
 EthashGPUMiner::EthashGPUMiner(Farm* _farm, unsigned _index):
 	GenericMiner<EthashProofOfWork>(_farm, _index),
 	Worker("openclminer" + toString(index())),
 	m_hook(new EthashCLHook(this))
 {
+	HashVerifier::get().setFaultHandler(m_index, [=] (uint64_t _nonce, h256 const& _header) {
+		LogB << "Hash fault : nonce = 0x" << std::hex << _nonce
+			<< ", headerHash = " << _header.hex().substr(0, 8) << ", [device:" << m_index << "]";
+		m_farm->reportHashFault(m_index);
+	});
 }
 
 EthashGPUMiner::~EthashGPUMiner()
 {
+	HashVerifier::get().setFaultHandler(m_index, HashVerifier::FaultFn());
 	pause();
 	delete m_miner;
 	delete m_hook;
@@ -137,7 +158,7 @@ bool EthashGPUMiner::report(uint64_t _nonce)
 {
 	Nonce n = (Nonce)(u64)_nonce;
 	WorkPackage w = work();
-	EthashProofOfWork::Result r = EthashAux::eval(w.seedHash, w.headerHash, n);
+	EthashProofOfWork::Result r = VerificationEngine::get().verify({w.seedHash, w.headerHash, n, h256()}).get();
 	uint64_t hash = upper64OfHash(r.value);
 	if (r.value < w.boundary)
 		return submitProof(Solution{n, r.mixHash});
@@ -167,7 +188,7 @@ void EthashGPUMiner::resetBestHash()
 void EthashGPUMiner::kickOff()
 {
 	LogF << "Trace: EthashGPUMiner::kickOff, miner[" << m_index << "]";
-	m_hook->reset();
+	m_hook->reset(work().headerHash);
 	startWorking();
 }
 
@@ -177,6 +198,7 @@ void EthashGPUMiner::workLoop()
 	try {
 		// take local copy of work since it may end up being overwritten by kickOff/pause.
 		WorkPackage w = work();
+		WorkTrace::get().stage(WorkTrace::WorkerStart, w.headerHash, m_index);
 		if (!m_miner || m_minerSeed != w.seedHash)
 		{
 			LogF << "Trace: EthashGPUMiner::workLoop-2, miner[" << m_index << "]";
@@ -193,7 +215,7 @@ void EthashGPUMiner::workLoop()
 			delete m_miner;
 			m_miner = new ethash_cl_miner(this);
 
-			m_device = s_devices[index()] > -1 ? s_devices[index()] : index();
+			m_device = index() < s_devices.size() && s_devices[index()] > -1 ? s_devices[index()] : index();
 
 			EthashAux::LightType light;
 			light = EthashAux::light(w.seedHash);
@@ -207,9 +229,9 @@ void EthashGPUMiner::workLoop()
 
 		m_farm->setIsMining(true);
 
-		uint64_t startN = 0;
-		if (w.exSizeBits >= 0)
-			startN = w.startNonce | ((uint64_t)index() << (64 - 4 - w.exSizeBits)); // this can support up to 16 devices
+		// the search claims its nonces from the partitioner a kernel run at a time, and idles
+		// once there's nothing left to claim.
+		uint64_t startN = w.startNonce;
 		uint64_t threshold = max(m_closeHit, upper64OfHash(w.boundary));
 		m_miner->search(w.headerHash, threshold, *m_hook, (w.exSizeBits >= 0), startN);
 	}
@@ -231,21 +253,13 @@ void EthashGPUMiner::pause()
 
 void EthashGPUMiner::checkHash(uint64_t _hash, uint64_t _nonce, h256 _header)
 {
+	// this runs on the thread feeding the GPU, so the actual verification is handed off
+	// to the verifier pool.
 	WorkPackage w = work();
-	h256 header = w.headerHash;
-	h256 seed = w.seedHash;
-
-	if (_header != header)
+	if (_header != w.headerHash)
 		// a new work package just came in so we'll skip this check.
 		return;
-	Nonce n = (Nonce) (u64) _nonce;
-	EthashProofOfWork::Result r = EthashAux::eval(seed, header, n);
-	if (_hash != upper64OfHash(r.value))
-	{
-		LogB << "Hash fault : nonce = 0x" << std::hex << _nonce
-			<< ", headerHash = " << header.hex().substr(0, 8) << ", [device:" << m_index << "]";
-		m_farm->reportHashFault(m_index);
-	}
+	HashVerifier::get().offer(m_index, w.seedHash, _header, _nonce, _hash);
 }
 
 
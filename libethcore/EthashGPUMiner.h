@@ -57,12 +57,9 @@ public:
 		unsigned _dagCreateDevice
 	);
 	static void setNumInstances(unsigned _instances) { s_numInstances = std::min<unsigned>(_instances, getNumDevices()); }
-	static void setDevices(unsigned * _devices, unsigned _selectedDeviceCount)
+	static void setDevices(std::vector<unsigned> const& _devices)
 	{
-		for (unsigned i = 0; i < _selectedDeviceCount; i++)
-		{
-			s_devices[i] = _devices[i];
-		}
+		s_devices.assign(_devices.begin(), _devices.end());
 	}
 	void setThrottle(int _percent);
 	static void exportDAG(unsigned _block);
@@ -84,7 +81,7 @@ private:
 	static unsigned s_platformId;
 	static unsigned s_deviceId;
 	static unsigned s_numInstances;
-	static int s_devices[16];
+	static std::vector<int> s_devices;
 
 };
 
@@ -0,0 +1,208 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "EthashSimMiner.h"
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include "WorkTrace.h"
+#include "NoncePartitioner.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace dev;
+using namespace dev::eth;
+
+EthashSimMiner::Settings EthashSimMiner::s_settings;
+Mutex EthashSimMiner::x_thermal;
+std::vector<SimulatedThermalDevice> EthashSimMiner::s_thermal;
+
+// longest the work loop sleeps without checking whether it should stop.
+static const milliseconds c_sleepSlice(20);
+
+
+/*-----------------------------------------------------------------------------------
+* class EthashSimMiner
+*----------------------------------------------------------------------------------*/
+EthashSimMiner::EthashSimMiner(Farm* _farm, unsigned _index) :
+	GenericMiner<EthashProofOfWork>(_farm, _index), Worker("sim" + toString(index()))
+{
+}
+
+EthashSimMiner::~EthashSimMiner()
+{
+	pause();
+}
+
+void EthashSimMiner::configure(Settings const& _settings)
+{
+	s_settings = _settings;
+	s_settings.devices = max(1u, s_settings.devices);
+
+	// no two cards run quite the same, so the thermal parameters are spread a little.
+	Guard l(x_thermal);
+	s_thermal.assign(s_settings.devices, SimulatedThermalDevice());
+	for (unsigned i = 0; i < s_thermal.size(); i++)
+	{
+		SimulatedThermalDevice& d = s_thermal[i];
+		d.selfHeat *= 1.0 + 0.05 * ((int) (i % 5) - 2);
+		d.coupling *= 1.0 + 0.1 * ((int) (i % 3) - 1);
+		d.fullRate = s_settings.hashRate;
+		d.temp = d.ambient;
+	}
+}
+
+std::string EthashSimMiner::platformInfo()
+{
+	return toString(s_settings.devices) + " simulated devices @ " + toString(s_settings.hashRate) + " MH/s";
+}
+
+void EthashSimMiner::listDevices()
+{
+	LogS << platformInfo() << ", " << s_settings.kernelMs << " ms kernel runs";
+}
+
+bool EthashSimMiner::simReading(unsigned _device, double& _temp, int& _power)
+{
+	Guard l(x_thermal);
+	if (_device >= s_thermal.size())
+		return false;
+	ThermalObservation o = s_thermal[_device].observation();
+	_temp = o.temp;
+	_power = (int) o.power;
+	return true;
+}
+
+void EthashSimMiner::kickOff()
+{
+	startWorking();
+}
+
+void EthashSimMiner::pause()
+{
+	stopWorking();
+}
+
+void EthashSimMiner::heat(double _seconds, double _duty)
+{
+	Guard l(x_thermal);
+	if (m_index >= s_thermal.size())
+		return;
+	double others = 0;
+	for (unsigned i = 0; i < s_thermal.size(); i++)
+		if (i != m_index)
+			others += throttleToDuty(s_thermal[i].throttle);
+	if (s_thermal.size() > 1)
+		others /= s_thermal.size() - 1;
+	s_thermal[m_index].throttle = dutyToThrottle(_duty);
+	s_thermal[m_index].step(others, _seconds);
+}
+
+void EthashSimMiner::workLoop()
+{
+	WorkPackage w = work();
+	WorkTrace::get().stage(WorkTrace::WorkerStart, w.headerHash, m_index);
+	m_farm->setIsMining(true);
+
+	std::mt19937_64 rng(time(0) + m_index * 7919);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+	// with stratum, nonces are claimed from the partitioner like the GPU miners do.
+	uint64_t nonce = w.exSizeBits >= 0 ? w.startNonce : rng();
+
+	uint64_t target = upper64OfHash(w.boundary);
+	uint64_t bestHash = ~uint64_t(0);
+	uint64_t batchCount = 0;
+	bool launched = false;
+	auto last = steady_clock::now();
+
+	while (!shouldStop())
+	{
+		double kernelMs = s_settings.kernelMs * (1.0 + s_settings.kernelJitter / 100.0 * (2 * uniform(rng) - 1));
+		if (uniform(rng) < s_settings.stallRate)
+			kernelMs *= 10;
+		// a throttled card sits idle for part of the time.  a stalled run on a heavily throttled
+		// card takes seconds, so the wait is sliced up to notice new work in the meantime.
+		double duty = max(0.02, throttleToDuty(m_throttle));
+		auto wake = steady_clock::now() + microseconds((int64_t) (kernelMs * 1000 / duty));
+		for (auto now = steady_clock::now(); now < wake && !shouldStop(); now = steady_clock::now())
+			this_thread::sleep_for(min<steady_clock::duration>(wake - now, c_sleepSlice));
+		if (shouldStop())
+			break;
+
+		if (!launched)
+		{
+			WorkTrace::get().stage(WorkTrace::KernelLaunch, w.headerHash, m_index);
+			launched = true;
+		}
+
+		double hashes = max(1.0, s_settings.hashRate * 1000.0 * kernelMs);
+		if (w.exSizeBits >= 0 && !NoncePartitioner::get().claim(m_index, w.headerHash, (uint64_t) hashes, nonce))
+		{
+			// like the GPU miners, idle rather than hash nonces another device has claimed.
+			// an idle device cools down, and stops warming its neighbours.
+			while (!shouldStop())
+			{
+				this_thread::sleep_for(c_sleepSlice);
+				auto now = steady_clock::now();
+				heat(duration_cast<microseconds>(now - last).count() / 1e6, 0);
+				last = now;
+			}
+			break;
+		}
+		uint64_t first = nonce;
+		nonce += (uint64_t) hashes;
+
+		// the smallest of n uniform hashes is very nearly exponentially distributed.
+		double lowest = -log(1.0 - uniform(rng)) / hashes * 18446744073709551615.0;
+		uint64_t hash = lowest >= 18446744073709551615.0 ? ~uint64_t(0) : (uint64_t) lowest;
+		setCurrentHash(hash);
+		if (hash < bestHash)
+		{
+			bestHash = hash;
+			setBestHash(hash);
+		}
+		if (m_closeHit > 0 && hash < m_closeHit)
+		{
+			unsigned secs = duration_cast<seconds>(SteadyClock::now() - m_lastCloseHit).count();
+			m_farm->reportCloseHit(hash, secs, m_index);
+			m_lastCloseHit = SteadyClock::now();
+		}
+
+		bool solved = s_settings.solutionRate > 0 ?
+			uniform(rng) < s_settings.solutionRate / 3600.0 * kernelMs / 1000.0 :
+			hash < target;
+		if (solved)
+		{
+			Nonce n = (Nonce) (u64) (first + (uint64_t) (uniform(rng) * hashes));
+			h256 mix;
+			for (unsigned i = 0; i < 32; i += 8)
+				*(uint64_t*) (mix.data() + i) = rng();
+			submitProof(Solution{n, mix});
+		}
+
+		if (uniform(rng) < s_settings.faultRate)
+			m_farm->reportHashFault(m_index);
+
+		accumulateHashes((unsigned) hashes, batchCount++);
+
+		auto now = steady_clock::now();
+		heat(duration_cast<microseconds>(now - last).count() / 1e6, throttleToDuty(m_throttle));
+		last = now;
+	}
+}
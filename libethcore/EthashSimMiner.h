@@ -0,0 +1,89 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// a miner backed by a virtual device, for load testing the farm, throttling, thermal
+// budgeting and RPC code with any number of devices on a plain box.  nothing is hashed.
+// each "kernel run" sleeps for the configured kernel time (stretched by the throttle),
+// and then draws the outcome the run would have had at the configured hash rate:
+//
+//	- the smallest of n uniformly distributed hashes, which drives best hash, close hits
+//	  and solutions (or solutions come at a fixed rate, if SolutionRate is set).  the
+//	  solutions won't verify, of course, so a pool or node will count them as invalid.
+//	- hash faults, and stalled kernel runs, at the configured rates.
+//
+// each device has a SimulatedThermalDevice, heated by its own duty cycle and its
+// neighbours'.  the readings are published through simReading(), which the "sim" sensor
+// provider serves to the rest of the program.
+
+#include <vector>
+#include <libdevcore/Worker.h>
+#include <libdevcore/Guards.h>
+#include "EthashAux.h"
+#include "Miner.h"
+#include "ThermalBudget.h"
+
+namespace dev
+{
+namespace eth
+{
+
+class EthashSimMiner: public GenericMiner<EthashProofOfWork>, Worker
+{
+public:
+	struct Settings
+	{
+		unsigned devices = 16;
+		double hashRate = 30;			// MH/s per device at zero throttle
+		unsigned kernelMs = 20;			// time per kernel run
+		unsigned kernelJitter = 10;		// +/- percent
+		double stallRate = 0;			// fraction of kernel runs that take 10 times as long
+		double faultRate = 0;			// fraction of kernel runs that report a hash fault
+		double solutionRate = 0;		// solutions per device per hour.  0 = as the boundary implies
+	};
+
+	EthashSimMiner(Farm* _farm, unsigned _index);
+	~EthashSimMiner();
+
+	static void configure(Settings const& _settings);
+	static unsigned instances() { return s_settings.devices; }
+	static std::string platformInfo();
+	static void listDevices();
+
+	// temperature and power of a device, or false if there's no such device.
+	static bool simReading(unsigned _device, double& _temp, int& _power);
+
+	void setThrottle(int _percent) override { m_throttle = min(100, max(0, _percent)); }
+
+protected:
+	void kickOff() override;
+	void pause() override;
+
+private:
+	void workLoop() override;
+	// advance the thermal model of this device by _seconds, spent at _duty.
+	void heat(double _seconds, double _duty);
+
+	static Settings s_settings;
+	static Mutex x_thermal;
+	static std::vector<SimulatedThermalDevice> s_thermal;
+};
+
+}
+}
@@ -29,6 +29,9 @@
 #include <libethcore/Common.h>
 #include <libethcore/Miner.h>
 #include <libethcore/BlockInfo.h>
+#include <libethcore/ThermalBudget.h>
+#include <libethcore/NoncePartitioner.h>
+#include <libethcore/EpochManager.h>
 #include <ethminer/DataLogger.h>
 #include <ethminer/MultiLog.h>
 
@@ -42,6 +45,9 @@ namespace eth
 	// pause mining after this number of retries (lost comm with node)
 	unsigned const c_StopWorkAt = 4;
 
+	// milliseconds between runs of the farm level thermal budget optimizer.
+	unsigned const c_thermalBudgetRate = 2000;
+
 
 
 /*-----------------------------------------------------------------------------------
@@ -200,13 +206,20 @@ public:
 	void setWork(WorkPackage const& _wp)
 	{
 		LogF << "Trace: GenericFarm::setWork";
+		if (_wp)
+		{
+			WorkTrace::get().stage(WorkTrace::FarmSetWork, _wp.headerHash);
+			EpochManager::get().setCurrent(_wp.seedHash);
+		}
 		if (m_onSetWork)
 			m_onSetWork(upper64OfHash(_wp.boundary));
 
 		WriteGuard l(x_minerWork);
-		if (_wp.headerHash == m_work.headerHash && _wp.startNonce == m_work.startNonce)
+		// the same job with a different nonce range (a proxy narrowing our partition) is new work.
+		if (_wp.headerHash == m_work.headerHash && _wp.startNonce == m_work.startNonce && _wp.exSizeBits == m_work.exSizeBits)
 			return;
 		m_work = _wp;
+		resetPartitions();
 		for (auto const& m: m_miners)
 			m->setWork(m_work);
 	}	
@@ -225,9 +238,12 @@ public:
 		m_bestHash = logger.retrieveBestHash();
 		m_hashRates->init();
 		// can't call setWork until we've initialized the hash rates
+		resetPartitions();
 		for (auto const& m : m_miners)
 			m->setWork(m_work);
 
+		startThermalBudget();
+
 		LogF << "Trace: GenericFarm.start [exit]";
 	}
 
@@ -238,6 +254,8 @@ public:
 	void stop()
 	{
 		LogF << "Trace: GenericFarm.stop";
+		if (m_thermalTimer)
+			m_thermalTimer->stop();
 		WriteGuard l(x_minerWork);
 		m_miners.clear();
 		m_work.reset();
@@ -467,6 +485,11 @@ public:
 			else
 				m_solutionStats.rejected();
 		}
+		else if (_state == SolutionState::Unsent)
+		{
+			LogB << ":-| Could not be delivered.";
+			m_solutionStats.unsent();
+		}
 		else
 		{
 			LogB << "FAILURE: GPU gave incorrect result!";
@@ -617,6 +640,12 @@ public:
 	{
 		for (auto const& m : m_miners)
 			m->thermalProtection(_neverExceed, _safetyShutdown);
+		{
+			Guard l(x_thermal);
+			ThermalBudget b = m_thermalOptimizer.budget();
+			b.maxTemp = _neverExceed;
+			m_thermalOptimizer.setBudget(b);
+		}
 		// persist these settings to disk.
 		ProgOpt::beginUpdating();
 		ProgOpt::Put("ThermalProtection", "ThrottleTemp", _neverExceed);
@@ -632,9 +661,85 @@ public:
 		m_miners.at(_gpu)->tunePIDController(_kp, _ki, _kd);
 	}
 
+	/*-----------------------------------------------------------------------------------
+	* resetPartitions
+	*----------------------------------------------------------------------------------*/
+	void resetPartitions()
+	{
+		// split the new job's nonce space in proportion to the hash rates.  x_minerWork is held.
+		std::vector<double> weights;
+		for (std::size_t i = 0; i < m_miners.size(); i++)
+			weights.push_back(m_hashRates->minerRate(i));
+		NoncePartitioner::get().reset(m_work.headerHash, m_work.startNonce, m_work.exSizeBits, weights);
+	}
+
+	/*-----------------------------------------------------------------------------------
+	* startThermalBudget
+	*----------------------------------------------------------------------------------*/
+	void startThermalBudget()
+	{
+		// with ThrottleMode=farm, throttling is coordinated across all GPUs so the rig as a
+		// whole stays within its temperature / power budget, instead of each GPU's PID
+		// controller looking after itself.  the PID controllers still watch for thermal runaway.
+		std::string mode = ProgOpt::Get("ThermalProtection", "ThrottleMode", "device");
+		bool farm = LowerCase(mode) == "farm";
+		for (auto const& m : m_miners)
+			m->setFarmThermalControl(farm);
+		if (!farm)
+			return;
+
+		ThermalBudget b;
+		b.maxTemp = strToInt(ProgOpt::Get("ThermalProtection", "ThrottleTemp", "80"), 80);
+		b.rigPower = strToInt(ProgOpt::Get("ThermalProtection", "RigPowerBudget", "0"), 0);
+		b.rigTemp = strToInt(ProgOpt::Get("ThermalProtection", "RigTempBudget", "0"), 0);
+		{
+			Guard l(x_thermal);
+			m_thermalOptimizer.setBudget(b);
+		}
+		LogB << "Farm thermal budget : max temp = " << b.maxTemp << ", rig power = " << b.rigPower << ", rig temp = " << b.rigTemp;
+
+		TimerCallback::Init();
+		if (!m_thermalTimer)
+			m_thermalTimer.reset(new TimerCallback(bind(&GenericFarm::balanceThermals, this, _1)));
+		m_thermalTimer->start(c_thermalBudgetRate);
+	}
+
+	/*-----------------------------------------------------------------------------------
+	* balanceThermals
+	*----------------------------------------------------------------------------------*/
+	void balanceThermals(void* _unused)
+	{
+		ReadGuard l(x_minerWork);
+		if (m_miners.empty())
+			return;
+
+		std::vector<ThermalObservation> obs(m_miners.size());
+		for (unsigned i = 0; i < m_miners.size(); i++)
+		{
+			obs[i].temp = m_miners[i]->gpuTemp();
+			obs[i].power = m_miners[i]->powerDraw();
+			obs[i].hashRate = m_hashRates->minerRate(i);
+			obs[i].throttle = m_miners[i]->throttle();
+		}
+
+		Guard g(x_thermal);
+		m_thermalOptimizer.observe(obs);
+		std::vector<int> throttles = m_thermalOptimizer.allocate();
+		std::string sep, s;
+		for (unsigned i = 0; i < m_miners.size(); i++)
+		{
+			if (throttles[i] != obs[i].throttle)
+				m_miners[i]->setThrottle(throttles[i]);
+			s += sep + toString(throttles[i]) + "% @ " + toString(obs[i].temp);
+			sep = ", ";
+		}
+		LogF << "ThermalBudget: [" << s << "], predicted rate = " << m_thermalOptimizer.predictedHashRate();
+	}
+
 	/**
 	 * @brief Called from a Miner to note a WorkPackage has a solution.
-	 * @return true if the solution was good and the Farm should pause until more work is submitted.
+	 * @return always false.  miners carry on with the current work package until the node
+	 * or pool delivers new work.
 	 */
 	 /*-----------------------------------------------------------------------------------
 	 * submitProof
@@ -642,21 +747,13 @@ public:
 	bool submitProof(Solution const& _s, Miner* _m)
 	{
 		// a miner is notifying us it found a solution.  we in turn notify the main loop 
-		// (typically a lambda expression) which submits the solution to the node. the main
-		// loop will call us back on solutionFound to let us know if the solution was accepted.
+		// (typically a lambda expression) which queues the solution for submission to the 
+		// node. the main loop will call us back on solutionFound to let us know if the 
+		// solution was accepted.  we used to pause all the other miners here until the
+		// node responded, but that just throws away hash rate for a full round trip.
 		LogF << "Trace: GenericFarm.submitProof";
-		if (m_onSolutionFound && m_onSolutionFound(_s, _m->index()))
-		{
-			if (x_minerWork.try_lock())
-			{
-				for (auto const& m : m_miners)
-					if (m != _m)
-						m->setWork();
-				m_work.reset();
-				x_minerWork.unlock();
-				return true;
-			}
-		}
+		if (m_onSolutionFound)
+			m_onSolutionFound(_s, _m ? _m->index() : -1);
 		return false;
 	}
 
@@ -704,6 +801,11 @@ private:
 	unsigned m_closeHits = 0;
 	// this includes work units
 	uint64_t m_lastCloseHit;
+
+	// farm level throttling (ThrottleMode=farm)
+	ThermalBudgetOptimizer m_thermalOptimizer;
+	std::unique_ptr<TimerCallback> m_thermalTimer;
+	Mutex x_thermal;
 }; 
 
 }
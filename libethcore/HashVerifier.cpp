@@ -0,0 +1,141 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HashVerifier.h"
+
+#include <algorithm>
+#include <libdevcore/Log.h>
+#include "EthashAux.h"
+#include "VerificationEngine.h"
+#include "ethminer/ProgOpt.h"
+#include "ethminer/MultiLog.h"
+#include "ethminer/Common.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+	// number of consecutive clean verifications before a device that faulted has its
+	// sampling interval doubled (up to the configured value).
+	unsigned const c_cleanToRelax = 32;
+}
+
+
+HashVerifier& HashVerifier::get()
+{
+	static HashVerifier s_verifier(
+		max(1, strToInt(ProgOpt::Get("HashFaults", "SampleInterval", "4"), 4)),
+		max(1, strToInt(ProgOpt::Get("HashFaults", "QueueSize", "256"), 256))
+	);
+	return s_verifier;
+}
+
+HashVerifier::HashVerifier(unsigned _interval, unsigned _queueSize):
+	m_interval(_interval), m_queueSize(_queueSize), m_handlers(c_maxDevices)
+{
+	LogF << "HashVerifier : interval = " << _interval << ", queue = " << _queueSize;
+	for (auto& d : m_devices)
+		d.interval = m_interval;
+	// the engine has to outlive us, since it calls back with the samples still pending.
+	VerificationEngine::get();
+}
+
+HashVerifier::~HashVerifier()
+{
+	while (m_pending)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void HashVerifier::setFaultHandler(unsigned _device, FaultFn const& _f)
+{
+	if (_device >= c_maxDevices)
+		return;
+	Guard l(x_handlers);
+	m_handlers[_device] = _f;
+}
+
+bool HashVerifier::offer(unsigned _device, h256 const& _seed, h256 const& _header, uint64_t _nonce, uint64_t _hash)
+{
+	if (_device >= c_maxDevices)
+		return false;
+	Device& d = m_devices[_device];
+	if (d.offered++ % d.interval != 0)
+		return false;
+
+	// bounded, so a backlog of samples can't hold up the solutions and shares the engine
+	// verifies as well.
+	if (m_pending++ >= m_queueSize)
+	{
+		m_pending--;
+		d.dropped++;
+		return false;
+	}
+	Sample s{_device, _seed, _header, _nonce, _hash};
+	VerificationEngine::get().verify({_seed, _header, (Nonce) (u64) _nonce, h256()}, [this, s] (VerificationEngine::Result const& _r) {
+		// a result the engine couldn't evaluate (see VerificationEngine::evaluate) says
+		// nothing about the device.
+		if (_r.value != ~h256() || _r.mixHash)
+			verified(s, upper64OfHash(_r.value) == s.hash);
+		m_pending--;
+	});
+	return true;
+}
+
+HashVerifier::DeviceStats HashVerifier::stats(unsigned _device) const
+{
+	DeviceStats s;
+	if (_device < c_maxDevices)
+	{
+		Device const& d = m_devices[_device];
+		s.offered = d.offered;
+		s.verified = d.verified;
+		s.faults = d.faults;
+		s.dropped = d.dropped;
+		s.interval = d.interval;
+	}
+	return s;
+}
+
+void HashVerifier::verified(Sample const& _s, bool _ok)
+{
+	Device& d = m_devices[_s.device];
+	d.verified++;
+	if (_ok)
+	{
+		unsigned interval = d.interval;
+		if (interval < m_interval && ++d.clean >= c_cleanToRelax)
+		{
+			d.interval = min(m_interval, interval * 2);
+			d.clean = 0;
+			LogF << "HashVerifier : device " << _s.device << " sampling interval relaxed to " << d.interval;
+		}
+		return;
+	}
+
+	// the device is misbehaving.  watch every sample until it settles down.
+	d.faults++;
+	d.clean = 0;
+	d.interval = 1;
+
+	// called with the lock held, so a miner that unregisters itself can't be called back
+	// after it has gone away.
+	Guard l(x_handlers);
+	if (m_handlers[_s.device])
+		m_handlers[_s.device](_s.nonce, _s.header);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// double checks hashes reported by the GPUs.  the GPU feeder threads hand over (nonce,
+// header, claimed hash) samples and carry on immediately; the samples are hashed by the
+// VerificationEngine, alongside the solutions and shares it checks, and any mismatch is
+// reported to the device that produced it.
+//
+// sampling is adaptive.  each device verifies one in every 'interval' samples offered.
+// as soon as a device faults, it drops to verifying every sample, and it gradually works
+// its way back up to the configured interval once it has been clean for a while.
+
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+class HashVerifier
+{
+public:
+	using FaultFn = std::function<void(uint64_t _nonce, h256 const& _header)>;
+
+	struct DeviceStats
+	{
+		uint64_t offered = 0;
+		uint64_t verified = 0;
+		uint64_t faults = 0;
+		uint64_t dropped = 0;		// samples thrown away because too many were waiting
+		unsigned interval = 0;
+	};
+
+	enum { c_maxDevices = 256 };
+
+	// the shared instance, configured from the [HashFaults] section of the INI file.
+	static HashVerifier& get();
+
+	HashVerifier(unsigned _interval, unsigned _queueSize);
+	~HashVerifier();
+
+	// faults found on _device are reported here.  pass an empty function to unregister.
+	void setFaultHandler(unsigned _device, FaultFn const& _f);
+
+	// called from the GPU feeder threads.  never blocks on verification work.  returns
+	// true if the sample was queued.
+	bool offer(unsigned _device, h256 const& _seed, h256 const& _header, uint64_t _nonce, uint64_t _hash);
+
+	DeviceStats stats(unsigned _device) const;
+
+private:
+	struct Sample
+	{
+		unsigned device;
+		h256 seed;
+		h256 header;
+		uint64_t nonce;
+		uint64_t hash;
+	};
+
+	struct Device
+	{
+		std::atomic<uint64_t> offered = {0};
+		std::atomic<uint64_t> verified = {0};
+		std::atomic<uint64_t> faults = {0};
+		std::atomic<uint64_t> dropped = {0};
+		std::atomic<unsigned> interval = {1};
+		std::atomic<unsigned> clean = {0};	// consecutive clean verifications
+	};
+
+	void verified(Sample const& _s, bool _ok);
+
+	unsigned m_interval;
+	unsigned m_queueSize;
+
+	Device m_devices[c_maxDevices];
+	Mutex x_handlers;
+	std::vector<FaultFn> m_handlers;
+
+	// samples handed to the engine and not verified yet.
+	std::atomic<unsigned> m_pending = {0};
+};
+
+}
+}
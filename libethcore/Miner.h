@@ -33,10 +33,8 @@
 #include <ethminer/Common.h>
 #include <boost/multiprecision/cpp_dec_float.hpp>
 #include <ethminer/MultiLog.h>
-#include <ethminer/ADLUtils.h>
-#ifdef _WIN32
-#include <ethminer/speedfan.h>
-#endif
+#include <ethminer/SensorSampler.h>
+#include <libethcore/WorkTrace.h>
 #include "ethminer/ProgOpt.h"
 #include "ethminer/Misc.h"
 
@@ -53,9 +51,6 @@
 #define STRATUM_PROTOCOL_ETHPROXY		 1
 #define STRATUM_PROTOCOL_ETHEREUMSTRATUM 2
 
-#define TEMP_SOURCE_AMD			"amd_adl"
-#define TEMP_SOURCE_SPEEDFAN	"speedfan"
-
 
 using namespace std;
 
@@ -78,14 +73,16 @@ enum class MinerType
 	CPU,
 	CL,
 	CUDA,
-	Mixed
+	Mixed,
+	Sim
 };
 
 enum SolutionState
 {
 	Accepted = 1,
 	Rejected = 2,
-	Failed = 3
+	Failed = 3,
+	Unsent = 4		// valid, but the pool or node couldn't be reached to take it
 };
 
 
@@ -98,22 +95,25 @@ public:
 	void accepted() { accepts++;  }
 	void rejected() { rejects++;  }
 	void failed()   { failures++; }
+	void unsent()   { unsents++;  }
 
 	void acceptedStale() { acceptedStales++; }
 	void rejectedStale() { rejectedStales++; }
 
 
-	void reset() { accepts = rejects = failures = acceptedStales = rejectedStales = 0; }
+	void reset() { accepts = rejects = failures = unsents = acceptedStales = rejectedStales = 0; }
 
 	unsigned getAccepts()			{ return accepts; }
 	unsigned getRejects()			{ return rejects; }
 	unsigned getFailures()			{ return failures; }
+	unsigned getUnsent()			{ return unsents; }
 	unsigned getAcceptedStales()	{ return acceptedStales; }
 	unsigned getRejectedStales()	{ return rejectedStales; }
 private:
 	unsigned accepts  = 0;
 	unsigned rejects  = 0;
 	unsigned failures = 0; 
+	unsigned unsents = 0;
 
 	unsigned acceptedStales = 0;
 	unsigned rejectedStales = 0;
@@ -124,7 +124,10 @@ private:
 
 inline std::ostream& operator<<(std::ostream& os, SolutionStats s)
 {
-	return os << "[A" << s.getAccepts() << "+" << s.getAcceptedStales() << ":R" << s.getRejects() << "+" << s.getRejectedStales() << ":F" << s.getFailures() << "]";
+	os << "[A" << s.getAccepts() << "+" << s.getAcceptedStales() << ":R" << s.getRejects() << "+" << s.getRejectedStales() << ":F" << s.getFailures();
+	if (s.getUnsent())
+		os << ":U" << s.getUnsent();
+	return os << "]";
 }
 
 
@@ -189,6 +192,10 @@ public:
 		else
 			m_thermalRunaway = std::max(0, m_thermalRunaway - int(c_updateRate * 0.75));
 
+		// the farm is handing out throttle settings.  we're only here as a safety net.
+		if (farmManaged)
+			return;
+
 		// PID calculations
 		double error = gpuTemp - setPoint;
 		m_iTerm += Ki * (error * m_lastUpdate.elapsedSeconds());
@@ -217,6 +224,7 @@ public:
 
 	double setPoint;		// set to negative to disable PIDController
 	int shutDownTime;		// number of seconds thermal runaway will be tolerated until we shut down.
+	bool farmManaged = false;	// throttling is done by the farm. only watch for thermal runaway.
 	double Kp = 8;
 	double Ki = 4;
 	double Kd = 1;
@@ -250,9 +258,9 @@ public:
 
 
 	GenericMiner(Farm* _farm, unsigned _index):
-		m_farm(_farm), m_index(_index), m_pidController(*this)
+		m_farm(_farm), m_index(_index), m_device(_index), m_pidController(*this)
 	{
-		m_tempSource = ProgOpt::Get("ThermalProtection", "TempProvider", "amd_adl");
+		m_tempSource = ProgOpt::Get("ThermalProtection", "TempProvider", TEMP_SOURCE_AMD);
 		LowerCase(m_tempSource);
 	}
 
@@ -272,6 +280,7 @@ public:
 		{
 			DEV_TIMED_ABOVE("pause", 250)
 				pause();
+			WorkTrace::get().stage(WorkTrace::MinerRestart, _work.headerHash, m_index);
 			DEV_TIMED_ABOVE("kickOff", 250)
 				kickOff();
 		}
@@ -368,20 +377,10 @@ public:
 		return m_throttle; 
 	}
 
+	// sensor values come from the background sampler's cache, so these are cheap to call.
 	double gpuTemp(void)
 	{
-		if (m_tempSource == TEMP_SOURCE_SPEEDFAN)
-		{
-			#ifdef _WIN32
-			std::vector<double> data;
-			g_SpeedFan.getData(data, SpeedFan::Temperatures, m_index + 1);
-			return data.size() > m_index ? data[m_index] : 0;
-			#else
-			return 0;
-			#endif
-		}
-		else
-			return g_ADLUtils.getTemps(m_device);
+		return g_sensors.temperature(sensorIndex());
 	}
 
 	void thermalProtection(int _maxTemp, double _shutdown)
@@ -395,9 +394,20 @@ public:
 		m_pidController.tune(_kp, _ki, _kd);
 	}
 
+	// hand throttling over to the farm's thermal budget optimizer.
+	void setFarmThermalControl(bool _farm)
+	{
+		m_pidController.farmManaged = _farm;
+	}
+
 	int fanSpeed(void)
 	{
-		return g_ADLUtils.getFanSpeed(m_device);
+		return g_sensors.fanSpeed(sensorIndex());
+	}
+
+	int powerDraw(void)
+	{
+		return g_sensors.power(sensorIndex());
 	}
 
 	/**
@@ -494,7 +504,8 @@ protected:
 	/**
 	 * @brief Notes that the Miner found a solution.
 	 * @param _s The solution.
-	 * @return true if the solution was correct and that the miner should pause.
+	 * @return true if the miner should pause.  the farm doesn't ask for this anymore, it
+	 * keeps mining the current work package while the solution is being submitted.
 	 */
 	bool submitProof(Solution const& _s)
 	{
@@ -528,6 +539,12 @@ protected:
 
 private:
 
+	// speedfan numbers its sensors by miner index, the drivers by device id.
+	unsigned sensorIndex() const
+	{
+		return m_tempSource == TEMP_SOURCE_SPEEDFAN ? m_index : m_device;
+	}
+
 	mutable SharedMutex x_hashRates;
 	EMA m_hashRate = EMA(4);
 	// start time of hash rate accumulation period
@@ -0,0 +1,120 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "NoncePartitioner.h"
+
+#include "ethminer/MultiLog.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+
+/*-----------------------------------------------------------------------------------
+* class NoncePartitioner
+*----------------------------------------------------------------------------------*/
+NoncePartitioner& NoncePartitioner::get()
+{
+	static NoncePartitioner s_partitioner;
+	return s_partitioner;
+}
+
+void NoncePartitioner::reset(h256 const& _header, uint64_t _startNonce, int _exSizeBits, std::vector<double> const& _weights)
+{
+	Guard l(x_ranges);
+	m_header = _header;
+	m_ranges.clear();
+	if (_exSizeBits < 0 || _exSizeBits >= 64 || _weights.empty())
+		return;
+
+	// the free part of the nonce.  with no extranonce at all it's the whole 64 bits, less one.
+	uint64_t span = _exSizeBits == 0 ? ~uint64_t(0) : (uint64_t(1) << (64 - _exSizeBits)) - 1;
+	m_base = _startNonce & ~span;
+
+	// devices without a rate yet (just started, or fully throttled) get the average share.
+	double total = 0;
+	unsigned rated = 0;
+	for (double w: _weights)
+		if (w > 0)
+		{
+			total += w;
+			rated++;
+		}
+	double average = rated ? total / rated : 1;
+	vector<double> weights(_weights);
+	total = 0;
+	for (double& w: weights)
+	{
+		if (w <= 0)
+			w = average;
+		total += w;
+	}
+
+	m_ranges.resize(weights.size());
+	long double cumulative = 0;
+	uint64_t begin = 0;
+	for (unsigned i = 0; i < weights.size(); i++)
+	{
+		cumulative += weights[i];
+		uint64_t end = i + 1 == weights.size() ? span : (uint64_t) (span * (cumulative / total));
+		m_ranges[i].next = begin;
+		m_ranges[i].end = max(begin, end);
+		begin = m_ranges[i].end;
+	}
+}
+
+bool NoncePartitioner::claim(unsigned _device, h256 const& _header, uint64_t _count, uint64_t& _start)
+{
+	Guard l(x_ranges);
+	if (_header != m_header || _device >= m_ranges.size() || _count == 0)
+		return false;
+
+	Range& r = m_ranges[_device];
+	if (r.end - r.next < _count)
+	{
+		// our own range is used up, so take over the back half of the biggest one left.
+		unsigned victim = 0;
+		for (unsigned i = 1; i < m_ranges.size(); i++)
+			if (m_ranges[i].end - m_ranges[i].next > m_ranges[victim].end - m_ranges[victim].next)
+				victim = i;
+		Range& v = m_ranges[victim];
+		uint64_t left = v.end - v.next;
+		if (left < _count)
+			return false;
+		uint64_t split = left < 2 * _count ? v.next : v.next + left / 2;
+		if (victim != _device)
+		{
+			r.next = split;
+			r.end = v.end;
+			v.end = split;
+			m_steals++;
+			LogF << "NoncePartitioner: device " << _device << " took " << (r.end - r.next) << " nonces from device " << victim;
+		}
+	}
+
+	_start = m_base + r.next;
+	r.next += _count;
+	return true;
+}
+
+uint64_t NoncePartitioner::remaining(unsigned _device)
+{
+	Guard l(x_ranges);
+	if (_device >= m_ranges.size())
+		return 0;
+	return m_ranges[_device].end - m_ranges[_device].next;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// splits the nonce space of a stratum job between the devices.  the pool owns the top
+// exSizeBits of the nonce (the extranonce, which can be any width), and everything below
+// that is ours.  each new job divides our part into one contiguous range per device, sized
+// in proportion to the device's measured hash rate, so a mixed rig runs out of nonces
+// at roughly the same time on every card.
+//
+// the devices claim their nonces a kernel run at a time.  when a device has used up its
+// own range (because it's faster than its rate said, or the space is small) it steals
+// the back half of whichever range has the most left.
+//
+// there's no limit on the number of devices, other than each needing at least a few
+// kernel runs worth of nonces.
+
+#include <vector>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+
+namespace dev
+{
+namespace eth
+{
+
+class NoncePartitioner
+{
+public:
+	// the shared instance, reset by the farm with every new work package.
+	static NoncePartitioner& get();
+
+	// a new job.  _weights has one entry (usually the hash rate) per device.  a negative
+	// _exSizeBits means there's no extranonce partitioning at all, and every claim fails.
+	void reset(h256 const& _header, uint64_t _startNonce, int _exSizeBits, std::vector<double> const& _weights);
+
+	// claims the next _count nonces for _device and returns the first one in _start.
+	// returns false, leaving _start alone, if _header is no longer the current job or
+	// there's nothing left to claim.
+	bool claim(unsigned _device, h256 const& _header, uint64_t _count, uint64_t& _start);
+
+	// nonces not yet claimed in _device's range.
+	uint64_t remaining(unsigned _device);
+	unsigned steals() { Guard l(x_ranges); return m_steals; }
+
+private:
+	NoncePartitioner() {}
+
+	struct Range
+	{
+		uint64_t next = 0;		// offsets from m_base
+		uint64_t end = 0;
+	};
+
+	Mutex x_ranges;
+	h256 m_header;
+	uint64_t m_base = 0;
+	std::vector<Range> m_ranges;
+	unsigned m_steals = 0;
+};
+
+}
+}
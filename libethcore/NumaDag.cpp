@@ -0,0 +1,272 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "NumaDag.h"
+
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <libethash/ethash.h>
+#include "Exceptions.h"
+#include "ethminer/MultiLog.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+using namespace std;
+using namespace std::chrono;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+// linux numbers its nodes from 0, but they don't have to be contiguous.
+unsigned const c_maxNodes = 256;
+unsigned const c_rateLogInterval = 60;		// seconds
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class NumaTopology
+*----------------------------------------------------------------------------------*/
+vector<NumaTopology::Node> const& NumaTopology::nodes()
+{
+	static vector<Node> s_nodes = detect();
+	return s_nodes;
+}
+
+vector<NumaTopology::Node> NumaTopology::detect()
+{
+	vector<Node> nodes;
+#if defined(_WIN32)
+	ULONG highest = 0;
+	if (GetNumaHighestNodeNumber(&highest))
+		for (ULONG n = 0; n <= highest; n++)
+		{
+			ULONGLONG mask = 0;
+			if (!GetNumaNodeProcessorMask((UCHAR) n, &mask) || !mask)
+				continue;
+			Node node{(unsigned) n, {}};
+			for (unsigned cpu = 0; cpu < 64; cpu++)
+				if (mask & (1ull << cpu))
+					node.cpus.push_back(cpu);
+			nodes.push_back(node);
+		}
+#elif defined(__linux__)
+	for (unsigned n = 0; n < c_maxNodes; n++)
+	{
+		ifstream f("/sys/devices/system/node/node" + toString(n) + "/cpulist");
+		string list;
+		if (!f || !getline(f, list))
+			continue;
+		Node node{n, parseCpuList(list)};
+		if (!node.cpus.empty())
+			nodes.push_back(node);
+	}
+#endif
+	if (nodes.empty())
+	{
+		Node node{0, {}};
+		for (unsigned cpu = 0; cpu < max(1u, thread::hardware_concurrency()); cpu++)
+			node.cpus.push_back(cpu);
+		nodes.push_back(node);
+	}
+	return nodes;
+}
+
+vector<unsigned> NumaTopology::parseCpuList(string const& _list)
+{
+	vector<unsigned> cpus;
+	stringstream ss(_list);
+	string range;
+	while (getline(ss, range, ','))
+	{
+		unsigned first, last;
+		size_t dash = range.find('-');
+		try
+		{
+			first = stoul(range.substr(0, dash));
+			last = dash == string::npos ? first : stoul(range.substr(dash + 1));
+		}
+		catch (...)
+		{
+			continue;
+		}
+		for (unsigned cpu = first; cpu <= last; cpu++)
+			cpus.push_back(cpu);
+	}
+	return cpus;
+}
+
+void NumaTopology::placeThread(unsigned _index, unsigned& _node, unsigned& _cpu)
+{
+	auto const& n = nodes();
+	_node = _index % n.size();
+	auto const& cpus = n[_node].cpus;
+	_cpu = cpus[(_index / n.size()) % cpus.size()];
+}
+
+bool NumaTopology::pin(unsigned _cpu)
+{
+#if defined(_WIN32)
+	if (_cpu >= 64)
+		return false;
+	return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << _cpu) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(_cpu, &set);
+	return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+	(void) _cpu;
+	return false;
+#endif
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class NumaDag
+*----------------------------------------------------------------------------------*/
+NumaDag& NumaDag::get()
+{
+	static NumaDag s_dag;
+	return s_dag;
+}
+
+NumaDag::NumaDag()
+{
+	m_hashes.assign(NumaTopology::nodes().size(), 0);
+	m_since = steady_clock::now();
+}
+
+EthashProofOfWork::Result NumaDag::Replica::compute(h256 const& _headerHash, Nonce const& _nonce) const
+{
+	ethash_return_value_t r = ethash_full_compute_data(data, size, *(ethash_h256_t*)_headerHash.data(), (uint64_t)(u64)_nonce);
+	if (!r.success)
+		BOOST_THROW_EXCEPTION(DAGCreationFailure());
+	return EthashProofOfWork::Result{h256((uint8_t*)&r.result, h256::ConstructFromPointer), h256((uint8_t*)&r.mix_hash, h256::ConstructFromPointer)};
+}
+
+void NumaDag::Replica::computeBatch(h256 const& _headerHash, uint64_t const* _nonces, unsigned _count, EthashProofOfWork::Result* _results) const
+{
+	ethash_return_value_t r[ETHASH_MAX_INTERLEAVE];
+	for (unsigned base = 0; base < _count; base += ETHASH_MAX_INTERLEAVE)
+	{
+		unsigned n = min(_count - base, (unsigned) ETHASH_MAX_INTERLEAVE);
+		if (!ethash_full_compute_batch(data, size, *(ethash_h256_t*)_headerHash.data(), _nonces + base, n, r))
+			BOOST_THROW_EXCEPTION(DAGCreationFailure());
+		for (unsigned i = 0; i < n; i++)
+			_results[base + i] = EthashProofOfWork::Result{h256((uint8_t*)&r[i].result, h256::ConstructFromPointer), h256((uint8_t*)&r[i].mix_hash, h256::ConstructFromPointer)};
+	}
+}
+
+NumaDag::ReplicaPtr NumaDag::wrap(EthashAux::FullType const& _full)
+{
+	if (!_full)
+		return ReplicaPtr();
+	auto r = make_shared<Replica>();
+	r->data = _full->data().data();
+	r->size = _full->data().size();
+	r->owner = _full;
+	return r;
+}
+
+NumaDag::ReplicaPtr NumaDag::replica(h256 const& _seedHash, unsigned _node)
+{
+	Guard l(x_replicas);
+	if (_seedHash != m_seedHash)
+		build(_seedHash);
+	return _node < m_replicas.size() ? m_replicas[_node] : ReplicaPtr();
+}
+
+void NumaDag::build(h256 const& _seedHash)
+{
+	// x_replicas is held, so the other miner threads wait here until we're done.
+	m_replicas.clear();
+	m_seedHash = _seedHash;
+
+	LogB << "NUMA : loading the DAG for " << _seedHash.hex().substr(0, 8);
+	EthashAux::FullType full = EthashAux::full(_seedHash, true);
+	if (!full)
+	{
+		LogB << "NUMA : DAG not available, falling back to light evaluation";
+		return;
+	}
+	bytesConstRef dag = full->data();
+
+	auto const& nodes = NumaTopology::nodes();
+	m_replicas.resize(nodes.size());
+	if (nodes.size() == 1)
+	{
+		m_replicas[0] = wrap(full);
+		return;
+	}
+
+	// fill each copy from a thread on its own node so its pages land there.
+	vector<thread> copiers;
+	for (unsigned i = 0; i < nodes.size(); i++)
+		copiers.emplace_back([&, i] () {
+			NumaTopology::pin(nodes[i].cpus.front());
+			try
+			{
+				shared_ptr<uint8_t> mem(new uint8_t[dag.size()], default_delete<uint8_t[]>());
+				memcpy(mem.get(), dag.data(), dag.size());
+				auto r = make_shared<Replica>();
+				r->data = mem.get();
+				r->size = dag.size();
+				r->owner = mem;
+				m_replicas[i] = r;
+			}
+			catch (std::bad_alloc const&)
+			{
+				LogB << "NUMA : not enough memory for a DAG copy on node " << nodes[i].id;
+			}
+		});
+	for (auto& t: copiers)
+		t.join();
+	LogB << "NUMA : DAG copied to " << nodes.size() << " nodes";
+}
+
+void NumaDag::reportHashes(unsigned _node, uint64_t _hashes)
+{
+	{
+		Guard l(x_rates);
+		if (_node < m_hashes.size())
+			m_hashes[_node] += _hashes;
+		if (steady_clock::now() - m_since < seconds(c_rateLogInterval))
+			return;
+	}
+	LogB << "NUMA hash rates : " << summary();
+}
+
+string NumaDag::summary()
+{
+	Guard l(x_rates);
+	double secs = max(1.0, duration_cast<milliseconds>(steady_clock::now() - m_since).count() / 1000.0);
+	ostringstream ss;
+	ss.precision(3);
+	auto const& nodes = NumaTopology::nodes();
+	for (unsigned i = 0; i < m_hashes.size(); i++)
+		ss << (i ? ", " : "") << "node" << nodes[i].id << " " << m_hashes[i] / secs / 1000.0 << " kH/s";
+	m_hashes.assign(m_hashes.size(), 0);
+	m_since = steady_clock::now();
+	return ss.str();
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// NUMA support for CPU mining.  on a multi-socket machine a thread reading a DAG that
+// lives on the other socket's memory runs at about half speed, so in NUMA mode each node
+// gets its own copy of the DAG, and each CPU miner thread is pinned to a core and hashes
+// against the copy on its own node.
+//
+// the copies are placed by first touch: each one is allocated and filled in by a thread
+// pinned to a core of the node it's for, so the OS puts its pages in that node's memory.
+//
+// nodes are read from /sys/devices/system/node on Linux and from the NUMA API on Windows.
+// anywhere else, or on a single socket machine, there's just the one node.
+
+#include <map>
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+#include "EthashAux.h"
+
+namespace dev
+{
+namespace eth
+{
+
+/*-----------------------------------------------------------------------------------
+* class NumaTopology
+*----------------------------------------------------------------------------------*/
+class NumaTopology
+{
+public:
+	struct Node
+	{
+		unsigned id;
+		std::vector<unsigned> cpus;
+	};
+
+	// detected on first use.  never empty.
+	static std::vector<Node> const& nodes();
+
+	// spreads CPU miner threads evenly over the nodes, then over each node's cores.
+	static void placeThread(unsigned _index, unsigned& _node, unsigned& _cpu);
+
+	// pins the calling thread to _cpu.  returns false if that isn't supported here.
+	static bool pin(unsigned _cpu);
+
+private:
+	static std::vector<Node> detect();
+	// "0-7,16-23" -> 0 .. 7, 16 .. 23
+	static std::vector<unsigned> parseCpuList(std::string const& _list);
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class NumaDag
+*----------------------------------------------------------------------------------*/
+class NumaDag
+{
+public:
+	struct Replica
+	{
+		uint8_t const* data = nullptr;
+		uint64_t size = 0;
+		// keeps data alive.  with only one node the "replica" is the DAG EthashAux loaded.
+		std::shared_ptr<void const> owner;
+		EthashProofOfWork::Result compute(h256 const& _headerHash, Nonce const& _nonce) const;
+		// hashes _count nonces with their DAG reads interleaved.  see ethash_full_compute_batch.
+		void computeBatch(h256 const& _headerHash, uint64_t const* _nonces, unsigned _count, EthashProofOfWork::Result* _results) const;
+	};
+	using ReplicaPtr = std::shared_ptr<Replica const>;
+
+	static NumaDag& get();
+
+	// a "replica" that is just the DAG EthashAux loaded, for hashing against it outside NUMA mode.
+	static ReplicaPtr wrap(EthashAux::FullType const& _full);
+
+	// the replica of _seedHash's DAG on _node.  the first call for a new epoch generates the
+	// DAG if need be and copies it to every node, which takes a while.  null if the DAG
+	// isn't available.
+	ReplicaPtr replica(h256 const& _seedHash, unsigned _node);
+
+	// hashes done by the threads on _node.  per node hash rates are logged once a minute.
+	void reportHashes(unsigned _node, uint64_t _hashes);
+	// per node hash rates since the last summary, which starts a new period.
+	std::string summary();
+
+private:
+	NumaDag();
+	void build(h256 const& _seedHash);
+
+	Mutex x_replicas;
+	h256 m_seedHash;
+	std::vector<ReplicaPtr> m_replicas;
+
+	Mutex x_rates;
+	std::vector<uint64_t> m_hashes;
+	std::chrono::steady_clock::time_point m_since;
+};
+
+}
+}
@@ -0,0 +1,310 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThermalBudget.h"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+	// forgetting factor for the least squares fits. with a 2 second update rate this
+	// gives the models a memory of roughly 15 minutes.
+	double const c_lambda = 0.995;
+
+	// keep the covariance from winding up while the inputs are not changing.
+	double const c_maxTempTrace = 300;
+	double const c_maxPowerTrace = 20000;
+
+	// number of observations before we trust a model enough to act on it.
+	unsigned const c_minSamples = 5;
+
+	// a new allocation has to beat the current one by this fraction of its hash rate.
+	double const c_hysteresis = 0.01;
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class DeviceThermalModel
+*----------------------------------------------------------------------------------*/
+DeviceThermalModel::DeviceThermalModel()
+{
+	// priors: a typical card idles around 35C, runs 40C hotter when fully loaded, and picks
+	// up a few more degrees when its neighbours are running.  the temperature moves 20% of
+	// the way towards its steady state value in each update interval.
+	double temp[] = {0.8, 7, 8, 1};
+	double tempP[] = {0.01, 0, 0, 0,   0, 25, 0, 0,   0, 0, 25, 0,   0, 0, 0, 4};
+	double power[] = {30, 150};
+	double powerP[] = {10000, 0,   0, 10000};
+	copy(temp, temp + 4, m_temp);
+	copy(tempP, tempP + 16, m_tempP);
+	copy(power, power + 2, m_power);
+	copy(powerP, powerP + 4, m_powerP);
+	fill(m_efficiency, m_efficiency + c_buckets, 1.0);
+}
+
+void DeviceThermalModel::rlsUpdate(double* _theta, double* _P, double const* _x, unsigned _n, double _y, double _lambda)
+{
+	// standard recursive least squares step.  _P is _n x _n, row major.
+	double Px[4];
+	double denom = _lambda;
+	for (unsigned i = 0; i < _n; i++)
+	{
+		Px[i] = 0;
+		for (unsigned j = 0; j < _n; j++)
+			Px[i] += _P[i * _n + j] * _x[j];
+		denom += _x[i] * Px[i];
+	}
+	double err = _y;
+	for (unsigned i = 0; i < _n; i++)
+		err -= _x[i] * _theta[i];
+	for (unsigned i = 0; i < _n; i++)
+		_theta[i] += Px[i] / denom * err;
+	// P is symmetric, so x'P == (Px)'
+	for (unsigned i = 0; i < _n; i++)
+		for (unsigned j = 0; j < _n; j++)
+			_P[i * _n + j] = (_P[i * _n + j] - Px[i] * Px[j] / denom) / _lambda;
+}
+
+void DeviceThermalModel::observe(ThermalObservation const& _o, double _othersDuty)
+{
+	double duty = throttleToDuty(_o.throttle);
+
+	if (_o.temp > 0 && m_lastTemp > 0)
+	{
+		// the duty reported with an observation is what the card has been running at since
+		// the previous observation.
+		double x[] = {m_lastTemp, 1, duty, _othersDuty};
+		rlsUpdate(m_temp, m_tempP, x, 4, _o.temp, c_lambda);
+		double trace = m_tempP[0] + m_tempP[5] + m_tempP[10] + m_tempP[15];
+		if (trace > c_maxTempTrace)
+			for (double& p : m_tempP)
+				p *= c_maxTempTrace / trace;
+	}
+	m_lastTemp = _o.temp;
+
+	if (_o.power > 0)
+	{
+		double x[] = {1, duty};
+		rlsUpdate(m_power, m_powerP, x, 2, _o.power, c_lambda);
+		double trace = m_powerP[0] + m_powerP[3];
+		if (trace > c_maxPowerTrace)
+			for (double& p : m_powerP)
+				p *= c_maxPowerTrace / trace;
+		m_hasPower = true;
+	}
+
+	if (_o.hashRate > 0 && duty >= 0.2)
+	{
+		unsigned bucket = min<unsigned>(c_buckets - 1, _o.throttle / 5);
+		if (bucket == 0)
+			m_fullRate = m_fullRate == 0 ? _o.hashRate : m_fullRate * 0.8 + _o.hashRate * 0.2;
+		else if (m_fullRate == 0)
+			m_fullRate = _o.hashRate / duty;
+		else
+			m_efficiency[bucket] = m_efficiency[bucket] * 0.8 + (_o.hashRate / (m_fullRate * duty)) * 0.2;
+	}
+	m_samples++;
+}
+
+double DeviceThermalModel::predictTemp(double _duty, double _othersDuty) const
+{
+	// convert the fitted dynamics into a steady state temperature.  a card never gets
+	// cooler by working harder, no matter what the fit says.
+	double gain = 1.0 / (1.0 - min(0.98, max(0.0, m_temp[0])));
+	double self = max(5.0, m_temp[2] * gain);
+	double shared = min(self, max(0.0, m_temp[3] * gain));
+	return m_temp[1] * gain + self * _duty + shared * _othersDuty;
+}
+
+double DeviceThermalModel::predictPower(double _duty) const
+{
+	return m_hasPower ? max(0.0, m_power[0] + max(0.0, m_power[1]) * _duty) : 0;
+}
+
+double DeviceThermalModel::predictHashRate(double _duty) const
+{
+	unsigned bucket = min<unsigned>(c_buckets - 1, dutyToThrottle(_duty) / 5);
+	// before we've seen any hash rate, rank cards purely by duty.
+	double full = m_fullRate > 0 ? m_fullRate : 1.0;
+	return full * _duty * m_efficiency[bucket];
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class ThermalBudgetOptimizer
+*----------------------------------------------------------------------------------*/
+double ThermalBudgetOptimizer::othersDuty(std::vector<double> const& _duty, unsigned _i)
+{
+	if (_duty.size() < 2)
+		return 0;
+	double sum = 0;
+	for (unsigned j = 0; j < _duty.size(); j++)
+		if (j != _i)
+			sum += _duty[j];
+	return sum / (_duty.size() - 1);
+}
+
+void ThermalBudgetOptimizer::observe(std::vector<ThermalObservation> const& _obs)
+{
+	if (m_models.size() != _obs.size())
+		m_models.assign(_obs.size(), DeviceThermalModel());
+
+	vector<double> duty;
+	for (auto const& o : _obs)
+		duty.push_back(throttleToDuty(o.throttle));
+	for (unsigned i = 0; i < _obs.size(); i++)
+		m_models[i].observe(_obs[i], othersDuty(duty, i));
+	m_last = _obs;
+}
+
+bool ThermalBudgetOptimizer::feasible(std::vector<double> const& _duty, double& _power, std::vector<double>& _temps) const
+{
+	_power = 0;
+	double tempSum = 0;
+	bool ok = true;
+	for (unsigned i = 0; i < _duty.size(); i++)
+	{
+		_temps[i] = m_models[i].predictTemp(_duty[i], othersDuty(_duty, i));
+		_power += m_models[i].predictPower(_duty[i]);
+		tempSum += _temps[i];
+		if (_temps[i] > m_budget.maxTemp - m_budget.margin)
+			ok = false;
+	}
+	if (m_budget.rigPower > 0 && _power > m_budget.rigPower)
+		ok = false;
+	if (m_budget.rigTemp > 0 && tempSum / _duty.size() > m_budget.rigTemp - m_budget.margin)
+		ok = false;
+	return ok;
+}
+
+double ThermalBudgetOptimizer::rate(std::vector<double> const& _duty) const
+{
+	double r = 0;
+	for (unsigned i = 0; i < _duty.size(); i++)
+		r += m_models[i].predictHashRate(_duty[i]);
+	return r;
+}
+
+std::vector<int> ThermalBudgetOptimizer::allocate()
+{
+	unsigned n = m_models.size();
+	vector<int> throttles;
+	for (auto const& o : m_last)
+		throttles.push_back(o.throttle);
+	if (n == 0 || m_models[0].samples() < c_minSamples)
+		return throttles;
+
+	double const step = c_step / 100.0;
+
+	// upper limit on each card's duty for this round.  we let cards ramp up gradually so
+	// the models get a chance to catch up, and anything that is actually over the limit
+	// right now gets pulled back regardless of what its model predicts.
+	vector<double> cap(n);
+	for (unsigned i = 0; i < n; i++)
+	{
+		double current = throttleToDuty(m_last[i].throttle);
+		cap[i] = min(1.0, current + 2 * step);
+		if (m_last[i].temp > m_budget.maxTemp)
+			cap[i] = max(0.0, current - step);
+	}
+
+	// greedy marginal allocation: starting from all cards idle, repeatedly give the next
+	// slice of duty to the card that buys the most hash rate per unit of the scarcest
+	// resource, until no card can be raised without breaking the budget.
+	vector<double> duty(n, 0.0);
+	vector<double> temps(n), trialTemps(n);
+	double power;
+	feasible(duty, power, temps);
+	for (;;)
+	{
+		int best = -1;
+		double bestScore = 0;
+		for (unsigned i = 0; i < n; i++)
+		{
+			if (duty[i] + step > cap[i] + 1e-9)
+				continue;
+			vector<double> trial = duty;
+			trial[i] += step;
+			double trialPower;
+			if (!feasible(trial, trialPower, trialTemps))
+				continue;
+
+			double gain = m_models[i].predictHashRate(trial[i]) - m_models[i].predictHashRate(duty[i]);
+			double cost = 1e-3;
+			if (m_budget.rigPower > 0)
+				cost = max(cost, (trialPower - power) / max(1.0, m_budget.rigPower - power));
+			for (unsigned j = 0; j < n; j++)
+			{
+				double headroom = max(0.5, m_budget.maxTemp - m_budget.margin - temps[j]);
+				cost = max(cost, (trialTemps[j] - temps[j]) / headroom);
+			}
+			double score = gain / cost;
+			if (best < 0 || score > bestScore)
+			{
+				best = i;
+				bestScore = score;
+			}
+		}
+		if (best < 0)
+			break;
+		duty[best] += step;
+		feasible(duty, power, temps);
+	}
+
+	// the greedy pass breaks ties on noise in the models, so left to itself it keeps
+	// trading throttle between cards for no gain.  stay put unless it's clearly better.
+	vector<double> current(n);
+	bool keep = true;
+	for (unsigned i = 0; i < n; i++)
+	{
+		current[i] = throttleToDuty(m_last[i].throttle);
+		keep = keep && current[i] <= cap[i] + 1e-9;
+	}
+	if (keep && feasible(current, power, temps) && rate(current) >= rate(duty) * (1 - c_hysteresis))
+		duty = current;
+
+	for (unsigned i = 0; i < n; i++)
+		throttles[i] = max(0, min(100, dutyToThrottle(duty[i])));
+	m_predictedRate = rate(duty);
+	return throttles;
+}
+
+
+/*-----------------------------------------------------------------------------------
+* struct SimulatedThermalDevice
+*----------------------------------------------------------------------------------*/
+void SimulatedThermalDevice::step(double _othersDuty, double _seconds)
+{
+	double target = ambient + selfHeat * throttleToDuty(throttle) + coupling * _othersDuty;
+	temp += (target - temp) * (1.0 - exp(-_seconds / tau));
+}
+
+ThermalObservation SimulatedThermalDevice::observation() const
+{
+	ThermalObservation o;
+	double duty = throttleToDuty(throttle);
+	o.temp = temp;
+	o.power = idlePower + loadPower * duty;
+	o.hashRate = fullRate * duty;
+	o.throttle = throttle;
+	return o;
+}
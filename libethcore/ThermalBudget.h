@@ -0,0 +1,166 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// rig-wide thermal / power budgeting.  instead of every GPU running its own PID loop
+// against ThrottleTemp, the optimizer learns a simple model of each card (how hot it runs,
+// how much it is heated by its neighbours, how much power it draws, and how its hash rate
+// responds to throttling) and hands out throttle percentages that maximize the total
+// hash rate of the rig while keeping every card below the temperature limit and the rig
+// as a whole within its power / temperature budget.
+//
+// the optimizer has no dependencies on miners or drivers: observations go in, throttle
+// percentages come out.  SimulatedThermalDevice can stand in for real hardware.
+
+#include <vector>
+
+namespace dev
+{
+namespace eth
+{
+
+// throttle is the percentage of time a GPU sits idle.  duty is the fraction of time it
+// spends hashing, ie. duty = 1 - throttle / 100.
+inline double throttleToDuty(int _throttle) { return 1.0 - _throttle / 100.0; }
+inline int dutyToThrottle(double _duty) { return int(100.0 - _duty * 100.0 + 0.5); }
+
+struct ThermalObservation
+{
+	double temp = 0;		// degrees celcius
+	double power = 0;		// watts. zero means unknown.
+	double hashRate = 0;	// MH/s
+	int throttle = 0;		// percent
+};
+
+struct ThermalBudget
+{
+	double maxTemp = 80;	// per GPU limit
+	double rigPower = 0;	// total watts. zero means no limit.
+	double rigTemp = 0;		// limit on the average GPU temperature. zero means no limit.
+	double margin = 2;		// degrees of headroom the optimizer leaves below maxTemp & rigTemp
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class DeviceThermalModel
+*----------------------------------------------------------------------------------*/
+// learned, linear model of a single GPU:
+//
+//		temp' = a * temp + (1 - a) * (base + self * duty + shared * (mean duty of the other GPUs))
+//		power = idle + load * duty
+//		hashRate = fullRate * duty * efficiency(duty)
+//
+// the temperature model is first order so that the card's thermal lag doesn't bias the
+// fit.  predictions are of the steady state (temp' == temp).  the linear parameters are
+// fitted with recursive least squares, with a forgetting factor so the model follows
+// changes in ambient temperature over the day.
+class DeviceThermalModel
+{
+public:
+	DeviceThermalModel();
+
+	void observe(ThermalObservation const& _o, double _othersDuty);
+
+	double predictTemp(double _duty, double _othersDuty) const;
+	double predictPower(double _duty) const;
+	double predictHashRate(double _duty) const;
+
+	bool hasPower() const { return m_hasPower; }
+	unsigned samples() const { return m_samples; }
+
+private:
+	enum { c_buckets = 21 };
+
+	static void rlsUpdate(double* _theta, double* _P, double const* _x, unsigned _n, double _y, double _lambda);
+
+	// temperature model: [a, (1-a)*base, (1-a)*self, (1-a)*shared] and its covariance
+	double m_temp[4];
+	double m_tempP[16];
+	double m_lastTemp = 0;
+	// power model: [idle, load]
+	double m_power[2];
+	double m_powerP[4];
+	bool m_hasPower = false;
+
+	// hash rate at 100% duty, and the measured deviation from linear per 5% throttle step.
+	double m_fullRate = 0;
+	double m_efficiency[c_buckets];
+	unsigned m_samples = 0;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class ThermalBudgetOptimizer
+*----------------------------------------------------------------------------------*/
+class ThermalBudgetOptimizer
+{
+public:
+	// granularity of throttle changes, in percent.
+	enum { c_step = 5 };
+
+	void setBudget(ThermalBudget const& _budget) { m_budget = _budget; }
+	ThermalBudget const& budget() const { return m_budget; }
+
+	// feed in the latest readings of all GPUs (one entry per GPU, always in the same order).
+	void observe(std::vector<ThermalObservation> const& _obs);
+
+	// compute new throttle percentages for all GPUs, based on what has been observed so far.
+	std::vector<int> allocate();
+
+	DeviceThermalModel const& model(unsigned _i) const { return m_models[_i]; }
+	double predictedHashRate() const { return m_predictedRate; }
+
+private:
+	bool feasible(std::vector<double> const& _duty, double& _power, std::vector<double>& _temps) const;
+	static double othersDuty(std::vector<double> const& _duty, unsigned _i);
+	// predicted hash rate of the rig at _duty.
+	double rate(std::vector<double> const& _duty) const;
+
+	ThermalBudget m_budget;
+	std::vector<DeviceThermalModel> m_models;
+	std::vector<ThermalObservation> m_last;
+	double m_predictedRate = 0;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class SimulatedThermalDevice
+*----------------------------------------------------------------------------------*/
+// first order thermal model of a GPU, for exercising the optimizer without hardware.
+// the steady state temperature is ambient + selfHeat * duty + coupling * othersDuty, and
+// the card approaches it with time constant tau.
+struct SimulatedThermalDevice
+{
+	double ambient = 30;
+	double selfHeat = 45;
+	double coupling = 8;
+	double tau = 20;			// seconds
+	double idlePower = 30;
+	double loadPower = 150;
+	double fullRate = 30;		// MH/s at zero throttle
+
+	double temp = 30;
+	int throttle = 0;
+
+	void step(double _othersDuty, double _seconds);
+	ThermalObservation observation() const;
+};
+
+}
+}
@@ -0,0 +1,253 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "VerificationEngine.h"
+
+#include <sstream>
+#include <algorithm>
+#include <libdevcore/Log.h>
+#include "NumaDag.h"
+#include "ethminer/ProgOpt.h"
+#include "ethminer/MultiLog.h"
+#include "ethminer/Common.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+
+VerificationEngine& VerificationEngine::get()
+{
+	static VerificationEngine s_engine(
+		max(1, strToInt(ProgOpt::Get("Verification", "Threads", "2"), 2)),
+		max(1, strToInt(ProgOpt::Get("Verification", "BatchSize", "64"), 64)),
+		max(1, strToInt(ProgOpt::Get("Verification", "CacheSize", "4096"), 4096))
+	);
+	return s_engine;
+}
+
+VerificationEngine::VerificationEngine(unsigned _threads, unsigned _batchSize, unsigned _cacheSize):
+	m_batchSize(_batchSize), m_cacheSize(_cacheSize)
+{
+	LogF << "VerificationEngine : threads = " << _threads << ", batch = " << _batchSize << ", cache = " << _cacheSize;
+	for (unsigned i = 0; i < _threads; i++)
+		m_threads.push_back(std::thread(&VerificationEngine::workLoop, this));
+}
+
+VerificationEngine::~VerificationEngine()
+{
+	{
+		Guard l(x_engine);
+		m_running = false;
+	}
+	m_queueChanged.notify_all();
+	for (auto& t : m_threads)
+		t.join();
+}
+
+VerificationEngine::EntryPtr VerificationEngine::lookup(Request const& _r, bool& _queued)
+{
+	m_requests++;
+	Key key(_r.seed, _r.header, (uint64_t) (u64) _r.nonce);
+	auto it = m_cache.find(key);
+	if (it != m_cache.end())
+	{
+		m_deduped++;
+		_queued = false;
+		return it->second;
+	}
+
+	EntryPtr e = make_shared<Entry>();
+	e->request = _r;
+	e->future = e->promise.get_future().share();
+	m_cache[key] = e;
+	m_cacheOrder.push_back(key);
+	// an evicted entry that's still queued is evaluated anyway; it just can't be shared any more.
+	while (m_cacheOrder.size() > m_cacheSize)
+	{
+		m_cache.erase(m_cacheOrder.front());
+		m_cacheOrder.pop_front();
+	}
+	m_queue.push_back(e);
+	_queued = true;
+	return e;
+}
+
+VerificationEngine::Future VerificationEngine::verify(Request const& _r)
+{
+	bool queued;
+	Future f;
+	DEV_GUARDED(x_engine)
+		f = lookup(_r, queued)->future;
+	if (queued)
+		m_queueChanged.notify_one();
+	return f;
+}
+
+vector<VerificationEngine::Future> VerificationEngine::verify(vector<Request> const& _batch)
+{
+	vector<Future> ret;
+	ret.reserve(_batch.size());
+	bool any = false;
+	DEV_GUARDED(x_engine)
+		for (auto const& r : _batch)
+		{
+			bool queued;
+			ret.push_back(lookup(r, queued)->future);
+			any = any || queued;
+		}
+	if (any)
+		m_queueChanged.notify_all();
+	return ret;
+}
+
+void VerificationEngine::verify(Request const& _r, Callback const& _done)
+{
+	bool queued;
+	EntryPtr e;
+	bool done;
+	{
+		Guard l(x_engine);
+		e = lookup(_r, queued);
+		done = e->done;
+		if (!done)
+			e->callbacks.push_back(_done);
+	}
+	if (queued)
+		m_queueChanged.notify_one();
+	if (done)
+		_done(e->result);
+}
+
+bool VerificationEngine::valid(Request const& _r, Result const& _result, h256 const& _boundary)
+{
+	return _result.value < _boundary && (!_r.mix || _result.mixHash == _r.mix);
+}
+
+void VerificationEngine::workLoop()
+{
+	setThreadName("verify");
+	vector<EntryPtr> batch;
+	for (;;)
+	{
+		batch.clear();
+		{
+			UniqueGuard l(x_engine);
+			m_queueChanged.wait(l, [&] () { return !m_running || !m_queue.empty(); });
+			if (!m_running)
+				return;
+			while (!m_queue.empty() && batch.size() < m_batchSize)
+			{
+				batch.push_back(m_queue.front());
+				m_queue.pop_front();
+			}
+		}
+		m_batches++;
+		evaluate(batch);
+	}
+}
+
+void VerificationEngine::evaluate(vector<EntryPtr>& _batch)
+{
+	// group the batch by epoch, and within that by header.  the DAG or light cache is
+	// looked up once per epoch, and each header's nonces are hashed together.
+	sort(_batch.begin(), _batch.end(), [] (EntryPtr const& a, EntryPtr const& b) {
+		return tie(a->request.seed, a->request.header) < tie(b->request.seed, b->request.header);
+	});
+
+	vector<uint64_t> nonces;
+	vector<Result> results;
+	auto seedStart = _batch.begin();
+	while (seedStart != _batch.end())
+	{
+		h256 seed = (*seedStart)->request.seed;
+		auto seedEnd = find_if(seedStart, _batch.end(), [&] (EntryPtr const& e) { return e->request.seed != seed; });
+		try
+		{
+			NumaDag::ReplicaPtr dag = NumaDag::wrap(EthashAux::loadedFull(seed));
+			EthashAux::LightType light;
+			if (!dag)
+				light = EthashAux::light(seed);
+			for (auto start = seedStart; start != seedEnd; )
+			{
+				h256 header = (*start)->request.header;
+				auto end = find_if(start, seedEnd, [&] (EntryPtr const& e) { return e->request.header != header; });
+				if (dag)
+				{
+					nonces.clear();
+					for (auto e = start; e != end; ++e)
+						nonces.push_back((uint64_t) (u64) (*e)->request.nonce);
+					results.resize(nonces.size());
+					dag->computeBatch(header, nonces.data(), nonces.size(), results.data());
+					m_full += nonces.size();
+					for (auto e = start; e != end; ++e)
+						complete(**e, results[e - start]);
+				}
+				else
+					for (auto e = start; e != end; ++e)
+					{
+						complete(**e, light->compute(header, (*e)->request.nonce));
+						m_light++;
+					}
+				start = end;
+			}
+		}
+		catch (std::exception const& _e)
+		{
+			// same as EthashAux::eval: a share we can't evaluate fails any boundary.
+			LogF << "VerificationEngine::evaluate : " << _e.what();
+			for (auto e = seedStart; e != seedEnd; ++e)
+				if (!(*e)->done)
+					complete(**e, Result{~h256(), h256()});
+		}
+		seedStart = seedEnd;
+	}
+}
+
+void VerificationEngine::complete(Entry& _e, Result const& _r)
+{
+	vector<Callback> callbacks;
+	{
+		Guard l(x_engine);
+		_e.done = true;
+		_e.result = _r;
+		callbacks.swap(_e.callbacks);
+	}
+	_e.promise.set_value(_r);
+	for (auto const& c : callbacks)
+		c(_r);
+}
+
+VerificationEngine::Stats VerificationEngine::stats() const
+{
+	Stats s;
+	s.requests = m_requests;
+	s.deduped = m_deduped;
+	s.full = m_full;
+	s.light = m_light;
+	s.batches = m_batches;
+	return s;
+}
+
+string VerificationEngine::summary() const
+{
+	Stats s = stats();
+	ostringstream ss;
+	ss << s.requests << " requests, " << s.deduped << " deduplicated, " << s.full << " hashed against the DAG, "
+		<< s.light << " against the light cache, " << s.batches << " batches";
+	return ss.str();
+}
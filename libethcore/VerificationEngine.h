@@ -0,0 +1,140 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// the one place shares get evaluated.  the GPU and CUDA miners, the getWork and stratum
+// submitters, the stratum proxy, the hash fault sampler and the mock pool all hand their
+// (seed, header, nonce) triples to this engine instead of calling EthashAux::eval
+// themselves.  requests can come from any thread, singly or in batches, and each one gets
+// a future for its result (or a callback, for code that mustn't block).
+//
+// a pool of threads works through the queue a batch at a time.  each batch is grouped by
+// epoch and header: if the epoch's DAG is in memory, the nonces for one header are hashed
+// against it with their DAG reads interleaved (see NumaDag::Replica::computeBatch),
+// otherwise each one is hashed against the light cache.
+//
+// the last CacheSize evaluations are remembered, and a request for one of them (or for
+// one still in the queue) shares its future instead of being hashed again.  a solution
+// found by a GPU is evaluated once in report(), and the submitter that checks it against
+// the current job a moment later gets the same result straight from the cache.
+
+#include <map>
+#include <deque>
+#include <tuple>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+#include "EthashAux.h"
+
+namespace dev
+{
+namespace eth
+{
+
+class VerificationEngine
+{
+public:
+	using Result = EthashProofOfWork::Result;
+	using Future = std::shared_future<Result>;
+	using Callback = std::function<void(Result const&)>;
+
+	struct Request
+	{
+		h256 seed;
+		h256 header;
+		Nonce nonce;
+		// the mix hash that came with the share, checked by valid().  h256() if there
+		// wasn't one.
+		h256 mix;
+	};
+
+	struct Stats
+	{
+		uint64_t requests = 0;
+		uint64_t deduped = 0;		// answered from the cache or an evaluation already queued
+		uint64_t full = 0;			// hashed against the full DAG
+		uint64_t light = 0;			// hashed against the light cache
+		uint64_t batches = 0;
+	};
+
+	// the shared instance, configured from the [Verification] section of the INI file.
+	static VerificationEngine& get();
+
+	VerificationEngine(unsigned _threads, unsigned _batchSize, unsigned _cacheSize);
+	~VerificationEngine();
+
+	Future verify(Request const& _r);
+	std::vector<Future> verify(std::vector<Request> const& _batch);
+	// _done is called with the result on one of the engine's threads, or straight away on
+	// this one if the result is already known.
+	void verify(Request const& _r, Callback const& _done);
+
+	// the share meets _boundary, and its mix hash is the one claimed (if one was).
+	static bool valid(Request const& _r, Result const& _result, h256 const& _boundary);
+
+	Stats stats() const;
+	std::string summary() const;
+
+private:
+	using Key = std::tuple<h256, h256, uint64_t>;
+
+	struct Entry
+	{
+		Request request;
+		std::promise<Result> promise;
+		Future future;
+		bool done = false;
+		Result result;
+		std::vector<Callback> callbacks;
+	};
+	using EntryPtr = std::shared_ptr<Entry>;
+
+	// the cached or queued entry for _r, or a new queued one.  call with x_engine held.
+	EntryPtr lookup(Request const& _r, bool& _queued);
+	void workLoop();
+	void evaluate(std::vector<EntryPtr>& _batch);
+	void complete(Entry& _e, Result const& _r);
+
+	unsigned m_batchSize;
+	unsigned m_cacheSize;
+
+	mutable Mutex x_engine;
+	std::condition_variable m_queueChanged;
+	std::deque<EntryPtr> m_queue;
+	std::map<Key, EntryPtr> m_cache;
+	std::deque<Key> m_cacheOrder;	// oldest first
+	bool m_running = true;
+	std::vector<std::thread> m_threads;
+
+	std::atomic<uint64_t> m_requests{0};
+	std::atomic<uint64_t> m_deduped{0};
+	std::atomic<uint64_t> m_full{0};
+	std::atomic<uint64_t> m_light{0};
+	std::atomic<uint64_t> m_batches{0};
+};
+
+}
+}
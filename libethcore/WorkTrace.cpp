@@ -0,0 +1,125 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "WorkTrace.h"
+
+#include <sstream>
+#include <libdevcore/Log.h>
+#include <libdevcore/Worker.h>
+#include "ethminer/ProgOpt.h"
+#include "ethminer/MultiLog.h"
+#include "ethminer/Common.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace dev;
+using namespace dev::eth;
+
+
+/*-----------------------------------------------------------------------------------
+* class WorkTrace
+*----------------------------------------------------------------------------------*/
+WorkTrace& WorkTrace::get()
+{
+	static WorkTrace s_trace;
+	return s_trace;
+}
+
+WorkTrace::WorkTrace()
+{
+	m_logInterval = strToInt(ProgOpt::Get("General", "LatencyLogInterval", "300"), 300);
+	m_lastLog = steady_clock::now();
+}
+
+char const* WorkTrace::stageName(Stage _s)
+{
+	switch (_s)
+	{
+	case FarmSetWork: return "farm";
+	case MinerRestart: return "restart";
+	case WorkerStart: return "worker";
+	case KernelLaunch: return "kernel";
+	default: return "?";
+	}
+}
+
+void WorkTrace::received(h256 const& _header, steady_clock::time_point _when)
+{
+	Guard l(x_trace);
+	for (auto const& j : m_jobs)
+		if (j.first == _header)
+			// a job can come from more than one place (eg. hot standby pools).  the first one counts.
+			return;
+	m_jobs.push_back(make_pair(_header, _when));
+	if (m_jobs.size() > c_recentJobs)
+		m_jobs.pop_front();
+}
+
+void WorkTrace::stage(Stage _s, h256 const& _header, int _device)
+{
+	auto now = steady_clock::now();
+	{
+		Guard l(x_trace);
+		h256& seen = m_seen[_device][_s];
+		if (seen == _header)
+			return;
+		seen = _header;
+
+		// newest jobs are at the back, and that's normally where we'll find it.
+		for (auto it = m_jobs.rbegin(); it != m_jobs.rend(); ++it)
+			if (it->first == _header)
+			{
+				m_latency[_device][_s].record(now - it->second);
+				break;
+			}
+
+		if (_s != KernelLaunch || !m_logInterval || now - m_lastLog < seconds(m_logInterval))
+			return;
+		m_lastLog = now;
+	}
+	LogF << "Job latency : " << summary();
+}
+
+vector<WorkTrace::Entry> WorkTrace::snapshot()
+{
+	vector<Entry> entries;
+	Guard l(x_trace);
+	for (auto const& d : m_latency)
+		for (unsigned s = 0; s < StageCount; s++)
+			if (d.second[s].count())
+				entries.push_back(Entry{d.first, (Stage) s, d.second[s]});
+	return entries;
+}
+
+string WorkTrace::summary()
+{
+	ostringstream ss;
+	for (auto const& e : snapshot())
+		ss << endl << "  " << (e.device < 0 ? string("farm") : "gpu" + toString(e.device)) << " " << stageName(e.stage) << " : " << e.latency.summary();
+	// how long the miners' worker threads take to acknowledge being stopped and restarted.
+	LatencyHistogram start, stop;
+	Worker::transitionLatency(start, stop);
+	if (start.count())
+		ss << endl << "  worker start : " << start.summary() << endl << "  worker stop : " << stop.summary();
+	return ss.str();
+}
+
+void WorkTrace::reset()
+{
+	Guard l(x_trace);
+	m_latency.clear();
+}
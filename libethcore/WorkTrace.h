@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// measures how long a new job takes to travel from the network to the GPUs.  the clock
+// starts when the job's bytes are received (stratum mining.notify or a getWork response),
+// and each stage of the pipeline reports when it first sees the job's header:
+//
+//	FarmSetWork		GenericFarm::setWork
+//	MinerRestart	GenericMiner::setWork, after pausing the old job, before kickOff
+//	WorkerStart		the miner's work loop picks up the new job
+//	KernelLaunch	the first kernel run with the new header has been queued
+//
+// the elapsed times go into a histogram per device and stage.
+
+#include <map>
+#include <deque>
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Histogram.h>
+
+namespace dev
+{
+namespace eth
+{
+
+class WorkTrace
+{
+public:
+	enum Stage { FarmSetWork, MinerRestart, WorkerStart, KernelLaunch, StageCount };
+
+	struct Entry
+	{
+		int device;			// -1 for farm wide stages
+		Stage stage;
+		LatencyHistogram latency;
+	};
+
+	static WorkTrace& get();
+	static char const* stageName(Stage _s);
+
+	// a job has arrived.  _when is when its bytes came off the wire.
+	void received(h256 const& _header, std::chrono::steady_clock::time_point _when);
+	void received(h256 const& _header) { received(_header, std::chrono::steady_clock::now()); }
+
+	// _header has reached stage _s on _device.  only the first report per job, stage and
+	// device counts.
+	void stage(Stage _s, h256 const& _header, int _device = -1);
+
+	std::vector<Entry> snapshot();
+	std::string summary();
+	void reset();
+
+private:
+	WorkTrace();
+
+	static const unsigned c_recentJobs = 8;
+
+	Mutex x_trace;
+	std::deque<std::pair<h256, std::chrono::steady_clock::time_point>> m_jobs;
+	std::map<int, std::array<h256, StageCount>> m_seen;
+	std::map<int, std::array<LatencyHistogram, StageCount>> m_latency;
+
+	// seconds between summaries in the log.  0 = never.
+	unsigned m_logInterval;
+	std::chrono::steady_clock::time_point m_lastLog;
+};
+
+}
+}
@@ -17,12 +17,23 @@ along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "EthStratumClient.h"
+#include "StratumParser.h"
+#include <libethcore/WorkTrace.h>
+#include <libethcore/VerificationEngine.h>
 #include <libdevcore/Log.h>
 #include <libethash/endian.h>
 using boost::asio::ip::tcp;
 
 #define BOOST_ASIO_ENABLE_CANCELIO 
 
+namespace
+{
+	// seconds allowed for resolving and connecting to the pool.
+	const int c_connectTimeout = 10;
+	// seconds we'll wait on the pool to answer a request before giving up on the connection.
+	const int c_replyTimeout = 30;
+}
+
 EthStratumClient::EthStratumClient(
 	GenericFarm<EthashProofOfWork>* f, 
 	MinerType m, 
@@ -30,9 +41,11 @@ EthStratumClient::EthStratumClient(
 	string const & port,
 	string const & password,
 	int const & retries,
-	int const & worktimeout
+	int const & worktimeout,
+	JobFn const & onJob
 )
-	: m_socket(m_io_service)
+	: m_onJob(onJob), m_resolver(m_io_service), m_socket(m_io_service), m_worktimer(m_io_service), m_reconnectTimer(m_io_service),
+	  m_connectTimer(m_io_service), m_replyTimer(m_io_service)
 {
 	// Note: host should not include the "http://" prefix.
 	m_host = host;
@@ -49,16 +62,14 @@ EthStratumClient::EthStratumClient(
 
 	p_farm = f;
 	
-	f->onSolutionFound([&] (EthashProofOfWork::Solution sol, int miner) {
-		m_solutionMiner = miner;
-		if (isConnected())
-			submit(sol);
-		else
-			LogB << "Can't submit solution: Not connected";
-		return false;
-	});
-
-	p_worktimer = nullptr;
+	if (!m_onJob)
+		f->onSolutionFound([&] (EthashProofOfWork::Solution sol, int miner) {
+			if (isConnected())
+				submit(sol, miner);
+			else
+				LogB << "Can't submit solution: Not connected";
+			return false;
+		});
 
 	launchIOS();
 
@@ -66,7 +77,10 @@ EthStratumClient::EthStratumClient(
 
 EthStratumClient::~EthStratumClient()
 {
+	m_running = false;
 	m_io_service.stop();
+	if (m_ioThread.joinable())
+		m_ioThread.join();
 }
 
 /*-----------------------------------------------------------------------------------
@@ -74,11 +88,12 @@ EthStratumClient::~EthStratumClient()
 *----------------------------------------------------------------------------------*/
 void EthStratumClient::launchIOS()
 {
+	// keep run() from returning while we're between connections.
+	m_work.reset(new boost::asio::io_service::work(m_io_service));
+	m_io_service.post(boost::bind(&EthStratumClient::connectStratum, this));
 
-	connectStratum();
-
-	boost::thread bt([&] () {
-
+	m_ioThread = boost::thread([&] () {
+		dev::setThreadName("stratum");
 		while (m_running)
 		{
 			try
@@ -101,34 +116,86 @@ void EthStratumClient::launchIOS()
 
 void EthStratumClient::connectStratum()
 {
+	if (!m_running)
+		return;
 	LogB << "Connecting to stratum server " << m_host + ":" + m_port << " ...";
-	tcp::resolver resolver(m_io_service);
+	m_connectTimer.expires_from_now(boost::posix_time::seconds(c_connectTimeout));
+	m_connectTimer.async_wait(boost::bind(&EthStratumClient::connect_timeout_handler, this, boost::asio::placeholders::error));
+
 	tcp::resolver::query query(m_host, m_port);
+	m_resolver.async_resolve(query, boost::bind(&EthStratumClient::resolved, this,
+		boost::asio::placeholders::error, boost::asio::placeholders::iterator));
+}
 
-	boost::system::error_code ec;
-	connect(m_socket, resolver.resolve(query), ec);
+void EthStratumClient::resolved(const boost::system::error_code& ec, tcp::resolver::iterator endpoints)
+{
 	if (ec)
 	{
-		reconnect("Could not connect to stratum server " + m_host + ":" + m_port + " : " + ec.message());
+		m_connectTimer.cancel();
+		if (m_running)
+			reconnect("Could not resolve stratum server " + m_host + " : " + ec.message());
 		return;
 	}
+	async_connect(m_socket, endpoints, boost::bind(&EthStratumClient::connected, this, boost::asio::placeholders::error));
+}
+
+void EthStratumClient::connected(const boost::system::error_code& ec)
+{
+	m_connectTimer.cancel();
+	if (ec)
+	{
+		if (m_running)
+			reconnect("Could not connect to stratum server " + m_host + ":" + m_port + " : " + ec.message());
+		return;
+	}
+
+	boost::system::error_code ignored;
+	m_socket.set_option(tcp::no_delay(true), ignored);
+	m_socket.set_option(socket_base::keep_alive(true), ignored);
+
 	m_connected = true;
 	m_retries = 0;
 
-	std::ostream os(&m_requestBuffer);
-	os << "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": []}\n";
-	writeStratum(m_requestBuffer);
+	sendRequest(PendingRequest(Method::Subscribe), "mining.subscribe", "[]");
 	readline();
 }
 
+void EthStratumClient::connect_timeout_handler(const boost::system::error_code& ec)
+{
+	if (!ec && !m_connected)
+	{
+		// this aborts the resolve or connect in progress, and its handler takes it from there.
+		LogB << "Timed out connecting to stratum server " << m_host + ":" + m_port;
+		m_resolver.cancel();
+		boost::system::error_code ignored;
+		m_socket.close(ignored);
+	}
+}
+
 
 void EthStratumClient::disconnect()
 {
 	LogS << "Disconnecting from stratum server";
+	dropPending();
 	m_connected = false;
 	m_running = false;
-	m_socket.close();
-	m_io_service.stop();
+	m_io_service.post([this] () {
+		closeSocket();
+		m_worktimer.cancel();
+		m_reconnectTimer.cancel();
+		m_connectTimer.cancel();
+		m_io_service.stop();
+	});
+}
+
+void EthStratumClient::closeSocket()
+{
+	boost::system::error_code ignored;
+	m_socket.close(ignored);
+	m_generation++;
+	m_writeQueue.clear();
+	m_replyTimer.cancel();
+	m_replyTimerArmed = false;
 }
 
 void EthStratumClient::reconnect(string msg)
@@ -137,12 +204,16 @@ void EthStratumClient::reconnect(string msg)
 		LogB << msg;
 
 	m_retries++;
-	if (m_retries == m_maxRetries)
+	// a managed client leaves it up to the pool manager to decide when mining should stop.
+	if (m_retries == m_maxRetries && !m_onJob)
 	{
 		// if there's a failover available, we'll switch to it, but worst case scenario, it could be 
 		// unavailable as well, so at some point we should pause mining.  we'll do it here.
-		m_current.reset();
-		p_farm->setWork(m_current);
+		DEV_GUARDED(x_current)
+			m_current.reset();
+		p_farm->setWork(EthashProofOfWork::WorkPackage());
+		if (m_onNewJob)
+			m_onNewJob(EthashProofOfWork::WorkPackage(), 0);
 		LogB << "Mining paused ...";
 		if (m_failoverAvailable)
 		{
@@ -151,11 +222,17 @@ void EthStratumClient::reconnect(string msg)
 		}
 	}
 
+	dropPending();
 	LogS << "Reconnecting in 5 seconds...";
-	p_reconnect = new boost::asio::deadline_timer(m_io_service, boost::posix_time::seconds(5));
-	p_reconnect->async_wait(boost::bind(&EthStratumClient::connectStratum, this));
 	m_connected = false;
-	m_socket.close();
+	m_authorized = false;
+	closeSocket();
+	m_worktimer.cancel();
+	m_reconnectTimer.expires_from_now(boost::posix_time::seconds(5));
+	m_reconnectTimer.async_wait([this] (const boost::system::error_code& ec) {
+		if (!ec)
+			connectStratum();
+	});
 }
 
 void EthStratumClient::readline() {
@@ -166,31 +243,54 @@ void EthStratumClient::readline() {
 
 void EthStratumClient::readResponse(const boost::system::error_code& ec, std::size_t bytes_transferred)
 {
-	dev::setThreadName("stratum");
 	if (!ec && bytes_transferred)
 	{
-		std::istream is(&m_responseBuffer);
-		std::string response;
-		getline(is, response);
-		LogF << "Stratum.Receive : " << response;
-
-		if (!response.empty() && response.front() == '{' && response.back() == '}') 
+		m_received = std::chrono::steady_clock::now();
+		// the line is looked at in place.  a streambuf's input sequence is contiguous.
+		char const* line = buffer_cast<char const*>(m_responseBuffer.data());
+		size_t len = bytes_transferred - 1;
+		if (len && line[len - 1] == '\r')
+			len--;
+
+		StratumParser::Message msg;
+		if (StratumParser::parse(line, line + len, msg))
 		{
-			Json::Value responseObject;
-			Json::Reader reader;
-			if (reader.parse(response.c_str(), responseObject))
-				processReponse(responseObject);
+			// new work goes to the miners before anything else is done with the message.
+			if (msg.kind == StratumParser::Message::Kind::Notify)
+				setWork(msg.header, msg.seed, msg.boundary, msg.block);
 			else
+				processReply(msg.id, msg.result);
+			LogF << "Stratum.Receive : " << string(line, len);
+		}
+		else
+		{
+			std::string response(line, len);
+			LogF << "Stratum.Receive : " << response;
+
+			if (!response.empty() && response.front() == '{' && response.back() == '}') 
 			{
-				LogB << "Unable to parse JSON in EthStratumClient::readResponse : " << reader.getFormattedErrorMessages();
-				LogB << "  - was attempting to parse : " << response;
+				Json::Value responseObject;
+				Json::Reader reader;
+				if (reader.parse(response.c_str(), responseObject))
+					processReponse(responseObject);
+				else
+				{
+					LogB << "Unable to parse JSON in EthStratumClient::readResponse : " << reader.getFormattedErrorMessages();
+					LogB << "  - was attempting to parse : " << response;
+				}
 			}
+			else
+				LogB << "Invalid JSON response in EthStratumClient::readResponse : " << response;
 		}
-		else
-			LogB << "Invalid JSON response in EthStratumClient::readResponse : " << response;
+		m_responseBuffer.consume(bytes_transferred);
 
 		if (m_connected)
+		{
+			// the pool is alive.  restart the clock on anything still unanswered.
+			m_replyTimerArmed = false;
+			armReplyTimer();
 			readline();
+		}
 	}
 	else
 	{
@@ -207,72 +307,238 @@ void EthStratumClient::processReponse(Json::Value& responseObject)
 		string msg = error.get(1, "Unknown error").asString();
 		LogB << msg;
 	}
-	std::ostream os(&m_requestBuffer);
 	Json::Value params;
-	int id = responseObject.get("id", Json::Value::null).asInt();
-	switch (id)
+	Json::Value id = responseObject.get("id", Json::Value::null);
+	string method = responseObject.get("method", "").asString();
+
+	// anything carrying a method is a notification or a request from the pool.
+	if (method == "mining.notify")
 	{
-		case 1:
+		params = responseObject.get("params", Json::Value::null);
+		if (params.isArray())
+			setWork(params);
+		return;
+	}
+	else if (method == "mining.set_extranonce")
+	{
+		// params : [start nonce as 64 bit hex, number of leading bits that are fixed]
+		params = responseObject.get("params", Json::Value::null);
+		try
 		{
-			LogB << "Connection established";
-			params = responseObject.get("result", Json::Value::null);
-			if (params.isArray())
-				setWork(params);
-
-			os << "{\"id\": 3, \"method\": \"mining.authorize\", \"params\": [\"\",\"" << m_password << "\"]}\n";
-			writeStratum(m_requestBuffer);
+			m_startNonce = std::stoull(params.get((Json::Value::ArrayIndex) 0, "").asString(), nullptr, 16);
+			m_exSizeBits = params.get((Json::Value::ArrayIndex) 1, -1).asInt();
+			LogF << "Stratum : nonce range set to 0x" << std::hex << m_startNonce << std::dec << " / " << m_exSizeBits << " bits";
 		}
+		catch (std::exception const& e)
+		{
+			LogB << "Invalid mining.set_extranonce from stratum server : " << e.what();
+			m_startNonce = 0;
+			m_exSizeBits = -1;
+		}
+		restartJob();
+		return;
+	}
+	else if (method == "client.get_version")
+	{
+		Json::FastWriter fw;
+		fw.omitEndingLineFeed();
+		writeStratum("{\"error\": null, \"id\" : " + fw.write(id) + ", \"result\" : \"" + ETH_PROJECT_VERSION + "\"}\n");
+		return;
+	}
+	else if (method != "")
+	{
+		LogF << "Stratum : ignoring unsupported method " << method;
+		return;
+	}
+
+	// otherwise it is the answer to one of our requests.
+	unsigned reqId = id.isConvertibleTo(Json::uintValue) ? id.asUInt() : 0;
+	PendingRequest req;
+	if (takePending(reqId, req))
+		processReply(req, reqId, responseObject);
+}
+
+bool EthStratumClient::takePending(unsigned _id, PendingRequest& _req)
+{
+	Guard l(x_pending);
+	auto it = m_pending.find(_id);
+	if (it == m_pending.end())
+	{
+		LogF << "Stratum : reply to unknown request id " << _id;
+		return false;
+	}
+	_req = it->second;
+	m_pending.erase(it);
+	return true;
+}
+
+void EthStratumClient::processReply(unsigned _id, bool _result)
+{
+	// fast path version of the above, for replies with a plain true/false result.
+	PendingRequest req;
+	if (!takePending(_id, req))
+		return;
+	if (req.method == Method::Submit)
+		shareAnswered(req, _id, _result);
+	else
+	{
+		Json::Value responseObject;
+		responseObject["result"] = _result;
+		processReply(req, _id, responseObject);
+	}
+}
+
+void EthStratumClient::processReply(PendingRequest const& _req, unsigned _id, Json::Value& responseObject)
+{
+	Json::Value params;
+	switch (_req.method)
+	{
+	case Method::Subscribe:
+		LogB << "Connection established to " << m_host << ":" << m_port;
+		params = responseObject.get("result", Json::Value::null);
+		if (params.isArray())
+			setWork(params);
+		sendRequest(PendingRequest(Method::Authorize), "mining.authorize", "[\"\",\"" + m_password + "\"]");
 		break;
-	case 2:
-		// nothing to do...
-		break;
-	case 3:
+	case Method::Authorize:
 		m_authorized = responseObject.get("result", Json::Value::null).asBool();
 		if (!m_authorized)
 		{
 			LogB << "Stratum logon rejected. Worker not authorized.";
-			if (!m_failoverAvailable)
+			if (!m_failoverAvailable && !m_onJob)
 				exit(-1);
 			disconnect();
 			return;
 		}
 		break;
-	case 4:
-		if (responseObject.get("result", false).asBool())
-			p_farm->solutionFound(SolutionState::Accepted, m_stale, m_solutionMiner);
-		else
-			p_farm->solutionFound(SolutionState::Rejected, m_stale, m_solutionMiner);
+	case Method::Submit:
+		shareAnswered(_req, _id, responseObject.get("result", false).asBool());
 		break;
-	default:
-		string method = responseObject.get("method", "").asString();
+	}
+}
 
-		if (method == "mining.notify")
-		{
-			params = responseObject.get("params", Json::Value::null);
-			if (params.isArray())
-				setWork(params);
-		}
-		else if (method == "client.get_version")
-		{
-			os << "{\"error\": null, \"id\" : " << id << ", \"result\" : \"" << ETH_PROJECT_VERSION << "\"}\n";
-			writeStratum(m_requestBuffer);
-		}
-		break;
+void EthStratumClient::shareAnswered(PendingRequest const& _req, unsigned _id, bool _accepted)
+{
+	if (_accepted)
+		m_accepted++;
+	else
+		m_rejected++;
+	auto rtt = std::chrono::steady_clock::now() - _req.sent;
+	{
+		Guard l(x_pending);
+		m_shareLatency.record(rtt);
+		LogF << "Stratum : share " << _id << " answered in " << std::chrono::duration_cast<std::chrono::microseconds>(rtt).count() / 1000.0
+			 << " ms.  " << m_pending.size() << " still pending.  Round trips : " << m_shareLatency.summary();
 	}
+	if (_req.done)
+		_req.done(_accepted);
+	else if (_accepted)
+		p_farm->solutionFound(SolutionState::Accepted, _req.stale, _req.miner);
+	else
+		p_farm->solutionFound(SolutionState::Rejected, _req.stale, _req.miner);
+}
+
+unsigned EthStratumClient::sendRequest(PendingRequest _req, string const& _method, string const& _params)
+{
+	unsigned id;
+	{
+		Guard l(x_pending);
+		id = m_nextId++;
+		_req.sent = std::chrono::steady_clock::now();
+		m_pending[id] = _req;
+	}
+	writeStratum("{\"id\": " + to_string(id) + ", \"method\": \"" + _method + "\", \"params\": " + _params + "}\n");
+	return id;
+}
 
+unsigned EthStratumClient::pendingShares()
+{
+	Guard l(x_pending);
+	unsigned n = 0;
+	for (auto const& p : m_pending)
+		if (p.second.method == Method::Submit)
+			n++;
+	return n;
 }
 
-void EthStratumClient::writeStratum(boost::asio::streambuf& buff)
+void EthStratumClient::dropPending()
 {
-	boost::system::error_code ec;
-	string s = streamBufToStr(buff);
-	LogF << "Stratum.Send: " << s;
-	write(m_socket, buff, ec);
+	// replies to requests on a dead connection are never coming.
+	unsigned shares = pendingShares();
+	if (shares)
+		LogB << shares << " submitted share(s) still awaiting a reply from the pool have been lost.";
+	std::vector<ShareFn> forwarded;
+	DEV_GUARDED(x_pending)
+	{
+		for (auto const& p : m_pending)
+			if (p.second.done)
+				forwarded.push_back(p.second.done);
+		m_pending.clear();
+	}
+	for (auto const& done : forwarded)
+		done(false);
+}
+
+void EthStratumClient::writeStratum(string const& s)
+{
+	m_io_service.post([this, s] () {
+		if (!m_connected)
+			return;
+		bool idle = m_writeQueue.empty();
+		m_writeQueue.push_back(s);
+		if (idle)
+			writeNext();
+		armReplyTimer();
+	});
+}
+
+void EthStratumClient::writeNext()
+{
+	LogF << "Stratum.Send: " << m_writeQueue.front();
+	async_write(m_socket, buffer(m_writeQueue.front()), boost::bind(&EthStratumClient::written, this,
+		boost::asio::placeholders::error, m_generation));
+}
+
+void EthStratumClient::written(const boost::system::error_code& ec, unsigned generation)
+{
+	if (generation != m_generation)
+		// the connection this was written to is gone.
+		return;
 	if (ec)
 	{
 		LogB << "Error writing to stratum socket : " << ec.message();
-		LogD << "  - was attempting to send : " << s;
-		reconnect("");
+		LogD << "  - was attempting to send : " << m_writeQueue.front();
+		if (m_running && m_connected)
+			reconnect("");
+		return;
+	}
+	m_writeQueue.pop_front();
+	if (!m_writeQueue.empty())
+		writeNext();
+}
+
+void EthStratumClient::armReplyTimer()
+{
+	if (m_replyTimerArmed)
+		return;
+	DEV_GUARDED(x_pending)
+		if (m_pending.empty())
+		{
+			m_replyTimer.cancel();
+			return;
+		}
+	m_replyTimerArmed = true;
+	m_replyTimer.expires_from_now(boost::posix_time::seconds(c_replyTimeout));
+	m_replyTimer.async_wait(boost::bind(&EthStratumClient::reply_timeout_handler, this, boost::asio::placeholders::error));
+}
+
+void EthStratumClient::reply_timeout_handler(const boost::system::error_code& ec)
+{
+	if (!ec)
+	{
+		m_replyTimerArmed = false;
+		if (m_connected)
+			reconnect("No response from stratum server in " + to_string(c_replyTimeout) + " seconds.");
 	}
 }
 
@@ -284,39 +550,61 @@ void EthStratumClient::setWork(Json::Value params)
 
 	if (sHeaderHash != "" && sSeedHash != "" && sShareTarget != "")
 	{
-		h256 seedHash = h256(sSeedHash);
-		h256 headerHash = h256(sHeaderHash);
-
-		if (headerHash != m_current.headerHash)
+		unsigned blockNum = m_blockNumber;
+		try
 		{
-			if (p_worktimer)
-				p_worktimer->cancel();
+			string sBlocknumber = params.get((Json::Value::ArrayIndex)4, "").asString();
+			blockNum = (sBlocknumber == "") ? 0 : std::stoul(sBlocknumber, nullptr, 16);
+		}
+		catch (const std::exception& e)
+		{
+			LogB << "Error in EthStratumClient::setWork. Unable to convert block number. " << e.what();
+		}
+		setWork(h256(sHeaderHash), h256(sSeedHash), h256(sShareTarget), blockNum);
+	}
+}
 
-			m_previous.headerHash = m_current.headerHash;
-			m_previous.seedHash = m_current.seedHash;
-			m_previous.boundary = m_current.boundary;
+void EthStratumClient::setWork(h256 const& headerHash, h256 const& seedHash, h256 const& boundary, unsigned blockNum)
+{
+	UniqueGuard l(x_current);
+	if (headerHash != m_current.headerHash)
+	{
+		WorkTrace::get().received(headerHash, m_received);
+		m_previous.headerHash = m_current.headerHash;
+		m_previous.seedHash = m_current.seedHash;
+		m_previous.boundary = m_current.boundary;
+
+		m_current.headerHash = headerHash;
+		m_current.seedHash = seedHash;
+		m_current.boundary = boundary;
+		m_current.startNonce = m_startNonce;
+		m_current.exSizeBits = m_exSizeBits;
+		EthashProofOfWork::WorkPackage current(m_current);
+		l.unlock();
+
+		m_blockNumber = blockNum;
+		dispatch(current, blockNum);
+		// restarting the timer aborts the previous wait.
+		m_worktimer.expires_from_now(boost::posix_time::seconds(m_worktimeout));
+		m_worktimer.async_wait(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error));
+	}
+}
 
-			m_current.headerHash = headerHash;
-			m_current.seedHash = seedHash;
-			m_current.boundary = h256(sShareTarget);
+void EthStratumClient::dispatch(EthashProofOfWork::WorkPackage _wp, unsigned _blockNum)
+{
+	if (m_onNewJob)
+		m_onNewJob(_wp, _blockNum);
+	if (m_localBits)
+		// we keep the first slot of the partition for ourselves.
+		_wp.exSizeBits = max(_wp.exSizeBits, 0) + m_localBits;
 
-			try
-			{
-				string sBlocknumber = params.get((Json::Value::ArrayIndex)4, "").asString();
-				unsigned blockNum = (sBlocknumber == "") ? 0 : std::stoul(sBlocknumber, nullptr, 16);
-				if (m_onWorkPackage)
-					m_onWorkPackage(blockNum);
-			}
-			catch (const std::exception& e)
-			{
-				LogB << "Error in EthStratumClient::setWork. Unable to convert block number. " << e.what();
-			}
+	if (m_onWorkPackage)
+		m_onWorkPackage(_blockNum);
 
-			p_farm->setWork(m_current);
-			p_worktimer = new boost::asio::deadline_timer(m_io_service, boost::posix_time::seconds(m_worktimeout));
-			p_worktimer->async_wait(boost::bind(&EthStratumClient::work_timeout_handler, this, boost::asio::placeholders::error));
-		}
-	}
+	if (m_onJob)
+		m_onJob(_wp, _blockNum);
+	else
+		p_farm->setWork(_wp);
 }
 
 
@@ -327,47 +615,70 @@ void EthStratumClient::work_timeout_handler(const boost::system::error_code& ec)
 	}
 }
 
-bool EthStratumClient::submit(EthashProofOfWork::Solution solution) {
+bool EthStratumClient::submit(EthashProofOfWork::Solution solution, int miner, bool reportFailure) {
+	UniqueGuard l(x_current);
 	EthashProofOfWork::WorkPackage tempWork(m_current);
 	EthashProofOfWork::WorkPackage tempPreviousWork(m_previous);
+	l.unlock();
 
 	LogB << "Solution found; Submitting to " << m_host << "...";
 
-	if (EthashAux::eval(tempWork.seedHash, tempWork.headerHash, solution.nonce).value < tempWork.boundary)
+	EthashProofOfWork::WorkPackage* wp = nullptr;
+	bool stale = false;
+	VerificationEngine& engine = VerificationEngine::get();
+	VerificationEngine::Request current{tempWork.seedHash, tempWork.headerHash, solution.nonce, solution.mixHash};
+	VerificationEngine::Request previous{tempPreviousWork.seedHash, tempPreviousWork.headerHash, solution.nonce, solution.mixHash};
+	if (VerificationEngine::valid(current, engine.verify(current).get(), tempWork.boundary))
+		wp = &tempWork;
+	else if (VerificationEngine::valid(previous, engine.verify(previous).get(), tempPreviousWork.boundary))
 	{
-		string json;
-
-		json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"\",\"\",\"0x" + solution.nonce.hex() + "\",\"0x" + tempWork.headerHash.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]}\n";
-		std::ostream os(&m_requestBuffer);
-		os << json;
-		m_stale = false;
-		writeStratum(m_requestBuffer);
-		return true;
+		wp = &tempPreviousWork;
+		stale = true;
 	}
-	else if (EthashAux::eval(tempPreviousWork.seedHash, tempPreviousWork.headerHash, solution.nonce).value < tempPreviousWork.boundary)
+	else
 	{
-		string json;
-
-		json = "{\"id\": 4, \"method\": \"mining.submit\", \"params\": [\"\",\"\",\"0x" + solution.nonce.hex() + "\",\"0x" + tempPreviousWork.headerHash.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]}\n";
-		std::ostream os(&m_requestBuffer);
-		os << json;
-		m_stale = true;
-		writeStratum(m_requestBuffer);
-		return true;
-	}
-	else {
-		m_stale = false;
-		p_farm->solutionFound(SolutionState::Failed, NULL, m_solutionMiner);
+		if (reportFailure)
+			p_farm->solutionFound(SolutionState::Failed, false, miner);
+		return false;
 	}
 
-	return false;
+	sendRequest(PendingRequest(Method::Submit, miner, wp->headerHash, stale), "mining.submit",
+		"[\"\",\"\",\"0x" + solution.nonce.hex() + "\",\"0x" + wp->headerHash.hex() + "\",\"0x" + solution.mixHash.hex() + "\"]");
+	return true;
+}
+
+void EthStratumClient::setLocalPartitionBits(unsigned bits)
+{
+	// jobs are dispatched on the I/O thread, so that's where the change is made.
+	m_io_service.post([this, bits] () {
+		m_localBits = bits;
+		restartJob();
+	});
+}
+
+void EthStratumClient::restartJob()
+{
+	// if we're already working on a job, hand it out again with the new nonce range.  it's
+	// still the same job, so m_previous and the work timer are left alone.
+	EthashProofOfWork::WorkPackage wp;
+	DEV_GUARDED(x_current)
+	{
+		m_current.startNonce = m_startNonce;
+		m_current.exSizeBits = m_exSizeBits;
+		wp = m_current;
+	}
+	if (wp)
+		dispatch(wp, m_blockNumber);
 }
 
-string EthStratumClient::streamBufToStr(boost::asio::streambuf& buff)
+void EthStratumClient::submitShare(h256 const& header, Nonce const& nonce, h256 const& mixHash, ShareFn const& done)
 {
-	boost::asio::streambuf::const_buffers_type bufs = buff.data();
-	std::string str(boost::asio::buffers_begin(bufs), boost::asio::buffers_begin(bufs) + buff.size());
-	return str;
+	if (!isConnected())
+	{
+		done(false);
+		return;
+	}
+	sendRequest(PendingRequest(Method::Submit, -1, header, false, done), "mining.submit", "[\"\",\"\",\"0x" + nonce.hex() + "\",\"0x" + header.hex() + "\",\"0x" + mixHash.hex() + "\"]");
 }
 
 void EthStratumClient::logJson(Json::Value _json)
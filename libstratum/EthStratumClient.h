@@ -1,3 +1,4 @@
+#pragma once
 
 /*
 This file is part of mvis-ethereum.
@@ -17,12 +18,19 @@ along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <iostream>
+#include <map>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <chrono>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <json/json.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/Histogram.h>
 #include <libethcore/Farm.h>
 #include <libethcore/EthashAux.h>
 #include "BuildInfo.h"
@@ -40,7 +48,12 @@ class EthStratumClient
 public:
 
 	using WorkPackageFn = std::function<void(unsigned int)>;
+	using JobFn = std::function<void(EthashProofOfWork::WorkPackage const&, unsigned int)>;
+	using ShareFn = std::function<void(bool)>;
 
+	// if onJob is supplied, the client is managed (see PoolManager).  it hands new jobs to
+	// onJob instead of the farm, doesn't take solutions from the farm, and keeps trying to
+	// reconnect forever instead of pausing the farm.
 	EthStratumClient(
 		GenericFarm<EthashProofOfWork> * f, 
 		MinerType m, 
@@ -48,38 +61,101 @@ public:
 		string const & port,
 		string const & password,
 		int const & retries,
-		int const & worktimeout
+		int const & worktimeout,
+		JobFn const & onJob = JobFn()
 	);
 	~EthStratumClient();
 
 	bool isRunning() { return m_running; }
 	bool isConnected() { return m_connected && m_authorized; }
-	h256 currentHeaderHash() { return m_current.headerHash; }
-	bool current() { return m_current; }
-	bool submit(EthashProofOfWork::Solution solution);
+	h256 currentHeaderHash() { Guard l(x_current); return m_current.headerHash; }
+	bool current() { Guard l(x_current); return m_current; }
+	EthashProofOfWork::WorkPackage currentWork() { Guard l(x_current); return m_current; }
+	unsigned currentBlock() { return m_blockNumber; }
+	string const& host() const { return m_host; }
+	string const& port() const { return m_port; }
+	unsigned accepted() const { return m_accepted; }
+	unsigned rejected() const { return m_rejected; }
+	// returns false if the solution doesn't belong to either the current or the previous
+	// job.  that counts as a failure (bad hash), unless reportFailure is false.
+	bool submit(EthashProofOfWork::Solution solution, int miner = -1, bool reportFailure = true);
 	void disconnect();
 	void onWorkPackage(WorkPackageFn const& handler) { m_onWorkPackage = handler; }
 
+	// called with every new job, and the nonce range (startNonce/exSizeBits) the pool
+	// assigned to us.  unlike the managed mode onJob, the job still goes to the farm too.
+	void onNewJob(JobFn const& handler) { m_onNewJob = handler; }
+	// confine local mining to the first 1/2^bits of our nonce range, leaving the rest to
+	// be handed out to others (see StratumProxy).
+	void setLocalPartitionBits(unsigned bits);
+	// forward a share found by someone else, without checking it.  done is called with the
+	// pool's verdict, or false if the connection is lost before the pool answers.
+	void submitShare(h256 const& header, Nonce const& nonce, h256 const& mixHash, ShareFn const& done);
+
+	// round trip times of share submissions, from the time the share was written to the
+	// socket until the pool's answer was read.
+	LatencyHistogram shareLatency() { Guard l(x_pending); return m_shareLatency; }
+	unsigned pendingShares();
+
 private:
+	enum class Method { Subscribe, Authorize, Submit };
+
+	// every request we send gets a new id, and is remembered here until the pool answers
+	// it.  this lets any number of shares be in flight at once, with each reply credited
+	// to the right miner and stale flag.
+	struct PendingRequest
+	{
+		PendingRequest() {}
+		PendingRequest(Method _method, int _miner = -1, h256 const& _header = h256(), bool _stale = false, ShareFn const& _done = ShareFn()):
+			method(_method), miner(_miner), header(_header), stale(_stale), done(_done) {}
+
+		Method method = Method::Subscribe;
+		int miner = -1;
+		h256 header;
+		bool stale = false;
+		std::chrono::steady_clock::time_point sent;
+		ShareFn done;		// forwarded shares only
+	};
+
+	unsigned sendRequest(PendingRequest _req, string const& _method, string const& _params);
+	bool takePending(unsigned _id, PendingRequest& _req);
+	void processReply(PendingRequest const& _req, unsigned _id, Json::Value& responseObject);
+	void processReply(unsigned _id, bool _result);
+	void shareAnswered(PendingRequest const& _req, unsigned _id, bool _accepted);
+	void dropPending();
+	// all socket and timer operations happen on the I/O thread.  nothing on it ever
+	// blocks, so a slow DNS server or pool can't hold up the delivery of new work.
 	void connectStratum();
+	void resolved(const boost::system::error_code& ec, tcp::resolver::iterator endpoints);
+	void connected(const boost::system::error_code& ec);
+	void connect_timeout_handler(const boost::system::error_code& ec);
 	void launchIOS();
 	void reconnect(string msg);
+	void closeSocket();
 	void readline();
 	void readResponse(const boost::system::error_code& ec, std::size_t bytes_transferred);
 	void processReponse(Json::Value& responseObject);
-	void writeStratum(boost::asio::streambuf &buff);
+	// may be called from any thread.  the message is queued and written asynchronously.
+	void writeStratum(string const& _s);
+	void writeNext();
+	void written(const boost::system::error_code& ec, unsigned generation);
+	void armReplyTimer();
+	void reply_timeout_handler(const boost::system::error_code& ec);
 	void setWork(Json::Value params);
+	void setWork(h256 const& headerHash, h256 const& seedHash, h256 const& boundary, unsigned blockNum);
+	// hands a job to the farm, or whoever gets our jobs instead, and to our downstream sessions.
+	void dispatch(EthashProofOfWork::WorkPackage _wp, unsigned _blockNum);
+	void restartJob();
 	void work_timeout_handler(const boost::system::error_code& ec);
-	string streamBufToStr(boost::asio::streambuf &buff);
 	void logJson(Json::Value _json);
 
 	string m_host;
 	string m_port;
 	string m_password;
 
-	bool m_authorized;
-	bool m_connected;	// this refers to a TCP connection
-	bool m_running;
+	std::atomic<bool> m_authorized;
+	std::atomic<bool> m_connected;	// this refers to a TCP connection
+	std::atomic<bool> m_running;
 
 	int	m_retries = 0;
 	int	m_maxRetries;
@@ -87,22 +163,46 @@ private:
 	bool m_failoverAvailable;
 
 	GenericFarm<EthashProofOfWork> * p_farm;
+	Mutex x_current;
 	EthashProofOfWork::WorkPackage m_current;
 	EthashProofOfWork::WorkPackage m_previous;
 	WorkPackageFn m_onWorkPackage;
-
-	bool m_stale = false;
+	JobFn m_onJob;
+	JobFn m_onNewJob;
+	// nonce range assigned by the pool through mining.set_extranonce.  -1 = the whole range.
+	uint64_t m_startNonce = 0;
+	int m_exSizeBits = -1;
+	unsigned m_localBits = 0;
+	std::atomic<unsigned> m_blockNumber = {0};
+	std::atomic<unsigned> m_accepted = {0};
+	std::atomic<unsigned> m_rejected = {0};
+
+	Mutex x_pending;
+	std::map<unsigned, PendingRequest> m_pending;
+	unsigned m_nextId = 1;
+	LatencyHistogram m_shareLatency;
 
 	boost::asio::io_service m_io_service;
+	std::unique_ptr<boost::asio::io_service::work> m_work;
+	boost::thread m_ioThread;
+	tcp::resolver m_resolver;
 	tcp::socket m_socket;
 
-	boost::asio::streambuf m_requestBuffer;
 	boost::asio::streambuf m_responseBuffer;
+	// when the line currently being processed was received.
+	std::chrono::steady_clock::time_point m_received;
+
+	// only touched on the I/O thread.  the generation is bumped every time the socket is
+	// closed, so completions belonging to an old connection can be recognized.
+	std::deque<string> m_writeQueue;
+	unsigned m_generation = 0;
+	bool m_replyTimerArmed = false;
 
-	boost::asio::deadline_timer * p_worktimer;
-	boost::asio::deadline_timer * p_reconnect;
+	boost::asio::deadline_timer m_worktimer;
+	boost::asio::deadline_timer m_reconnectTimer;
+	boost::asio::deadline_timer m_connectTimer;
+	boost::asio::deadline_timer m_replyTimer;
 
 	double m_nextWorkDifficulty;
-	int m_solutionMiner;
 
 };
\ No newline at end of file
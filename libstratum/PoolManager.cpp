@@ -0,0 +1,277 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoolManager.h"
+
+using namespace std::chrono;
+
+namespace
+{
+	// how often pool health is evaluated (ms).
+	const unsigned c_monitorInterval = 500;
+	// on startup, give the primary pool this long to come up before settling for a backup.
+	const seconds c_startupGrace(5);
+	// how many recent blocks we remember the first announcement of.
+	const unsigned c_recentBlocks = 16;
+	// reject rate isn't judged until a pool has had this many shares answered.
+	const unsigned c_minShares = 8;
+	// seconds between pool status lines in the log.
+	const seconds c_reportInterval(60);
+
+	double msSince(steady_clock::time_point _t, steady_clock::time_point _now)
+	{
+		return duration_cast<microseconds>(_now - _t).count() / 1000.0;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class PoolManager
+*----------------------------------------------------------------------------------*/
+PoolManager::PoolManager(GenericFarm<EthashProofOfWork>* _f, MinerType _m, std::vector<Pool> const& _pools, Settings const& _settings) :
+	m_farm(_f), m_settings(_settings), m_pools(_pools.size())
+{
+	m_started = m_lastReport = steady_clock::now();
+
+	// jobs can start arriving as soon as a client is constructed, so m_pools is sized
+	// up front and never resized.
+	for (unsigned i = 0; i < _pools.size(); i++)
+	{
+		EthStratumClient* client = new EthStratumClient(_f, _m, _pools[i].host, _pools[i].port, _pools[i].password, 0, m_settings.worktimeout,
+			[this, i] (EthashProofOfWork::WorkPackage const& _wp, unsigned _block) { onJob(i, _wp, _block); });
+		DEV_GUARDED(x_pools)
+			m_pools[i].client.reset(client);
+	}
+
+	_f->onSolutionFound([&] (EthashProofOfWork::Solution sol, int miner) {
+		submit(sol, miner);
+		return false;
+	});
+
+	m_monitor = std::thread(&PoolManager::monitor, this);
+}
+
+PoolManager::~PoolManager()
+{
+	DEV_GUARDED(x_pools)
+		m_running = false;
+	m_stop.notify_all();
+	m_monitor.join();
+	m_farm->onSolutionFound([] (EthashProofOfWork::Solution, int) { return false; });
+	for (auto& p : m_pools)
+		p.client.reset();
+}
+
+bool PoolManager::isConnected()
+{
+	int a = m_active;
+	return a >= 0 && m_pools[a].client->isConnected();
+}
+
+string PoolManager::name(int _pool)
+{
+	return m_pools[_pool].client->host() + ":" + m_pools[_pool].client->port();
+}
+
+/*-----------------------------------------------------------------------------------
+* onJob
+*   - called on the I/O thread of the pool the job came from.
+*----------------------------------------------------------------------------------*/
+void PoolManager::onJob(unsigned _pool, EthashProofOfWork::WorkPackage const& _wp, unsigned _block)
+{
+	auto now = steady_clock::now();
+
+	DEV_GUARDED(x_pools)
+	{
+		// only a pool's first job for a block says anything about how far behind it is.
+		// the jobs it re-issues during the block don't, and neither do the headers, which
+		// are different on every pool.
+		PoolState& p = m_pools[_pool];
+		if (_block > p.lastBlock)
+		{
+			double lag = 0;
+			auto it = find_if(m_recentBlocks.begin(), m_recentBlocks.end(), [&] (std::pair<unsigned, steady_clock::time_point> const& b) { return b.first == _block; });
+			if (it == m_recentBlocks.end())
+			{
+				m_recentBlocks.push_back(make_pair(_block, now));
+				if (m_recentBlocks.size() > c_recentBlocks)
+					m_recentBlocks.pop_front();
+			}
+			else
+				lag = msSince(it->second, now);
+
+			p.lastBlock = _block;
+			p.lagMs = p.blocks++ ? p.lagMs * 0.8 + lag * 0.2 : lag;
+			if (lag > 0)
+				LogF << "PoolManager : " << (p.client ? name(_pool) : "") << " announced block " << _block << " " << lag << " ms after the first pool";
+		}
+	}
+
+	Guard l(x_switch);
+	if ((int) _pool == m_active)
+	{
+		m_farm->setWork(_wp);
+		if (m_onWorkPackage)
+			m_onWorkPackage(_block);
+	}
+}
+
+/*-----------------------------------------------------------------------------------
+* submit
+*----------------------------------------------------------------------------------*/
+bool PoolManager::submit(EthashProofOfWork::Solution const& _sol, int _miner)
+{
+	int a = m_active;
+	int prev = m_previous;
+	if (a < 0 || !m_pools[a].client->isConnected())
+	{
+		LogB << "Can't submit solution: Not connected";
+		return false;
+	}
+	// a solution found just before a switch belongs to the previous pool's job.
+	bool havePrev = prev >= 0 && prev != a && m_pools[prev].client->isConnected();
+	if (m_pools[a].client->submit(_sol, _miner, !havePrev))
+		return true;
+	return havePrev && m_pools[prev].client->submit(_sol, _miner);
+}
+
+/*-----------------------------------------------------------------------------------
+* monitor
+*----------------------------------------------------------------------------------*/
+void PoolManager::monitor()
+{
+	setThreadName("pools");
+	for (;;)
+	{
+		{
+			UniqueGuard l(x_pools);
+			m_stop.wait_for(l, milliseconds(c_monitorInterval), [&] () { return !m_running; });
+			if (!m_running)
+				return;
+		}
+		evaluate();
+	}
+}
+
+bool PoolManager::checkHealth(PoolState& _p, steady_clock::time_point _now, string& _problem)
+{
+	EthStratumClient& c = *_p.client;
+	if (!c.isRunning())
+		_problem = "stopped";
+	else if (!c.isConnected())
+		_problem = "not connected";
+	else if (!c.current())
+		_problem = "no work";
+	else if (_p.lagMs > m_settings.maxJobLag)
+		_problem = "jobs arriving " + std::to_string((int) _p.lagMs) + " ms behind the other pools";
+	else if (_p.lastBlock && !m_recentBlocks.empty() && _p.lastBlock < m_recentBlocks.back().first && msSince(m_recentBlocks.back().second, _now) > m_settings.maxJobLag)
+		_problem = "has not announced block " + std::to_string(m_recentBlocks.back().first);
+	else if (_p.shares >= c_minShares && _p.rejectRate * 100 > m_settings.maxRejectRate)
+		_problem = "rejecting " + std::to_string((int) (_p.rejectRate * 100)) + "% of shares";
+	else
+		return true;
+	return false;
+}
+
+void PoolManager::evaluate()
+{
+	auto now = steady_clock::now();
+	int active = m_active;
+	int best = -1;
+	bool report = now - m_lastReport > c_reportInterval;
+	if (report)
+		m_lastReport = now;
+
+	{
+		Guard l(x_pools);
+		for (unsigned i = 0; i < m_pools.size(); i++)
+		{
+			PoolState& p = m_pools[i];
+
+			// fold newly answered shares into the reject rate.
+			unsigned a = p.client->accepted();
+			unsigned r = p.client->rejected();
+			for (; p.accepted < a; p.accepted++, p.shares++)
+				p.rejectRate *= 0.9;
+			for (; p.rejected < r; p.rejected++, p.shares++)
+				p.rejectRate = p.rejectRate * 0.9 + 0.1;
+
+			string problem;
+			bool healthy = checkHealth(p, now, problem);
+			if (healthy && !p.healthy)
+				p.healthySince = now;
+			if (!healthy && (p.healthy || problem != p.problem))
+				LogB << "Pool " << name(i) << " : " << problem;
+			p.healthy = healthy;
+			p.problem = problem;
+
+			if (report)
+				LogF << "PoolManager : " << name(i) << (i == (unsigned) active ? " (active)" : "") << " : "
+					 << (healthy ? "ok" : problem) << ", job lag " << p.lagMs << " ms, reject rate "
+					 << p.rejectRate * 100 << "% over " << p.shares << " shares";
+		}
+
+		for (unsigned i = 0; i < m_pools.size() && best == -1; i++)
+		{
+			PoolState const& p = m_pools[i];
+			if (!p.healthy)
+				continue;
+			if (active == -1 && i != 0 && now - m_started < c_startupGrace)
+				// give the primary a chance to come up first.
+				continue;
+			if (active >= 0 && (int) i < active && m_pools[active].healthy && now - p.healthySince < seconds(m_settings.switchBackDelay))
+				// a more preferred pool has recovered, but we'll make sure it stays up before going back.
+				continue;
+			best = i;
+		}
+	}
+
+	if (best >= 0 && best != active)
+		activate(best);
+	else if (best == -1 && active >= 0 && !m_pools[active].client->isConnected())
+		activate(-1);
+}
+
+/*-----------------------------------------------------------------------------------
+* activate
+*   - make _pool the farm's source of work. -1 pauses mining.
+*----------------------------------------------------------------------------------*/
+void PoolManager::activate(int _pool)
+{
+	Guard l(x_switch);
+	int prev = m_active;
+	m_previous = prev;
+	m_active = _pool;
+
+	if (_pool < 0)
+	{
+		LogB << "No pool available.  Mining paused ...";
+		m_farm->setWork(EthashProofOfWork::WorkPackage());
+		return;
+	}
+
+	if (prev >= 0)
+		LogB << "Switching from pool " << name(prev) << " to " << name(_pool);
+	else
+		LogB << "Mining on pool " << name(_pool);
+
+	// the client is already logged in with a current job, so this is all there is to it.
+	EthStratumClient& c = *m_pools[_pool].client;
+	m_farm->setWork(c.currentWork());
+	if (m_onWorkPackage)
+		m_onWorkPackage(c.currentBlock());
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// keeps subscribed and authorized stratum sessions open to the primary pool and all the
+// backups at the same time.  only the active pool's jobs are handed to the farm, and
+// solutions are submitted to it.  since the backups are already logged in and have a
+// current job, failing over is just a matter of handing the farm a different job.
+//
+// each pool is watched for:
+//	- being disconnected or unauthorized
+//	- job lag: how long after the first pool to announce a new block this pool sends its
+//	  first job for that block.  a pool that falls too far behind (or never gets to a block
+//	  the others have) is considered stalled.  only block numbers are compared: pools
+//	  re-issue jobs within a block, and every pool's headers are different anyway, so a
+//	  pool that doesn't send block numbers is only judged on the other criteria.
+//	- reject rate over its recent shares
+//
+// pools are listed in order of preference.  we always mine on the most preferred
+// healthy pool, but a pool that recovers has to stay healthy for a while before we
+// switch back to it.
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <condition_variable>
+#include "EthStratumClient.h"
+
+class PoolManager
+{
+public:
+	struct Pool
+	{
+		string host;
+		string port;
+		string password;
+	};
+
+	struct Settings
+	{
+		unsigned maxJobLag = 3000;			// milliseconds
+		unsigned maxRejectRate = 50;		// percent
+		unsigned switchBackDelay = 30;		// seconds
+		int worktimeout = 180;				// seconds
+	};
+
+	using WorkPackageFn = EthStratumClient::WorkPackageFn;
+
+	PoolManager(GenericFarm<EthashProofOfWork>* _f, MinerType _m, std::vector<Pool> const& _pools, Settings const& _settings);
+	~PoolManager();
+
+	// index of the pool we're mining on, or -1 if mining is paused because no pool is usable.
+	int active() const { return m_active; }
+	bool isConnected();
+	void onWorkPackage(WorkPackageFn const& _handler) { m_onWorkPackage = _handler; }
+
+private:
+	struct PoolState
+	{
+		std::unique_ptr<EthStratumClient> client;
+		unsigned lastBlock = 0;		// zero if the pool doesn't send block numbers
+		unsigned blocks = 0;
+		double lagMs = 0;			// moving average
+		double rejectRate = 0;		// moving average, 0..1
+		unsigned shares = 0;
+		unsigned accepted = 0;
+		unsigned rejected = 0;
+		bool healthy = false;
+		string problem;
+		std::chrono::steady_clock::time_point healthySince;
+	};
+
+	void onJob(unsigned _pool, EthashProofOfWork::WorkPackage const& _wp, unsigned _block);
+	bool submit(EthashProofOfWork::Solution const& _sol, int _miner);
+	void monitor();
+	void evaluate();
+	bool checkHealth(PoolState& _p, std::chrono::steady_clock::time_point _now, string& _problem);
+	void activate(int _pool);
+	string name(int _pool);
+
+	GenericFarm<EthashProofOfWork>* m_farm;
+	Settings m_settings;
+	WorkPackageFn m_onWorkPackage;
+
+	// guards m_pools and m_recentBlocks.
+	Mutex x_pools;
+	std::vector<PoolState> m_pools;
+	// when each recent block was first announced by any pool.
+	std::deque<std::pair<unsigned, std::chrono::steady_clock::time_point>> m_recentBlocks;
+
+	// serializes handing work to the farm, so a switch can't interleave with a job
+	// arriving from the pool being switched away from.
+	Mutex x_switch;
+	std::atomic<int> m_active = {-1};
+	std::atomic<int> m_previous = {-1};
+
+	std::chrono::steady_clock::time_point m_started;
+	std::chrono::steady_clock::time_point m_lastReport;
+	bool m_running = true;
+	std::condition_variable m_stop;
+	std::thread m_monitor;
+};
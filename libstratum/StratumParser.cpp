@@ -0,0 +1,265 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StratumParser.h"
+
+#include <cstring>
+
+using namespace dev;
+
+namespace
+{
+	// -1 for anything that isn't a hex digit.
+	struct HexTable
+	{
+		signed char v[256];
+		HexTable()
+		{
+			memset(v, -1, sizeof(v));
+			for (int i = 0; i < 10; i++)
+				v['0' + i] = i;
+			for (int i = 0; i < 6; i++)
+				v['a' + i] = v['A' + i] = 10 + i;
+		}
+	};
+	const HexTable c_hex;
+
+	inline int nibble(char _c) { return c_hex.v[(unsigned char) _c]; }
+
+	class Scanner
+	{
+	public:
+		Scanner(char const* _begin, char const* _end): p(_begin), end(_end) {}
+
+		void ws() { while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++; }
+		bool eat(char _c) { ws(); if (p < end && *p == _c) { p++; return true; } return false; }
+		bool peek(char _c) { ws(); return p < end && *p == _c; }
+		bool atEnd() { ws(); return p == end; }
+
+		// a string without escapes.  _b/_e point into the buffer.
+		bool str(char const*& _b, char const*& _e)
+		{
+			if (!eat('"'))
+				return false;
+			_b = p;
+			while (p < end && *p != '"')
+				if (*p++ == '\\')
+					return false;
+			if (p == end)
+				return false;
+			_e = p++;
+			return true;
+		}
+
+		bool literal(char const* _s)
+		{
+			ws();
+			size_t n = strlen(_s);
+			if ((size_t) (end - p) < n || memcmp(p, _s, n) != 0)
+				return false;
+			p += n;
+			return true;
+		}
+
+		bool uint(unsigned& _v)
+		{
+			ws();
+			if (p == end || *p < '0' || *p > '9')
+				return false;
+			_v = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+				_v = _v * 10 + (*p++ - '0');
+			return true;
+		}
+
+		// strings, numbers, true, false and null.  anything structured is refused.
+		bool skipScalar()
+		{
+			char const* b;
+			char const* e;
+			ws();
+			if (p == end)
+				return false;
+			if (*p == '"')
+				return str(b, e);
+			if (literal("true") || literal("false") || literal("null"))
+				return true;
+			if (*p == '-' || (*p >= '0' && *p <= '9'))
+			{
+				while (p < end && (*p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E' || (*p >= '0' && *p <= '9')))
+					p++;
+				return true;
+			}
+			return false;
+		}
+
+		char const* p;
+		char const* end;
+	};
+
+	bool keyIs(char const* _b, char const* _e, char const* _key)
+	{
+		size_t n = strlen(_key);
+		return (size_t) (_e - _b) == n && memcmp(_b, _key, n) == 0;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class StratumParser
+*----------------------------------------------------------------------------------*/
+bool StratumParser::decodeHash(char const* _begin, char const* _end, h256& _hash)
+{
+	if (_end - _begin >= 2 && _begin[0] == '0' && (_begin[1] == 'x' || _begin[1] == 'X'))
+		_begin += 2;
+	if (_end - _begin != 64)
+		return false;
+	byte* out = _hash.data();
+	for (unsigned i = 0; i < 32; i++)
+	{
+		int hi = nibble(_begin[2 * i]);
+		int lo = nibble(_begin[2 * i + 1]);
+		if (hi < 0 || lo < 0)
+			return false;
+		out[i] = (byte) ((hi << 4) | lo);
+	}
+	return true;
+}
+
+bool StratumParser::parse(char const* _begin, char const* _end, Message& _msg)
+{
+	Scanner s(_begin, _end);
+	if (!s.eat('{'))
+		return false;
+
+	bool notify = false;
+	bool haveParams = false;
+	bool haveId = false;
+	bool haveResult = false;
+
+	if (!s.peek('}'))
+	do
+	{
+		char const* kb;
+		char const* ke;
+		if (!s.str(kb, ke) || !s.eat(':'))
+			return false;
+
+		if (keyIs(kb, ke, "id"))
+		{
+			if (s.literal("null"))
+				_msg.id = 0;
+			else if (!s.uint(_msg.id))
+				return false;
+			haveId = true;
+		}
+		else if (keyIs(kb, ke, "method"))
+		{
+			char const* b;
+			char const* e;
+			if (!s.str(b, e) || !keyIs(b, e, "mining.notify"))
+				return false;
+			notify = true;
+		}
+		else if (keyIs(kb, ke, "result"))
+		{
+			if (s.literal("true"))
+				_msg.result = true;
+			else if (s.literal("false"))
+				_msg.result = false;
+			else
+				// eg. the subscribe reply, which carries a job.
+				return false;
+			haveResult = true;
+		}
+		else if (keyIs(kb, ke, "error"))
+		{
+			// errors get logged, which the slow path takes care of.
+			if (!s.literal("null"))
+				return false;
+		}
+		else if (keyIs(kb, ke, "params"))
+		{
+			// [job id, header, seed, boundary, block number (optional), ...]
+			if (!s.eat('['))
+				return false;
+			unsigned i = 0;
+			if (!s.peek(']'))
+			do
+			{
+				char const* b;
+				char const* e;
+				if (!s.str(b, e))
+					return false;
+				switch (i++)
+				{
+				case 1:
+					if (!decodeHash(b, e, _msg.header))
+						return false;
+					break;
+				case 2:
+					if (!decodeHash(b, e, _msg.seed))
+						return false;
+					break;
+				case 3:
+					if (!decodeHash(b, e, _msg.boundary))
+						return false;
+					break;
+				case 4:
+				{
+					if (e - b >= 2 && b[0] == '0' && (b[1] == 'x' || b[1] == 'X'))
+						b += 2;
+					if (e - b > 8)
+						return false;
+					unsigned block = 0;
+					for (; b < e; b++)
+					{
+						int n = nibble(*b);
+						if (n < 0)
+							return false;
+						block = (block << 4) | n;
+					}
+					_msg.block = block;
+					break;
+				}
+				default:
+					break;
+				}
+			} while (s.eat(','));
+			if (!s.eat(']') || i < 4)
+				return false;
+			haveParams = true;
+		}
+		else if (!s.skipScalar())
+			return false;
+	} while (s.eat(','));
+
+	if (!s.eat('}') || !s.atEnd())
+		return false;
+
+	if (notify && haveParams)
+	{
+		_msg.kind = Message::Kind::Notify;
+		return true;
+	}
+	if (!notify && !haveParams && haveId && haveResult)
+	{
+		_msg.kind = Message::Kind::Reply;
+		return true;
+	}
+	return false;
+}
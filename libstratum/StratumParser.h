@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// fast path for the two stratum messages that matter for latency: mining.notify and the
+// pool's answer to a mining.submit.  the message is scanned in place in the receive
+// buffer, and the hashes are decoded straight from hex into h256, without building a
+// Json::Value or any intermediate strings.
+//
+// the parser only accepts the plain shape these messages have in practice (no escapes,
+// no nested objects, full length hashes).  anything else is rejected, and the caller
+// should hand the message to jsoncpp instead.
+
+#include <libdevcore/FixedHash.h>
+
+class StratumParser
+{
+public:
+	struct Message
+	{
+		enum class Kind { Notify, Reply };
+		Kind kind;
+
+		// Reply
+		unsigned id = 0;
+		bool result = false;
+
+		// Notify
+		dev::h256 header;
+		dev::h256 seed;
+		dev::h256 boundary;
+		unsigned block = 0;
+	};
+
+	// _begin/_end delimit a single line, without the trailing newline.
+	static bool parse(char const* _begin, char const* _end, Message& _msg);
+
+	// decodes exactly 64 hex digits, with or without a 0x prefix.
+	static bool decodeHash(char const* _begin, char const* _end, dev::h256& _hash);
+};
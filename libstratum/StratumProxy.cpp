@@ -0,0 +1,552 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StratumProxy.h"
+
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <libethcore/VerificationEngine.h>
+
+using namespace std::chrono;
+
+namespace
+{
+	// seconds between per miner summaries in the log.
+	const unsigned c_reportInterval = 300;
+
+	string hex64(uint64_t _v)
+	{
+		std::ostringstream ss;
+		ss << std::hex << std::setw(16) << std::setfill('0') << _v;
+		return ss.str();
+	}
+
+	string jsonString(Json::Value const& _v)
+	{
+		Json::FastWriter fw;
+		fw.omitEndingLineFeed();
+		return fw.write(_v);
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class StratumProxy
+*----------------------------------------------------------------------------------*/
+StratumProxy::StratumProxy(EthStratumClient& _upstream, Settings const& _settings) :
+	m_upstream(_upstream),
+	m_settings(_settings),
+	m_acceptor(m_io),
+	m_reportTimer(m_io)
+{
+	// 4 more bits are needed to split a slot between the GPUs of a rig.
+	m_settings.extraNonceBits = std::min(std::max(m_settings.extraNonceBits, 1u), 16u);
+	m_slotUsed.assign(1u << m_settings.extraNonceBits, false);
+	m_slotUsed[0] = true;
+
+	tcp::endpoint endpoint(tcp::v4(), m_settings.port);
+	m_acceptor.open(endpoint.protocol());
+	m_acceptor.set_option(tcp::acceptor::reuse_address(true));
+	m_acceptor.bind(endpoint);
+	m_acceptor.listen();
+	LogB << "Stratum proxy listening on port " << m_settings.port << " with " << m_slotUsed.size() - 1 << " nonce slots";
+
+	m_work.reset(new boost::asio::io_service::work(m_io));
+	m_io.post([this] () {
+		accept();
+		m_reportTimer.expires_from_now(boost::posix_time::seconds(c_reportInterval));
+		m_reportTimer.async_wait(boost::bind(&StratumProxy::report, this, boost::asio::placeholders::error));
+	});
+	m_ioThread = boost::thread([this] () {
+		dev::setThreadName("proxy");
+		for (;;)
+		{
+			try
+			{
+				m_io.run();
+				break;
+			}
+			catch (std::exception& e)
+			{
+				LogB << "StratumProxy io_service exception : " << e.what();
+				m_io.reset();
+			}
+		}
+	});
+
+	// our own farm mines in slot 0, so the upstream client hands it a narrower range from now on.
+	m_upstream.onNewJob([this] (EthashProofOfWork::WorkPackage const& _wp, unsigned _block) {
+		m_io.post(boost::bind(&StratumProxy::setJob, this, _wp, _block));
+	});
+	m_upstream.setLocalPartitionBits(m_settings.extraNonceBits);
+	EthashProofOfWork::WorkPackage current = m_upstream.currentWork();
+	if (current)
+		m_io.post(boost::bind(&StratumProxy::setJob, this, current, m_upstream.currentBlock()));
+}
+
+StratumProxy::~StratumProxy()
+{
+	m_upstream.onNewJob(nullptr);
+	m_upstream.setLocalPartitionBits(0);
+	m_io.post([this] () {
+		boost::system::error_code ignored;
+		m_acceptor.close(ignored);
+		m_reportTimer.cancel();
+		for (auto& s : m_sessions)
+			s->socket.close(ignored);
+		m_io.stop();
+	});
+	m_work.reset();
+	if (m_ioThread.joinable())
+		m_ioThread.join();
+	Guard l(x_sessions);
+	m_sessions.clear();
+}
+
+unsigned StratumProxy::sessionCount()
+{
+	Guard l(x_sessions);
+	return m_sessions.size();
+}
+
+string StratumProxy::summary()
+{
+	std::ostringstream ss;
+	Guard l(x_sessions);
+	for (auto const& s : m_sessions)
+		ss << describe(*s) << endl;
+	return ss.str();
+}
+
+string StratumProxy::describe(Session const& _s)
+{
+	Stats const& st = _s.stats;
+	double secs = duration_cast<seconds>(steady_clock::now() - _s.started).count();
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(2) << (_s.worker.empty() ? _s.remote : _s.worker + " (" + _s.remote + ")")
+	   << " slot " << _s.slot << " : " << (secs > 0 ? st.hashes / secs / 1000000 : 0) << " MH/s, "
+	   << st.valid << " shares, " << st.accepted << " accepted, " << st.rejected << " rejected, "
+	   << st.stale << " stale, " << st.invalid << " invalid";
+	return ss.str();
+}
+
+double StratumProxy::shareHashes(h256 const& _boundary)
+{
+	// a share takes 2^256 / boundary hashes on average.
+	u256 b = _boundary;
+	return b ? std::pow(2.0, 256) / b.convert_to<double>() : 0;
+}
+
+uint64_t StratumProxy::slotStart(unsigned _slot) const
+{
+	return m_job.startNonce | ((uint64_t) _slot << (64 - fixedBits()));
+}
+
+void StratumProxy::report(boost::system::error_code const& ec)
+{
+	if (ec)
+		return;
+	string s = summary();
+	if (!s.empty())
+		LogF << "Stratum proxy : " << sessionCount() << " miner(s)\n" << s;
+	m_reportTimer.expires_from_now(boost::posix_time::seconds(c_reportInterval));
+	m_reportTimer.async_wait(boost::bind(&StratumProxy::report, this, boost::asio::placeholders::error));
+}
+
+/*-----------------------------------------------------------------------------------
+* accept
+*----------------------------------------------------------------------------------*/
+void StratumProxy::accept()
+{
+	SessionPtr s = std::make_shared<Session>(m_io);
+	m_acceptor.async_accept(s->socket, [this, s] (boost::system::error_code const& ec) { accepted(s, ec); });
+}
+
+void StratumProxy::accepted(SessionPtr _s, boost::system::error_code const& ec)
+{
+	if (ec == boost::asio::error::operation_aborted)
+		return;
+	if (!ec)
+	{
+		boost::system::error_code ignored;
+		_s->remote = _s->socket.remote_endpoint(ignored).address().to_string();
+		_s->socket.set_option(tcp::no_delay(true), ignored);
+		_s->started = steady_clock::now();
+		LogB << "Stratum proxy : miner connected from " << _s->remote;
+		DEV_GUARDED(x_sessions)
+			m_sessions.push_back(_s);
+		setDeadline(_s, m_settings.loginTimeout, "did not log in within " + toString(m_settings.loginTimeout) + " seconds");
+		read(_s);
+	}
+	else
+		LogF << "Stratum proxy : accept failed : " << ec.message();
+	accept();
+}
+
+/*-----------------------------------------------------------------------------------
+* read / received
+*----------------------------------------------------------------------------------*/
+void StratumProxy::read(SessionPtr _s)
+{
+	boost::asio::async_read_until(_s->socket, _s->buffer, "\n",
+		[this, _s] (boost::system::error_code const& ec, std::size_t) { received(_s, ec); });
+}
+
+void StratumProxy::received(SessionPtr _s, boost::system::error_code const& ec)
+{
+	if (_s->closed)
+		return;
+	if (ec)
+	{
+		close(_s, ec == boost::asio::error::not_found ? "line too long" : ec.message());
+		return;
+	}
+
+	std::istream is(&_s->buffer);
+	string line;
+	getline(is, line);
+
+	Json::Value msg;
+	Json::Reader reader;
+	if (!reader.parse(line, msg) || !msg.isObject())
+	{
+		close(_s, "invalid message : " + line);
+		return;
+	}
+	process(_s, msg);
+	if (_s->closed)
+		return;
+	// the login deadline keeps running until the miner is in.  from then on, any message
+	// pushes the idle deadline back.
+	if (_s->subscribed && _s->authorized)
+		setDeadline(_s, m_settings.idleTimeout, "nothing received in " + toString(m_settings.idleTimeout) + " seconds");
+	read(_s);
+}
+
+void StratumProxy::setDeadline(SessionPtr _s, unsigned _seconds, string const& _why)
+{
+	if (!_seconds)
+	{
+		_s->deadline.cancel();
+		return;
+	}
+	// setting a new expiry aborts the previous wait.
+	_s->deadline.expires_from_now(boost::posix_time::seconds(_seconds));
+	_s->deadline.async_wait([this, _s, _why] (boost::system::error_code const& ec) {
+		if (!ec && !_s->closed)
+			close(_s, _why);
+	});
+}
+
+void StratumProxy::process(SessionPtr _s, Json::Value const& _msg)
+{
+	Json::Value id = _msg.get("id", Json::Value::null);
+	Json::Value params = _msg.get("params", Json::Value::null);
+	string method = _msg.get("method", "").asString();
+
+	if (method == "mining.subscribe")
+		subscribe(_s, id);
+	else if (method == "mining.authorize")
+		authorize(_s, id, params);
+	else if (method == "mining.submit")
+		submit(_s, id, params);
+	else if (method == "")
+		// eg. the answer to a client.get_version.  we don't ask anything, so ignore it.
+		return;
+	else
+		reply(_s, id, false, "Unsupported method " + method);
+}
+
+/*-----------------------------------------------------------------------------------
+* subscribe
+*   - hand out a nonce slot, then the current job.
+*----------------------------------------------------------------------------------*/
+void StratumProxy::subscribe(SessionPtr _s, Json::Value const& _id)
+{
+	if (!_s->subscribed)
+	{
+		unsigned slot = 1;
+		while (slot < m_slotUsed.size() && m_slotUsed[slot])
+			slot++;
+		if (slot == m_slotUsed.size())
+		{
+			reply(_s, _id, false, "No free nonce slots");
+			close(_s, "no free nonce slots.  increase [Proxy] ExtraNonceBits");
+			return;
+		}
+		m_slotUsed[slot] = true;
+		DEV_GUARDED(x_sessions)
+		{
+			_s->slot = slot;
+			_s->subscribed = true;
+		}
+	}
+	sendExtraNonce(_s);
+
+	// the reply to subscribe carries the current job, the same as the upstream pool does.
+	Json::Value res;
+	res["id"] = _id;
+	res["error"] = Json::Value::null;
+	if (m_job)
+	{
+		std::ostringstream block;
+		block << std::hex << m_block;
+		res["result"].append("0x" + m_job.headerHash.hex());
+		res["result"].append("0x" + m_job.headerHash.hex());
+		res["result"].append("0x" + m_job.seedHash.hex());
+		res["result"].append("0x" + m_job.boundary.hex());
+		res["result"].append(block.str());
+	}
+	else
+		res["result"] = true;
+	write(_s, jsonString(res));
+}
+
+void StratumProxy::authorize(SessionPtr _s, Json::Value const& _id, Json::Value const& _params)
+{
+	string worker = _params.get((Json::Value::ArrayIndex) 0, "").asString();
+	string password = _params.get((Json::Value::ArrayIndex) 1, "").asString();
+	if (!m_settings.password.empty() && password != m_settings.password)
+	{
+		reply(_s, _id, false, "Invalid password");
+		close(_s, "invalid password");
+		return;
+	}
+	DEV_GUARDED(x_sessions)
+	{
+		_s->worker = worker;
+		_s->authorized = true;
+	}
+	reply(_s, _id, true);
+}
+
+/*-----------------------------------------------------------------------------------
+* submit
+*   - params : [worker, job id, nonce, header, mix hash]
+*----------------------------------------------------------------------------------*/
+void StratumProxy::submit(SessionPtr _s, Json::Value const& _id, Json::Value const& _params)
+{
+	if (!_s->subscribed || !_s->authorized)
+	{
+		reply(_s, _id, false, "Not authorized");
+		return;
+	}
+
+	string sNonce = _params.get((Json::Value::ArrayIndex) 2, "").asString();
+	string sHeader = _params.get((Json::Value::ArrayIndex) 3, "").asString();
+	string sMix = _params.get((Json::Value::ArrayIndex) 4, "").asString();
+	if (sNonce.size() > 2 && sNonce.substr(0, 2) == "0x")
+		sNonce = sNonce.substr(2);
+	h256 header(sHeader);
+	h256 mix(sMix);
+	Nonce nonce(sNonce);
+
+	string problem;
+	EthashProofOfWork::WorkPackage const* job = nullptr;
+	bool stale = false;
+	if (m_job && header == m_job.headerHash)
+		job = &m_job;
+	else if (m_previousJob && header == m_previousJob.headerHash)
+	{
+		job = &m_previousJob;
+		stale = true;
+	}
+
+	uint64_t n = fromBigEndian<uint64_t>(nonce.ref());
+	uint64_t mask = ~0ull << (64 - fixedBits());
+	if (!job)
+		problem = "Job not found";
+	else if (sNonce.size() != 16 || (n & mask) != slotStart(_s->slot))
+		problem = "Nonce outside of the assigned range";
+	else if (!(stale ? m_previousSubmitted : m_submitted).insert(n).second)
+		problem = "Duplicate share";
+
+	if (!problem.empty())
+	{
+		shareChecked(_s, _id, problem, false, h256(), header, nonce, mix);
+		return;
+	}
+
+	// hashing a share takes a while against the light cache, so it's done on the
+	// verification engine's threads and the I/O thread carries on.  the answer comes back
+	// here to be forwarded.
+	std::weak_ptr<Session> weak = _s;
+	Json::Value id = _id;
+	h256 boundary = job->boundary;
+	VerificationEngine::Request req{job->seedHash, header, nonce, mix};
+	VerificationEngine::get().verify(req, [this, weak, id, req, boundary, stale] (EthashProofOfWork::Result const& _r) {
+		string problem;
+		if (_r.value >= boundary)
+			problem = "Low difficulty share";
+		else if (_r.mixHash != req.mix)
+			problem = "Invalid mix hash";
+		if (SessionPtr s = weak.lock())
+			m_io.post([=] () { shareChecked(s, id, problem, stale, boundary, req.header, req.nonce, req.mix); });
+	});
+}
+
+void StratumProxy::shareChecked(SessionPtr _s, Json::Value const& _id, string const& _problem, bool _stale, h256 const& _boundary, h256 const& _header, Nonce const& _nonce, h256 const& _mix)
+{
+	if (!_problem.empty())
+	{
+		DEV_GUARDED(x_sessions)
+			_s->stats.invalid++;
+		LogB << "Stratum proxy : invalid share from " << (_s->worker.empty() ? _s->remote : _s->worker) << " : " << _problem;
+		if (!_s->closed)
+			reply(_s, _id, false, _problem);
+		return;
+	}
+
+	DEV_GUARDED(x_sessions)
+	{
+		_s->stats.valid++;
+		_s->stats.hashes += shareHashes(_boundary);
+		if (_stale)
+			_s->stats.stale++;
+	}
+	LogB << "Share from " << (_s->worker.empty() ? _s->remote : _s->worker) << (_stale ? " (stale)" : "") << "; Submitting to pool ...";
+
+	// the pool answers on the upstream I/O thread.
+	std::weak_ptr<Session> weak = _s;
+	Json::Value id = _id;
+	m_upstream.submitShare(_header, _nonce, _mix, [this, weak, id] (bool _accepted) {
+		if (SessionPtr s = weak.lock())
+			m_io.post(boost::bind(&StratumProxy::shareAnswered, this, s, id, _accepted));
+	});
+}
+
+void StratumProxy::shareAnswered(SessionPtr _s, Json::Value const& _id, bool _accepted)
+{
+	DEV_GUARDED(x_sessions)
+		if (_accepted)
+			_s->stats.accepted++;
+		else
+			_s->stats.rejected++;
+	if (!_s->closed)
+		reply(_s, _id, _accepted, _accepted ? "" : "Rejected by pool");
+}
+
+/*-----------------------------------------------------------------------------------
+* setJob
+*   - a new job from upstream.
+*----------------------------------------------------------------------------------*/
+void StratumProxy::setJob(EthashProofOfWork::WorkPackage const& _wp, unsigned _block)
+{
+	bool rangeChanged = _wp.startNonce != m_job.startNonce || _wp.exSizeBits != m_job.exSizeBits;
+	if (_wp.headerHash != m_job.headerHash)
+	{
+		m_previousJob = m_job;
+		m_previousSubmitted.swap(m_submitted);
+		m_submitted.clear();
+	}
+	if (!_wp)
+	{
+		// the upstream pool is gone.  downstream miners keep going until their work times out,
+		// and any shares they find will be refused.
+		m_job.reset();
+		return;
+	}
+	m_job = _wp;
+	m_block = _block;
+
+	std::vector<SessionPtr> sessions;
+	DEV_GUARDED(x_sessions)
+		sessions = m_sessions;
+	for (auto const& s : sessions)
+		if (s->subscribed)
+		{
+			if (rangeChanged)
+				sendExtraNonce(s);
+			sendJob(s);
+		}
+}
+
+void StratumProxy::sendExtraNonce(SessionPtr _s)
+{
+	write(_s, "{\"id\":null,\"method\":\"mining.set_extranonce\",\"params\":[\"" + hex64(slotStart(_s->slot)) + "\"," + toString(fixedBits()) + "]}");
+}
+
+void StratumProxy::sendJob(SessionPtr _s)
+{
+	std::ostringstream block;
+	block << std::hex << m_block;
+	write(_s, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"0x" + m_job.headerHash.hex() + "\",\"0x" + m_job.headerHash.hex() +
+		"\",\"0x" + m_job.seedHash.hex() + "\",\"0x" + m_job.boundary.hex() + "\",\"" + block.str() + "\"]}");
+}
+
+void StratumProxy::reply(SessionPtr _s, Json::Value const& _id, bool _result, string const& _error)
+{
+	string error = "null";
+	if (!_error.empty())
+	{
+		Json::Value e;
+		e.append(20);
+		e.append(_error);
+		e.append(Json::Value::null);
+		error = jsonString(e);
+	}
+	write(_s, "{\"id\":" + jsonString(_id) + ",\"result\":" + (_result ? "true" : "false") + ",\"error\":" + error + "}");
+}
+
+/*-----------------------------------------------------------------------------------
+* write
+*----------------------------------------------------------------------------------*/
+void StratumProxy::write(SessionPtr _s, string const& _line)
+{
+	if (_s->closed)
+		return;
+	_s->writeQueue.push_back(_line + "\n");
+	if (_s->writeQueue.size() == 1)
+		writeNext(_s);
+}
+
+void StratumProxy::writeNext(SessionPtr _s)
+{
+	boost::asio::async_write(_s->socket, boost::asio::buffer(_s->writeQueue.front()),
+		[this, _s] (boost::system::error_code const& ec, std::size_t) {
+			if (_s->closed)
+				return;
+			if (ec)
+			{
+				close(_s, ec.message());
+				return;
+			}
+			_s->writeQueue.pop_front();
+			if (!_s->writeQueue.empty())
+				writeNext(_s);
+		});
+}
+
+void StratumProxy::close(SessionPtr _s, string const& _why)
+{
+	if (_s->closed)
+		return;
+	_s->closed = true;
+	boost::system::error_code ignored;
+	_s->deadline.cancel(ignored);
+	_s->socket.close(ignored);
+	if (_s->subscribed)
+		m_slotUsed[_s->slot] = false;
+
+	LogB << "Stratum proxy : miner " << (_s->worker.empty() ? _s->remote : _s->worker) << " disconnected (" << _why << ")";
+	DEV_GUARDED(x_sessions)
+	{
+		LogF << "Stratum proxy : " << describe(*_s);
+		m_sessions.erase(std::remove(m_sessions.begin(), m_sessions.end(), _s), m_sessions.end());
+	}
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// local stratum proxy.  this ethminer keeps its single connection to the pool, and acts as
+// a stratum server for other ethminers on the LAN, so a whole farm of rigs looks like one
+// miner to the pool.
+//
+// the nonce range we were given by the pool (all of it, unless the pool sends
+// mining.set_extranonce) is split in 2^ExtraNonceBits slots.  slot 0 is mined by our own
+// GPUs, and every downstream miner gets one of the others, announced with
+//
+//	{"id":null, "method":"mining.set_extranonce", "params":["<64 bit start nonce in hex>", <fixed bits>]}
+//
+// before its first job.  shares from downstream are checked against their slot, the nonces
+// already submitted for the job, and the job's boundary (hashed on the VerificationEngine's
+// threads) before they're forwarded upstream, and the pool's answer is routed back to the
+// miner that found them.  hashrate and shares are accounted per downstream miner.
+
+#include <map>
+#include <set>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <boost/asio.hpp>
+#include <json/json.h>
+#include <libdevcore/Guards.h>
+#include <libethcore/EthashAux.h>
+#include "EthStratumClient.h"
+
+
+class StratumProxy
+{
+public:
+	struct Settings
+	{
+		unsigned port = 0;
+		// the downstream miners get (2^bits - 1) slots between them.
+		unsigned extraNonceBits = 8;
+		// if set, downstream miners must log on with it.
+		string password;
+		// seconds a downstream miner gets to subscribe and authorize, and seconds it may go
+		// without sending us anything after that.  0 = no limit.
+		unsigned loginTimeout = 30;
+		unsigned idleTimeout = 900;
+	};
+
+	// _upstream must outlive the proxy.  jobs are taken from it as they arrive, and it takes
+	// care of our own farm, which mines in slot 0.
+	StratumProxy(EthStratumClient& _upstream, Settings const& _settings);
+	~StratumProxy();
+
+	unsigned sessionCount();
+	// one line per downstream miner.
+	string summary();
+
+private:
+	struct Stats
+	{
+		unsigned valid = 0;		// passed our checks, and were forwarded
+		unsigned accepted = 0;
+		unsigned rejected = 0;
+		unsigned invalid = 0;	// failed our checks
+		unsigned stale = 0;		// for the previous job
+		double hashes = 0;		// expected hashes behind the valid shares
+	};
+
+	struct Session : std::enable_shared_from_this<Session>
+	{
+		Session(boost::asio::io_service& _io) : socket(_io), deadline(_io), buffer(c_maxLine) {}
+
+		static const size_t c_maxLine = 4096;
+
+		tcp::socket socket;
+		// closes the session if the miner doesn't log in, or goes quiet.
+		boost::asio::deadline_timer deadline;
+		boost::asio::streambuf buffer;
+		std::deque<string> writeQueue;
+		string remote;
+		string worker;
+		unsigned slot = 0;
+		bool subscribed = false;
+		bool authorized = false;
+		bool closed = false;
+		std::chrono::steady_clock::time_point started;
+		Stats stats;
+	};
+	using SessionPtr = std::shared_ptr<Session>;
+
+	// everything below runs on our I/O thread.
+	void accept();
+	void accepted(SessionPtr _s, boost::system::error_code const& ec);
+	void read(SessionPtr _s);
+	void received(SessionPtr _s, boost::system::error_code const& ec);
+	void process(SessionPtr _s, Json::Value const& _msg);
+	void subscribe(SessionPtr _s, Json::Value const& _id);
+	void authorize(SessionPtr _s, Json::Value const& _id, Json::Value const& _params);
+	void submit(SessionPtr _s, Json::Value const& _id, Json::Value const& _params);
+	// a share has been hashed.  _problem is empty if it's good.
+	void shareChecked(SessionPtr _s, Json::Value const& _id, string const& _problem, bool _stale, h256 const& _boundary, h256 const& _header, Nonce const& _nonce, h256 const& _mix);
+	void shareAnswered(SessionPtr _s, Json::Value const& _id, bool _accepted);
+	void write(SessionPtr _s, string const& _line);
+	void writeNext(SessionPtr _s);
+	void close(SessionPtr _s, string const& _why);
+	void setDeadline(SessionPtr _s, unsigned _seconds, string const& _why);
+	void setJob(EthashProofOfWork::WorkPackage const& _wp, unsigned _block);
+	void sendExtraNonce(SessionPtr _s);
+	void sendJob(SessionPtr _s);
+	void reply(SessionPtr _s, Json::Value const& _id, bool _result, string const& _error = "");
+	void report(boost::system::error_code const& ec);
+
+	// first nonce and number of fixed bits for a slot.
+	uint64_t slotStart(unsigned _slot) const;
+	unsigned fixedBits() const { return std::max(m_job.exSizeBits, 0) + m_settings.extraNonceBits; }
+	static string describe(Session const& _s);
+	static double shareHashes(h256 const& _boundary);
+
+	EthStratumClient& m_upstream;
+	Settings m_settings;
+
+	boost::asio::io_service m_io;
+	std::unique_ptr<boost::asio::io_service::work> m_work;
+	tcp::acceptor m_acceptor;
+	boost::asio::deadline_timer m_reportTimer;
+	boost::thread m_ioThread;
+
+	// sessions and their stats are only changed on the I/O thread, but summary() may be
+	// called from any thread.
+	Mutex x_sessions;
+	std::vector<SessionPtr> m_sessions;
+	std::vector<bool> m_slotUsed;
+	EthashProofOfWork::WorkPackage m_job;
+	EthashProofOfWork::WorkPackage m_previousJob;
+	// nonces submitted for each of the two jobs, so a share is only forwarded once.
+	std::set<uint64_t> m_submitted;
+	std::set<uint64_t> m_previousSubmitted;
+	unsigned m_block = 0;
+};
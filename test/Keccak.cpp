@@ -0,0 +1,200 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_MODULE Keccak
+#include <boost/test/unit_test.hpp>
+
+#include <libdevcore/CommonData.h>
+#include <libethash/keccak.h>
+
+using namespace std;
+using namespace dev;
+
+
+namespace
+{
+
+// Keccak with the original padding, as Ethereum uses it.  the last message is longer than
+// a block at either rate.
+struct KnownAnswer
+{
+	bytes message;
+	string keccak256;
+	string keccak512;
+};
+
+bytes counting(size_t _size)
+{
+	bytes ret(_size);
+	for (size_t i = 0; i < _size; i++)
+		ret[i] = (uint8_t) i;
+	return ret;
+}
+
+vector<KnownAnswer> vectors()
+{
+	string const fox = "The quick brown fox jumps over the lazy dog";
+	return {
+		{bytes(),
+			"c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470",
+			"0eab42de4c3ceb9235fc91acffe746b29c29a8c366b7c60e4e67c466f36a4304c00fa9caf9d87976ba469bcbe06713b435f091ef2769fb160cdab33d3670680e"},
+		{asBytes("abc"),
+			"4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45",
+			"18587dc2ea106b9a1563e32b3312421ca164c7f1f07bc922a9c83d77cea3a1e5d0c69910739025372dc14ac9642629379540c17e2a65b19d77aa511a9d00bb96"},
+		{asBytes(fox),
+			"4d741b6f1eb29cb2a9b9911c82f56fa8d73b04959d3d9d222895df6c0b28aa15",
+			"d135bb84d0439dbac432247ee573a23ea7d3c9deb2a968eb31d47c4fb45f1ef4422d6c531b5b9bd6f449ebcc449ea94d0a8f05f62130fda612da53c79659f609"},
+		{counting(200),
+			"bfb0aa97863e797943cf7c33bb7e880bb4543f3d2703c0923c6901c2af57b890",
+			"f452d81b62b961f8023f8228cbe780379b36c49ddcef29e0dffb01a930c2cc53a694ed6ae3f0d224a2f1be55814a81841b90d56bcdf4a48a633f258a32dc14fc"},
+	};
+}
+
+// the backends the multi-buffer calls can use.  ones that aren't compiled in, or that this
+// CPU can't run, are skipped.
+char const* const c_backends[] = {"scalar", "avx2", "avx512"};
+
+// puts the automatically picked backend back when a test is done forcing others.
+struct RestoreBackend
+{
+	RestoreBackend(): original(ethash_keccak_backend()) {}
+	~RestoreBackend() { ethash_keccak_set_backend(original.c_str()); }
+	string original;
+};
+
+// hashes _count messages of _size bytes with the multi-buffer call, and each of them with
+// the single message one, which is always scalar.
+void compareMulti(size_t _outSize, size_t _size, unsigned _count, bool _inPlace)
+{
+	vector<bytes> messages;
+	for (unsigned m = 0; m < _count; m++)
+	{
+		// different in every message, so a backend mixing up its lanes shows.
+		bytes b = counting(max<size_t>(_size, _outSize));
+		for (auto& c : b)
+			c ^= (uint8_t) (m * 37 + 1);
+		messages.push_back(b);
+	}
+
+	vector<bytes> expected;
+	for (auto const& m : messages)
+	{
+		bytes out(_outSize);
+		if (_outSize == 32)
+			ethash_keccak256(out.data(), m.data(), _size);
+		else
+			ethash_keccak512(out.data(), m.data(), _size);
+		expected.push_back(out);
+	}
+
+	vector<bytes> outs(_count, bytes(_outSize));
+	vector<uint8_t*> out;
+	vector<uint8_t const*> in;
+	for (unsigned m = 0; m < _count; m++)
+	{
+		out.push_back(_inPlace ? messages[m].data() : outs[m].data());
+		in.push_back(messages[m].data());
+	}
+	if (_outSize == 32)
+		ethash_keccak256_multi(out.data(), in.data(), _size, _count);
+	else
+		ethash_keccak512_multi(out.data(), in.data(), _size, _count);
+
+	for (unsigned m = 0; m < _count; m++)
+		BOOST_CHECK_MESSAGE(bytes(out[m], out[m] + _outSize) == expected[m],
+			ethash_keccak_backend() << ": keccak" << _outSize * 8 << " of " << _count << " x " << _size << " bytes"
+			<< (_inPlace ? " in place" : "") << ", message " << m);
+}
+
+}
+
+
+BOOST_AUTO_TEST_CASE(knownAnswers)
+{
+	for (auto const& k : vectors())
+	{
+		bytes out256(32);
+		bytes out512(64);
+		ethash_keccak256(out256.data(), k.message.data(), k.message.size());
+		ethash_keccak512(out512.data(), k.message.data(), k.message.size());
+		BOOST_CHECK_EQUAL(toHex(out256), k.keccak256);
+		BOOST_CHECK_EQUAL(toHex(out512), k.keccak512);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(knownAnswersOnEveryBackend)
+{
+	RestoreBackend restore;
+	vector<KnownAnswer> const kas = vectors();
+	for (char const* name : c_backends)
+	{
+		if (!ethash_keccak_set_backend(name))
+		{
+			BOOST_TEST_MESSAGE("keccak backend " << name << " isn't available, skipped");
+			continue;
+		}
+		// every message at once, each one repeated to fill more than the widest backend.
+		for (auto const& k : kas)
+		{
+			vector<bytes> out256(ETHASH_KECCAK_LANES + 1, bytes(32));
+			vector<bytes> out512(ETHASH_KECCAK_LANES + 1, bytes(64));
+			vector<uint8_t*> p256;
+			vector<uint8_t*> p512;
+			vector<uint8_t const*> in(ETHASH_KECCAK_LANES + 1, k.message.data());
+			for (unsigned i = 0; i <= ETHASH_KECCAK_LANES; i++)
+			{
+				p256.push_back(out256[i].data());
+				p512.push_back(out512[i].data());
+			}
+			ethash_keccak256_multi(p256.data(), in.data(), k.message.size(), in.size());
+			ethash_keccak512_multi(p512.data(), in.data(), k.message.size(), in.size());
+			for (unsigned i = 0; i <= ETHASH_KECCAK_LANES; i++)
+			{
+				BOOST_CHECK_EQUAL(toHex(out256[i]), k.keccak256);
+				BOOST_CHECK_EQUAL(toHex(out512[i]), k.keccak512);
+			}
+		}
+	}
+}
+
+// every message count up to two full batches and a bit, at lengths either side of the
+// block boundaries.  the 64 byte in place case is how ethash uses keccak512.
+BOOST_AUTO_TEST_CASE(multiBufferMatchesScalar)
+{
+	RestoreBackend restore;
+	size_t const sizes[] = {0, 1, 31, 32, 63, 64, 71, 72, 73, 135, 136, 137, 200, 300};
+	for (char const* name : c_backends)
+	{
+		if (!ethash_keccak_set_backend(name))
+		{
+			BOOST_TEST_MESSAGE("keccak backend " << name << " isn't available, skipped");
+			continue;
+		}
+		BOOST_TEST_MESSAGE("keccak backend " << name);
+		for (unsigned count = 1; count <= 2 * ETHASH_KECCAK_LANES + 1; count++)
+			for (size_t size : sizes)
+			{
+				compareMulti(32, size, count, false);
+				compareMulti(64, size, count, false);
+			}
+		for (unsigned count = 1; count <= 2 * ETHASH_KECCAK_LANES + 1; count++)
+		{
+			compareMulti(32, 32, count, true);
+			compareMulti(64, 64, count, true);
+		}
+	}
+}
@@ -0,0 +1,892 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MockServers.h"
+
+#include <random>
+#include <sstream>
+#include <boost/bind.hpp>
+#include <libdevcore/Log.h>
+#include <libdevcore/SHA3.h>
+#include <libethcore/EthashAux.h>
+#include <libethcore/VerificationEngine.h>
+#include <ethminer/MultiLog.h>
+#include <ethminer/Misc.h>
+#include <ethminer/MVisFrame.h>
+
+using namespace std;
+using namespace std::chrono;
+using namespace dev;
+using namespace dev::eth;
+using boost::asio::ip::tcp;
+using boost::asio::ip::udp;
+
+namespace
+{
+	// how many jobs shares are accepted for.
+	const unsigned c_recentJobs = 8;
+
+	string jsonString(Json::Value const& _v)
+	{
+		Json::FastWriter fw;
+		fw.omitEndingLineFeed();
+		return fw.write(_v);
+	}
+
+	string hexBlock(unsigned _block)
+	{
+		ostringstream ss;
+		ss << "0x" << hex << _block;
+		return ss.str();
+	}
+
+	// runs _io until it's stopped, logging anything thrown by a handler.
+	void runIOS(boost::asio::io_service& _io, char const* _name)
+	{
+		setThreadName(_name);
+		for (;;)
+		{
+			try
+			{
+				_io.run();
+				return;
+			}
+			catch (std::exception& e)
+			{
+				LogB << _name << " io_service exception : " << e.what();
+				_io.reset();
+			}
+		}
+	}
+
+	// a share is valid if it meets the job's boundary and the mix hash is right.
+	bool checkShare(MockJobs::Job const& _job, Nonce const& _nonce, h256 const& _mix)
+	{
+		EthashProofOfWork::Result r = VerificationEngine::get().verify({_job.seed, _job.header, _nonce, _mix}).get();
+		return r.value < _job.boundary && r.mixHash == _mix;
+	}
+
+	Nonce parseNonce(string _s)
+	{
+		if (_s.size() > 2 && _s.substr(0, 2) == "0x")
+			_s = _s.substr(2);
+		return _s.size() == 16 ? Nonce(_s) : Nonce();
+	}
+
+	std::mt19937& rng()
+	{
+		static std::mt19937 s_rng(std::random_device{}());
+		return s_rng;
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class MockJobs
+*----------------------------------------------------------------------------------*/
+MockJobs::MockJobs(Settings const& _settings) : m_settings(_settings)
+{
+	if (!m_settings.difficulty)
+		m_settings.difficulty = 1;
+	if (m_settings.jitter >= m_settings.interval)
+		m_settings.jitter = m_settings.interval / 2;
+	// the first job is ready before anybody asks.
+	m_recent.push_back(next());
+}
+
+MockJobs::~MockJobs()
+{
+	{
+		std::unique_lock<std::mutex> l(x_jobs);
+		m_running = false;
+	}
+	m_stop.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void MockJobs::start()
+{
+	m_thread = std::thread(&MockJobs::run, this);
+}
+
+MockJobs::Job MockJobs::next()
+{
+	Job j;
+	j.id = m_nextId++;
+	j.header = sha3(toString(j.id) + toString(rng()()));
+	j.block = m_settings.block;
+	j.seed = EthashAux::seedHash(m_settings.block);
+	// 2^256 doesn't fit, so difficulty 1 gets the largest boundary there is.
+	j.boundary = m_settings.difficulty > 1 ? h256(u256((bigint(1) << 256) / m_settings.difficulty)) : ~h256();
+	j.issued = SteadyClock::now();
+	return j;
+}
+
+MockJobs::Job MockJobs::current()
+{
+	std::unique_lock<std::mutex> l(x_jobs);
+	return m_recent.back();
+}
+
+MockJobs::Job MockJobs::waitForNext(Job const& _job, unsigned _ms)
+{
+	std::unique_lock<std::mutex> l(x_jobs);
+	m_issued.wait_for(l, milliseconds(_ms), [&] () { return m_recent.back().id != _job.id; });
+	return m_recent.back();
+}
+
+bool MockJobs::find(h256 const& _header, Job& _job, bool& _latest)
+{
+	std::unique_lock<std::mutex> l(x_jobs);
+	for (unsigned i = 0; i < m_recent.size(); i++)
+		if (m_recent[i].header == _header)
+		{
+			_job = m_recent[i];
+			_latest = i == m_recent.size() - 1;
+			return true;
+		}
+	return false;
+}
+
+void MockJobs::run()
+{
+	setThreadName("mockjobs");
+	std::uniform_int_distribution<int> jitter(-(int) m_settings.jitter, (int) m_settings.jitter);
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> l(x_jobs);
+			auto wait = milliseconds((int) m_settings.interval + jitter(rng()));
+			if (m_stop.wait_for(l, wait, [&] () { return !m_running; }))
+				return;
+		}
+		issue();
+	}
+}
+
+MockJobs::Job MockJobs::issue(bool _newBlock)
+{
+	Job job;
+	{
+		std::unique_lock<std::mutex> l(x_jobs);
+		if (_newBlock)
+			m_settings.block++;
+		job = next();
+		m_recent.push_back(job);
+		if (m_recent.size() > c_recentJobs)
+			m_recent.pop_front();
+	}
+	LogF << "MockJobs : job " << job.id << " for block " << job.block << " " << job.header.hex();
+	for (auto const& h : m_handlers)
+		h(job);
+	m_issued.notify_all();
+	return job;
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class MockPool
+*----------------------------------------------------------------------------------*/
+MockPool::MockPool(MockJobs& _jobs, Settings const& _settings) :
+	m_jobs(_jobs),
+	m_settings(_settings),
+	m_acceptor(m_io),
+	m_dropTimer(m_io)
+{
+	tcp::endpoint endpoint(tcp::v4(), m_settings.port);
+	m_acceptor.open(endpoint.protocol());
+	m_acceptor.set_option(tcp::acceptor::reuse_address(true));
+	m_acceptor.bind(endpoint);
+	m_acceptor.listen();
+	m_port = m_acceptor.local_endpoint().port();
+	LogB << "Mock pool listening on port " << m_port;
+
+	m_jobs.onJob([this] (MockJobs::Job const& _job) {
+		m_io.post(boost::bind(&MockPool::notify, this, _job));
+	});
+
+	m_work.reset(new boost::asio::io_service::work(m_io));
+	m_io.post([this] () {
+		accept();
+		// with an error code, this only arms the timer.
+		dropAll(boost::asio::error::would_block);
+	});
+	m_ioThread = boost::thread(boost::bind(&runIOS, boost::ref(m_io), "mockpool"));
+}
+
+MockPool::~MockPool()
+{
+	m_io.post([this] () {
+		boost::system::error_code ignored;
+		m_acceptor.close(ignored);
+		m_dropTimer.cancel();
+		for (auto& s : m_sessions)
+			s->socket.close(ignored);
+		m_io.stop();
+	});
+	m_work.reset();
+	if (m_ioThread.joinable())
+		m_ioThread.join();
+}
+
+string MockPool::summary()
+{
+	Guard l(x_stats);
+	ostringstream ss;
+	ss << "Mock pool : " << m_stats.connections << " connections, " << m_stats.jobsSent << " notifies, "
+	   << m_stats.accepted << " accepted, " << m_stats.rejected << " rejected, " << m_stats.invalid << " invalid, " << m_stats.stale << " stale"
+	   << "\n  share age : " << m_shareAge.summary();
+	if (m_reconnect.count())
+		ss << "\n  reconnect : " << m_reconnect.summary();
+	return ss.str();
+}
+
+string MockPool::notifyParams(MockJobs::Job const& _job)
+{
+	return "[\"0x" + _job.header.hex() + "\",\"0x" + _job.header.hex() + "\",\"0x" + _job.seed.hex() + "\",\"0x" + _job.boundary.hex() + "\",\"" + hexBlock(_job.block) + "\"]";
+}
+
+void MockPool::accept()
+{
+	SessionPtr s = std::make_shared<Session>(m_io);
+	m_acceptor.async_accept(s->socket, [this, s] (boost::system::error_code const& ec) {
+		if (ec == boost::asio::error::operation_aborted)
+			return;
+		if (!ec)
+		{
+			boost::system::error_code ignored;
+			s->remote = s->socket.remote_endpoint(ignored).address().to_string();
+			s->socket.set_option(tcp::no_delay(true), ignored);
+			m_sessions.push_back(s);
+			DEV_GUARDED(x_stats)
+				m_stats.connections++;
+			LogF << "Mock pool : connection from " << s->remote;
+			boost::asio::async_read_until(s->socket, s->buffer, "\n", boost::bind(&MockPool::received, this, s, boost::asio::placeholders::error));
+		}
+		accept();
+	});
+}
+
+void MockPool::received(SessionPtr _s, boost::system::error_code const& ec)
+{
+	if (_s->closed)
+		return;
+	if (ec)
+	{
+		close(_s);
+		return;
+	}
+	istream is(&_s->buffer);
+	string line;
+	getline(is, line);
+	Json::Value msg;
+	Json::Reader reader;
+	if (reader.parse(line, msg) && msg.isObject())
+		process(_s, msg);
+	else
+		LogB << "Mock pool : invalid message from " << _s->remote << " : " << line;
+	if (!_s->closed)
+		boost::asio::async_read_until(_s->socket, _s->buffer, "\n", boost::bind(&MockPool::received, this, _s, boost::asio::placeholders::error));
+}
+
+void MockPool::process(SessionPtr _s, Json::Value const& _msg)
+{
+	Json::Value id = _msg.get("id", Json::Value::null);
+	string method = _msg.get("method", "").asString();
+	string sid = jsonString(id);
+
+	if (method == "mining.subscribe")
+	{
+		_s->subscribed = true;
+		auto it = m_dropped.find(_s->remote);
+		if (it != m_dropped.end())
+		{
+			DEV_GUARDED(x_stats)
+				m_reconnect.record(SteadyClock::now() - it->second);
+			m_dropped.erase(it);
+		}
+		reply(_s, "{\"id\":" + sid + ",\"result\":" + notifyParams(m_jobs.current()) + ",\"error\":null}");
+	}
+	else if (method == "mining.authorize")
+		reply(_s, "{\"id\":" + sid + ",\"result\":true,\"error\":null}");
+	else if (method == "mining.submit")
+		submit(_s, id, _msg.get("params", Json::Value::null));
+	else if (method != "")
+		reply(_s, "{\"id\":" + sid + ",\"result\":false,\"error\":[20,\"Unsupported method\",null]}");
+}
+
+void MockPool::submit(SessionPtr _s, Json::Value const& _id, Json::Value const& _params)
+{
+	// params : [worker, job id, nonce, header, mix hash]
+	Nonce nonce = parseNonce(_params.get((Json::Value::ArrayIndex) 2, "").asString());
+	h256 header(_params.get((Json::Value::ArrayIndex) 3, "").asString());
+	h256 mix(_params.get((Json::Value::ArrayIndex) 4, "").asString());
+
+	MockJobs::Job job;
+	bool latest = false;
+	bool accepted = false;
+	bool valid = m_jobs.find(header, job, latest) && checkShare(job, nonce, mix);
+	{
+		Guard l(x_stats);
+		if (!valid)
+			m_stats.invalid++;
+		else
+		{
+			m_shareAge.record(SteadyClock::now() - job.issued);
+			if (!latest)
+				m_stats.stale++;
+			accepted = std::uniform_int_distribution<unsigned>(0, 99)(rng()) >= m_settings.rejectRate;
+			if (accepted)
+				m_stats.accepted++;
+			else
+				m_stats.rejected++;
+		}
+	}
+	reply(_s, "{\"id\":" + jsonString(_id) + ",\"result\":" + (accepted ? "true" : "false") + ",\"error\":null}");
+}
+
+void MockPool::reply(SessionPtr _s, string const& _line)
+{
+	if (!m_settings.replyDelay)
+	{
+		write(_s, _line);
+		return;
+	}
+	auto timer = std::make_shared<boost::asio::deadline_timer>(m_io, boost::posix_time::milliseconds(m_settings.replyDelay));
+	timer->async_wait([this, _s, _line, timer] (boost::system::error_code const&) { write(_s, _line); });
+}
+
+void MockPool::write(SessionPtr _s, string const& _line)
+{
+	if (_s->closed)
+		return;
+	_s->writeQueue.push_back(_line + "\n");
+	if (_s->writeQueue.size() == 1)
+		writeNext(_s);
+}
+
+void MockPool::writeNext(SessionPtr _s)
+{
+	boost::asio::async_write(_s->socket, boost::asio::buffer(_s->writeQueue.front()),
+		[this, _s] (boost::system::error_code const& ec, std::size_t) {
+			if (_s->closed)
+				return;
+			if (ec)
+			{
+				close(_s);
+				return;
+			}
+			_s->writeQueue.pop_front();
+			if (!_s->writeQueue.empty())
+				writeNext(_s);
+		});
+}
+
+void MockPool::close(SessionPtr _s)
+{
+	if (_s->closed)
+		return;
+	_s->closed = true;
+	boost::system::error_code ignored;
+	_s->socket.close(ignored);
+	m_sessions.erase(std::remove(m_sessions.begin(), m_sessions.end(), _s), m_sessions.end());
+	LogF << "Mock pool : " << _s->remote << " disconnected";
+}
+
+void MockPool::notify(MockJobs::Job const& _job)
+{
+	if (m_stalled)
+		return;
+	if (!m_settings.notifyDelay)
+	{
+		broadcast(_job);
+		return;
+	}
+	auto timer = std::make_shared<boost::asio::deadline_timer>(m_io, boost::posix_time::milliseconds(m_settings.notifyDelay));
+	timer->async_wait([this, _job, timer] (boost::system::error_code const&) { broadcast(_job); });
+}
+
+void MockPool::broadcast(MockJobs::Job const& _job)
+{
+	string line = "{\"id\":null,\"method\":\"mining.notify\",\"params\":" + notifyParams(_job) + "}";
+	auto sessions = m_sessions;
+	for (auto const& s : sessions)
+		if (s->subscribed)
+		{
+			write(s, line);
+			DEV_GUARDED(x_stats)
+				m_stats.jobsSent++;
+		}
+}
+
+void MockPool::drop()
+{
+	m_io.post([this] () { dropSessions(); });
+}
+
+void MockPool::stall(bool _stalled)
+{
+	m_io.post([this, _stalled] () { m_stalled = _stalled; });
+}
+
+void MockPool::setRejectRate(unsigned _percent)
+{
+	m_io.post([this, _percent] () { m_settings.rejectRate = _percent; });
+}
+
+void MockPool::dropSessions()
+{
+	LogB << "Mock pool : dropping " << m_sessions.size() << " connection(s)";
+	auto now = SteadyClock::now();
+	auto sessions = m_sessions;
+	for (auto const& s : sessions)
+	{
+		m_dropped[s->remote] = now;
+		close(s);
+	}
+}
+
+void MockPool::dropAll(boost::system::error_code const& ec)
+{
+	if (ec == boost::asio::error::operation_aborted || !m_settings.disconnectInterval)
+		return;
+	if (!ec)
+		dropSessions();
+	m_dropTimer.expires_from_now(boost::posix_time::seconds(m_settings.disconnectInterval));
+	m_dropTimer.async_wait(boost::bind(&MockPool::dropAll, this, boost::asio::placeholders::error));
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class MockNode
+*----------------------------------------------------------------------------------*/
+MockNode::MockNode(MockJobs& _jobs, Settings const& _settings) :
+	m_jobs(_jobs),
+	m_settings(_settings),
+	m_acceptor(m_io)
+{
+	tcp::endpoint endpoint(tcp::v4(), m_settings.port);
+	m_acceptor.open(endpoint.protocol());
+	m_acceptor.set_option(tcp::acceptor::reuse_address(true));
+	m_acceptor.bind(endpoint);
+	m_acceptor.listen();
+	m_port = m_acceptor.local_endpoint().port();
+	LogB << "Mock node listening on port " << m_port;
+
+	if (!m_settings.notify.empty())
+	{
+		size_t colon = m_settings.notify.rfind(':');
+		m_notifyClient.reset(new KeepAliveHttpClient(m_settings.notify.substr(0, colon), colon == string::npos ? "80" : m_settings.notify.substr(colon + 1)));
+		m_notifyClient->setTimeout(2000);
+	}
+
+	m_jobs.onJob([this] (MockJobs::Job const& _job) {
+		// pushing blocks, so it's done here on the job thread rather than the I/O thread.
+		if (m_notifyClient)
+			push(_job);
+		m_io.post([this] () {
+			auto waiting = std::move(m_waiting);
+			m_waiting.clear();
+			for (auto const& w : waiting)
+				respond(w.first, w.second, work(m_jobs.current()));
+		});
+	});
+
+	m_work.reset(new boost::asio::io_service::work(m_io));
+	m_io.post(boost::bind(&MockNode::accept, this));
+	m_ioThread = boost::thread(boost::bind(&runIOS, boost::ref(m_io), "mocknode"));
+}
+
+MockNode::~MockNode()
+{
+	m_io.post([this] () {
+		boost::system::error_code ignored;
+		m_acceptor.close(ignored);
+		m_io.stop();
+	});
+	m_work.reset();
+	if (m_ioThread.joinable())
+		m_ioThread.join();
+}
+
+string MockNode::summary()
+{
+	Guard l(x_stats);
+	ostringstream ss;
+	ss << "Mock node : " << m_stats.requests << " requests, " << m_stats.accepted << " accepted, " << m_stats.rejected << " rejected";
+	if (m_notifyClient)
+		ss << ", " << m_stats.pushes << " pushes (" << m_stats.pushFailures << " failed)";
+	ss << "\n  share age : " << m_shareAge.summary();
+	return ss.str();
+}
+
+Json::Value MockNode::work(MockJobs::Job const& _job)
+{
+	Json::Value w(Json::arrayValue);
+	w.append("0x" + _job.header.hex());
+	w.append("0x" + _job.seed.hex());
+	w.append("0x" + _job.boundary.hex());
+	w.append(hexBlock(_job.block));
+	return w;
+}
+
+void MockNode::push(MockJobs::Job const& _job)
+{
+	Json::Value body;
+	body["jsonrpc"] = "2.0";
+	body["id"] = 0;
+	body["result"] = work(_job);
+	try
+	{
+		m_notifyClient->post(jsonString(body));
+		DEV_GUARDED(x_stats)
+			m_stats.pushes++;
+	}
+	catch (std::exception const& e)
+	{
+		LogF << "Mock node : push to " << m_settings.notify << " failed : " << e.what();
+		m_notifyClient->close();
+		DEV_GUARDED(x_stats)
+			m_stats.pushFailures++;
+	}
+}
+
+void MockNode::accept()
+{
+	SessionPtr s = std::make_shared<Session>(m_io);
+	m_acceptor.async_accept(s->socket, [this, s] (boost::system::error_code const& ec) {
+		if (ec == boost::asio::error::operation_aborted)
+			return;
+		if (!ec)
+		{
+			boost::system::error_code ignored;
+			s->socket.set_option(tcp::no_delay(true), ignored);
+			readHeaders(s);
+		}
+		accept();
+	});
+}
+
+void MockNode::readHeaders(SessionPtr _s)
+{
+	boost::asio::async_read_until(_s->socket, _s->buffer, "\r\n\r\n", [this, _s] (boost::system::error_code const& ec, std::size_t _bytes) {
+		if (ec)
+		{
+			_s->closed = true;
+			return;
+		}
+		string headers(boost::asio::buffer_cast<char const*>(_s->buffer.data()), _bytes);
+		_s->buffer.consume(_bytes);
+		size_t length = 0;
+		string lower = LowerCase(headers);
+		size_t pos = lower.find("content-length:");
+		if (pos != string::npos)
+			length = strToInt(headers.substr(pos + 15, headers.find("\r\n", pos) - pos - 15), 0);
+		readBody(_s, length);
+	});
+}
+
+void MockNode::readBody(SessionPtr _s, size_t _length)
+{
+	size_t have = _s->buffer.size();
+	if (have >= _length)
+	{
+		string body(boost::asio::buffer_cast<char const*>(_s->buffer.data()), _length);
+		_s->buffer.consume(_length);
+		process(_s, body);
+		return;
+	}
+	boost::asio::async_read(_s->socket, _s->buffer, boost::asio::transfer_exactly(_length - have), [this, _s, _length] (boost::system::error_code const& ec, std::size_t) {
+		if (ec)
+			_s->closed = true;
+		else
+			readBody(_s, _length);
+	});
+}
+
+void MockNode::process(SessionPtr _s, string const& _body)
+{
+	Json::Value req;
+	Json::Reader reader;
+	if (!reader.parse(_body, req) || !req.isObject())
+	{
+		respond(_s, Json::Value::null, Json::Value::null);
+		return;
+	}
+	Json::Value id = req.get("id", Json::Value::null);
+	Json::Value params = req.get("params", Json::Value::null);
+	string method = req.get("method", "").asString();
+	DEV_GUARDED(x_stats)
+	{
+		m_stats.requests++;
+		m_stats.getWorks += method == "eth_getWork";
+		m_stats.awaitNewWorks += method == "eth_awaitNewWork";
+	}
+
+	if (method == "eth_getWork")
+		respond(_s, id, work(m_jobs.current()));
+	else if (method == "eth_awaitNewWork")
+		// answered by the next job.
+		m_waiting.push_back(make_pair(_s, id));
+	else if (method == "eth_submitWork")
+	{
+		// params : [nonce, header, mix hash]
+		Nonce nonce = parseNonce(params.get((Json::Value::ArrayIndex) 0, "").asString());
+		h256 header(params.get((Json::Value::ArrayIndex) 1, "").asString());
+		h256 mix(params.get((Json::Value::ArrayIndex) 2, "").asString());
+		MockJobs::Job job;
+		bool latest;
+		bool ok = m_jobs.find(header, job, latest) && checkShare(job, nonce, mix);
+		DEV_GUARDED(x_stats)
+		{
+			if (ok)
+			{
+				m_stats.accepted++;
+				m_shareAge.record(SteadyClock::now() - job.issued);
+			}
+			else
+				m_stats.rejected++;
+		}
+		respond(_s, id, ok);
+	}
+	else if (method == "eth_submitHashrate" || method == "eth_progress")
+		respond(_s, id, method == "eth_submitHashrate");
+	else
+		respond(_s, id, Json::Value::null);
+}
+
+void MockNode::respond(SessionPtr _s, Json::Value const& _id, Json::Value const& _result)
+{
+	if (!m_settings.replyDelay)
+	{
+		send(_s, _id, _result);
+		return;
+	}
+	auto timer = std::make_shared<boost::asio::deadline_timer>(m_io, boost::posix_time::milliseconds(m_settings.replyDelay));
+	timer->async_wait([this, _s, _id, _result, timer] (boost::system::error_code const&) { send(_s, _id, _result); });
+}
+
+void MockNode::send(SessionPtr _s, Json::Value const& _id, Json::Value const& _result)
+{
+	if (_s->closed)
+		return;
+	Json::Value res;
+	res["jsonrpc"] = "2.0";
+	res["id"] = _id;
+	if (_result.isNull() && _id.isNull())
+		res["error"]["code"] = -32700;
+	else if (_result.isNull())
+		res["error"]["code"] = -32601;
+	else
+		res["result"] = _result;
+	string body = jsonString(res);
+	_s->response = "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nConnection: keep-alive\r\nContent-Length: " + toString(body.size()) + "\r\n\r\n" + body;
+	boost::asio::async_write(_s->socket, boost::asio::buffer(_s->response), [this, _s] (boost::system::error_code const& ec, std::size_t) {
+		if (ec)
+			_s->closed = true;
+		else
+			readHeaders(_s);
+	});
+}
+
+
+/*-----------------------------------------------------------------------------------
+* class MockMVisClient
+*----------------------------------------------------------------------------------*/
+MockMVisClient::MockMVisClient(Settings const& _settings) :
+	m_settings(_settings),
+	m_socket(m_io, udp::endpoint(udp::v4(), _settings.returnPort)),
+	m_timer(m_io)
+{
+	m_returnPort = m_socket.local_endpoint().port();
+	udp::resolver resolver(m_io);
+	m_miner = *resolver.resolve(udp::resolver::query(udp::v4(), m_settings.host, toString(m_settings.port)));
+	LogB << "Mock MVis client talking to " << m_settings.host << ":" << m_settings.port << " from port " << m_returnPort;
+
+	m_io.post([this] () {
+		receive();
+		tick(boost::system::error_code());
+	});
+	m_ioThread = boost::thread(boost::bind(&runIOS, boost::ref(m_io), "mockmvis"));
+}
+
+MockMVisClient::~MockMVisClient()
+{
+	// the miner only talks to one client at a time, so let it go before the next one comes.
+	if (m_connected)
+	{
+		Json::Value cmd;
+		cmd["command"] = "disconnect";
+		command(cmd);
+		auto until = SteadyClock::now() + seconds(2);
+		while (m_connected && SteadyClock::now() < until)
+			this_thread::sleep_for(milliseconds(10));
+	}
+	m_io.post([this] () {
+		boost::system::error_code ignored;
+		m_timer.cancel();
+		m_socket.close(ignored);
+		m_io.stop();
+	});
+	if (m_ioThread.joinable())
+		m_ioThread.join();
+}
+
+string MockMVisClient::summary()
+{
+	Guard l(x_stats);
+	ostringstream ss;
+	ss << "Mock MVis : " << (m_connected ? "connected" : "not connected") << ", " << m_stats.pings << " pings, " << m_stats.replies << " replies, "
+	   << m_stats.lost << " lost, " << m_stats.workPackages << " work packages, " << m_stats.frames << " binary frames, " << m_stats.other << " other packets"
+	   << "\n  round trip : " << m_roundTrip.summary();
+	return ss.str();
+}
+
+void MockMVisClient::command(Json::Value _cmd)
+{
+	m_io.post([this, _cmd] () {
+		Json::Value cmd = _cmd;
+		cmd["id"] = m_nextId++;
+		send(cmd);
+	});
+}
+
+void MockMVisClient::send(Json::Value _cmd)
+{
+	_cmd["return_port"] = m_returnPort;
+	auto message = std::make_shared<string>(jsonString(_cmd));
+	m_socket.async_send_to(boost::asio::buffer(*message), m_miner, [message] (boost::system::error_code const&, std::size_t) {});
+}
+
+void MockMVisClient::tick(boost::system::error_code const& ec)
+{
+	if (ec == boost::asio::error::operation_aborted)
+		return;
+
+	// anything that's been out for more than 5 pings is lost.
+	auto now = SteadyClock::now();
+	for (auto it = m_outstanding.begin(); it != m_outstanding.end(); )
+		if (now - it->second > milliseconds(5 * m_settings.pingInterval))
+		{
+			DEV_GUARDED(x_stats)
+				m_stats.lost++;
+			it = m_outstanding.erase(it);
+		}
+		else
+			++it;
+
+	Json::Value cmd;
+	cmd["id"] = m_nextId++;
+	if (!m_connected)
+	{
+		cmd["command"] = "connect";
+		cmd["miner_id"] = 1;
+		cmd["rpc_version"] = m_settings.rpcVersion;
+		cmd["password"] = m_settings.password;
+	}
+	else
+	{
+		cmd["command"] = "ping";
+		m_outstanding[cmd["id"].asUInt()] = now;
+		DEV_GUARDED(x_stats)
+			m_stats.pings++;
+		send(cmd);
+		cmd["id"] = m_nextId++;
+		cmd["command"] = "keep_alive";
+	}
+	send(cmd);
+
+	m_timer.expires_from_now(boost::posix_time::milliseconds(m_settings.pingInterval));
+	m_timer.async_wait(boost::bind(&MockMVisClient::tick, this, boost::asio::placeholders::error));
+}
+
+void MockMVisClient::receive()
+{
+	m_socket.async_receive_from(boost::asio::buffer(m_buffer), m_from,
+		boost::bind(&MockMVisClient::received, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+
+void MockMVisClient::received(boost::system::error_code const& ec, std::size_t _bytes)
+{
+	if (ec == boost::asio::error::operation_aborted)
+		return;
+	if (!ec && _bytes >= 2 && m_buffer[0] == 'M' && m_buffer[1] == 'V')
+		receivedFrame(_bytes);
+	else if (!ec)
+	{
+		auto now = SteadyClock::now();
+		Json::Value v;
+		Json::Reader reader;
+		if (reader.parse(m_buffer.data(), m_buffer.data() + _bytes, v) && v.isObject())
+		{
+			string data = v.get("data_id", "").asString();
+			auto it = m_outstanding.find(v.get("id", 0).asUInt());
+			if (data == "connect")
+			{
+				m_connected = !v.isMember("error");
+				DEV_GUARDED(x_stats)
+					m_error = v.get("error", "").asString();
+				LogB << "Mock MVis : " << (m_connected ? "connected" : "connect failed : " + v["error"].asString());
+			}
+			else if (data == "disconnect")
+			{
+				m_connected = false;
+				LogB << "Mock MVis : disconnected";
+			}
+			else if (data == "ping" && it != m_outstanding.end())
+			{
+				DEV_GUARDED(x_stats)
+				{
+					m_stats.replies++;
+					m_roundTrip.record(now - it->second);
+				}
+				m_outstanding.erase(it);
+			}
+			else if (data == "work_package" && v.get("type", "").asString() == "notify")
+				DEV_GUARDED(x_stats)
+					m_stats.workPackages++;
+			else if (v.get("type", "").asString() == "notify")
+				DEV_GUARDED(x_stats)
+					m_stats.other++;
+		}
+	}
+	receive();
+}
+
+void MockMVisClient::receivedFrame(std::size_t _bytes)
+{
+	// 'M' 'V' version:u8 miner_id:u16 count:u8, then count * (type:u8 length:u16 payload).
+	// see MVisFrame.h.
+	unsigned char const* p = (unsigned char const*) m_buffer.data();
+	if (_bytes < 6)
+		return;
+	unsigned count = p[5];
+	size_t pos = 6;
+	Guard l(x_stats);
+	m_stats.frames++;
+	for (unsigned i = 0; i < count && pos + 3 <= _bytes; i++)
+	{
+		unsigned type = p[pos];
+		unsigned length = p[pos + 1] | (p[pos + 2] << 8);
+		if (type == (unsigned) MVisEvent::WorkPackage)
+			m_stats.workPackages++;
+		else
+			m_stats.other++;
+		pos += 3 + length;
+	}
+}
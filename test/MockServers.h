@@ -0,0 +1,339 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// scriptable stand-ins for everything ethminer talks to over the network, so the stratum,
+// getWork and MVis code can be tested (and timed) without a live node, pool or MVis (see
+// Protocols.cpp and ProtocolBench.cpp).
+//
+//	MockJobs		generates jobs at a configurable rate, with jitter
+//	MockPool		stratum server.  verifies shares, and can delay replies or jobs, stall,
+//					reject a percentage of shares and drop every connection at intervals
+//	MockNode		HTTP JSON-RPC node.  eth_getWork, eth_submitWork, eth_submitHashrate,
+//					eth_awaitNewWork, and optionally pushes new work like geth --miner.notify
+//	MockMVisClient	the MVis side of the UDP protocol.  logs on, then pings and times
+//					the replies, and counts the notifications it gets
+//
+// each one counts what it sees in stats(), and logs latencies with summary().
+
+#include <map>
+#include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <string>
+#include <functional>
+#include <condition_variable>
+#include <boost/asio.hpp>
+#include <boost/thread.hpp>
+#include <json/json.h>
+#include <libdevcore/Guards.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Histogram.h>
+#include <ethminer/KeepAliveHttpClient.h>
+#include <ethminer/Common.h>
+
+
+/*-----------------------------------------------------------------------------------
+* class MockJobs
+*----------------------------------------------------------------------------------*/
+class MockJobs
+{
+public:
+	struct Settings
+	{
+		unsigned interval = 15000;		// ms between jobs
+		unsigned jitter = 0;			// +/- ms
+		unsigned block = 0;				// block number, which determines the epoch
+		uint64_t difficulty = 1ull << 32;	// expected hashes per share
+	};
+
+	struct Job
+	{
+		unsigned id = 0;
+		dev::h256 header;
+		dev::h256 seed;
+		dev::h256 boundary;
+		unsigned block = 0;
+		SteadyClock::time_point issued;
+		operator bool() const { return id != 0; }
+	};
+
+	using JobFn = std::function<void(Job const&)>;
+
+	MockJobs(Settings const& _settings);
+	~MockJobs();
+
+	// called on the job thread, or the caller's for issue().  all subscribers must be added
+	// before start() or the first issue().
+	void onJob(JobFn const& _handler) { m_handlers.push_back(_handler); }
+	void start();
+	// a new job right now, on top of the timed ones.  _newBlock moves on to the next block.
+	Job issue(bool _newBlock = false);
+
+	Job current();
+	// waits up to _ms for a job newer than _job.  returns the current job either way.
+	Job waitForNext(Job const& _job, unsigned _ms);
+	// looks _header up among the recent jobs.  _latest says whether it's the newest one.
+	bool find(dev::h256 const& _header, Job& _job, bool& _latest);
+
+private:
+	void run();
+	Job next();
+
+	Settings m_settings;
+	std::vector<JobFn> m_handlers;
+
+	std::mutex x_jobs;
+	std::condition_variable m_stop;
+	std::condition_variable m_issued;
+	bool m_running = true;
+	std::deque<Job> m_recent;
+	unsigned m_nextId = 1;
+	std::thread m_thread;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class MockPool
+*----------------------------------------------------------------------------------*/
+class MockPool
+{
+public:
+	struct Settings
+	{
+		unsigned port = 0;
+		unsigned replyDelay = 0;		// ms before answering anything
+		unsigned notifyDelay = 0;		// ms before passing a new job on
+		unsigned rejectRate = 0;		// percentage of valid shares to reject anyway
+		unsigned disconnectInterval = 0;	// s between dropping every connection.  0 = never
+	};
+
+	struct Stats
+	{
+		unsigned connections = 0;
+		unsigned jobsSent = 0;
+		unsigned accepted = 0;
+		unsigned rejected = 0;
+		unsigned invalid = 0;
+		unsigned stale = 0;		// valid, but not for the latest job
+	};
+
+	// Settings::port 0 picks a free port.  see port().
+	MockPool(MockJobs& _jobs, Settings const& _settings);
+	~MockPool();
+
+	unsigned port() const { return m_port; }
+	Stats stats() { dev::Guard l(x_stats); return m_stats; }
+	std::string summary();
+	// closes every connection, as if the pool had restarted.
+	void drop();
+	// a stalled pool stays connected and answers shares, but passes no new jobs on.
+	void stall(bool _stalled);
+	void setRejectRate(unsigned _percent);
+
+private:
+	struct Session
+	{
+		Session(boost::asio::io_service& _io) : socket(_io), buffer(4096) {}
+		boost::asio::ip::tcp::socket socket;
+		boost::asio::streambuf buffer;
+		std::deque<std::string> writeQueue;
+		std::string remote;
+		bool subscribed = false;
+		bool closed = false;
+	};
+	using SessionPtr = std::shared_ptr<Session>;
+
+	// all on the I/O thread.
+	void accept();
+	void received(SessionPtr _s, boost::system::error_code const& ec);
+	void process(SessionPtr _s, Json::Value const& _msg);
+	void submit(SessionPtr _s, Json::Value const& _id, Json::Value const& _params);
+	void reply(SessionPtr _s, std::string const& _line);
+	void write(SessionPtr _s, std::string const& _line);
+	void writeNext(SessionPtr _s);
+	void close(SessionPtr _s);
+	void notify(MockJobs::Job const& _job);
+	void broadcast(MockJobs::Job const& _job);
+	void dropAll(boost::system::error_code const& ec);
+	void dropSessions();
+	static std::string notifyParams(MockJobs::Job const& _job);
+
+	MockJobs& m_jobs;
+	Settings m_settings;
+	unsigned m_port = 0;
+
+	boost::asio::io_service m_io;
+	std::unique_ptr<boost::asio::io_service::work> m_work;
+	boost::asio::ip::tcp::acceptor m_acceptor;
+	boost::asio::deadline_timer m_dropTimer;
+	boost::thread m_ioThread;
+	std::vector<SessionPtr> m_sessions;
+	bool m_stalled = false;
+	// when each remote address was last dropped by us, to time the reconnect.
+	std::map<std::string, SteadyClock::time_point> m_dropped;
+
+	dev::Mutex x_stats;
+	Stats m_stats;
+	dev::LatencyHistogram m_shareAge;		// job issued -> share for it received
+	dev::LatencyHistogram m_reconnect;		// dropped -> subscribed again
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class MockNode
+*----------------------------------------------------------------------------------*/
+class MockNode
+{
+public:
+	struct Settings
+	{
+		unsigned port = 0;
+		unsigned replyDelay = 0;		// ms
+		// host:port to POST new work to, like geth --miner.notify.  empty = don't push.
+		std::string notify;
+	};
+
+	struct Stats
+	{
+		unsigned requests = 0;
+		unsigned getWorks = 0;
+		unsigned awaitNewWorks = 0;
+		unsigned accepted = 0;
+		unsigned rejected = 0;
+		unsigned pushes = 0;
+		unsigned pushFailures = 0;
+	};
+
+	// Settings::port 0 picks a free port.  see port().
+	MockNode(MockJobs& _jobs, Settings const& _settings);
+	~MockNode();
+
+	unsigned port() const { return m_port; }
+	Stats stats() { dev::Guard l(x_stats); return m_stats; }
+	std::string summary();
+
+private:
+	struct Session
+	{
+		Session(boost::asio::io_service& _io) : socket(_io) {}
+		boost::asio::ip::tcp::socket socket;
+		boost::asio::streambuf buffer;
+		std::string response;
+		bool closed = false;
+	};
+	using SessionPtr = std::shared_ptr<Session>;
+
+	void accept();
+	void readHeaders(SessionPtr _s);
+	void readBody(SessionPtr _s, size_t _length);
+	void process(SessionPtr _s, std::string const& _body);
+	void respond(SessionPtr _s, Json::Value const& _id, Json::Value const& _result);
+	void send(SessionPtr _s, Json::Value const& _id, Json::Value const& _result);
+	void push(MockJobs::Job const& _job);
+	static Json::Value work(MockJobs::Job const& _job);
+
+	MockJobs& m_jobs;
+	Settings m_settings;
+	unsigned m_port = 0;
+
+	boost::asio::io_service m_io;
+	std::unique_ptr<boost::asio::io_service::work> m_work;
+	boost::asio::ip::tcp::acceptor m_acceptor;
+	boost::thread m_ioThread;
+	// eth_awaitNewWork requests waiting for the next job.
+	std::vector<std::pair<SessionPtr, Json::Value>> m_waiting;
+	std::unique_ptr<KeepAliveHttpClient> m_notifyClient;
+
+	dev::Mutex x_stats;
+	Stats m_stats;
+	dev::LatencyHistogram m_shareAge;
+};
+
+
+/*-----------------------------------------------------------------------------------
+* class MockMVisClient
+*----------------------------------------------------------------------------------*/
+class MockMVisClient
+{
+public:
+	struct Settings
+	{
+		std::string host = "127.0.0.1";
+		unsigned port = 5225;			// the miner's Network.UdpListen
+		unsigned returnPort = 0;		// 0 picks a free port.  see returnPort()
+		std::string password;
+		unsigned rpcVersion = 10;		// 11 and up get binary notifications
+		unsigned pingInterval = 1000;	// ms
+	};
+
+	struct Stats
+	{
+		unsigned pings = 0;
+		unsigned replies = 0;
+		unsigned lost = 0;
+		unsigned workPackages = 0;		// work_package notifications, JSON or binary
+		unsigned frames = 0;			// binary datagrams
+		unsigned other = 0;				// anything else the miner sent unasked
+	};
+
+	// keeps trying to connect until the miner lets us, and disconnects when destroyed.
+	MockMVisClient(Settings const& _settings);
+	~MockMVisClient();
+
+	unsigned returnPort() const { return m_returnPort; }
+	bool connected() const { return m_connected; }
+	// why the miner refused our last connect.  empty if it didn't.
+	std::string error() { dev::Guard l(x_stats); return m_error; }
+	Stats stats() { dev::Guard l(x_stats); return m_stats; }
+	std::string summary();
+	// sends a command, with the id and return_port filled in.
+	void command(Json::Value _cmd);
+
+private:
+	void send(Json::Value _cmd);
+	void receive();
+	void received(boost::system::error_code const& ec, std::size_t _bytes);
+	void receivedFrame(std::size_t _bytes);
+	void tick(boost::system::error_code const& ec);
+
+	Settings m_settings;
+	unsigned m_returnPort = 0;
+
+	boost::asio::io_service m_io;
+	boost::asio::ip::udp::socket m_socket;
+	boost::asio::ip::udp::endpoint m_miner;
+	boost::asio::ip::udp::endpoint m_from;
+	boost::asio::deadline_timer m_timer;
+	boost::thread m_ioThread;
+	std::array<char, 4096> m_buffer;
+
+	std::atomic<bool> m_connected = {false};
+	unsigned m_nextId = 1;
+	std::map<unsigned, SteadyClock::time_point> m_outstanding;
+
+	dev::Mutex x_stats;
+	Stats m_stats;
+	std::string m_error;
+	dev::LatencyHistogram m_roundTrip;
+};
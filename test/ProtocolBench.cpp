@@ -0,0 +1,167 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// how fast the protocol code is against the mock servers.  the numbers are printed with
+// --log_level=message.  the limits checked are far above what a healthy build does, so
+// they only catch something being badly wrong, not noise on a busy machine.
+
+#define BOOST_TEST_MODULE ProtocolBench
+#include <boost/test/unit_test.hpp>
+
+#include <future>
+#include <libdevcore/Histogram.h>
+#include <libethcore/WorkTrace.h>
+#include "ProtocolFixtures.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+
+BOOST_GLOBAL_FIXTURE(DefaultSettings);
+
+
+BOOST_AUTO_TEST_SUITE(Stratum)
+
+// one share at a time, so each one is the full round trip to the pool and back.
+BOOST_AUTO_TEST_CASE(shareLatency)
+{
+	unsigned const c_shares = 50;
+	StratumFixture f(jobSettings(c_never, 1));
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(job));
+
+	LatencyHistogram roundTrip;
+	for (unsigned i = 0; i < c_shares; i++)
+	{
+		// with difficulty 1 every nonce is a share.
+		EthashProofOfWork::Solution sol = solve(job, i);
+		std::promise<bool> answer;
+		auto sent = SteadyClock::now();
+		f.client->submitShare(job.header, sol.nonce, sol.mixHash, [&] (bool _accepted) { answer.set_value(_accepted); });
+		auto verdict = answer.get_future();
+		BOOST_REQUIRE(verdict.wait_for(std::chrono::seconds(5)) == future_status::ready);
+		roundTrip.record(SteadyClock::now() - sent);
+		BOOST_REQUIRE(verdict.get());
+	}
+	BOOST_TEST_MESSAGE("share round trip : " << roundTrip.summary());
+	BOOST_CHECK_LT(roundTrip.percentileMs(50), 100);
+}
+
+// every share sent at once.  the pool verifies each one, so this is mostly the pool's speed,
+// but it also shows up a client that serializes its requests.
+BOOST_AUTO_TEST_CASE(shareThroughput)
+{
+	unsigned const c_shares = 200;
+	StratumFixture f(jobSettings(c_never, 1));
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(job));
+
+	// solved up front, so hashing isn't part of the timing.
+	vector<EthashProofOfWork::Solution> sols;
+	for (unsigned i = 0; i < c_shares; i++)
+		sols.push_back(solve(job, i));
+
+	Mutex x_answers;
+	LatencyHistogram roundTrip;
+	unsigned answered = 0;
+	unsigned accepted = 0;
+	auto start = SteadyClock::now();
+	for (auto const& sol : sols)
+	{
+		auto sent = SteadyClock::now();
+		f.client->submitShare(job.header, sol.nonce, sol.mixHash, [&, sent] (bool _accepted) {
+			Guard l(x_answers);
+			roundTrip.record(SteadyClock::now() - sent);
+			answered++;
+			accepted += _accepted;
+		});
+	}
+	BOOST_REQUIRE(waitFor(60000, [&] () { Guard l(x_answers); return answered == c_shares; }));
+	double secs = std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now() - start).count() / 1e6;
+
+	BOOST_TEST_MESSAGE("share throughput : " << c_shares << " shares in " << secs << " s, " << c_shares / secs << " shares/s, round trip " << roundTrip.summary());
+	BOOST_CHECK_EQUAL(accepted, c_shares);
+	BOOST_CHECK_EQUAL(f.pool.stats().accepted, c_shares);
+	BOOST_CHECK_GT(c_shares / secs, 20);
+}
+
+// from the pool sending mining.notify to GenericFarm::setWork having the job, through the
+// client's real receive path.  WorkTrace's FarmSetWork stage covers the same path, but its
+// clock only starts once the notify has been read off the socket, so it's printed alongside
+// for comparison: the difference is the pool's send and the loopback.
+BOOST_AUTO_TEST_CASE(jobLatency)
+{
+	unsigned const c_jobs = 50;
+	StratumFixture f(jobSettings(c_never), MockPool::Settings(), false);
+	BOOST_REQUIRE(waitFor(2000, [&] () { return f.farm.work().headerHash == f.jobs.current().header; }));
+
+	Mutex x_set;
+	unsigned sets = 0;
+	SteadyClock::time_point lastSet;
+	f.farm.onSetWork([&] (uint64_t) {
+		Guard l(x_set);
+		sets++;
+		lastSet = SteadyClock::now();
+	});
+	WorkTrace::get().reset();
+
+	LatencyHistogram latency;
+	for (unsigned i = 0; i < c_jobs; i++)
+	{
+		unsigned before;
+		DEV_GUARDED(x_set)
+			before = sets;
+		MockJobs::Job job = f.jobs.issue();
+		BOOST_REQUIRE(waitFor(2000, [&] () { Guard l(x_set); return sets > before; }));
+		DEV_GUARDED(x_set)
+			latency.record(lastSet - job.issued);
+	}
+	f.farm.onSetWork([] (uint64_t) {});
+
+	BOOST_TEST_MESSAGE("notify -> setWork : " << latency.summary());
+	for (auto const& e : WorkTrace::get().snapshot())
+		if (e.stage == WorkTrace::FarmSetWork)
+			BOOST_TEST_MESSAGE("WorkTrace FarmSetWork : " << e.latency.summary());
+	BOOST_CHECK_LT(latency.percentileMs(50), 50);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(Failover)
+
+// from the pool we're mining on going away to the farm mining a backup's job.
+BOOST_AUTO_TEST_CASE(failoverTime)
+{
+	unsigned const c_runs = 3;
+	LatencyHistogram failover;
+	for (unsigned i = 0; i < c_runs; i++)
+	{
+		PoolManagerFixture f({MockPool::Settings(), MockPool::Settings()});
+		BOOST_REQUIRE(f.mining(0));
+		auto gone = SteadyClock::now();
+		f.pools[0].reset();
+		BOOST_REQUIRE(f.mining(1));
+		failover.record(SteadyClock::now() - gone);
+	}
+	BOOST_TEST_MESSAGE("failover : " << failover.summary());
+	// PoolManager looks at the pools twice a second.
+	BOOST_CHECK_LT(failover.maxUs() / 1000.0, 2000);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,211 @@
+#pragma once
+
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+// what the protocol tests and benchmarks share: settings, waiting, solving shares, and a
+// stratum client logged on to a mock pool.  include after boost/test/unit_test.hpp.
+
+#include <vector>
+#include <boost/filesystem/fstream.hpp>
+#include <libethcore/EthashAux.h>
+#include <libethcore/Farm.h>
+#include <libstratum/EthStratumClient.h>
+#include <libstratum/PoolManager.h>
+#include <ethminer/ProgOpt.h>
+#include "MockServers.h"
+
+
+namespace
+{
+
+// the farm reads its settings when it's constructed, so everything runs with an empty
+// ethminer.ini, i.e. the defaults.  tests that need something else Put() it.
+struct DefaultSettings
+{
+	DefaultSettings(): ini(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("ethminer-%%%%-%%%%.ini"))
+	{
+		boost::filesystem::ofstream(ini).close();
+		ProgOpt::Load(ini.string());
+	}
+	~DefaultSettings()
+	{
+		boost::system::error_code ec;
+		boost::filesystem::remove(ini, ec);
+	}
+	boost::filesystem::path ini;
+};
+
+// jobs are only issued when a test asks for one.
+unsigned const c_never = 3600 * 1000;
+
+template <class _Pred>
+bool waitFor(unsigned _ms, _Pred _pred)
+{
+	auto until = SteadyClock::now() + std::chrono::milliseconds(_ms);
+	while (!_pred())
+	{
+		if (SteadyClock::now() > until)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return true;
+}
+
+// a port nobody is listening on, as far as we can tell.
+unsigned freePort()
+{
+	boost::asio::io_service io;
+	boost::asio::ip::tcp::acceptor a(io, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 0));
+	return a.local_endpoint().port();
+}
+
+unsigned freeUdpPort()
+{
+	boost::asio::io_service io;
+	boost::asio::ip::udp::socket s(io, boost::asio::ip::udp::endpoint(boost::asio::ip::udp::v4(), 0));
+	return s.local_endpoint().port();
+}
+
+dev::eth::EthashProofOfWork::Solution solve(MockJobs::Job const& _job, uint64_t _from = 0)
+{
+	auto light = dev::eth::EthashAux::light(_job.seed);
+	for (uint64_t n = _from; ; n++)
+	{
+		dev::eth::Nonce nonce((dev::u64) n);
+		dev::eth::EthashProofOfWork::Result r = light->compute(_job.header, nonce);
+		if (r.value < _job.boundary)
+			return dev::eth::EthashProofOfWork::Solution{nonce, r.mixHash};
+	}
+}
+
+MockJobs::Settings jobSettings(unsigned _interval, uint64_t _difficulty = 1ull << 32)
+{
+	MockJobs::Settings s;
+	s.interval = _interval;
+	s.difficulty = _difficulty;
+	return s;
+}
+
+// a mock pool with an EthStratumClient logged on to it.  by default the client runs managed,
+// the way PoolManager uses it, so jobs come to us rather than to the farm.
+struct StratumFixture
+{
+	StratumFixture(MockJobs::Settings const& _jobs, MockPool::Settings const& _pool = MockPool::Settings(), bool _managed = true):
+		jobs(_jobs), pool(jobs, _pool)
+	{
+		jobs.start();
+		EthStratumClient::JobFn onJob;
+		if (_managed)
+			onJob = [this] (dev::eth::EthashProofOfWork::WorkPackage const&, unsigned) { dispatched++; };
+		client.reset(new EthStratumClient(&farm, dev::eth::MinerType::CPU, "127.0.0.1", dev::toString(pool.port()), "", 0, 180, onJob));
+		BOOST_REQUIRE(waitFor(5000, [&] () { return client->isConnected() && client->current(); }));
+	}
+
+	~StratumFixture()
+	{
+		BOOST_TEST_MESSAGE(pool.summary());
+		client.reset();
+	}
+
+	// waits for the client to be working on _job.
+	bool onJob(MockJobs::Job const& _job)
+	{
+		return waitFor(2000, [&] () { return client->currentHeaderHash() == _job.header; });
+	}
+
+	MockJobs jobs;
+	MockPool pool;
+	dev::eth::GenericFarm<dev::eth::EthashProofOfWork> farm;
+	std::unique_ptr<EthStratumClient> client;
+	std::atomic<unsigned> dispatched = {0};
+};
+
+// a PoolManager on a farm, over one mock pool per entry of _pools, each with its own jobs.
+// every job the farm is handed is recorded, so a test can tell whether a switch happened
+// in one step or went through a pause.
+struct PoolManagerFixture
+{
+	PoolManagerFixture(std::vector<MockPool::Settings> const& _pools, PoolManager::Settings const& _settings = PoolManager::Settings())
+	{
+		std::vector<PoolManager::Pool> pools;
+		for (auto const& ps : _pools)
+		{
+			// easy shares, and block numbers from 1, since PoolManager takes block 0 to mean
+			// a pool that doesn't send them.
+			MockJobs::Settings js = jobSettings(c_never, 2);
+			js.block = 1;
+			jobs.emplace_back(new MockJobs(js));
+			jobs.back()->start();
+			this->pools.emplace_back(new MockPool(*jobs.back(), ps));
+			pools.push_back(PoolManager::Pool{"127.0.0.1", dev::toString(this->pools.back()->port()), ""});
+		}
+		manager.reset(new PoolManager(&farm, dev::eth::MinerType::CPU, pools, _settings));
+		manager->onWorkPackage([this] (unsigned) {
+			dev::Guard l(x_seen);
+			seen.push_back(farm.work().headerHash);
+		});
+	}
+
+	~PoolManagerFixture()
+	{
+		for (auto const& p : pools)
+			if (p)
+				BOOST_TEST_MESSAGE(p->summary());
+		manager.reset();
+	}
+
+	// waits for the farm to be mining pool _pool's current job.
+	bool mining(unsigned _pool, unsigned _ms = 5000)
+	{
+		return waitFor(_ms, [&] () { return manager->active() == (int) _pool && farm.work().headerHash == jobs[_pool]->current().header; });
+	}
+
+	// a miner finds a share for the job the farm is on, which is submitted to the active pool.
+	void submit(uint64_t _nonce)
+	{
+		int active = manager->active();
+		if (active >= 0)
+			farm.submitProof(solve(jobs[active]->current(), _nonce), nullptr);
+	}
+
+	// every pool moves on to a new block.
+	void newBlock()
+	{
+		for (auto const& j : jobs)
+			j->issue(true);
+	}
+
+	// the jobs the farm has been handed since the last call.
+	std::vector<dev::h256> takeSeen()
+	{
+		dev::Guard l(x_seen);
+		std::vector<dev::h256> ret;
+		ret.swap(seen);
+		return ret;
+	}
+
+	std::vector<std::unique_ptr<MockJobs>> jobs;
+	std::vector<std::unique_ptr<MockPool>> pools;
+	dev::eth::GenericFarm<dev::eth::EthashProofOfWork> farm;
+	std::unique_ptr<PoolManager> manager;
+	dev::Mutex x_seen;
+	std::vector<dev::h256> seen;
+};
+
+}
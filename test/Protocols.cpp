@@ -0,0 +1,525 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_MODULE Protocols
+#include <boost/test/unit_test.hpp>
+
+#include <future>
+#include <libethcore/EthashAux.h>
+#include <libethcore/Farm.h>
+#include <libethcore/WorkTrace.h>
+#include <libdevcore/CommonJS.h>
+#include <libstratum/EthStratumClient.h>
+#include <libstratum/PoolManager.h>
+#include <libstratum/StratumProxy.h>
+#include <jsonrpccpp/client/connectors/httpclient.h>
+#include <ethminer/FarmClient.h>
+#include <ethminer/WorkFetcher.h>
+#include <ethminer/ProgOpt.h>
+#include <ethminer/Common.h>
+#include <ethminer/MultiLog.h>
+#include <ethminer/MVisRPC.h>
+#include "ProtocolFixtures.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+
+namespace
+{
+
+string const c_mvisPassword = "mock";
+
+// MVisRPC can't be torn down: its UDP socket and timers live as long as the process.  so the
+// MVis tests share one miner, and take turns connecting to it.
+struct MVisMiner
+{
+	static MVisMiner& get()
+	{
+		static MVisMiner* s_miner = new MVisMiner;
+		return *s_miner;
+	}
+
+	MVisMiner(): port(freeUdpPort())
+	{
+		ProgOpt::Put("Network", "UdpListen", port);
+		ProgOpt::Put("Network", "UdpPassword", c_mvisPassword);
+		rpc = new MVisRPC(farm);
+		// connecting only needs a node to be configured.  none of these tests talk to it.
+		rpc->configNodeRPC("http://127.0.0.1:" + toString(freePort()));
+	}
+
+	// hands the farm a job it hasn't seen.
+	void newWork()
+	{
+		EthashProofOfWork::WorkPackage wp;
+		wp.headerHash = sha3(toString(++jobs));
+		wp.seedHash = EthashAux::seedHash(0);
+		wp.boundary = h256(u256(1) << 224);
+		farm.setWork(wp);
+	}
+
+	unsigned port;
+	unsigned jobs = 0;
+	GenericFarm<EthashProofOfWork> farm;
+	MVisRPC* rpc;
+};
+
+// quick to give up on a pool, so the tests don't take long.
+PoolManager::Settings poolSettings()
+{
+	PoolManager::Settings s;
+	s.maxJobLag = 300;
+	s.switchBackDelay = 1;
+	return s;
+}
+
+MockMVisClient::Settings mvisSettings(unsigned _rpcVersion = 10, string const& _password = c_mvisPassword)
+{
+	MockMVisClient::Settings s;
+	s.port = MVisMiner::get().port;
+	s.password = _password;
+	s.rpcVersion = _rpcVersion;
+	s.pingInterval = 100;
+	return s;
+}
+
+}
+
+
+BOOST_GLOBAL_FIXTURE(DefaultSettings);
+
+
+BOOST_AUTO_TEST_SUITE(Stratum)
+
+BOOST_AUTO_TEST_CASE(followsJobs)
+{
+	StratumFixture f(jobSettings(c_never));
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(job));
+
+	for (unsigned i = 0; i < 3; i++)
+	{
+		job = f.jobs.issue();
+		BOOST_REQUIRE(f.onJob(job));
+		EthashProofOfWork::WorkPackage wp = f.client->currentWork();
+		BOOST_CHECK_EQUAL(wp.seedHash, job.seed);
+		BOOST_CHECK_EQUAL(wp.boundary, job.boundary);
+		BOOST_CHECK_EQUAL(f.client->currentBlock(), job.block);
+	}
+	BOOST_CHECK_EQUAL(f.pool.stats().connections, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(sharesAreAnswered)
+{
+	StratumFixture f(jobSettings(c_never, 2));
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(job));
+
+	EthashProofOfWork::Solution sol = solve(job);
+	BOOST_REQUIRE(f.client->submit(sol));
+	BOOST_REQUIRE(waitFor(5000, [&] () { return f.client->accepted() == 1; }));
+	BOOST_CHECK_EQUAL(f.client->rejected(), 0u);
+	BOOST_CHECK_EQUAL(f.pool.stats().accepted, 1u);
+	BOOST_CHECK_EQUAL(f.client->pendingShares(), 0u);
+
+	// forwarded shares aren't checked by the client, so the pool gets to refuse this one.
+	std::promise<bool> answer;
+	f.client->submitShare(job.header, sol.nonce, h256(1), [&] (bool _accepted) { answer.set_value(_accepted); });
+	auto verdict = answer.get_future();
+	BOOST_REQUIRE(verdict.wait_for(std::chrono::seconds(5)) == future_status::ready);
+	BOOST_CHECK(!verdict.get());
+	BOOST_CHECK_EQUAL(f.pool.stats().invalid, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(rejectedShares)
+{
+	MockPool::Settings ps;
+	ps.rejectRate = 100;
+	StratumFixture f(jobSettings(c_never, 2), ps);
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(job));
+
+	BOOST_REQUIRE(f.client->submit(solve(job)));
+	BOOST_REQUIRE(waitFor(5000, [&] () { return f.client->rejected() == 1; }));
+	BOOST_CHECK_EQUAL(f.client->accepted(), 0u);
+	BOOST_CHECK_EQUAL(f.pool.stats().rejected, 1u);
+}
+
+// handing the current job out again with a new nonce range mustn't cost us the previous
+// job: shares for it are still worth submitting as stale.
+BOOST_AUTO_TEST_CASE(restartKeepsThePreviousJob)
+{
+	StratumFixture f(jobSettings(c_never, 2));
+	MockJobs::Job previous = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(previous));
+	MockJobs::Job job = f.jobs.issue();
+	BOOST_REQUIRE(f.onJob(job));
+
+	unsigned dispatched = f.dispatched;
+	f.client->setLocalPartitionBits(1);
+	BOOST_REQUIRE(waitFor(2000, [&] () { return f.dispatched > dispatched; }));
+	BOOST_CHECK_EQUAL(f.client->currentHeaderHash(), job.header);
+
+	BOOST_REQUIRE(f.client->submit(solve(previous)));
+	BOOST_REQUIRE(waitFor(5000, [&] () { return f.client->accepted() == 1; }));
+	BOOST_CHECK_EQUAL(f.pool.stats().stale, 1u);
+}
+
+// the same job with a narrower nonce range has to reach the miners, or they keep searching
+// the slots a proxy has handed out downstream.
+BOOST_AUTO_TEST_CASE(restartReachesTheFarm)
+{
+	StratumFixture f(jobSettings(c_never), MockPool::Settings(), false);
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(waitFor(2000, [&] () { return f.farm.work().headerHash == job.header; }));
+	int bits = f.farm.work().exSizeBits;
+
+	f.client->setLocalPartitionBits(2);
+	BOOST_REQUIRE(waitFor(2000, [&] () { return f.farm.work().exSizeBits != bits; }));
+	EthashProofOfWork::WorkPackage wp = f.farm.work();
+	BOOST_CHECK_EQUAL(wp.headerHash, job.header);
+	BOOST_CHECK_EQUAL(wp.exSizeBits, max(bits, 0) + 2);
+}
+
+BOOST_AUTO_TEST_CASE(reconnectsWhenDropped)
+{
+	StratumFixture f(jobSettings(c_never));
+	f.pool.drop();
+	BOOST_REQUIRE(waitFor(2000, [&] () { return !f.client->isConnected(); }));
+	// the client waits a few seconds before reconnecting.
+	BOOST_REQUIRE(waitFor(15000, [&] () { return f.client->isConnected(); }));
+	BOOST_CHECK_EQUAL(f.pool.stats().connections, 2u);
+
+	// and is subscribed again.
+	MockJobs::Job job = f.jobs.issue();
+	BOOST_CHECK(f.onJob(job));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(Failover)
+
+// reconnectsWhenDropped only ever gets the client back to the same pool.  with backups,
+// PoolManager moves the farm to one as soon as the pool it's mining on goes away.
+BOOST_AUTO_TEST_CASE(failsOverWhenThePoolGoesAway)
+{
+	PoolManagerFixture f({MockPool::Settings(), MockPool::Settings()});
+	BOOST_REQUIRE(f.mining(0));
+	f.takeSeen();
+
+	f.pools[0].reset();
+	BOOST_REQUIRE(f.mining(1));
+	// straight to the backup's job, without pausing in between.
+	vector<h256> seen = f.takeSeen();
+	BOOST_REQUIRE_EQUAL(seen.size(), 1u);
+	BOOST_CHECK_EQUAL(seen[0], f.jobs[1]->current().header);
+
+	// and the backup's jobs are followed from then on.
+	MockJobs::Job job = f.jobs[1]->issue();
+	BOOST_CHECK(waitFor(2000, [&] () { return f.farm.work().headerHash == job.header; }));
+}
+
+BOOST_AUTO_TEST_CASE(leavesAStalledPool)
+{
+	PoolManagerFixture f({MockPool::Settings(), MockPool::Settings()}, poolSettings());
+	BOOST_REQUIRE(f.mining(0));
+	f.takeSeen();
+
+	// the primary stays connected, but never gets to the next block.
+	f.pools[0]->stall(true);
+	f.newBlock();
+	BOOST_REQUIRE(f.mining(1));
+	BOOST_CHECK(f.takeSeen() == vector<h256>{f.jobs[1]->current().header});
+}
+
+BOOST_AUTO_TEST_CASE(leavesAPoolWhoseJobsLag)
+{
+	MockPool::Settings slow;
+	slow.notifyDelay = 1500;
+	PoolManagerFixture f({slow, MockPool::Settings()}, poolSettings());
+	BOOST_REQUIRE(f.mining(0));
+	f.takeSeen();
+
+	// the primary does pass every job on, just too late.
+	f.newBlock();
+	BOOST_REQUIRE(f.mining(1, 1400));
+	BOOST_CHECK(f.takeSeen() == vector<h256>{f.jobs[1]->current().header});
+}
+
+BOOST_AUTO_TEST_CASE(leavesAPoolThatRejectsShares)
+{
+	PoolManagerFixture f({MockPool::Settings(), MockPool::Settings()}, poolSettings());
+	BOOST_REQUIRE(f.mining(0));
+	for (unsigned i = 0; i < 4; i++)
+		f.submit(i);
+	BOOST_REQUIRE(waitFor(5000, [&] () { return f.pools[0]->stats().accepted == 4; }));
+	// a few accepted shares aren't judged, and neither are a few rejected ones.
+	BOOST_CHECK_EQUAL(f.manager->active(), 0);
+	f.takeSeen();
+
+	f.pools[0]->setRejectRate(100);
+	for (unsigned i = 4; i < 16 && f.manager->active() == 0; i++)
+	{
+		f.submit(i);
+		waitFor(200, [&] () { return f.pools[0]->stats().rejected > i - 4; });
+	}
+	BOOST_REQUIRE(f.mining(1));
+	BOOST_CHECK_GE(f.pools[0]->stats().rejected, 4u);
+	BOOST_CHECK(f.takeSeen() == vector<h256>{f.jobs[1]->current().header});
+}
+
+BOOST_AUTO_TEST_CASE(switchesBackOnceThePrimaryRecovers)
+{
+	PoolManager::Settings ps = poolSettings();
+	ps.switchBackDelay = 2;
+	PoolManagerFixture f({MockPool::Settings(), MockPool::Settings()}, ps);
+	BOOST_REQUIRE(f.mining(0));
+	f.pools[0]->stall(true);
+	f.newBlock();
+	BOOST_REQUIRE(f.mining(1));
+
+	f.pools[0]->stall(false);
+	f.newBlock();
+	auto recovered = SteadyClock::now();
+	BOOST_REQUIRE(f.mining(1));
+	f.takeSeen();
+
+	// not straight away: the primary has to stay healthy for switchBackDelay first.
+	BOOST_REQUIRE(f.mining(0, 10000));
+	BOOST_CHECK_GE(std::chrono::duration_cast<std::chrono::milliseconds>(SteadyClock::now() - recovered).count(), 1500);
+	BOOST_CHECK(f.takeSeen() == vector<h256>{f.jobs[0]->current().header});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(Proxy)
+
+// two miners mining through a proxy on our connection to the pool.  each gets a slot of its
+// own, its shares reach the pool and are accounted to it, and a share sent twice is only
+// forwarded once.
+BOOST_AUTO_TEST_CASE(forwardsSharesFromEachSlot)
+{
+	StratumFixture f(jobSettings(c_never, 2), MockPool::Settings(), false);
+	MockJobs::Job job = f.jobs.current();
+	BOOST_REQUIRE(f.onJob(job));
+
+	StratumProxy::Settings ps;
+	ps.port = freePort();
+	ps.extraNonceBits = 2;
+	StratumProxy proxy(*f.client, ps);
+	// our own farm keeps slot 0.
+	BOOST_REQUIRE(waitFor(2000, [&] () { return f.farm.work().exSizeBits == 2; }));
+	BOOST_CHECK_EQUAL(f.farm.work().startNonce, 0u);
+
+	GenericFarm<EthashProofOfWork> farms[2];
+	unique_ptr<EthStratumClient> miners[2];
+	for (unsigned i = 0; i < 2; i++)
+	{
+		miners[i].reset(new EthStratumClient(&farms[i], MinerType::CPU, "127.0.0.1", toString(ps.port), "", 0, 180,
+			[] (EthashProofOfWork::WorkPackage const&, unsigned) {}));
+		BOOST_REQUIRE(waitFor(5000, [&] () {
+			EthashProofOfWork::WorkPackage wp = miners[i]->currentWork();
+			return miners[i]->isConnected() && wp.headerHash == job.header && wp.exSizeBits == 2;
+		}));
+	}
+	BOOST_REQUIRE(waitFor(2000, [&] () { return proxy.sessionCount() == 2; }));
+	uint64_t starts[2] = {miners[0]->currentWork().startNonce, miners[1]->currentWork().startNonce};
+	BOOST_CHECK_NE(starts[0], starts[1]);
+	for (uint64_t start : starts)
+		BOOST_CHECK(start == 1ull << 62 || start == 2ull << 62);
+
+	// two shares from the first miner, one from the second, and the first miner's first
+	// share again.
+	EthashProofOfWork::Solution first = solve(job, starts[0]);
+	EthashProofOfWork::Solution second = solve(job, fromBigEndian<uint64_t>(first.nonce.ref()) + 1);
+	BOOST_REQUIRE(miners[0]->submit(first));
+	BOOST_REQUIRE(miners[0]->submit(second));
+	BOOST_REQUIRE(miners[1]->submit(solve(job, starts[1])));
+	BOOST_REQUIRE(waitFor(5000, [&] () { return miners[0]->accepted() == 2 && miners[1]->accepted() == 1; }));
+	BOOST_REQUIRE(miners[0]->submit(first));
+	BOOST_REQUIRE(waitFor(5000, [&] () { return miners[0]->rejected() == 1; }));
+
+	BOOST_CHECK_EQUAL(f.pool.stats().accepted, 3u);
+	BOOST_CHECK_EQUAL(f.pool.stats().invalid, 0u);
+	BOOST_CHECK_EQUAL(miners[1]->rejected(), 0u);
+	string summary = proxy.summary();
+	BOOST_TEST_MESSAGE(summary);
+	BOOST_CHECK(summary.find("slot " + toString(starts[0] >> 62) + " : ") != string::npos);
+	BOOST_CHECK(summary.find("2 shares, 2 accepted, 0 rejected, 0 stale, 1 invalid") != string::npos);
+	BOOST_CHECK(summary.find("1 shares, 1 accepted, 0 rejected, 0 stale, 0 invalid") != string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(GetWork)
+
+BOOST_AUTO_TEST_CASE(polls)
+{
+	MockJobs jobs(jobSettings(c_never));
+	MockNode node(jobs, MockNode::Settings());
+	WorkFetcher fetcher("127.0.0.1", toString(node.port()), WorkFetcher::Mode::Poll, 100, 0);
+
+	WorkFetcher::Work w;
+	MockJobs::Job job = jobs.current();
+	BOOST_REQUIRE(fetcher.waitForWork(3000, w));
+	BOOST_CHECK_EQUAL(w.header, job.header);
+	BOOST_CHECK_EQUAL(w.seed, job.seed);
+	BOOST_CHECK_EQUAL(w.boundary, job.boundary);
+
+	// the same work isn't handed out twice, however often we ask for it.
+	unsigned asked = node.stats().getWorks;
+	BOOST_CHECK(!fetcher.waitForWork(500, w));
+	BOOST_CHECK_GT(node.stats().getWorks, asked + 1);
+
+	job = jobs.issue();
+	BOOST_REQUIRE(fetcher.waitForWork(3000, w));
+	BOOST_CHECK_EQUAL(w.header, job.header);
+}
+
+BOOST_AUTO_TEST_CASE(longPolls)
+{
+	MockJobs jobs(jobSettings(c_never));
+	MockNode node(jobs, MockNode::Settings());
+	WorkFetcher fetcher("127.0.0.1", toString(node.port()), WorkFetcher::Mode::LongPoll, c_never, 0);
+
+	WorkFetcher::Work w;
+	BOOST_REQUIRE(fetcher.waitForWork(3000, w));
+	BOOST_REQUIRE(waitFor(2000, [&] () { return node.stats().awaitNewWorks > 0; }));
+
+	// with polling this would take an hour.
+	MockJobs::Job job = jobs.issue();
+	BOOST_REQUIRE(fetcher.waitForWork(2000, w));
+	BOOST_CHECK_EQUAL(w.header, job.header);
+	BOOST_CHECK(fetcher.mode() == WorkFetcher::Mode::LongPoll);
+}
+
+BOOST_AUTO_TEST_CASE(takesPushedWork)
+{
+	unsigned pushPort = freePort();
+	MockJobs jobs(jobSettings(c_never));
+	MockNode::Settings ns;
+	ns.notify = "127.0.0.1:" + toString(pushPort);
+	MockNode node(jobs, ns);
+	WorkFetcher fetcher("127.0.0.1", toString(node.port()), WorkFetcher::Mode::Push, c_never, pushPort);
+
+	WorkFetcher::Work w;
+	BOOST_REQUIRE(fetcher.waitForWork(3000, w));
+
+	// in push mode the node is only polled every few seconds, so this has to be the push.
+	MockJobs::Job job;
+	BOOST_REQUIRE(waitFor(3000, [&] () {
+		job = jobs.issue();
+		return fetcher.waitForWork(500, w);
+	}));
+	BOOST_CHECK_EQUAL(w.header, job.header);
+	BOOST_CHECK_GE(node.stats().pushes, 1u);
+}
+
+// a request that timed out may still have been acted on, so it's never sent again, not even
+// on a kept-alive connection that might have gone stale.
+BOOST_AUTO_TEST_CASE(doesntResendAfterATimeout)
+{
+	MockJobs jobs(jobSettings(c_never));
+	MockNode::Settings ns;
+	ns.replyDelay = 300;
+	MockNode node(jobs, ns);
+	KeepAliveHttpClient client("127.0.0.1", toString(node.port()));
+	client.post("{\"jsonrpc\":\"2.0\",\"id\":1,\"method\":\"eth_getWork\",\"params\":[]}");
+
+	client.setTimeout(100);
+	BOOST_CHECK_THROW(client.post("{\"jsonrpc\":\"2.0\",\"id\":2,\"method\":\"eth_submitHashrate\",\"params\":[]}"), jsonrpc::JsonRpcException);
+	this_thread::sleep_for(std::chrono::milliseconds(500));
+	BOOST_CHECK_EQUAL(node.stats().requests, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(reportsAnUnreachableNode)
+{
+	WorkFetcher fetcher("127.0.0.1", toString(freePort()), WorkFetcher::Mode::Poll, 100, 0);
+	WorkFetcher::Work w;
+	BOOST_CHECK_THROW(fetcher.waitForWork(3000, w), jsonrpc::JsonRpcException);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_SUITE(MVis)
+
+BOOST_AUTO_TEST_CASE(answersPings)
+{
+	MockMVisClient client(mvisSettings());
+	BOOST_REQUIRE(waitFor(5000, [&] () { return client.connected(); }));
+	BOOST_REQUIRE(waitFor(3000, [&] () { return client.stats().replies >= 5; }));
+	BOOST_CHECK_EQUAL(client.stats().lost, 0u);
+	BOOST_CHECK_EQUAL(client.error(), "");
+	BOOST_TEST_MESSAGE(client.summary());
+}
+
+BOOST_AUTO_TEST_CASE(refusesAWrongPassword)
+{
+	{
+		MockMVisClient client(mvisSettings(10, "wrong"));
+		BOOST_REQUIRE(waitFor(5000, [&] () { return !client.error().empty(); }));
+		BOOST_CHECK(!client.connected());
+	}
+	// the caller that was turned away mustn't keep anybody else out.
+	MockMVisClient client(mvisSettings());
+	BOOST_CHECK(waitFor(5000, [&] () { return client.connected(); }));
+}
+
+BOOST_AUTO_TEST_CASE(notifiesWorkPackages)
+{
+	MVisMiner& miner = MVisMiner::get();
+	MockMVisClient client(mvisSettings());
+	BOOST_REQUIRE(waitFor(5000, [&] () { return client.connected(); }));
+	Json::Value cmd;
+	cmd["command"] = "work_package";
+	cmd["rate"] = RATE_ON_CHANGE;
+	client.command(cmd);
+
+	// the command may still be on its way, so keep handing out work until it's reported.
+	BOOST_REQUIRE(waitFor(3000, [&] () {
+		miner.newWork();
+		return client.stats().workPackages > 0;
+	}));
+	BOOST_CHECK_EQUAL(client.stats().frames, 0u);
+}
+
+// clients from rpc_version 11 get their notifications in binary frames.
+BOOST_AUTO_TEST_CASE(notifiesInBinaryFrames)
+{
+	MVisMiner& miner = MVisMiner::get();
+	MockMVisClient client(mvisSettings(11));
+	BOOST_REQUIRE(waitFor(5000, [&] () { return client.connected(); }));
+	Json::Value cmd;
+	cmd["command"] = "work_package";
+	cmd["rate"] = RATE_ON_CHANGE;
+	client.command(cmd);
+
+	BOOST_REQUIRE(waitFor(3000, [&] () {
+		miner.newWork();
+		return client.stats().workPackages > 0;
+	}));
+	BOOST_CHECK_GT(client.stats().frames, 0u);
+	BOOST_TEST_MESSAGE(client.summary());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
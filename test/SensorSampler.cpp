@@ -0,0 +1,157 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_MODULE SensorSampler
+#include <boost/test/unit_test.hpp>
+
+#include <thread>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#include <ethminer/SensorSampler.h>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+
+namespace
+{
+
+// a throwaway /sys/class/drm with two GPUs, card0 and card10, and some entries that
+// aren't GPUs.
+struct FakeSysfs
+{
+	FakeSysfs(): root(fs::temp_directory_path() / fs::unique_path("ethminer-sysfs-%%%%-%%%%"))
+	{
+		fs::create_directories(root / "card0" / "device" / "hwmon" / "hwmon3");
+		fs::create_directories(root / "card0-DP-1");
+		fs::create_directories(root / "card1" / "device");
+		fs::create_directories(root / "card10" / "device" / "hwmon" / "hwmon0");
+		fs::create_directories(root / "renderD128");
+		write(0, "temp1_input", 65000);
+		write(0, "fan1_input", 1500);
+		write(0, "power1_average", 120000000);
+		write(1, "temp1_input", 50500);
+	}
+	~FakeSysfs()
+	{
+		boost::system::error_code ec;
+		fs::remove_all(root, ec);
+	}
+
+	fs::path hwmon(unsigned _gpu) const
+	{
+		return _gpu == 0 ? root / "card0" / "device" / "hwmon" / "hwmon3" : root / "card10" / "device" / "hwmon" / "hwmon0";
+	}
+	void write(unsigned _gpu, string const& _file, long long _value) const
+	{
+		ofstream f((hwmon(_gpu) / _file).string());
+		f << _value;
+	}
+	void remove(unsigned _gpu, string const& _file) const
+	{
+		fs::remove(hwmon(_gpu) / _file);
+	}
+
+	fs::path root;
+};
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(sensors)
+
+BOOST_AUTO_TEST_CASE(hwmonReadsEveryGpu)
+{
+	FakeSysfs sysfs;
+	HwmonSensorProvider provider(sysfs.root.string());
+
+	SensorReading r;
+	BOOST_REQUIRE(provider.read(0, r));
+	BOOST_CHECK_CLOSE(r.temp, 65.0, 0.001);
+	BOOST_CHECK_EQUAL(r.fanSpeed, 1500);
+	BOOST_CHECK_EQUAL(r.power, 120);
+
+	// card1 has no hwmon directory, so card10 is the second GPU.
+	r = SensorReading();
+	BOOST_REQUIRE(provider.read(1, r));
+	BOOST_CHECK_CLOSE(r.temp, 50.5, 0.001);
+	BOOST_CHECK_EQUAL(r.fanSpeed, 0);
+	BOOST_CHECK_EQUAL(r.power, 0);
+
+	BOOST_CHECK(!provider.read(2, r));
+}
+
+BOOST_AUTO_TEST_CASE(hwmonFallsBackToInstantaneousPower)
+{
+	FakeSysfs sysfs;
+	sysfs.write(1, "power1_input", 95000000);
+	HwmonSensorProvider provider(sysfs.root.string());
+
+	SensorReading r;
+	BOOST_REQUIRE(provider.read(1, r));
+	BOOST_CHECK_EQUAL(r.power, 95);
+}
+
+BOOST_AUTO_TEST_CASE(hwmonMissingRoot)
+{
+	HwmonSensorProvider provider((fs::temp_directory_path() / fs::unique_path("ethminer-none-%%%%-%%%%")).string());
+	SensorReading r;
+	BOOST_CHECK(!provider.read(0, r));
+}
+
+BOOST_AUTO_TEST_CASE(failedReadsLeaveTheStampAlone)
+{
+	FakeSysfs sysfs;
+	SensorSampler sampler;
+	sampler.start(new HwmonSensorProvider(sysfs.root.string()), 50);
+
+	// the first request is answered synchronously.
+	SensorReading first = sampler.reading(0);
+	BOOST_REQUIRE(first.stamp != SteadyClock::time_point());
+	BOOST_CHECK_CLOSE(first.temp, 65.0, 0.001);
+
+	// the driver stops answering.  the sampler keeps going, but the reading must not
+	// look any fresher than the last one that worked.
+	sysfs.remove(0, "temp1_input");
+	sysfs.remove(0, "fan1_input");
+	sysfs.remove(0, "power1_average");
+	this_thread::sleep_for(chrono::milliseconds(300));
+	SensorReading stale = sampler.reading(0);
+	BOOST_CHECK(stale.stamp == first.stamp);
+	BOOST_CHECK_CLOSE(stale.temp, 65.0, 0.001);
+	BOOST_CHECK_EQUAL(stale.power, 120);
+
+	// and picks up again when it comes back.
+	sysfs.write(0, "temp1_input", 71000);
+	SensorReading fresh;
+	for (int i = 0; i < 100; i++)
+	{
+		fresh = sampler.reading(0);
+		if (fresh.stamp != first.stamp)
+			break;
+		this_thread::sleep_for(chrono::milliseconds(20));
+	}
+	BOOST_CHECK(fresh.stamp > first.stamp);
+	BOOST_CHECK_CLOSE(fresh.temp, 71.0, 0.001);
+
+	// a device the provider doesn't know never gets a stamp.
+	BOOST_CHECK(sampler.reading(5).stamp == SteadyClock::time_point());
+	BOOST_CHECK(sampler.reading(SensorSampler::c_maxDevices + 1).stamp == SteadyClock::time_point());
+	sampler.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,108 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_MODULE StratumParser
+#include <boost/test/unit_test.hpp>
+
+#include <libstratum/StratumParser.h>
+
+using namespace std;
+using namespace dev;
+
+
+namespace
+{
+
+string const c_header = "1111111111111111111111111111111111111111111111111111111111111111";
+string const c_seed = "2222222222222222222222222222222222222222222222222222222222222222";
+string const c_boundary = "00000000ffffffffffffffffffffffffffffffffffffffffffffffffffffffff";
+
+bool parse(string const& _line, StratumParser::Message& _msg)
+{
+	return StratumParser::parse(_line.data(), _line.data() + _line.size(), _msg);
+}
+
+string notify(string const& _extra = ",\"0x4c4b40\"")
+{
+	return "{\"id\":0,\"method\":\"mining.notify\",\"params\":[\"0xabcd\",\"0x" + c_header + "\",\"0x" + c_seed
+		+ "\",\"0x" + c_boundary + "\"" + _extra + "],\"jsonrpc\":\"2.0\"}";
+}
+
+}
+
+
+BOOST_AUTO_TEST_CASE(notifyIsDecoded)
+{
+	StratumParser::Message msg;
+	BOOST_REQUIRE(parse(notify(), msg));
+	BOOST_CHECK(msg.kind == StratumParser::Message::Kind::Notify);
+	BOOST_CHECK_EQUAL(msg.header, h256(c_header));
+	BOOST_CHECK_EQUAL(msg.seed, h256(c_seed));
+	BOOST_CHECK_EQUAL(msg.boundary, h256(c_boundary));
+	BOOST_CHECK_EQUAL(msg.block, 0x4c4b40u);
+}
+
+BOOST_AUTO_TEST_CASE(notifyWithoutBlockNumber)
+{
+	StratumParser::Message msg;
+	BOOST_REQUIRE(parse(notify(""), msg));
+	BOOST_CHECK(msg.kind == StratumParser::Message::Kind::Notify);
+	BOOST_CHECK_EQUAL(msg.header, h256(c_header));
+	BOOST_CHECK_EQUAL(msg.block, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(submitReplies)
+{
+	StratumParser::Message msg;
+	BOOST_REQUIRE(parse("{\"id\":7,\"jsonrpc\":\"2.0\",\"result\":true,\"error\":null}", msg));
+	BOOST_CHECK(msg.kind == StratumParser::Message::Kind::Reply);
+	BOOST_CHECK_EQUAL(msg.id, 7u);
+	BOOST_CHECK(msg.result);
+
+	BOOST_REQUIRE(parse(" { \"id\" : 12 , \"result\" : false }\r", msg));
+	BOOST_CHECK_EQUAL(msg.id, 12u);
+	BOOST_CHECK(!msg.result);
+}
+
+// everything the fast path doesn't fully understand has to go to jsoncpp.
+BOOST_AUTO_TEST_CASE(leavesTheRestToJsoncpp)
+{
+	StratumParser::Message msg;
+	// errors get logged by the slow path.
+	BOOST_CHECK(!parse("{\"id\":4,\"result\":false,\"error\":[21,\"Stale share\",null]}", msg));
+	// the subscribe reply carries a job.
+	BOOST_CHECK(!parse("{\"id\":1,\"result\":[\"0x" + c_header + "\"],\"error\":null}", msg));
+	BOOST_CHECK(!parse("{\"id\":0,\"method\":\"mining.set_difficulty\",\"params\":[\"1\"]}", msg));
+	// short or malformed hashes.
+	BOOST_CHECK(!parse(notify().replace(notify().find(c_header), 2, ""), msg));
+	BOOST_CHECK(!parse(notify().replace(notify().find(c_seed), 1, "g"), msg));
+	// escapes, and anything after the object.
+	BOOST_CHECK(!parse("{\"id\":3,\"result\":true,\"x\":\"a\\\"b\"}", msg));
+	BOOST_CHECK(!parse("{\"id\":3,\"result\":true} x", msg));
+	BOOST_CHECK(!parse("", msg));
+}
+
+BOOST_AUTO_TEST_CASE(decodeHash)
+{
+	h256 h;
+	BOOST_CHECK(StratumParser::decodeHash(c_seed.data(), c_seed.data() + c_seed.size(), h));
+	BOOST_CHECK_EQUAL(h, h256(c_seed));
+	string upper = "0X" + string(64, 'A');
+	BOOST_CHECK(StratumParser::decodeHash(upper.data(), upper.data() + upper.size(), h));
+	BOOST_CHECK_EQUAL(h, h256(string(64, 'a')));
+	BOOST_CHECK(!StratumParser::decodeHash(upper.data(), upper.data() + upper.size() - 1, h));
+}
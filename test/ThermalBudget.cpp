@@ -0,0 +1,188 @@
+/*
+This file is part of mvis-ethereum.
+
+mvis-ethereum is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+mvis-ethereum is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with mvis-ethereum.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#define BOOST_TEST_MODULE ThermalBudget
+#include <boost/test/unit_test.hpp>
+
+#include <libethcore/ThermalBudget.h>
+
+using namespace std;
+using namespace dev::eth;
+
+
+namespace
+{
+
+// a rig of simulated GPUs, driven by the optimizer the way GenericFarm::balanceThermals
+// does it, at the farm's 2 second rate.
+struct SimulatedRig
+{
+	SimulatedRig(unsigned _devices, ThermalBudget const& _budget): devices(_devices)
+	{
+		optimizer.setBudget(_budget);
+	}
+
+	void run(unsigned _steps)
+	{
+		for (unsigned s = 0; s < _steps; s++)
+		{
+			vector<ThermalObservation> obs;
+			for (auto const& d : devices)
+				obs.push_back(d.observation());
+			optimizer.observe(obs);
+			vector<int> throttles = optimizer.allocate();
+			BOOST_REQUIRE_EQUAL(throttles.size(), devices.size());
+
+			if (throttles != last)
+				lastChange = steps;
+			last = throttles;
+			steps++;
+
+			for (unsigned i = 0; i < devices.size(); i++)
+				devices[i].throttle = throttles[i];
+			for (unsigned i = 0; i < devices.size(); i++)
+				devices[i].step(othersDuty(i), 2);
+		}
+	}
+
+	double othersDuty(unsigned _i) const
+	{
+		if (devices.size() < 2)
+			return 0;
+		double sum = 0;
+		for (unsigned j = 0; j < devices.size(); j++)
+			if (j != _i)
+				sum += throttleToDuty(devices[j].throttle);
+		return sum / (devices.size() - 1);
+	}
+	// where device _i's temperature ends up with the current throttles.
+	double steadyTemp(unsigned _i) const
+	{
+		SimulatedThermalDevice const& d = devices[_i];
+		return d.ambient + d.selfHeat * throttleToDuty(d.throttle) + d.coupling * othersDuty(_i);
+	}
+	double power() const
+	{
+		double p = 0;
+		for (auto const& d : devices)
+			p += d.observation().power;
+		return p;
+	}
+	double hashRate() const
+	{
+		double r = 0;
+		for (auto const& d : devices)
+			r += d.observation().hashRate;
+		return r;
+	}
+
+	vector<SimulatedThermalDevice> devices;
+	ThermalBudgetOptimizer optimizer;
+	vector<int> last;
+	unsigned steps = 0;
+	unsigned lastChange = 0;
+};
+
+}
+
+
+BOOST_AUTO_TEST_SUITE(thermalBudget)
+
+BOOST_AUTO_TEST_CASE(convergesUnderRigPowerBudget)
+{
+	ThermalBudget b;
+	b.maxTemp = 80;
+	b.rigPower = 500;
+	SimulatedRig rig(4, b);
+	// one card sits in a hot slot.
+	rig.devices[1].ambient = 42;
+	rig.devices[1].selfHeat = 50;
+
+	rig.run(300);
+
+	// settled: nothing has moved for the last 100 rounds.
+	BOOST_CHECK_LT(rig.lastChange, 200u);
+	BOOST_CHECK_LE(rig.power(), b.rigPower);
+	for (unsigned i = 0; i < rig.devices.size(); i++)
+	{
+		BOOST_CHECK_LE(rig.devices[i].temp, b.maxTemp);
+		BOOST_CHECK_LE(rig.steadyTemp(i), b.maxTemp);
+	}
+
+	// the power budget allows (500 - 4 * 30) / 150 of a card's worth of duty.  the optimizer
+	// works in 5% steps, so it can't quite get there, but it shouldn't leave much behind.
+	double best = (b.rigPower - 4 * 30) / 150 * 30;
+	BOOST_CHECK_GE(rig.hashRate(), best * 0.95);
+}
+
+BOOST_AUTO_TEST_CASE(convergesUnderTemperatureLimit)
+{
+	ThermalBudget b;
+	b.maxTemp = 75;
+	SimulatedRig rig(3, b);
+	// flat out, these would settle at 35 + 60 + 8 = 103C.
+	for (auto& d : rig.devices)
+	{
+		d.ambient = 35;
+		d.selfHeat = 60;
+	}
+	rig.devices[2].coupling = 12;
+
+	rig.run(300);
+
+	BOOST_CHECK_LT(rig.lastChange, 200u);
+	for (unsigned i = 0; i < rig.devices.size(); i++)
+	{
+		BOOST_CHECK_LE(rig.devices[i].temp, b.maxTemp);
+		BOOST_CHECK_LE(rig.steadyTemp(i), b.maxTemp);
+		// and not throttled any harder than it has to be.
+		BOOST_CHECK_GE(rig.steadyTemp(i), b.maxTemp - b.margin - 6);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(unconstrainedRigRunsFlatOut)
+{
+	ThermalBudget b;
+	b.maxTemp = 90;
+	SimulatedRig rig(2, b);
+	rig.run(100);
+	for (auto const& d : rig.devices)
+		BOOST_CHECK_EQUAL(d.throttle, 0);
+}
+
+BOOST_AUTO_TEST_CASE(modelLearnsTheDevice)
+{
+	ThermalBudget b;
+	b.maxTemp = 80;
+	b.rigPower = 450;
+	SimulatedRig rig(3, b);
+	rig.run(300);
+
+	for (unsigned i = 0; i < rig.devices.size(); i++)
+	{
+		SimulatedThermalDevice const& d = rig.devices[i];
+		DeviceThermalModel const& m = rig.optimizer.model(i);
+		double duty = throttleToDuty(d.throttle);
+		BOOST_CHECK(m.hasPower());
+		BOOST_CHECK_GT(m.samples(), 0u);
+		BOOST_CHECK_SMALL(m.predictTemp(duty, rig.othersDuty(i)) - rig.steadyTemp(i), 1.5);
+		BOOST_CHECK_SMALL(m.predictPower(duty) - (d.idlePower + d.loadPower * duty), 5.0);
+		BOOST_CHECK_SMALL(m.predictHashRate(duty) - d.fullRate * duty, 1.0);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()